@@ -0,0 +1,83 @@
+#ifndef NINETAILSX_CLOCK_H
+#define NINETAILSX_CLOCK_H
+#include <nxcore/helpers.h>
+#include <nxcore/simd.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+/**
+ * The clock.
+ *
+ * GetClockNanoseconds		A monotonic, high resolution timestamp in nanoseconds, from an arbitrary
+ * 							starting point. QueryPerformanceCounter on Windows, CLOCK_MONOTONIC_RAW
+ * 							on Linux, which unlike CLOCK_MONOTONIC isn't slewed by NTP, so a frame
+ * 							measured with it is the length it really was.
+ * SleepNanoseconds			Gives up the CPU for roughly the given time. It can wake late by however
+ * 							long the scheduler takes to get back to us, see pacer.h.
+ * SpinPause				Tells the CPU we are busy waiting, so it can save power and give the other
+ * 							hyperthread the core while we spin.
+ *
+ * NOTE:
+ * 			The QueryPerformanceCounter frequency is read the first time the clock is used, the
+ * 			same way the SIMD kernels are selected on first use.
+ */
+#if defined(_WIN32)
+global u64 __clock_frequency;
+
+inline u64
+GetClockNanoseconds()
+{
+	if (__clock_frequency == 0)
+	{
+		LARGE_INTEGER Frequency;
+		QueryPerformanceFrequency(&Frequency);
+		__clock_frequency = (u64)Frequency.QuadPart;
+	}
+
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+
+	// Split into whole seconds and the remainder, so the multiply can't overflow.
+	u64 _ticks = (u64)Counter.QuadPart;
+	return (_ticks / __clock_frequency) * 1000000000ull + ((_ticks % __clock_frequency) * 1000000000ull) / __clock_frequency;
+}
+
+inline void
+SleepNanoseconds(u64 nanoseconds)
+{
+	Sleep((DWORD)(nanoseconds / 1000000ull));
+}
+#else
+inline u64
+GetClockNanoseconds()
+{
+	struct timespec Timestamp;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &Timestamp);
+	return (u64)Timestamp.tv_sec*1000000000ull + (u64)Timestamp.tv_nsec;
+}
+
+inline void
+SleepNanoseconds(u64 nanoseconds)
+{
+	// clock_nanosleep won't sleep on CLOCK_MONOTONIC_RAW, the two only drift apart by parts per million.
+	struct timespec Duration;
+	Duration.tv_sec = (time_t)(nanoseconds / 1000000000ull);
+	Duration.tv_nsec = (long)(nanoseconds % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &Duration, &Duration) == EINTR);
+}
+#endif
+
+inline void
+SpinPause()
+{
+#if defined(NINETAILSX_ARCH_X86)
+	_mm_pause();
+#endif
+}
+
+#endif
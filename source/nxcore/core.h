@@ -5,29 +5,140 @@
 #ifndef NINETAILSX_CORE_H
 #define NINETAILSX_CORE_H
 #include <nxcore/helpers.h>
+#include <nxcore/memory.h>
 #include <nxcore/math.h>
 #include <nxcore/input.h>
 
+/**
+ * What the renderer did in the last frame, for sizing hosts and catching content which blows the
+ * fill budget.
+ *
+ * Pixels written are the ones which were actually drawn, tiles which didn't change since the last
+ * frame aren't drawn again and cost nothing. Pixels submitted are everything the frame's draws
+ * covered within the framebuffer, drawn or skipped, which is what the content would cost if every
+ * tile changed. Overdraw is the pixels written to the framebuffer over the pixels in it.
+ */
+typedef struct
+{
+	u64 framebufferPixels; // The native resolution the engine draws at.
+	u64 rectPixelsWritten; // Rects, clears included.
+	u64 bitmapPixelsWritten;
+	u64 linePixelsWritten;
+	u64 trianglePixelsWritten;
+	u64 presentPixelsWritten; // Scaling the framebuffer up into softwareBitmap.
+	u64 pixelsSubmitted;
+	u64 pixelsClipped; // Covered by draws, but outside the framebuffer.
+	r32 overdraw;
+
+	u32 blits; // Bitmap draws, counted once for every tile a bitmap was drawn into.
+	u32 tilesRasterized;
+	u32 commandsDropped; // Render commands pushed past the frame's capacity, which weren't drawn.
+	u64 memcopyBytes; // Copied by nx_memcopy while drawing and presenting.
+} render_stats;
+
+/**
+ * The regions of softwareBitmap which changed in the last frame, in bitmap coordinates (the
+ * origin is the lower-left corner). The platform only has to present these, unless it lost the
+ * contents of the window itself. The engine points renderStats at the last frame's stats.
+ *
+ * The platform sets fullRedraw to have every frame drawn and presented whole, whether anything
+ * changed or not. The headless runner times frames this way, a static scene costs nothing otherwise.
+ */
 typedef struct
 {
 	v2i dimensions;
 	void* softwareBitmap;
+	rect2i* dirtyRegions;
+	u32 dirtyRegionCount;
+	render_stats* renderStats;
+	b32 fullRedraw;
 } window_props;
 
+/**
+ * A resource file mapped read-only into memory. The contents come straight from the page cache as
+ * they are touched, nothing is read or copied up front, so data must not be written to.
+ */
+typedef struct
+{
+	void* data;
+	u64 size;
+} mapped_resource;
+
+/**
+ * Asynchronous resource requests.
+ *
+ * RequestResource sizes the file and pushes room for it on the given arena straight away, along
+ * with OutputSize bytes more for what the file is turned into, then returns a ticket while the
+ * platform's I/O threads read it in the background. A ticket of zero means the request couldn't be
+ * made. Process, if given, runs on the I/O thread once the file has been read. It gets an arena of
+ * its own over the output bytes, which is NULL without any, so decoding and pixel conversion into
+ * a format of a different size (ImportBitmap, DecodeQOI, DecodePNG) happen there too. It can fail
+ * the request by returning false. PollResources hands back the requests which finished since the
+ * last poll, with the output and how much of it the process pushed.
+ *
+ * NOTE:
+ * 			The buffers belong to the arena from the moment the request is made, so nothing may pop
+ * 			or reset past them until the request has completed.
+ */
+typedef u32 resource_ticket;
+typedef b32 fnptr_resource_process(void* Data, u64 Size, memarena_t* Output, void* UserData);
+
+typedef struct
+{
+	resource_ticket ticket;
+	b32 success;
+	void* data; // The file.
+	u64 size;
+	void* output; // The start of the process's output arena, NULL without one.
+	u64 outputSize; // Bytes the process pushed on it.
+	void* userData;
+} resource_completion;
+
 /** Platform -> Engine */
 typedef u32 fnptr_platform_fetch_res_file(char* RelativePath, void* Buffer, u32 BuffSize);
 typedef u32 fnptr_platform_fetch_res_size(char* RelativePath);
+typedef b32 fnptr_platform_map_res(const char* RelativePath, mapped_resource* Resource);
+typedef void fnptr_platform_unmap_res(mapped_resource* Resource);
+typedef resource_ticket fnptr_platform_request_res(char* RelativePath, memarena_t* Arena, u64 OutputSize, fnptr_resource_process* Process, void* UserData);
+typedef u32 fnptr_platform_poll_res(resource_completion* Completions, u32 MaxCount);
 
 typedef struct
 {
 	fnptr_platform_fetch_res_file* FetchResourceFile;
 	fnptr_platform_fetch_res_size* FetchResourceSize;
+	fnptr_platform_map_res* MapResource;
+	fnptr_platform_unmap_res* UnmapResource;
+	fnptr_platform_request_res* RequestResource;
+	fnptr_platform_poll_res* PollResources;
+
+	// The platform's profiler, which the engine records into as well (see profiler.h).
+	profiler* Profiler;
 } res_handler_interface;
 
-/** Engine -> Platform */
+/**
+ * Engine -> Platform
+ *
+ * The simulation and drawing are separate entry points. EngineUpdate advances the simulation by one
+ * fixed step and runs as many times a frame as the platform's accumulator says are due, which can
+ * be none. EngineRender then draws once, alpha of the way from the previous step to the latest one
+ * (see timestep.h). A non-zero return from either asks the platform to close.
+ *
+ * EngineShutdown stops the engine's worker threads. The platform calls it once on the way out,
+ * after the last frame, and nothing else may be called afterwards.
+ */
 typedef i32 fnptr_engine_init(void* memStore, u64 memSize, window_props* windowProps, res_handler_interface* ResHandler);
 typedef i32 fnptr_engine_reinit(void* memStore, u64 memSize, window_props* windowProps, res_handler_interface* ResHandler);
-typedef i32 fnptr_engine_runtime(window_props* windowProps, action_interface* InputHandle);
+typedef i32 fnptr_engine_update(action_interface* InputHandle);
+typedef i32 fnptr_engine_render(window_props* windowProps, r32 alpha);
+typedef void fnptr_engine_shutdown();
+
+/**
+ * The simulation's state, which input recordings start from and replays restore before feeding the
+ * recorded input back through EngineUpdate (see replay.h). Save returns the size of the state and
+ * only copies it out when the buffer is big enough, so it can be called with NULL to ask the size.
+ */
+typedef u64 fnptr_engine_save_state(void* Buffer, u64 BufferSize);
+typedef i32 fnptr_engine_load_state(void* Buffer, u64 Size);
 
 
 #endif
\ No newline at end of file
@@ -11,8 +11,8 @@
  * 		f. Final bitmap to Platform
  * 
  * 2. Application Scaling
- * 		a. Set up fixed resolutions.
- * 		b. Letter boxing, centering + offset controls
+ * 		//a. Set up fixed resolutions.
+ * 		//b. Letter boxing, centering + offset controls
  * 		c. Set up dynamic resolutions (to the nearested power of 2 scaling)
  * 
  * 3. Cleanup & Refactoring
@@ -43,8 +43,9 @@ NinetailsXAPI i32
 EngineReinit(void* memStore, u64 memSize, window_props* window_props, res_handler_interface* ResourceHandler)
 {
 
-	// Set the resource handler to global.
+	// Set the resource handler to global, and record into the platform's profiler.
 	ResourceInterface = ResourceHandler;
+	SetProfiler(ResourceHandler->Profiler);
 
 	// Cast the MemoryLayout to engine_state which contains the engine's persistent state.
 	// When the DLL reloads, this is how we persist the state.
@@ -57,7 +58,8 @@ EngineReinit(void* memStore, u64 memSize, window_props* window_props, res_handle
 /**
  * Engine initialization which occurs before the runtime of the engine. This handles
  * all internal memory formatting, necessary resource loading, and other critical engine
- * component initialization.
+ * component initialization. Returns non-zero if a resource the engine needs can't be loaded, the
+ * platform should then close.
  */
 NinetailsXAPI i32
 EngineInit(void* memStore, u64 memSize, window_props* windowProps, res_handler_interface* ResourceHandler)
@@ -66,53 +68,159 @@ EngineInit(void* memStore, u64 memSize, window_props* windowProps, res_handler_i
 	// We call EngineReinit here because it will set all the engine globals to the correct state.
 	EngineReinit(memStore, memSize, windowProps, ResourceHandler);
 
-	// Initialize window dimensions on start up.
-	windowProps->dimensions = { 160, 144 }; // 10:9 at 16*4 = 64
-	windowProps->dimensions *= 4;
+	// Initialize window dimensions on start up, the engine itself renders at the native resolution.
+	v2i nativeDimensions = { 160, 144 }; // 10:9
+	windowProps->dimensions = nativeDimensions * 4;
 
 	/**
 	 * We need to initialize the engine_state since EngineInit is called before the runtime performs
 	 * any actions. EngineReinit will reliably be called at any time during the runtime, so we need
 	 * to ensure that everything is correctly initialized here such that the state persists.
+	 *
+	 * NOTE:
+	 * 			The platform only reserves the memory store. We commit the engine_state ourselves and
+	 * 			the arena behind it commits the rest as it grows.
 	 */
+	CommitVirtualMemory(memStore, sizeof(engine_state));
 	EngineState->Initialized = true;
 	void* EngineHeapBasePointer = (void*)((u8*)memStore + sizeof(engine_state));
 	u64 EngineHeapSize = (u64)(memSize - sizeof(engine_state));
-	EngineState->EngineMemoryArena = CreateMemoryArena(EngineHeapBasePointer, EngineHeapSize);
+	EngineState->EngineMemoryArena = CreateVirtualMemoryArena(EngineHeapBasePointer, EngineHeapSize);
 
 	/**
-	 * Here, we are testing the resource fetching functions and bitmap stuff.
+	 * Map the asset archive, which nxpack builds from the assets directory. Assets are used in
+	 * place, so their pixels are only paged in when they are first drawn. Without an archive we
+	 * fall back to the loose files.
 	 */
-	u32 BitmapFileSize = ResourceInterface->FetchResourceSize("./assets/test.bmp");
-	EngineState->testbitmap_res = PushSize(&EngineState->EngineMemoryArena, BitmapFileSize);
-	ResourceInterface->FetchResourceFile("./assets/test.bmp", EngineState->testbitmap_res, BitmapFileSize); // Fetches the file.
+	if (ResourceInterface->MapResource("./assets.nxpak", &EngineState->AssetPackResource))
+		OpenNxpak(&EngineState->AssetPack, EngineState->AssetPackResource.data, EngineState->AssetPackResource.size);
 
-	EngineState->testbitmap = GetBitmapFromResource(EngineState->testbitmap_res);
+	EngineState->Simulation.testPosition = { 20.0f, 20.0f };
+	EngineState->Simulation.testPreviousPosition = EngineState->Simulation.testPosition;
+	EngineState->testbitmap = GetBitmapFromNxpak(&EngineState->AssetPack, NxpakAssetID("test.bmp"));
+	if (EngineState->testbitmap.buffer == NULL)
+	{
+		// The loose file still has to be imported, after which we no longer need it.
+		mapped_resource testbitmapFile;
+		if (!ResourceInterface->MapResource("./assets/test.bmp", &testbitmapFile)) return(1);
+		b32 imported = ImportBitmap(&EngineState->EngineMemoryArena, testbitmapFile.data, testbitmapFile.size,
+			&EngineState->testbitmap);
+		ResourceInterface->UnmapResource(&testbitmapFile);
+		if (!imported) return(1);
+	}
 
 	/**
-	 * Creating the base layer.
+	 * Creating the base layer at the native resolution, and the present stage which scales it up into
+	 * the bitmap the platform shows.
 	 */
-	u32 baseLayerSize = (u32)GetBitmapSize(sizeof(u32), windowProps->dimensions); // Cast down to a u32 for bitmap spec.
+	u32 baseLayerSize = (u32)GetBitmapSize(sizeof(u32), nativeDimensions); // Cast down to a u32 for bitmap spec.
 	void* bitmapBuffer = PushSize(&EngineState->EngineMemoryArena, baseLayerSize);
-	EngineState->base_layer = CreateBitmapLayer(bitmapBuffer, baseLayerSize, windowProps->dimensions);
-	windowProps->softwareBitmap = EngineState->base_layer.buffer;
+	EngineState->base_layer = CreateBitmapLayer(bitmapBuffer, baseLayerSize, nativeDimensions);
+	EngineState->Present = CreatePresentStage(&EngineState->EngineMemoryArena, &EngineState->base_layer,
+		windowProps->dimensions, PRESENT_FILTER_NEAREST, 256);
+	windowProps->softwareBitmap = EngineState->Present.output.buffer;
+	windowProps->renderStats = &EngineState->RenderStats;
+
+	/**
+	 * Start the worker threads and the tiled renderer. The kernels are selected before any
+	 * worker can draw with them.
+	 */
+	SelectRendererKernels();
+	EngineState->JobSystem = CreateJobSystem(&EngineState->EngineMemoryArena);
+	EngineState->Renderer = CreateTiledRenderer(&EngineState->EngineMemoryArena, &EngineState->base_layer,
+		EngineState->JobSystem, 1024);
+	EngineState->FrameArena = PushMemoryArena(&EngineState->EngineMemoryArena, Megabytes(16));
 
 	return 0;
 }
 
 /**
- * The frame-runtime of the engine.
+ * Joins the worker threads the renderer draws with. Everything else the engine holds lives in the
+ * memory store or is mapped, and goes with the process.
+ */
+NinetailsXAPI void
+EngineShutdown()
+{
+
+	if (EngineState == NULL || EngineState->JobSystem == NULL) return;
+	DestroyJobSystem(EngineState->JobSystem);
+	EngineState->JobSystem = NULL;
+
+}
+
+/**
+ * Advances the simulation by one fixed step of InputHandle->frameStep milliseconds. The platform
+ * calls this as many times a frame as there are steps due, so nothing here may depend on how long
+ * frames take, or on being called once per frame.
  */
 NinetailsXAPI i32
-EngineRuntime(window_props* windowProps, action_interface* InputHandle)
+EngineUpdate(action_interface* InputHandle)
+{
+
+	NX_PROFILE_SCOPE("EngineUpdate");
+
+	simulation_state* Simulation = &EngineState->Simulation;
+	input* frameInput = InputHandle->frame_input;
+	r32 stepSeconds = InputHandle->frameStep / 1000.0f;
+	r32 speed = 48.0f * stepSeconds; // Native pixels a second.
+
+	Simulation->stepCount++;
+	Simulation->testPreviousPosition = Simulation->testPosition;
+	if (frameInput->leftButton.down) Simulation->testPosition.x -= speed;
+	if (frameInput->rightButton.down) Simulation->testPosition.x += speed;
+	if (frameInput->downButton.down) Simulation->testPosition.y -= speed;
+	if (frameInput->upButton.down) Simulation->testPosition.y += speed;
+
+	return(0);
+}
+
+/**
+ * Copies the simulation out into Buffer, for the platform to start an input recording from. Returns
+ * the size of the state, which is all it does when Buffer is NULL or too small to hold it.
+ */
+NinetailsXAPI u64
+EngineSaveState(void* Buffer, u64 BufferSize)
 {
 
+	if (Buffer != NULL && BufferSize >= sizeof(simulation_state))
+		nx_memcopy(Buffer, &EngineState->Simulation, sizeof(simulation_state));
+	return sizeof(simulation_state);
+
+}
+
+/**
+ * Puts back a simulation saved by EngineSaveState, so that replaying a recording's input plays out
+ * exactly as it did. Returns non-zero if the state doesn't come from this build of the engine.
+ */
+NinetailsXAPI i32
+EngineLoadState(void* Buffer, u64 Size)
+{
+
+	if (Buffer == NULL || Size != sizeof(simulation_state)) return(1);
+	nx_memcopy(&EngineState->Simulation, Buffer, sizeof(simulation_state));
+	return(0);
+
+}
+
+/**
+ * Draws the frame. Alpha is how far the frame sits between the previous step and the latest one,
+ * anything which moves is drawn that far along, so motion stays smooth whether the platform renders
+ * faster or slower than the simulation steps.
+ */
+NinetailsXAPI i32
+EngineRender(window_props* windowProps, r32 alpha)
+{
+
+	NX_PROFILE_SCOPE("EngineRender");
+
 	/**
 	 * We are filling the background to clear out the contents of the last frame then we are drawing a
-	 * bitmap to test the basic drawing functions.
+	 * bitmap to test the basic drawing functions. Everything is recorded as render commands, then sorted
+	 * and rasterized across the worker threads at the end of the frame.
 	 */
-	DrawRect(&EngineState->base_layer, {0,0}, EngineState->base_layer.dims,
-		CreateDIBPixel(1.0f, 1.0f, 0.0f, 0.0f));
+	render_commands* Commands = &EngineState->RenderCommands;
+	BeginRenderCommands(Commands, &EngineState->FrameArena, 4096);
+	PushRenderClear(Commands, 0, CreateDIBPixel(1.0f, 1.0f, 0.0f, 0.0f));
 
 	r32 shadeBumper = 0.0f;
 	for (i32 testY = 0; testY < 9; ++testY)
@@ -120,14 +228,50 @@ EngineRuntime(window_props* windowProps, action_interface* InputHandle)
 		for (i32 testX = 0; testX < 10; ++testX)
 		{
 			//https://www.niwa.nu/2013/05/math-behind-colorspace-conversions-rgb-hsl/
-			DrawRect(&EngineState->base_layer, {testX*64,testY*64}, {64,64}, CreateDIBPixel({0.0f+shadeBumper, 0.0f+shadeBumper, 0.0f+shadeBumper, 1.0f}));
+			PushRenderRect(Commands, 1, {testX*16,testY*16}, {16,16}, CreateDIBPixel({0.0f+shadeBumper, 0.0f+shadeBumper, 0.0f+shadeBumper, 1.0f}));
 			shadeBumper += (1.0f/(9*10));
 		}
 
 	}
 
 	// Keep the test bitmap.
-	DrawBitmap(&EngineState->base_layer, &EngineState->testbitmap, {80,80});
+	v2 testFrom = EngineState->Simulation.testPreviousPosition;
+	v2 testTo = EngineState->Simulation.testPosition;
+	v2i testPosition = { (i32)floorf(testFrom.x + (testTo.x - testFrom.x) * alpha + 0.5f),
+		(i32)floorf(testFrom.y + (testTo.y - testFrom.y) * alpha + 0.5f) };
+	PushRenderBitmap(Commands, 2, &EngineState->testbitmap, testPosition);
+
+	if (windowProps->fullRedraw)
+	{
+		MarkTiledRendererDirty(&EngineState->Renderer);
+		MarkPresentDirty(&EngineState->Present);
+	}
+	ExecuteRenderCommands(Commands, &EngineState->Renderer);
+
+	// Only the regions which changed need to be scaled and presented.
+	PresentLayer(&EngineState->Present, EngineState->Renderer.dirtyRects, EngineState->Renderer.dirtyRectCount);
+	windowProps->dirtyRegions = EngineState->Present.dirtyRects;
+	windowProps->dirtyRegionCount = EngineState->Present.dirtyRectCount;
+
+	tiled_stats* tiledStats = &EngineState->Renderer.frameStats;
+	render_stats* renderStats = &EngineState->RenderStats;
+	renderStats->framebufferPixels = (u64)EngineState->base_layer.dims.width * (u64)EngineState->base_layer.dims.height;
+	renderStats->rectPixelsWritten = tiledStats->rectPixels;
+	renderStats->bitmapPixelsWritten = tiledStats->bitmapPixels;
+	renderStats->linePixelsWritten = tiledStats->linePixels;
+	renderStats->trianglePixelsWritten = tiledStats->trianglePixels;
+	renderStats->presentPixelsWritten = EngineState->Present.pixelsWritten;
+	renderStats->pixelsSubmitted = tiledStats->submittedPixels;
+	renderStats->pixelsClipped = tiledStats->clippedPixels;
+	renderStats->overdraw = (r32)(tiledStats->rectPixels + tiledStats->bitmapPixels + tiledStats->linePixels +
+		tiledStats->trianglePixels) / (r32)renderStats->framebufferPixels;
+	renderStats->blits = tiledStats->blits;
+	renderStats->tilesRasterized = tiledStats->rasterizedTiles;
+	renderStats->commandsDropped = Commands->droppedCount;
+	renderStats->memcopyBytes = tiledStats->memcopyBytes + EngineState->Present.memcopyBytes;
+
+	// Everything transient from this frame goes in one step.
+	ResetMemoryArena(&EngineState->FrameArena);
 
 
 
@@ -5,20 +5,57 @@
 #include <nxcore/math.h>
 #include <nxcore/input.h>
 #include <nxcore/renderer.h>
+#include <nxcore/jobs.h>
+#include <nxcore/core.h>
+#include <nxcore/nxpak.h>
+
+/**
+ * Everything EngineUpdate changes, and nothing else. It is plain data so that EngineSaveState can
+ * copy it out as it is, which is what input recordings start from (see replay.h). Whatever the
+ * simulation needs to keep between steps has to live in here, or replays stop being exact.
+ */
+typedef struct
+{
+	u64 stepCount;
+
+	// Where the test bitmap is, as of the latest step and the one before it, in native pixels.
+	// EngineRender draws it somewhere in between.
+	v2 testPosition;
+	v2 testPreviousPosition;
+} simulation_state;
 
 typedef struct
 {
 	memarena_t EngineMemoryArena;
 	b32 Initialized;
 
-	i32 x, y;
-	b32 mov_flip;
+	simulation_state Simulation;
+
+	// The asset archive, mapped for the lifetime of the engine.
+	mapped_resource AssetPackResource;
+	nxpak AssetPack;
 
-	// State for the testbitmap.
-	void* testbitmap_res;
+	// State for the testbitmap, which points straight into the archive (or an imported copy of the
+	// loose file without one).
 	dibitmap testbitmap;
 
+	// The frame is drawn into base_layer at the native resolution, then scaled up to the window.
 	dibitmap base_layer;
+	present_stage Present;
+
+	// The worker threads and the tiled renderer which draws into base_layer with them.
+	job_system* JobSystem;
+	tiled_renderer Renderer;
+
+	// Scratch memory for the frame, EngineRender can push anything here and it is all reset at once
+	// when the frame ends.
+	memarena_t FrameArena;
+
+	// The frame's draws, pushed on FrameArena and executed through Renderer at the end of EngineRender.
+	render_commands RenderCommands;
+
+	// What the last frame cost, handed to the platform through window_props.
+	render_stats RenderStats;
 
 } engine_state;
 
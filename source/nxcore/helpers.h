@@ -15,6 +15,10 @@
 
 #define ArraySize(arr) (sizeof(arr)/sizeof(arr[0]))
 
+#if defined(_WIN32)
 #define NinetailsXAPI extern "C" __declspec(dllexport)
+#else
+#define NinetailsXAPI extern "C" __attribute__((visibility("default")))
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,575 @@
+#ifndef NINETAILSX_INFLATE_H
+#define NINETAILSX_INFLATE_H
+#include <nxcore/helpers.h>
+#include <nxcore/primitives.h>
+
+/**
+ * Inflate.
+ *
+ * A DEFLATE (RFC 1951) decompressor, optionally inside a zlib (RFC 1950) wrapper, which takes its
+ * input a piece at a time. Inflate consumes every byte it is given and returns INFLATE_MORE until
+ * the final block has been decoded, so the compressed data can come from a mapped file, a partial
+ * read or anything in between without ever being gathered in one place.
+ *
+ * Output goes through a ring window of INFLATE_WINDOW_SIZE bytes, which the caller provides, and
+ * is handed to the sink callback in order, a contiguous run at a time. The window only has to hold
+ * the 32 KB a match can reach back plus whatever hasn't been handed over yet, so decompressing
+ * something large never needs the whole output in memory.
+ *
+ * NOTE:
+ * 			Symbols are decoded whole or not at all. When a call runs out of input partway through
+ * 			one, the bits it did get are kept in the bit buffer and decoding picks up from the start
+ * 			of that symbol on the next call. The longest step (a length, its extra bits, a distance
+ * 			and its extra bits) is 48 bits, so the buffer never needs more than that and a byte.
+ *
+ * NOTE:
+ * 			The zlib Adler-32 checksum is skipped over rather than checked. Bad data can make the
+ * 			output wrong but never makes Inflate read or write outside of its buffers.
+ */
+#define INFLATE_WINDOW_SIZE (Kilobytes(64))
+#define INFLATE_HISTORY_SIZE (Kilobytes(32))
+#define INFLATE_FAST_BITS 10
+#define INFLATE_MAX_BITS 15
+
+enum inflate_status
+{
+	INFLATE_MORE, // Every byte given was consumed, call again with the ones that follow.
+	INFLATE_DONE,
+	INFLATE_ERROR,
+};
+
+enum inflate_state
+{
+	INFLATE_STATE_ZLIB_HEADER,
+	INFLATE_STATE_BLOCK_HEADER,
+	INFLATE_STATE_STORED_HEADER,
+	INFLATE_STATE_STORED_DATA,
+	INFLATE_STATE_DYNAMIC_HEADER,
+	INFLATE_STATE_CODE_LENGTH_CODES,
+	INFLATE_STATE_CODE_LENGTHS,
+	INFLATE_STATE_BLOCK_DATA,
+	INFLATE_STATE_ZLIB_TRAILER,
+	INFLATE_STATE_DONE,
+	INFLATE_STATE_ERROR,
+};
+
+/**
+ * Receives the decompressed bytes. Returning false stops decompression with INFLATE_ERROR.
+ */
+typedef b32 fnptr_inflate_sink(void* UserData, u8* Data, u64 Size);
+
+/**
+ * A canonical Huffman code. Codes up to INFLATE_FAST_BITS long are decoded with one lookup in
+ * fast, indexed by the next bits of the stream, the rest a bit at a time from the counts.
+ */
+typedef struct inflate_huffman
+{
+	u16 fast[1 << INFLATE_FAST_BITS]; // (code length << 9) | symbol, zero for longer codes.
+	u16 count[INFLATE_MAX_BITS + 1]; // Codes of each length.
+	u16 symbols[288]; // Ordered by code.
+} inflate_huffman;
+
+typedef struct inflate_stream
+{
+	u64 bitBuffer;
+	u32 bitCount;
+	u32 state;
+	b32 zlib;
+	b32 finalBlock;
+	u32 storedRemaining;
+
+	// The code lengths of a dynamic block, which can be split across calls.
+	u32 literalCount;
+	u32 distanceCount;
+	u32 codeLengthCount;
+	u32 lengthIndex;
+	u8 lengths[288 + 32];
+
+	inflate_huffman literals;
+	inflate_huffman distances;
+	inflate_huffman codeLengths;
+
+	u8* window;
+	u64 position; // Bytes decompressed since the start of the stream.
+	u64 flushed; // Bytes handed to the sink.
+	fnptr_inflate_sink* sink;
+	void* userData;
+} inflate_stream;
+
+global const u16 __inflate_length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+global const u8 __inflate_length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+global const u16 __inflate_distance_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+	6145, 8193, 12289, 16385, 24577 };
+global const u8 __inflate_distance_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+global const u8 __inflate_code_length_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+#define INFLATE_SHORT -1 // The buffer doesn't hold the whole code yet.
+#define INFLATE_INVALID -2
+
+/**
+ * Builds a Huffman code from the code length of each symbol. Returns false if the lengths describe
+ * more codes than fit, incomplete codes are allowed and fail to decode the codes they're missing.
+ */
+internal b32
+__inflate_build_huffman(inflate_huffman* table, u8* lengths, u32 symbolCount)
+{
+
+	for (u32 length = 0; length <= INFLATE_MAX_BITS; ++length) table->count[length] = 0;
+	for (u32 symbol = 0; symbol < symbolCount; ++symbol) table->count[lengths[symbol]]++;
+	table->count[0] = 0;
+
+	i32 left = 1;
+	for (u32 length = 1; length <= INFLATE_MAX_BITS; ++length)
+	{
+		left = (left << 1) - table->count[length];
+		if (left < 0) return false;
+	}
+
+	u16 offsets[INFLATE_MAX_BITS + 1];
+	offsets[1] = 0;
+	for (u32 length = 1; length < INFLATE_MAX_BITS; ++length)
+		offsets[length + 1] = offsets[length] + table->count[length];
+	for (u32 symbol = 0; symbol < symbolCount; ++symbol)
+		if (lengths[symbol]) table->symbols[offsets[lengths[symbol]]++] = (u16)symbol;
+
+	// The stream holds codes first bit first, so the fast table is indexed by the reversed code.
+	for (u32 entry = 0; entry < (1 << INFLATE_FAST_BITS); ++entry) table->fast[entry] = 0;
+	u32 code = 0;
+	u32 index = 0;
+	for (u32 length = 1; length <= INFLATE_FAST_BITS; ++length)
+	{
+		for (u32 cIndex = 0; cIndex < table->count[length]; ++cIndex, ++code, ++index)
+		{
+			u32 reversed = 0;
+			for (u32 bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+			u16 entry = (u16)((length << 9) | table->symbols[index]);
+			for (u32 slot = reversed; slot < (1 << INFLATE_FAST_BITS); slot += (1u << length))
+				table->fast[slot] = entry;
+		}
+		code <<= 1;
+	}
+
+	return true;
+
+}
+
+/**
+ * Decodes the symbol at the bottom of the bit buffer without consuming it. Returns the symbol and
+ * its code length, INFLATE_SHORT if the buffer ends partway through the code or INFLATE_INVALID.
+ */
+inline i32
+__inflate_decode(inflate_huffman* table, u64 bitBuffer, u32 bitCount, u32* length)
+{
+
+	u32 entry = table->fast[bitBuffer & ((1 << INFLATE_FAST_BITS) - 1)];
+	if (entry)
+	{
+		*length = entry >> 9;
+		return (*length <= bitCount ? (i32)(entry & 511) : INFLATE_SHORT);
+	}
+
+	i32 code = 0;
+	i32 first = 0;
+	i32 index = 0;
+	for (u32 _length = 1; _length <= INFLATE_MAX_BITS; ++_length)
+	{
+		if (_length > bitCount) return INFLATE_SHORT;
+		code |= (i32)((bitBuffer >> (_length - 1)) & 1);
+		i32 count = table->count[_length];
+		if (code - first < count)
+		{
+			*length = _length;
+			return table->symbols[index + (code - first)];
+		}
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return INFLATE_INVALID;
+
+}
+
+/**
+ * Tops the bit buffer up to at least 56 bits, or with whatever input is left.
+ *
+ * NOTE:
+ * 			The eight byte load leaves the bytes it didn't count above the count, which are the same
+ * 			bytes the next refill puts there. It never reads past the end of the input, so once the
+ * 			input is used up everything above the count is zero.
+ */
+inline void
+__inflate_refill(u64* bitBuffer, u32* bitCount, u8* input, u64 size, u64* position)
+{
+	if (*bitCount > 56) return;
+	if (*position + 8 <= size)
+	{
+		// Assembled a byte at a time so it's a plain unaligned load wherever the compiler can.
+		u8* next = input + *position;
+		u64 bytes = (u64)next[0] | ((u64)next[1] << 8) | ((u64)next[2] << 16) | ((u64)next[3] << 24) |
+			((u64)next[4] << 32) | ((u64)next[5] << 40) | ((u64)next[6] << 48) | ((u64)next[7] << 56);
+		*bitBuffer |= bytes << *bitCount;
+		*position += (63 - *bitCount) >> 3;
+		*bitCount |= 56;
+	}
+	else
+	{
+		while (*bitCount <= 56 && *position < size)
+		{
+			*bitBuffer |= (u64)input[(*position)++] << *bitCount;
+			*bitCount += 8;
+		}
+	}
+}
+
+/**
+ * Hands everything decompressed since the last flush to the sink.
+ */
+internal b32
+__inflate_flush(inflate_stream* stream)
+{
+	while (stream->flushed < stream->position)
+	{
+		u64 start = stream->flushed & (INFLATE_WINDOW_SIZE - 1);
+		u64 size = stream->position - stream->flushed;
+		if (size > INFLATE_WINDOW_SIZE - start) size = INFLATE_WINDOW_SIZE - start;
+		if (!stream->sink(stream->userData, stream->window + start, size)) return false;
+		stream->flushed += size;
+	}
+	return true;
+}
+
+internal void
+__inflate_build_fixed(inflate_stream* stream)
+{
+	u8* lengths = stream->lengths;
+	for (u32 symbol = 0; symbol < 288; ++symbol)
+		lengths[symbol] = (symbol < 144 ? 8 : (symbol < 256 ? 9 : (symbol < 280 ? 7 : 8)));
+	__inflate_build_huffman(&stream->literals, lengths, 288);
+
+	for (u32 symbol = 0; symbol < 32; ++symbol) lengths[symbol] = 5;
+	__inflate_build_huffman(&stream->distances, lengths, 32);
+}
+
+/**
+ * Starts decompressing a new stream. The window must be INFLATE_WINDOW_SIZE bytes and outlive
+ * the stream, zlib says whether the data has a zlib header and trailer around it.
+ */
+inline void
+BeginInflate(inflate_stream* stream, u8* window, b32 zlib, fnptr_inflate_sink* sink, void* userData)
+{
+	stream->bitBuffer = 0;
+	stream->bitCount = 0;
+	stream->state = (zlib ? INFLATE_STATE_ZLIB_HEADER : INFLATE_STATE_BLOCK_HEADER);
+	stream->zlib = zlib;
+	stream->finalBlock = false;
+	stream->storedRemaining = 0;
+	stream->window = window;
+	stream->position = 0;
+	stream->flushed = 0;
+	stream->sink = sink;
+	stream->userData = userData;
+}
+
+/**
+ * Decompresses the next size bytes of the stream, handing the output to the sink as it goes. Once
+ * the stream returns INFLATE_DONE or INFLATE_ERROR it keeps returning it.
+ */
+internal inflate_status
+Inflate(inflate_stream* stream, void* Input, u64 Size)
+{
+
+	u8* input = (u8*)Input;
+	u64 inputPosition = 0;
+
+	for (;;)
+	{
+		__inflate_refill(&stream->bitBuffer, &stream->bitCount, input, Size, &inputPosition);
+		u64 bits = stream->bitBuffer;
+		u32 count = stream->bitCount;
+
+		switch (stream->state)
+		{
+
+			case INFLATE_STATE_ZLIB_HEADER:
+			{
+				if (count < 16) goto starved;
+				u32 method = (u32)(bits & 0xFF);
+				u32 flags = (u32)((bits >> 8) & 0xFF);
+				if ((method & 15) != 8 || (method >> 4) > 7 || ((method << 8) | flags) % 31 || (flags & 0x20))
+					goto failed; // Not deflate, or it needs a preset dictionary.
+				stream->bitBuffer >>= 16;
+				stream->bitCount -= 16;
+				stream->state = INFLATE_STATE_BLOCK_HEADER;
+			} break;
+
+			case INFLATE_STATE_BLOCK_HEADER:
+			{
+				if (stream->finalBlock)
+				{
+					stream->state = (stream->zlib ? INFLATE_STATE_ZLIB_TRAILER : INFLATE_STATE_DONE);
+					break;
+				}
+
+				if (count < 3) goto starved;
+				stream->finalBlock = (b32)(bits & 1);
+				u32 type = (u32)((bits >> 1) & 3);
+				stream->bitBuffer >>= 3;
+				stream->bitCount -= 3;
+
+				if (type == 0) stream->state = INFLATE_STATE_STORED_HEADER;
+				else if (type == 1)
+				{
+					__inflate_build_fixed(stream);
+					stream->state = INFLATE_STATE_BLOCK_DATA;
+				}
+				else if (type == 2) stream->state = INFLATE_STATE_DYNAMIC_HEADER;
+				else goto failed;
+			} break;
+
+			case INFLATE_STATE_STORED_HEADER:
+			{
+				u32 skip = count & 7;
+				if (count - skip < 32) goto starved;
+				bits >>= skip;
+				u32 length = (u32)(bits & 0xFFFF);
+				u32 inverse = (u32)((bits >> 16) & 0xFFFF);
+				if (length != (~inverse & 0xFFFF)) goto failed;
+				stream->bitBuffer = bits >> 32;
+				stream->bitCount -= skip + 32;
+				stream->storedRemaining = length;
+				stream->state = INFLATE_STATE_STORED_DATA;
+			} break;
+
+			case INFLATE_STATE_STORED_DATA:
+			{
+				while (stream->storedRemaining)
+				{
+					if (stream->position - stream->flushed >= INFLATE_HISTORY_SIZE && !__inflate_flush(stream)) goto failed;
+
+					if (stream->bitCount >= 8)
+					{
+						stream->window[stream->position++ & (INFLATE_WINDOW_SIZE - 1)] = (u8)stream->bitBuffer;
+						stream->bitBuffer >>= 8;
+						stream->bitCount -= 8;
+						stream->storedRemaining--;
+						continue;
+					}
+
+					// The buffer is empty, copy straight from the input. Clear what the refill left
+					// above the count, since those bytes are about to be consumed here instead.
+					stream->bitBuffer = 0;
+					if (inputPosition == Size) goto starved;
+
+					u64 start = stream->position & (INFLATE_WINDOW_SIZE - 1);
+					u64 run = stream->storedRemaining;
+					if (run > Size - inputPosition) run = Size - inputPosition;
+					if (run > INFLATE_WINDOW_SIZE - start) run = INFLATE_WINDOW_SIZE - start;
+					if (run > INFLATE_HISTORY_SIZE - (stream->position - stream->flushed)) run = INFLATE_HISTORY_SIZE - (stream->position - stream->flushed);
+					for (u64 bIndex = 0; bIndex < run; ++bIndex)
+						stream->window[start + bIndex] = input[inputPosition + bIndex];
+
+					inputPosition += run;
+					stream->position += run;
+					stream->storedRemaining -= (u32)run;
+				}
+				stream->state = INFLATE_STATE_BLOCK_HEADER;
+			} break;
+
+			case INFLATE_STATE_DYNAMIC_HEADER:
+			{
+				if (count < 14) goto starved;
+				stream->literalCount = (u32)(bits & 31) + 257;
+				stream->distanceCount = (u32)((bits >> 5) & 31) + 1;
+				stream->codeLengthCount = (u32)((bits >> 10) & 15) + 4;
+				if (stream->literalCount > 286 || stream->distanceCount > 30) goto failed;
+				stream->bitBuffer >>= 14;
+				stream->bitCount -= 14;
+
+				for (u32 lIndex = 0; lIndex < 19; ++lIndex) stream->lengths[lIndex] = 0;
+				stream->lengthIndex = 0;
+				stream->state = INFLATE_STATE_CODE_LENGTH_CODES;
+			} break;
+
+			case INFLATE_STATE_CODE_LENGTH_CODES:
+			{
+				while (stream->lengthIndex < stream->codeLengthCount)
+				{
+					if (stream->bitCount < 3) goto starved;
+					stream->lengths[__inflate_code_length_order[stream->lengthIndex++]] = (u8)(stream->bitBuffer & 7);
+					stream->bitBuffer >>= 3;
+					stream->bitCount -= 3;
+				}
+
+				if (!__inflate_build_huffman(&stream->codeLengths, stream->lengths, 19)) goto failed;
+				stream->lengthIndex = 0;
+				stream->state = INFLATE_STATE_CODE_LENGTHS;
+			} break;
+
+			case INFLATE_STATE_CODE_LENGTHS:
+			{
+				u32 total = stream->literalCount + stream->distanceCount;
+				while (stream->lengthIndex < total)
+				{
+					bits = stream->bitBuffer;
+					count = stream->bitCount;
+
+					u32 length;
+					i32 symbol = __inflate_decode(&stream->codeLengths, bits, count, &length);
+					if (symbol == INFLATE_SHORT) goto starved;
+					if (symbol < 0) goto failed;
+					bits >>= length;
+					count -= length;
+
+					u32 repeat = 1;
+					u8 value = (u8)symbol;
+					if (symbol >= 16)
+					{
+						u32 extra = (symbol == 16 ? 2 : (symbol == 17 ? 3 : 7));
+						if (count < extra) goto starved;
+						repeat = (symbol == 16 ? 3 : (symbol == 17 ? 3 : 11)) + (u32)(bits & ((1u << extra) - 1));
+						bits >>= extra;
+						count -= extra;
+
+						value = 0;
+						if (symbol == 16)
+						{
+							if (stream->lengthIndex == 0) goto failed;
+							value = stream->lengths[stream->lengthIndex - 1];
+						}
+					}
+					if (stream->lengthIndex + repeat > total) goto failed;
+
+					for (u32 rIndex = 0; rIndex < repeat; ++rIndex) stream->lengths[stream->lengthIndex++] = value;
+					stream->bitBuffer = bits;
+					stream->bitCount = count;
+				}
+
+				if (stream->lengths[256] == 0) goto failed; // No end of block code.
+				if (!__inflate_build_huffman(&stream->literals, stream->lengths, stream->literalCount)) goto failed;
+				if (!__inflate_build_huffman(&stream->distances, stream->lengths + stream->literalCount, stream->distanceCount)) goto failed;
+				stream->state = INFLATE_STATE_BLOCK_DATA;
+			} break;
+
+			case INFLATE_STATE_BLOCK_DATA:
+			{
+				u8* window = stream->window;
+				u64 position = stream->position;
+				u64 mask = INFLATE_WINDOW_SIZE - 1;
+
+				for (;;)
+				{
+					if (count < 48) __inflate_refill(&bits, &count, input, Size, &inputPosition);
+
+					// Keep the unflushed output and the history a match can reach inside the window.
+					if (position - stream->flushed >= INFLATE_HISTORY_SIZE)
+					{
+						stream->position = position;
+						if (!__inflate_flush(stream)) goto failed;
+					}
+
+					u32 length;
+					i32 symbol = __inflate_decode(&stream->literals, bits, count, &length);
+					if (symbol < 0) goto block_stopped;
+
+					if (symbol < 256)
+					{
+						window[position++ & mask] = (u8)symbol;
+						bits >>= length;
+						count -= length;
+						continue;
+					}
+
+					if (symbol == 256)
+					{
+						bits >>= length;
+						count -= length;
+						stream->state = INFLATE_STATE_BLOCK_HEADER;
+						break;
+					}
+
+					{
+					symbol -= 257;
+					if (symbol >= 29) { symbol = INFLATE_INVALID; goto block_stopped; }
+					u64 _bits = bits >> length;
+					u32 _count = count - length;
+
+					u32 extra = __inflate_length_extra[symbol];
+					if (_count < extra) { symbol = INFLATE_SHORT; goto block_stopped; }
+					u32 matchLength = __inflate_length_base[symbol] + (u32)(_bits & ((1u << extra) - 1));
+					_bits >>= extra;
+					_count -= extra;
+
+					i32 distanceSymbol = __inflate_decode(&stream->distances, _bits, _count, &length);
+					if (distanceSymbol < 0) { symbol = distanceSymbol; goto block_stopped; }
+					if (distanceSymbol >= 30) { symbol = INFLATE_INVALID; goto block_stopped; }
+					_bits >>= length;
+					_count -= length;
+
+					extra = __inflate_distance_extra[distanceSymbol];
+					if (_count < extra) { symbol = INFLATE_SHORT; goto block_stopped; }
+					u32 distance = __inflate_distance_base[distanceSymbol] + (u32)(_bits & ((1u << extra) - 1));
+					_bits >>= extra;
+					_count -= extra;
+					if (distance > position) { symbol = INFLATE_INVALID; goto block_stopped; }
+
+					// Matches may overlap their own output, so this has to go a byte at a time.
+					for (u32 bIndex = 0; bIndex < matchLength; ++bIndex, ++position)
+						window[position & mask] = window[(position - distance) & mask];
+					bits = _bits;
+					count = _count;
+					continue;
+					}
+
+				block_stopped:
+					stream->bitBuffer = bits;
+					stream->bitCount = count;
+					stream->position = position;
+					if (symbol == INFLATE_SHORT) goto starved;
+					goto failed;
+				}
+
+				stream->bitBuffer = bits;
+				stream->bitCount = count;
+				stream->position = position;
+			} break;
+
+			case INFLATE_STATE_ZLIB_TRAILER:
+			{
+				u32 skip = count & 7;
+				if (count - skip < 32) goto starved;
+				stream->bitBuffer >>= skip + 32;
+				stream->bitCount -= skip + 32;
+				stream->state = INFLATE_STATE_DONE;
+			} break;
+
+			case INFLATE_STATE_DONE:
+			{
+				if (!__inflate_flush(stream)) goto failed;
+				return INFLATE_DONE;
+			}
+
+			default: return INFLATE_ERROR;
+
+		}
+		continue;
+
+	starved:
+		// Anything short of a whole symbol after a refill means the input has run out.
+		if (inputPosition < Size) continue;
+		if (!__inflate_flush(stream)) goto failed;
+		return INFLATE_MORE;
+	}
+
+failed:
+	stream->state = INFLATE_STATE_ERROR;
+	return INFLATE_ERROR;
+
+}
+
+#endif
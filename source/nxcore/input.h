@@ -41,7 +41,19 @@ typedef struct input
 typedef struct action_interface
 {
 	input* frame_input;
-	r32 frameStep; // The v-sync frame timing for physics calculations.
+	r32 frameStep; // The fixed simulation step in milliseconds, the same for every EngineUpdate.
 } action_interface;
 
+/**
+ * Clears the released edges once an update has seen them. When a frame runs several updates, only
+ * the first should see a button being released, the rest only see whether it is held.
+ */
+inline void
+ClearInputEdges(input* frameInput)
+{
+	button* _buttons = (button*)frameInput;
+	for (u32 _index = 0; _index < sizeof(input) / sizeof(button); ++_index)
+		_buttons[_index].released = false;
+}
+
 #endif
\ No newline at end of file
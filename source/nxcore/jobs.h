@@ -0,0 +1,213 @@
+#ifndef NINETAILSX_JOBS_H
+#define NINETAILSX_JOBS_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
+
+/**
+ * The job system.
+ *
+ * A fixed pool of worker threads, each with its own queue. Jobs are handed out round-robin
+ * across the queues; a worker pops from the bottom of its own queue and, once that runs dry,
+ * steals from the top of the others. The thread which waits on the jobs is worker zero and
+ * works through the queues alongside the pool rather than sleeping.
+ *
+ * NOTE:
+ * 			The queues are guarded by a lock each rather than being lock-free. We submit tens to
+ * 			hundreds of jobs a frame, each of which rasterizes a whole tile, so the lock is never
+ * 			where the time goes.
+ */
+#define JOB_QUEUE_CAPACITY 1024
+#define JOB_SYSTEM_MAX_WORKERS 64
+
+typedef void fnptr_job_proc(void* Data, u32 WorkerIndex);
+
+typedef struct job
+{
+	fnptr_job_proc* Proc;
+	void* Data;
+} job;
+
+typedef struct alignas(64) job_queue
+{
+	std::mutex Lock;
+	job Jobs[JOB_QUEUE_CAPACITY];
+	u32 Top; // Thieves take from here.
+	u32 Bottom; // The owner pushes and pops here.
+} job_queue;
+
+typedef struct job_system
+{
+	u32 WorkerCount; // Including the waiting thread, which is worker zero.
+	job_queue* Queues;
+	std::thread* Threads;
+
+	std::atomic<u32> QueuedJobs; // Pushed, but not taken by a worker yet.
+	std::atomic<u32> PendingJobs; // Pushed, but not finished yet.
+	std::atomic<u32> NextQueue;
+	std::atomic<b32> Running;
+
+	std::mutex SleepLock;
+	std::condition_variable WakeWorkers;
+} job_system;
+
+// Takes a job from the bottom of the worker's own queue.
+internal b32
+__job_queue_pop(job_queue* Queue, job* Job)
+{
+	std::lock_guard<std::mutex> Guard(Queue->Lock);
+	if (Queue->Bottom == Queue->Top) return false;
+	*Job = Queue->Jobs[--Queue->Bottom % JOB_QUEUE_CAPACITY];
+	return true;
+}
+
+// Takes a job from the top of another worker's queue.
+internal b32
+__job_queue_steal(job_queue* Queue, job* Job)
+{
+	std::lock_guard<std::mutex> Guard(Queue->Lock);
+	if (Queue->Bottom == Queue->Top) return false;
+	*Job = Queue->Jobs[Queue->Top++ % JOB_QUEUE_CAPACITY];
+	return true;
+}
+
+/**
+ * Finds a job for a worker, from its own queue first and then from everyone else's, starting
+ * with its neighbour so the thieves spread out.
+ */
+internal b32
+__job_system_take(job_system* Jobs, u32 WorkerIndex, job* Job)
+{
+	b32 _taken = __job_queue_pop(&Jobs->Queues[WorkerIndex], Job);
+	for (u32 Offset = 1; !_taken && Offset < Jobs->WorkerCount; ++Offset)
+		_taken = __job_queue_steal(&Jobs->Queues[(WorkerIndex + Offset) % Jobs->WorkerCount], Job);
+
+	if (_taken) Jobs->QueuedJobs.fetch_sub(1);
+	return _taken;
+}
+
+internal void
+__job_system_run(job_system* Jobs, u32 WorkerIndex, job* Job)
+{
+	Job->Proc(Job->Data, WorkerIndex);
+	Jobs->PendingJobs.fetch_sub(1, std::memory_order_release);
+}
+
+internal void
+__job_system_worker(job_system* Jobs, u32 WorkerIndex)
+{
+	NX_PROFILE_THREAD("Job worker");
+	while (Jobs->Running.load())
+	{
+		job Job;
+		if (__job_system_take(Jobs, WorkerIndex, &Job))
+		{
+			__job_system_run(Jobs, WorkerIndex, &Job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> Sleep(Jobs->SleepLock);
+		Jobs->WakeWorkers.wait(Sleep, [Jobs]{ return Jobs->QueuedJobs.load() > 0 || !Jobs->Running.load(); });
+	}
+}
+
+/**
+ * The locks and atomics need their natural alignment, which PushSize doesn't give us, so
+ * everything the job system owns is pushed onto its own cache line. This also keeps the
+ * queues from sharing cache lines between workers.
+ */
+internal void*
+__job_system_push(memarena_t* Arena, size_t Size)
+{
+	return PushSizeAligned(Arena, Size, 64);
+}
+
+/**
+ * Creates the job system in the given arena and starts its threads. A WorkerCount of zero uses
+ * one worker per hardware thread. A worker count of one runs every job on the waiting thread.
+ */
+internal job_system*
+CreateJobSystem(memarena_t* Arena, u32 WorkerCount = 0)
+{
+	if (WorkerCount == 0) WorkerCount = std::thread::hardware_concurrency();
+	if (WorkerCount == 0) WorkerCount = 1;
+	if (WorkerCount > JOB_SYSTEM_MAX_WORKERS) WorkerCount = JOB_SYSTEM_MAX_WORKERS;
+
+	job_system* _jobs = new (__job_system_push(Arena, sizeof(job_system))) job_system();
+	_jobs->WorkerCount = WorkerCount;
+	_jobs->Queues = (job_queue*)__job_system_push(Arena, sizeof(job_queue)*WorkerCount);
+	_jobs->Threads = (std::thread*)__job_system_push(Arena, sizeof(std::thread)*WorkerCount);
+	_jobs->Running = true;
+
+	for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; ++WorkerIndex)
+		new (&_jobs->Queues[WorkerIndex]) job_queue();
+
+	for (u32 WorkerIndex = 1; WorkerIndex < WorkerCount; ++WorkerIndex)
+		new (&_jobs->Threads[WorkerIndex]) std::thread(&__job_system_worker, _jobs, WorkerIndex);
+
+	return _jobs;
+}
+
+/**
+ * Pushes a job onto the next queue. Jobs may only be submitted from the waiting thread.
+ */
+internal void
+SubmitJob(job_system* Jobs, fnptr_job_proc* Proc, void* Data)
+{
+	u32 QueueIndex = Jobs->NextQueue.fetch_add(1) % Jobs->WorkerCount;
+	job_queue* Queue = &Jobs->Queues[QueueIndex];
+
+	Jobs->PendingJobs.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> Guard(Queue->Lock);
+		assert(Queue->Bottom - Queue->Top < JOB_QUEUE_CAPACITY);
+		Queue->Jobs[Queue->Bottom++ % JOB_QUEUE_CAPACITY] = { Proc, Data };
+	}
+	Jobs->QueuedJobs.fetch_add(1);
+
+	// Taking the sleep lock guarantees a worker can't miss this between checking and sleeping.
+	std::lock_guard<std::mutex> Sleep(Jobs->SleepLock);
+	Jobs->WakeWorkers.notify_one();
+}
+
+/**
+ * Works through the queued jobs on the calling thread until every submitted job has finished.
+ */
+internal void
+WaitForJobs(job_system* Jobs)
+{
+	while (Jobs->PendingJobs.load(std::memory_order_acquire) > 0)
+	{
+		job Job;
+		if (__job_system_take(Jobs, 0, &Job)) __job_system_run(Jobs, 0, &Job);
+		else std::this_thread::yield();
+	}
+}
+
+/**
+ * Stops and joins the worker threads. The job system must not be used afterwards.
+ */
+internal void
+DestroyJobSystem(job_system* Jobs)
+{
+	{
+		std::lock_guard<std::mutex> Sleep(Jobs->SleepLock);
+		Jobs->Running = false;
+	}
+	Jobs->WakeWorkers.notify_all();
+
+	for (u32 WorkerIndex = 1; WorkerIndex < Jobs->WorkerCount; ++WorkerIndex)
+	{
+		Jobs->Threads[WorkerIndex].join();
+		Jobs->Threads[WorkerIndex].~thread();
+	}
+	for (u32 WorkerIndex = 0; WorkerIndex < Jobs->WorkerCount; ++WorkerIndex)
+		Jobs->Queues[WorkerIndex].~job_queue();
+	Jobs->~job_system();
+}
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <nxcore/math/trig.h>
 #include <nxcore/math/vector.h>
+#include <nxcore/math/rect.h>
 
 /**
  * Returns the absolute value of an i32. The method used in this function is very elementary and
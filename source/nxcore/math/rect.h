@@ -0,0 +1,52 @@
+#ifndef NINETAILSX_RECT_H
+#define NINETAILSX_RECT_H
+#include <nxcore/helpers.h>
+#include <nxcore/primitives.h>
+#include <nxcore/math/vector.h>
+
+/**
+ * A half-open integer rectangle, min is inclusive and max is exclusive. A rectangle with
+ * max <= min on either axis is empty.
+ */
+typedef struct rect2i
+{
+	v2i min;
+	v2i max;
+} rect2i;
+
+/**
+ * Creates a rectangle from a position and dimensions, the way the draw functions take them.
+ */
+inline rect2i
+CreateRect(v2i position, v2i dims)
+{
+	rect2i _rect;
+	_rect.min = position;
+	_rect.max = { position.x + dims.width, position.y + dims.height };
+	return _rect;
+}
+
+inline b32
+IsRectEmpty(rect2i rect)
+{
+	return (rect.max.x <= rect.min.x || rect.max.y <= rect.min.y);
+}
+
+inline rect2i
+IntersectRect(rect2i a, rect2i b)
+{
+	rect2i _rect;
+	_rect.min.x = (a.min.x > b.min.x ? a.min.x : b.min.x);
+	_rect.min.y = (a.min.y > b.min.y ? a.min.y : b.min.y);
+	_rect.max.x = (a.max.x < b.max.x ? a.max.x : b.max.x);
+	_rect.max.y = (a.max.y < b.max.y ? a.max.y : b.max.y);
+	return _rect;
+}
+
+inline v2i
+GetRectDims(rect2i rect)
+{
+	return { rect.max.x - rect.min.x, rect.max.y - rect.min.y };
+}
+
+#endif
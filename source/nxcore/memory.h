@@ -1,117 +1,425 @@
 #ifndef NINETAILSX_MEMORY_H
 #define NINETAILSX_MEMORY_H
+#include <stddef.h>
 #include <nxcore/helpers.h>
+#include <nxcore/simd.h>
+#include <nxcore/profiler.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 /**
  * nx_memcopy
  * 		Copies memory from source to destination using a given byte count.
+ *
+ * NOTE:
+ * 			There is a kernel for every instruction set level in simd.h. The kernel is picked the
+ * 			first time nx_memcopy is called and every call after that goes straight through the
+ * 			function pointer. Copies above NX_MEMCOPY_STREAMING_THRESHOLD use non-temporal stores,
+ * 			since a copy that large would otherwise evict everything else from the cache on its
+ * 			way through.
  */
+#ifndef NX_MEMCOPY_STREAMING_THRESHOLD
+#define NX_MEMCOPY_STREAMING_THRESHOLD Megabytes(1)
+#endif
+
+typedef void fnptr_nx_memcopy(void* Dest, void* Source, u64 ByteCount);
 
 // Copies unaligned in single-byte increments.
 inline void
-__nx_memcopy_unaligned(void* Dest, void* Source, u32 ByteCount)
+__nx_memcopy_unaligned(void* Dest, void* Source, u64 ByteCount)
 {
-	for (u32 bIndex = 0; bIndex < ByteCount; ++bIndex)
+	for (u64 bIndex = 0; bIndex < ByteCount; ++bIndex)
 		*((u8*)Dest+bIndex) = *((u8*)Source+bIndex);
 }
 
 // Copies 64-bit aligned in eight-byte increments. 
 inline void
-__nx_memcopy_aligned_64bit(void* Dest, void* Source, u32 ByteCount)
+__nx_memcopy_aligned_64bit(void* Dest, void* Source, u64 ByteCount)
 {
 #ifdef NINETAILSX_DEBUG
 	// Enforce that the byte count is perfectly aligned. If its not,
 	// this may accidently copy data out of bounds!
 	assert((ByteCount % 8) == 0);
 #endif
-	for (u32 bIndex = 0; bIndex < (ByteCount*8)/64; ++bIndex)
+	for (u64 bIndex = 0; bIndex < ByteCount/8; ++bIndex)
 		*((u64*)Dest+bIndex) = *((u64*)Source+bIndex);
 }
 
-/**
- * Copies memory to a given destination.
- * 
- * TODO:
- * 			We can use SSE instructions to potentially speed this up
- * 			so long as it aligns on 128bit/256bit boundaries. We will
- * 			need to dynamically determine CPU compatability for this.
- */
+// The scalar kernel, also used by the vector kernels to finish off their tails.
 internal void
-nx_memcopy(void* Dest, void* Source, u32 ByteCount)
+__nx_memcopy_scalar(void* Dest, void* Source, u64 ByteCount)
 {
-
-	u32 unaligned = ByteCount % 8;
-	u32 aligned = ByteCount - unaligned;
+	u64 unaligned = ByteCount % 8;
+	u64 aligned = ByteCount - unaligned;
 	__nx_memcopy_aligned_64bit(Dest, Source, aligned);
 	__nx_memcopy_unaligned((u8*)Dest+aligned, (u8*)Source+aligned, unaligned);
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+/**
+ * The vector kernels. Loads are always unaligned. When streaming, the destination is first
+ * brought up to the vector width with the scalar kernel since non-temporal stores require it,
+ * and the stores are fenced before we return so that they are visible to whoever reads next.
+ */
+NX_TARGET_SSE2 internal void
+__nx_memcopy_sse2(void* Dest, void* Source, u64 ByteCount)
+{
+	u8* _dest = (u8*)Dest;
+	u8* _source = (u8*)Source;
+
+	if (ByteCount >= NX_MEMCOPY_STREAMING_THRESHOLD)
+	{
+		u64 Head = (16 - ((uintptr_t)_dest & 15)) & 15;
+		__nx_memcopy_scalar(_dest, _source, Head);
+		_dest += Head; _source += Head; ByteCount -= Head;
+
+		for (; ByteCount >= 64; ByteCount -= 64, _dest += 64, _source += 64)
+		{
+			__m128i a = _mm_loadu_si128((__m128i*)_source + 0);
+			__m128i b = _mm_loadu_si128((__m128i*)_source + 1);
+			__m128i c = _mm_loadu_si128((__m128i*)_source + 2);
+			__m128i d = _mm_loadu_si128((__m128i*)_source + 3);
+			_mm_stream_si128((__m128i*)_dest + 0, a);
+			_mm_stream_si128((__m128i*)_dest + 1, b);
+			_mm_stream_si128((__m128i*)_dest + 2, c);
+			_mm_stream_si128((__m128i*)_dest + 3, d);
+		}
+		_mm_sfence();
+	}
+
+	for (; ByteCount >= 16; ByteCount -= 16, _dest += 16, _source += 16)
+		_mm_storeu_si128((__m128i*)_dest, _mm_loadu_si128((__m128i*)_source));
+
+	__nx_memcopy_scalar(_dest, _source, ByteCount);
+}
+
+NX_TARGET_AVX2 internal void
+__nx_memcopy_avx2(void* Dest, void* Source, u64 ByteCount)
+{
+	u8* _dest = (u8*)Dest;
+	u8* _source = (u8*)Source;
+
+	if (ByteCount >= NX_MEMCOPY_STREAMING_THRESHOLD)
+	{
+		u64 Head = (32 - ((uintptr_t)_dest & 31)) & 31;
+		__nx_memcopy_scalar(_dest, _source, Head);
+		_dest += Head; _source += Head; ByteCount -= Head;
 
+		for (; ByteCount >= 128; ByteCount -= 128, _dest += 128, _source += 128)
+		{
+			__m256i a = _mm256_loadu_si256((__m256i*)_source + 0);
+			__m256i b = _mm256_loadu_si256((__m256i*)_source + 1);
+			__m256i c = _mm256_loadu_si256((__m256i*)_source + 2);
+			__m256i d = _mm256_loadu_si256((__m256i*)_source + 3);
+			_mm256_stream_si256((__m256i*)_dest + 0, a);
+			_mm256_stream_si256((__m256i*)_dest + 1, b);
+			_mm256_stream_si256((__m256i*)_dest + 2, c);
+			_mm256_stream_si256((__m256i*)_dest + 3, d);
+		}
+		_mm_sfence();
+	}
+
+	for (; ByteCount >= 32; ByteCount -= 32, _dest += 32, _source += 32)
+		_mm256_storeu_si256((__m256i*)_dest, _mm256_loadu_si256((__m256i*)_source));
+
+	__nx_memcopy_scalar(_dest, _source, ByteCount);
+}
+
+NX_TARGET_AVX512 internal void
+__nx_memcopy_avx512(void* Dest, void* Source, u64 ByteCount)
+{
+	u8* _dest = (u8*)Dest;
+	u8* _source = (u8*)Source;
+
+	if (ByteCount >= NX_MEMCOPY_STREAMING_THRESHOLD)
+	{
+		u64 Head = (64 - ((uintptr_t)_dest & 63)) & 63;
+		__nx_memcopy_scalar(_dest, _source, Head);
+		_dest += Head; _source += Head; ByteCount -= Head;
+
+		for (; ByteCount >= 128; ByteCount -= 128, _dest += 128, _source += 128)
+		{
+			__m512i a = _mm512_loadu_si512((__m512i*)_source + 0);
+			__m512i b = _mm512_loadu_si512((__m512i*)_source + 1);
+			_mm512_stream_si512((__m512i*)_dest + 0, a);
+			_mm512_stream_si512((__m512i*)_dest + 1, b);
+		}
+		_mm_sfence();
+	}
+
+	for (; ByteCount >= 64; ByteCount -= 64, _dest += 64, _source += 64)
+		_mm512_storeu_si512((__m512i*)_dest, _mm512_loadu_si512((__m512i*)_source));
+
+	// The tail is done in a single masked load/store.
+	if (ByteCount > 0)
+	{
+		__mmask64 TailMask = _cvtu64_mask64(~0ull >> (64 - ByteCount));
+		_mm512_mask_storeu_epi8(_dest, TailMask, _mm512_maskz_loadu_epi8(TailMask, _source));
+	}
 }
+#endif
 
 /**
  * nx_memset
  * 			Sets a region of memory to a specified value.
+ *
+ * NOTE:
+ * 			Unlike nx_memcopy, nx_memset never streams. What we set is almost always the thing we
+ * 			are about to draw into, so we want it to be in the cache when we get there.
  */
+typedef void fnptr_nx_memset(void* Dest, u64 ByteCount, u8 Value);
 
 // Sets a region of memory with a given value.
 internal void
-__nx_memset_unaligned(void* Dest, u32 ByteCount, u8 Value)
+__nx_memset_unaligned(void* Dest, u64 ByteCount, u8 Value)
 {
-	for (u32 bIndex = 0; bIndex < ByteCount; ++bIndex)
+	for (u64 bIndex = 0; bIndex < ByteCount; ++bIndex)
 		*((u8*)Dest+bIndex) = Value;
 }
 
 // Sets a region of memory with a given value at 64-bit increments.
 internal void
-__nx_memset_aligned_64bit(void* Dest, u32 ByteCount, u64 Value)
+__nx_memset_aligned_64bit(void* Dest, u64 ByteCount, u64 Value)
 {
 #ifdef NINETAILSX_DEBUG
 	assert((ByteCount % 8) == 0);
 #endif
-	for (u32 bIndex = 0; bIndex < (ByteCount*8)/64; ++bIndex)
+	for (u64 bIndex = 0; bIndex < ByteCount/8; ++bIndex)
 		*((u64*)Dest+bIndex) = Value;
 }
 
-/**
- * Sets a region of memory to a specified value.
- * 
- * TODO:
- * 			Much like nx_memcopy, we can probably use SSE instructions to potentially
- * 			speed this up. There's a good possibility that this function will be called
- * 			often to reset certain regions of memory to zero every frame, so it may be
- * 			necessary to profile this and see how we can speed this up. For now,
- * 			this will work fine as a 64bit operation.
- * 
- * 			Additionally, some method of making this branchless would be ideal.
- */
+// The scalar kernel, also used by the vector kernels to finish off their tails.
 internal void
-nx_memset(void* Dest, u32 ByteCount, u8 Value = 0x00)
+__nx_memset_scalar(void* Dest, u64 ByteCount, u8 Value)
 {
+	u64 unaligned = ByteCount % 8;
+	u64 aligned = ByteCount - unaligned;
+
+	// Multiplying by 0x0101... spreads the byte across every byte of the 64-bit value.
+	__nx_memset_aligned_64bit(Dest, aligned, (u64)Value * 0x0101010101010101ull);
+	__nx_memset_unaligned((u8*)Dest+aligned, unaligned, Value);
+}
 
-	u32 unaligned = ByteCount % 8;
-	u32 aligned = ByteCount - unaligned;
+#if defined(NINETAILSX_ARCH_X86)
+NX_TARGET_SSE2 internal void
+__nx_memset_sse2(void* Dest, u64 ByteCount, u8 Value)
+{
+	u8* _dest = (u8*)Dest;
+	__m128i _value = _mm_set1_epi8((char)Value);
 
-	// No fancy bit manip required for zero.
-	if (Value == 0x00)
+	for (; ByteCount >= 64; ByteCount -= 64, _dest += 64)
 	{
-		__nx_memset_aligned_64bit(Dest, aligned, (u64)0x00);
+		_mm_storeu_si128((__m128i*)_dest + 0, _value);
+		_mm_storeu_si128((__m128i*)_dest + 1, _value);
+		_mm_storeu_si128((__m128i*)_dest + 2, _value);
+		_mm_storeu_si128((__m128i*)_dest + 3, _value);
 	}
+	for (; ByteCount >= 16; ByteCount -= 16, _dest += 16)
+		_mm_storeu_si128((__m128i*)_dest, _value);
 
-	// We need to perform some bit magic to spread this value across
-	// a 64-bit value.
-	else
+	__nx_memset_scalar(_dest, ByteCount, Value);
+}
+
+NX_TARGET_AVX2 internal void
+__nx_memset_avx2(void* Dest, u64 ByteCount, u8 Value)
+{
+	u8* _dest = (u8*)Dest;
+	__m256i _value = _mm256_set1_epi8((char)Value);
+
+	for (; ByteCount >= 128; ByteCount -= 128, _dest += 128)
 	{
-		u64 __aligned16 = (Value << 8) | Value;
-		u64 __aligned32 = (__aligned16 << 16) | __aligned16;
-		u64 __aligned64 = (__aligned32 << 32) | __aligned32;
-		__nx_memset_aligned_64bit(Dest, aligned, __aligned64);
+		_mm256_storeu_si256((__m256i*)_dest + 0, _value);
+		_mm256_storeu_si256((__m256i*)_dest + 1, _value);
+		_mm256_storeu_si256((__m256i*)_dest + 2, _value);
+		_mm256_storeu_si256((__m256i*)_dest + 3, _value);
 	}
+	for (; ByteCount >= 32; ByteCount -= 32, _dest += 32)
+		_mm256_storeu_si256((__m256i*)_dest, _value);
 
-	__nx_memset_unaligned((u8*)Dest+aligned, unaligned, Value);
+	__nx_memset_scalar(_dest, ByteCount, Value);
+}
+
+NX_TARGET_AVX512 internal void
+__nx_memset_avx512(void* Dest, u64 ByteCount, u8 Value)
+{
+	u8* _dest = (u8*)Dest;
+	__m512i _value = _mm512_set1_epi8((char)Value);
+
+	for (; ByteCount >= 128; ByteCount -= 128, _dest += 128)
+	{
+		_mm512_storeu_si512((__m512i*)_dest + 0, _value);
+		_mm512_storeu_si512((__m512i*)_dest + 1, _value);
+	}
+	for (; ByteCount >= 64; ByteCount -= 64, _dest += 64)
+		_mm512_storeu_si512((__m512i*)_dest, _value);
+
+	if (ByteCount > 0)
+		_mm512_mask_storeu_epi8(_dest, _cvtu64_mask64(~0ull >> (64 - ByteCount)), _value);
+}
+#endif
+
+/**
+ * The selected kernels. These are per translation unit, so the engine and the platform each
+ * select their own the first time they copy or set anything.
+ */
+global fnptr_nx_memcopy* __nx_memcopy_kernel;
+global fnptr_nx_memset* __nx_memset_kernel;
+
+/**
+ * Bytes this thread has copied with nx_memcopy, for the renderer's stats. Each thread keeps its own
+ * count so copies on different threads never contend for it, callers measure the difference across
+ * whatever they want counted.
+ */
+global thread_local u64 __nx_memcopy_bytes;
+
+/**
+ * Selects the memory kernels for the instruction set level reported by GetSIMDLevel(). This
+ * happens automatically on first use, it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectMemoryKernels()
+{
+	__nx_memcopy_kernel = &__nx_memcopy_scalar;
+	__nx_memset_kernel = &__nx_memset_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512:
+		{
+			__nx_memcopy_kernel = &__nx_memcopy_avx512;
+			__nx_memset_kernel = &__nx_memset_avx512;
+		} break;
+
+		case SIMD_LEVEL_AVX2:
+		{
+			__nx_memcopy_kernel = &__nx_memcopy_avx2;
+			__nx_memset_kernel = &__nx_memset_avx2;
+		} break;
+
+		case SIMD_LEVEL_SSE2:
+		{
+			__nx_memcopy_kernel = &__nx_memcopy_sse2;
+			__nx_memset_kernel = &__nx_memset_sse2;
+		} break;
+
+		default: break;
+	}
+#endif
+}
+
+/**
+ * Copies memory to a given destination. The regions must not overlap.
+ */
+internal void
+nx_memcopy(void* Dest, void* Source, u64 ByteCount)
+{
+	if (__nx_memcopy_kernel == NULL) SelectMemoryKernels();
+	__nx_memcopy_kernel(Dest, Source, ByteCount);
+	__nx_memcopy_bytes += ByteCount;
+}
+
+inline u64
+GetMemcopyByteCount()
+{
+	return __nx_memcopy_bytes;
+}
+
+/**
+ * Sets a region of memory to a specified value.
+ * 
+ * NOTE:
+ * 			This is called often to reset regions of memory to zero every frame, so it is
+ * 			dispatched the same way as nx_memcopy.
+ */
+internal void
+nx_memset(void* Dest, u64 ByteCount, u8 Value = 0x00)
+{
+	NX_PROFILE_SCOPE("nx_memset");
+	if (__nx_memset_kernel == NULL) SelectMemoryKernels();
+	__nx_memset_kernel(Dest, ByteCount, Value);
+}
+
+/**
+ * Virtual Memory
+ * 		The memory store is reserved as one large range of address space up front, and pages are
+ * 		only committed as the arenas in it grow into them.
+ *
+ * ReserveVirtualMemory		Reserves size bytes of address space, at base if possible. None of it
+ * 							can be touched until it is committed.
+ * CommitVirtualMemory		Commits the pages covering a range of reserved memory. Committing pages
+ * 							which are already committed is harmless.
+ * ReleaseVirtualMemory		Releases a whole reservation.
+ * AdviseLargePages			Asks for a committed range to be backed by large pages.
+ *
+ * NOTE:
+ * 			Windows only hands out large pages to processes holding SeLockMemoryPrivilege, and only for
+ * 			allocations committed in one go, which doesn't work with a reservation committed a chunk at
+ * 			a time. AdviseLargePages does nothing there. On Linux it is a transparent huge page hint.
+ */
+#define NX_MEMORY_PAGE_SIZE Kilobytes(4)
+#define NX_LARGE_PAGE_SIZE Megabytes(2)
+
+#ifndef NX_MEMORY_COMMIT_CHUNK
+#define NX_MEMORY_COMMIT_CHUNK Megabytes(1)
+#endif
+
+internal void*
+ReserveVirtualMemory(void* base, u64 size)
+{
+#if defined(_WIN32)
+	void* _memory = VirtualAlloc(base, size, MEM_RESERVE, PAGE_NOACCESS);
+	if (_memory == NULL && base != NULL) _memory = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+	return _memory;
+#else
+	void* _memory = mmap(base, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	return (_memory == MAP_FAILED ? NULL : _memory);
+#endif
+}
 
+internal b32
+CommitVirtualMemory(void* memory, u64 size)
+{
+	// Both APIs work in whole pages, so widen the range out to the pages it touches.
+	u64 first = (u64)memory & ~((u64)NX_MEMORY_PAGE_SIZE - 1);
+	u64 last = ((u64)memory + size + NX_MEMORY_PAGE_SIZE - 1) & ~((u64)NX_MEMORY_PAGE_SIZE - 1);
+
+#if defined(_WIN32)
+	return (VirtualAlloc((void*)first, last - first, MEM_COMMIT, PAGE_READWRITE) != NULL);
+#else
+	return (mprotect((void*)first, last - first, PROT_READ|PROT_WRITE) == 0);
+#endif
+}
+
+internal void
+ReleaseVirtualMemory(void* memory, u64 size)
+{
+#if defined(_WIN32)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+internal void
+AdviseLargePages(void* memory, u64 size)
+{
+#if defined(MADV_HUGEPAGE)
+	madvise(memory, size, MADV_HUGEPAGE);
+#endif
 }
 
 /**
  * Defines the simplest unit of allocation.
+ *
+ * NOTE:
+ * 			An arena made with CreateVirtualMemoryArena starts out reserved but not committed, and
+ * 			commits NX_MEMORY_COMMIT_CHUNK at a time as pushes cross the committed high-water mark.
+ * 			Pops never decommit, the pages are reused by the next push.
  */
 typedef struct
 {
@@ -119,8 +427,13 @@ typedef struct
 	void* offset;
 	size_t length;
 	size_t commit;
+	size_t committed;
+	u32 temporaryCount;
 } memarena_t;
 
+/**
+ * Creates an arena over memory which is already committed.
+ */
 inline memarena_t
 CreateMemoryArena(void* base, size_t length)
 {
@@ -128,7 +441,20 @@ CreateMemoryArena(void* base, size_t length)
 	_arena.base = base;
 	_arena.offset = base;
 	_arena.commit = 0;
+	_arena.committed = length;
 	_arena.length = length;
+	_arena.temporaryCount = 0;
+	return _arena;
+}
+
+/**
+ * Creates an arena over reserved memory, which is committed as the arena grows.
+ */
+inline memarena_t
+CreateVirtualMemoryArena(void* base, size_t length)
+{
+	memarena_t _arena = CreateMemoryArena(base, length);
+	_arena.committed = 0;
 	return _arena;
 }
 
@@ -136,7 +462,23 @@ CreateMemoryArena(void* base, size_t length)
  * Alias macros for PushSize for structs (types) and arrays.
  */
 #define PushStruct(memarena, struct_type) (struct_type*)PushSize(memarena, sizeof(struct_type))
-#define PushArray(memarena, array_type, array_count) (array_type*)PushSize(memarena, sizeof(array_type)*array_count)
+#define PushArray(memarena, array_type, array_count) (array_type*)PushSize(memarena, sizeof(array_type)*(array_count))
+
+/**
+ * Commits the arena up to at least required bytes, a whole chunk at a time.
+ */
+internal void
+__arena_commit(memarena_t* memoryArena, size_t required)
+{
+	size_t _committed = (required + NX_MEMORY_COMMIT_CHUNK - 1) & ~((size_t)NX_MEMORY_COMMIT_CHUNK - 1);
+	if (_committed > memoryArena->length) _committed = memoryArena->length;
+
+	b32 _success = CommitVirtualMemory((u8*)memoryArena->base + memoryArena->committed, _committed - memoryArena->committed);
+	assert(_success); // Out of memory, or the arena isn't over reserved memory.
+	(void)_success;
+
+	memoryArena->committed = _committed;
+}
 
 /**
  * Pushes a given size to a memory arena.
@@ -145,7 +487,8 @@ inline void*
 PushSize(memarena_t* memoryArena, size_t bytes)
 {
 
-	assert((memoryArena->commit + bytes) < memoryArena->length); // Ensure we don't run over the arena's limit.
+	assert((memoryArena->commit + bytes) <= memoryArena->length); // Ensure we don't run over the arena's limit.
+	if (memoryArena->commit + bytes > memoryArena->committed) __arena_commit(memoryArena, memoryArena->commit + bytes);
 
 	void* _allocation = memoryArena->offset;
 	memoryArena->commit += bytes;
@@ -155,6 +498,117 @@ PushSize(memarena_t* memoryArena, size_t bytes)
 
 }
 
+/**
+ * Pushes a given size to a memory arena, aligned to alignment bytes. The alignment must be a power
+ * of two. The padding in front of the allocation is pushed with it, so Pop can't undo this, use
+ * temporary memory instead.
+ */
+inline void*
+PushSizeAligned(memarena_t* memoryArena, size_t bytes, size_t alignment)
+{
+
+	assert((alignment & (alignment - 1)) == 0);
+	size_t _padding = (size_t)(-(intptr_t)memoryArena->offset) & (alignment - 1);
+	return (u8*)PushSize(memoryArena, _padding + bytes) + _padding;
+
+}
+
+#define PushStructAligned(memarena, struct_type, alignment) (struct_type*)PushSizeAligned(memarena, sizeof(struct_type), alignment)
+#define PushArrayAligned(memarena, array_type, array_count, alignment) (array_type*)PushSizeAligned(memarena, sizeof(array_type)*(array_count), alignment)
+
+/**
+ * Pushes a given size to a memory arena on its own large pages, for memory that is swept over
+ * every frame like the framebuffer. The allocation is aligned and rounded up to NX_LARGE_PAGE_SIZE
+ * so no other allocation shares its pages.
+ */
+internal void*
+PushLargePageSize(memarena_t* memoryArena, size_t bytes)
+{
+
+	size_t _size = (bytes + NX_LARGE_PAGE_SIZE - 1) & ~((size_t)NX_LARGE_PAGE_SIZE - 1);
+	void* _allocation = PushSizeAligned(memoryArena, _size, NX_LARGE_PAGE_SIZE);
+	AdviseLargePages(_allocation, _size);
+
+	return _allocation;
+
+}
+
+/**
+ * Carves a child arena of the given length out of an arena. A child of an arena over reserved
+ * memory commits its own pages as it grows, rather than the parent committing all of them now.
+ */
+internal memarena_t
+PushMemoryArena(memarena_t* memoryArena, size_t length)
+{
+
+	assert((memoryArena->commit + length) <= memoryArena->length);
+	if (memoryArena->committed == memoryArena->length)
+		return CreateMemoryArena(PushSize(memoryArena, length), length);
+
+	void* _base = memoryArena->offset;
+	memoryArena->commit += length;
+	memoryArena->offset = (u8*)memoryArena->offset + length;
+	return CreateVirtualMemoryArena(_base, length);
+
+}
+
+/**
+ * Empties an arena in one step. Nothing is cleared or decommitted.
+ */
+inline void
+ResetMemoryArena(memarena_t* memoryArena)
+{
+	assert(memoryArena->temporaryCount == 0);
+	memoryArena->offset = memoryArena->base;
+	memoryArena->commit = 0;
+}
+
+/**
+ * Temporary Memory
+ * 		Marks a point in an arena to roll back to. Everything pushed between BeginTemporaryMemory
+ * 		and EndTemporaryMemory is released together, however it was aligned.
+ *
+ * NOTE:
+ * 			Temporary memory nests, but has to be ended in the reverse order it was begun. The
+ * 			arena counts how many are open, so resetting or ending out of order trips an assert.
+ */
+typedef struct
+{
+	memarena_t* arena;
+	size_t commit;
+	u32 depth;
+} temporary_memory;
+
+inline temporary_memory
+BeginTemporaryMemory(memarena_t* memoryArena)
+{
+	temporary_memory _temp;
+	_temp.arena = memoryArena;
+	_temp.commit = memoryArena->commit;
+	_temp.depth = ++memoryArena->temporaryCount;
+	return _temp;
+}
+
+inline void
+EndTemporaryMemory(temporary_memory temp)
+{
+	memarena_t* _arena = temp.arena;
+	assert(_arena->temporaryCount == temp.depth && _arena->commit >= temp.commit);
+	_arena->offset = (u8*)_arena->base + temp.commit;
+	_arena->commit = temp.commit;
+	_arena->temporaryCount--;
+}
+
+/**
+ * Ends temporary memory without rolling back, so everything pushed since it began is kept.
+ */
+inline void
+KeepTemporaryMemory(temporary_memory temp)
+{
+	assert(temp.arena->temporaryCount == temp.depth);
+	temp.arena->temporaryCount--;
+}
+
 /**
  * Pops a given size to a memory arena. This does not clear to 0.
  */
@@ -168,4 +622,7 @@ Pop(memarena_t* memoryArena, size_t bytes)
 	
 }
 
-#endif
\ No newline at end of file
+#include <nxcore/memory/pool.h>
+#include <nxcore/memory/tlsf.h>
+
+#endif
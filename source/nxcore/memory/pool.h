@@ -0,0 +1,122 @@
+#ifndef NINETAILSX_POOL_H
+#define NINETAILSX_POOL_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+
+/**
+ * The block pool.
+ *
+ * A fixed number of same-size blocks carved out of an arena, for objects which are created and
+ * destroyed all the time. Free blocks are chained through their own first bytes, so allocating
+ * and freeing are both a single pointer swap.
+ *
+ * NOTE:
+ * 			Blocks past the high-water mark have never been handed out and aren't on the free
+ * 			list yet. They are handed out in order before the free list is touched, so creating a
+ * 			pool doesn't have to walk (and fault in) every block up front.
+ */
+typedef struct memory_pool
+{
+	u8* blocks;
+	size_t blockSize;
+	u32 blockCount;
+
+	void* freeList;
+	u32 highWaterCount; // Blocks [0, highWaterCount) have been handed out at least once.
+	u32 usedCount;
+	u32 peakCount;
+} memory_pool;
+
+typedef struct memory_pool_stats
+{
+	size_t blockSize;
+	u32 blockCount;
+	u32 usedBlocks;
+	u32 peakBlocks;
+	r32 occupancy; // Used blocks over all blocks.
+	r32 fragmentation; // Free blocks below the high-water mark, over the blocks below it.
+} memory_pool_stats;
+
+/**
+ * Creates a pool of blockCount blocks of at least blockSize bytes, aligned to alignment, from arena.
+ */
+internal memory_pool
+CreateMemoryPool(memarena_t* arena, size_t blockSize, u32 blockCount, size_t alignment = 16)
+{
+
+	// Every block has to be able to hold the free list link, and keep the next one aligned.
+	if (blockSize < sizeof(void*)) blockSize = sizeof(void*);
+	if (alignment < sizeof(void*)) alignment = sizeof(void*);
+	blockSize = (blockSize + alignment - 1) & ~(alignment - 1);
+
+	memory_pool _pool = {};
+	_pool.blocks = (u8*)PushSizeAligned(arena, blockSize * blockCount, alignment);
+	_pool.blockSize = blockSize;
+	_pool.blockCount = blockCount;
+	return _pool;
+
+}
+
+/**
+ * Returns a block, or NULL when every block is in use. The contents are not cleared.
+ */
+inline void*
+PoolAlloc(memory_pool* pool)
+{
+
+	void* _block = pool->freeList;
+	if (_block != NULL) pool->freeList = *(void**)_block;
+	else if (pool->highWaterCount < pool->blockCount) _block = pool->blocks + pool->blockSize * pool->highWaterCount++;
+	else return NULL;
+
+	if (++pool->usedCount > pool->peakCount) pool->peakCount = pool->usedCount;
+	return _block;
+
+}
+
+#define PoolAllocStruct(pool, struct_type) (struct_type*)PoolAlloc(pool)
+
+/**
+ * Returns a block to the pool. The block must have come from this pool.
+ */
+inline void
+PoolFree(memory_pool* pool, void* block)
+{
+
+	if (block == NULL) return;
+	assert((u8*)block >= pool->blocks && (u8*)block < pool->blocks + pool->blockSize * pool->highWaterCount);
+	assert(((size_t)((u8*)block - pool->blocks) % pool->blockSize) == 0);
+
+	*(void**)block = pool->freeList;
+	pool->freeList = block;
+	pool->usedCount--;
+
+}
+
+/**
+ * Frees every block at once.
+ */
+inline void
+ResetMemoryPool(memory_pool* pool)
+{
+	pool->freeList = NULL;
+	pool->highWaterCount = 0;
+	pool->usedCount = 0;
+}
+
+internal memory_pool_stats
+GetMemoryPoolStats(memory_pool* pool)
+{
+
+	memory_pool_stats _stats = {};
+	_stats.blockSize = pool->blockSize;
+	_stats.blockCount = pool->blockCount;
+	_stats.usedBlocks = pool->usedCount;
+	_stats.peakBlocks = pool->peakCount;
+	if (pool->blockCount) _stats.occupancy = (r32)pool->usedCount / (r32)pool->blockCount;
+	if (pool->highWaterCount) _stats.fragmentation = (r32)(pool->highWaterCount - pool->usedCount) / (r32)pool->highWaterCount;
+	return _stats;
+
+}
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef NINETAILSX_TLSF_H
+#define NINETAILSX_TLSF_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * The TLSF (two-level segregated fit) allocator.
+ *
+ * Variable-size allocations out of a region carved from an arena, with allocation and freeing
+ * in constant time regardless of how many blocks there are. Free blocks are binned in two levels:
+ * the first by the power of two of their size, the second splitting each power of two into
+ * TLSF_SL_COUNT linear ranges. A bitmap per level finds the smallest non-empty bin which fits a
+ * request with a couple of bit scans, and neighbouring free blocks are merged as soon as a block
+ * is freed.
+ *
+ * Every block starts with a header holding its size and a pointer to the block physically in
+ * front of it. The size is a multiple of TLSF_ALIGNMENT, which leaves the low bits of it free to
+ * flag whether the block, and the block in front of it, are free. Free blocks keep their free list
+ * links at the start of their payload.
+ *
+ * NOTE:
+ * 			Allocations are aligned to TLSF_ALIGNMENT and the region is limited to 4 GB.
+ */
+#define TLSF_ALIGNMENT_LOG2 4
+#define TLSF_ALIGNMENT (1 << TLSF_ALIGNMENT_LOG2)
+#define TLSF_SL_COUNT_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_COUNT_LOG2)
+#define TLSF_FL_SHIFT (TLSF_SL_COUNT_LOG2 + TLSF_ALIGNMENT_LOG2)
+#define TLSF_FL_MAX 32
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+#define TLSF_SMALL_BLOCK_SIZE (1 << TLSF_FL_SHIFT)
+
+#define TLSF_BLOCK_FREE 0x1
+#define TLSF_BLOCK_PREV_FREE 0x2
+
+typedef struct tlsf_block
+{
+	tlsf_block* prevPhysical; // Only valid while TLSF_BLOCK_PREV_FREE is set.
+	size_t size; // The payload size, with the flags in the low bits.
+
+	// These overlap the payload, so they only exist while the block is free.
+	tlsf_block* nextFree;
+	tlsf_block* prevFree;
+} tlsf_block;
+
+#define TLSF_BLOCK_HEADER_SIZE (2*sizeof(void*))
+#define TLSF_BLOCK_MIN_SIZE (2*sizeof(void*))
+
+typedef struct tlsf_allocator
+{
+	u8* base;
+	size_t length;
+
+	u32 flBitmap;
+	u32 slBitmap[TLSF_FL_COUNT];
+	tlsf_block* freeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+	size_t usedBytes; // Payload bytes handed out, headers excluded.
+	size_t peakUsedBytes;
+	u32 allocationCount;
+} tlsf_allocator;
+
+typedef struct tlsf_stats
+{
+	size_t totalBytes; // Bytes available for payloads, with nothing allocated.
+	size_t usedBytes;
+	size_t peakUsedBytes;
+	size_t freeBytes;
+	size_t largestFreeBlock;
+	u32 allocationCount;
+	u32 freeBlockCount;
+	r32 occupancy; // Used bytes over total bytes.
+	r32 fragmentation; // How much of the free memory is outside the largest free block.
+} tlsf_stats;
+
+inline u32
+__tlsf_find_lowest_bit(u32 value)
+{
+#if defined(_MSC_VER)
+	unsigned long _index;
+	_BitScanForward(&_index, value);
+	return (u32)_index;
+#else
+	return (u32)__builtin_ctz(value);
+#endif
+}
+
+inline u32
+__tlsf_find_highest_bit(size_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long _index;
+	_BitScanReverse64(&_index, (unsigned __int64)value);
+	return (u32)_index;
+#else
+	return (u32)(63 - __builtin_clzll((unsigned long long)value));
+#endif
+}
+
+inline size_t __tlsf_block_size(tlsf_block* block) { return block->size & ~(size_t)(TLSF_BLOCK_FREE|TLSF_BLOCK_PREV_FREE); }
+inline void* __tlsf_block_payload(tlsf_block* block) { return (u8*)block + TLSF_BLOCK_HEADER_SIZE; }
+inline tlsf_block* __tlsf_payload_block(void* memory) { return (tlsf_block*)((u8*)memory - TLSF_BLOCK_HEADER_SIZE); }
+inline tlsf_block* __tlsf_next_physical(tlsf_block* block) { return (tlsf_block*)((u8*)block + TLSF_BLOCK_HEADER_SIZE + __tlsf_block_size(block)); }
+
+/**
+ * Maps a size to the bin it is stored in.
+ */
+inline void
+__tlsf_mapping_insert(size_t size, u32* fl, u32* sl)
+{
+	if (size < TLSF_SMALL_BLOCK_SIZE)
+	{
+		*fl = 0;
+		*sl = (u32)(size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_COUNT));
+	}
+	else
+	{
+		u32 highest = __tlsf_find_highest_bit(size);
+		*sl = (u32)(size >> (highest - TLSF_SL_COUNT_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = highest - (TLSF_FL_SHIFT - 1);
+	}
+}
+
+/**
+ * Maps a request to the first bin whose every block is large enough for it, by rounding the
+ * request up to the start of the next bin.
+ */
+inline void
+__tlsf_mapping_search(size_t size, u32* fl, u32* sl)
+{
+	if (size >= TLSF_SMALL_BLOCK_SIZE)
+		size += ((size_t)1 << (__tlsf_find_highest_bit(size) - TLSF_SL_COUNT_LOG2)) - 1;
+	__tlsf_mapping_insert(size, fl, sl);
+}
+
+internal void
+__tlsf_insert_free(tlsf_allocator* tlsf, tlsf_block* block)
+{
+	u32 fl, sl;
+	__tlsf_mapping_insert(__tlsf_block_size(block), &fl, &sl);
+
+	tlsf_block* head = tlsf->freeLists[fl][sl];
+	block->nextFree = head;
+	block->prevFree = NULL;
+	if (head) head->prevFree = block;
+	tlsf->freeLists[fl][sl] = block;
+
+	tlsf->flBitmap |= (1u << fl);
+	tlsf->slBitmap[fl] |= (1u << sl);
+}
+
+internal void
+__tlsf_remove_free(tlsf_allocator* tlsf, tlsf_block* block)
+{
+	u32 fl, sl;
+	__tlsf_mapping_insert(__tlsf_block_size(block), &fl, &sl);
+
+	if (block->prevFree) block->prevFree->nextFree = block->nextFree;
+	else tlsf->freeLists[fl][sl] = block->nextFree;
+	if (block->nextFree) block->nextFree->prevFree = block->prevFree;
+
+	if (tlsf->freeLists[fl][sl] == NULL)
+	{
+		tlsf->slBitmap[fl] &= ~(1u << sl);
+		if (tlsf->slBitmap[fl] == 0) tlsf->flBitmap &= ~(1u << fl);
+	}
+}
+
+/**
+ * Creates a TLSF allocator over size bytes pushed from arena.
+ */
+internal tlsf_allocator
+CreateTLSFAllocator(memarena_t* arena, size_t size)
+{
+
+	size = size & ~((size_t)TLSF_ALIGNMENT - 1);
+	assert(size >= 2*TLSF_BLOCK_HEADER_SIZE + TLSF_BLOCK_MIN_SIZE && size <= ((size_t)1 << TLSF_FL_MAX));
+
+	tlsf_allocator _tlsf = {};
+	_tlsf.base = (u8*)PushSizeAligned(arena, size, TLSF_ALIGNMENT);
+	_tlsf.length = size;
+
+	// One free block covering everything, then a zero-size sentinel which is never free, so that
+	// merging never has to check for the end of the region.
+	tlsf_block* block = (tlsf_block*)_tlsf.base;
+	block->prevPhysical = NULL;
+	block->size = (size - 2*TLSF_BLOCK_HEADER_SIZE) | TLSF_BLOCK_FREE;
+
+	tlsf_block* sentinel = __tlsf_next_physical(block);
+	sentinel->prevPhysical = block;
+	sentinel->size = TLSF_BLOCK_PREV_FREE;
+
+	__tlsf_insert_free(&_tlsf, block);
+	return _tlsf;
+
+}
+
+/**
+ * Allocates size bytes, or returns NULL if no free block is large enough.
+ */
+internal void*
+TLSFAlloc(tlsf_allocator* tlsf, size_t size)
+{
+
+	if (size < TLSF_BLOCK_MIN_SIZE) size = TLSF_BLOCK_MIN_SIZE;
+	size = (size + TLSF_ALIGNMENT - 1) & ~((size_t)TLSF_ALIGNMENT - 1);
+	if (size >= ((size_t)1 << TLSF_FL_MAX)) return NULL;
+
+	// Find the smallest non-empty bin at or above the one the size rounds up to.
+	u32 fl, sl;
+	__tlsf_mapping_search(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT) return NULL;
+
+	u32 slMap = tlsf->slBitmap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		u32 flMap = (fl + 1 < 32 ? tlsf->flBitmap & (~0u << (fl + 1)) : 0);
+		if (flMap == 0) return NULL;
+		fl = __tlsf_find_lowest_bit(flMap);
+		slMap = tlsf->slBitmap[fl];
+	}
+	sl = __tlsf_find_lowest_bit(slMap);
+
+	tlsf_block* block = tlsf->freeLists[fl][sl];
+	__tlsf_remove_free(tlsf, block);
+
+	// Give whatever is left over back as a block of its own, if it is big enough to be one.
+	size_t blockSize = __tlsf_block_size(block);
+	tlsf_block* next = __tlsf_next_physical(block);
+	if (blockSize >= size + TLSF_BLOCK_HEADER_SIZE + TLSF_BLOCK_MIN_SIZE)
+	{
+		tlsf_block* remainder = (tlsf_block*)((u8*)block + TLSF_BLOCK_HEADER_SIZE + size);
+		remainder->size = (blockSize - size - TLSF_BLOCK_HEADER_SIZE) | TLSF_BLOCK_FREE;
+		next->prevPhysical = remainder;
+		__tlsf_insert_free(tlsf, remainder);
+
+		blockSize = size;
+	}
+	else next->size &= ~(size_t)TLSF_BLOCK_PREV_FREE;
+
+	block->size = blockSize | (block->size & TLSF_BLOCK_PREV_FREE);
+
+	tlsf->usedBytes += blockSize;
+	if (tlsf->usedBytes > tlsf->peakUsedBytes) tlsf->peakUsedBytes = tlsf->usedBytes;
+	tlsf->allocationCount++;
+	return __tlsf_block_payload(block);
+
+}
+
+/**
+ * Frees an allocation from TLSFAlloc, merging it with any free blocks on either side.
+ */
+internal void
+TLSFFree(tlsf_allocator* tlsf, void* memory)
+{
+
+	if (memory == NULL) return;
+	tlsf_block* block = __tlsf_payload_block(memory);
+	assert((u8*)block >= tlsf->base && (u8*)block < tlsf->base + tlsf->length);
+	assert(!(block->size & TLSF_BLOCK_FREE)); // Double free.
+
+	tlsf->usedBytes -= __tlsf_block_size(block);
+	tlsf->allocationCount--;
+
+	if (block->size & TLSF_BLOCK_PREV_FREE)
+	{
+		tlsf_block* prev = block->prevPhysical;
+		__tlsf_remove_free(tlsf, prev);
+		prev->size += TLSF_BLOCK_HEADER_SIZE + __tlsf_block_size(block);
+		block = prev;
+	}
+
+	tlsf_block* next = __tlsf_next_physical(block);
+	if (next->size & TLSF_BLOCK_FREE)
+	{
+		__tlsf_remove_free(tlsf, next);
+		block->size += TLSF_BLOCK_HEADER_SIZE + __tlsf_block_size(next);
+		next = __tlsf_next_physical(block);
+	}
+
+	block->size |= TLSF_BLOCK_FREE;
+	next->prevPhysical = block;
+	next->size |= TLSF_BLOCK_PREV_FREE;
+	__tlsf_insert_free(tlsf, block);
+
+}
+
+/**
+ * Returns the usable size of an allocation, which may be larger than what was asked for.
+ */
+inline size_t
+TLSFAllocationSize(void* memory)
+{
+	return __tlsf_block_size(__tlsf_payload_block(memory));
+}
+
+/**
+ * Collects the allocator's statistics.
+ *
+ * NOTE:
+ * 			Unlike allocating and freeing, this walks every block, so keep it out of hot paths.
+ */
+internal tlsf_stats
+GetTLSFStats(tlsf_allocator* tlsf)
+{
+
+	tlsf_stats _stats = {};
+	_stats.totalBytes = tlsf->length - 2*TLSF_BLOCK_HEADER_SIZE;
+	_stats.usedBytes = tlsf->usedBytes;
+	_stats.peakUsedBytes = tlsf->peakUsedBytes;
+	_stats.allocationCount = tlsf->allocationCount;
+
+	for (tlsf_block* block = (tlsf_block*)tlsf->base; __tlsf_block_size(block) != 0; block = __tlsf_next_physical(block))
+	{
+		if (!(block->size & TLSF_BLOCK_FREE)) continue;
+		size_t blockSize = __tlsf_block_size(block);
+		_stats.freeBytes += blockSize;
+		_stats.freeBlockCount++;
+		if (blockSize > _stats.largestFreeBlock) _stats.largestFreeBlock = blockSize;
+	}
+
+	if (_stats.totalBytes) _stats.occupancy = (r32)_stats.usedBytes / (r32)_stats.totalBytes;
+	if (_stats.freeBytes) _stats.fragmentation = 1.0f - (r32)_stats.largestFreeBlock / (r32)_stats.freeBytes;
+	return _stats;
+
+}
+
+#endif
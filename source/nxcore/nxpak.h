@@ -0,0 +1,154 @@
+#ifndef NINETAILSX_NXPAK_H
+#define NINETAILSX_NXPAK_H
+#include <nxcore/helpers.h>
+#include <nxcore/primitives.h>
+#include <nxcore/math.h>
+#include <nxcore/renderer/dibitmap.h>
+
+/**
+ * The asset archive (.nxpak).
+ *
+ * Every asset under assets/ packed into one file by the nxpack tool, so that loading them is one
+ * mapping rather than an open and a read each. The file is laid out as:
+ *
+ * 		nxpak_header
+ * 		nxpak_entry[tableCapacity]		The table of contents, an open-addressed hash table.
+ * 		blobs							Each starting on an NXPAK_BLOB_ALIGNMENT boundary.
+ *
+ * Assets are looked up by the hash of their path relative to assets/, with forward slashes
+ * ("sprites/player.bmp"), linearly probing from the slot the hash lands on. An id of zero marks
+ * an empty slot, and tableCapacity is always a power of two with room to spare, so a lookup is a
+ * couple of probes at most.
+ *
+ * Images are imported by the packer with ImportBitmap (renderer/import.h), DecodeQOI or DecodePNG,
+ * so they are stored in the renderer's own format, premultiplied and row aligned, and drawn in place.
+ *
+ * NOTE:
+ * 			Everything is little endian, like every platform we run on.
+ */
+#define NXPAK_MAGIC 0x4B50584E // "NXPK"
+#define NXPAK_VERSION 2
+#define NXPAK_BLOB_ALIGNMENT Kilobytes(4)
+
+enum nxpak_asset_type
+{
+	NXPAK_ASSET_RAW, // Copied as it was on disk.
+	NXPAK_ASSET_BITMAP, // Imported pixels, pitch*height u32s.
+};
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct nxpak_header
+{
+	u32 magic;
+	u32 version;
+	u32 entryCount;
+	u32 tableCapacity;
+	u64 tableOffset;
+} nxpak_header;
+
+typedef struct nxpak_entry
+{
+	u64 id;
+	u64 offset; // From the start of the file.
+	u64 size;
+	u32 type;
+	u32 width;
+	u32 height;
+	u32 pitch; // In pixels.
+} nxpak_entry;
+
+#pragma pack(pop)
+
+/**
+ * Hashes an asset path into its id, 64-bit FNV-1a. Zero is reserved for empty slots.
+ */
+inline u64
+NxpakAssetID(const char* path)
+{
+	u64 _hash = 0xCBF29CE484222325ull;
+	for (; *path; ++path)
+	{
+		_hash ^= (u8)*path;
+		_hash *= 0x100000001B3ull;
+	}
+	return (_hash ? _hash : 1);
+}
+
+typedef struct nxpak
+{
+	u8* base;
+	u64 size;
+	nxpak_header* header;
+	nxpak_entry* table;
+} nxpak;
+
+/**
+ * Opens an archive which is already in memory, usually mapped with MapResource. Returns false
+ * if it isn't an archive we can read.
+ */
+internal b32
+OpenNxpak(nxpak* pak, void* data, u64 size)
+{
+
+	*pak = {};
+	if (data == NULL || size < sizeof(nxpak_header)) return false;
+
+	nxpak_header* header = (nxpak_header*)data;
+	if (header->magic != NXPAK_MAGIC || header->version != NXPAK_VERSION) return false;
+	if (header->tableCapacity == 0 || (header->tableCapacity & (header->tableCapacity - 1)) != 0) return false;
+	if (header->tableOffset + (u64)header->tableCapacity * sizeof(nxpak_entry) > size) return false;
+
+	pak->base = (u8*)data;
+	pak->size = size;
+	pak->header = header;
+	pak->table = (nxpak_entry*)(pak->base + header->tableOffset);
+	return true;
+
+}
+
+/**
+ * Finds an asset by id, returns NULL if the archive doesn't have it.
+ */
+internal nxpak_entry*
+FindNxpakAsset(nxpak* pak, u64 id)
+{
+
+	if (pak->header == NULL) return NULL;
+
+	u32 mask = pak->header->tableCapacity - 1;
+	for (u32 probe = 0; probe <= mask; ++probe)
+	{
+		nxpak_entry* entry = &pak->table[(id + probe) & mask];
+		if (entry->id == id) return (entry->offset + entry->size <= pak->size ? entry : NULL);
+		if (entry->id == 0) return NULL;
+	}
+	return NULL;
+
+}
+
+inline void*
+GetNxpakAssetData(nxpak* pak, nxpak_entry* entry)
+{
+	return pak->base + entry->offset;
+}
+
+/**
+ * Returns a bitmap asset as a dibitmap pointing straight into the archive, or an empty dibitmap
+ * (NULL buffer) if there is no such bitmap. Packed bitmaps have no file header.
+ */
+internal dibitmap
+GetBitmapFromNxpak(nxpak* pak, u64 id)
+{
+	dibitmap _bitmap = {};
+	nxpak_entry* entry = FindNxpakAsset(pak, id);
+	if (entry == NULL || entry->type != NXPAK_ASSET_BITMAP) return _bitmap;
+
+	_bitmap.buffer = GetNxpakAssetData(pak, entry);
+	_bitmap.dims = { (i32)entry->width, (i32)entry->height };
+	_bitmap.pitch = (i32)entry->pitch;
+	return _bitmap;
+}
+
+#endif
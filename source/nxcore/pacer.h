@@ -0,0 +1,183 @@
+#ifndef NINETAILSX_PACER_H
+#define NINETAILSX_PACER_H
+#include <nxcore/helpers.h>
+#include <nxcore/clock.h>
+#include <nxcore/profiler.h>
+
+/**
+ * The frame pacer.
+ *
+ * Holds the platform loops to a fixed frame rate without burning a core to do it. Each wait sleeps
+ * until shortly before the frame's deadline and spins the rest of the way on the clock, so frames
+ * flip on time even though the scheduler can only promise to wake us up late.
+ *
+ * How much earlier than the deadline to stop sleeping (the spin margin) is learned as we go. Every
+ * sleep measures how far it overslept, and the margin follows the running average of that plus four
+ * times its running deviation, the same estimate TCP uses for its retransmit timer. A quiet machine
+ * settles to a margin of tens of microseconds, a noisy one backs off to NX_PACER_MAX_SPIN_MARGIN.
+ *
+ * Deadlines sit on a fixed grid, each one frame after the last, so sleeping late never pushes back
+ * the frames after it. A frame which misses its deadline entirely skips ahead to the next deadline
+ * on the grid, rather than rushing the frames after it to catch up.
+ *
+ * NOTE:
+ * 			On Windows the pacer sleeps on a high resolution waitable timer where there is one
+ * 			(Windows 10 1803 onwards), otherwise it raises the scheduler resolution to 1ms with
+ * 			timeBeginPeriod for as long as the pacer exists and falls back on Sleep.
+ */
+#ifndef NX_PACER_INITIAL_SPIN_MARGIN
+#define NX_PACER_INITIAL_SPIN_MARGIN 1000000ull // 1ms, until the first few sleeps have been measured.
+#endif
+
+#define NX_PACER_MIN_SPIN_MARGIN 20000ull // 20us
+#define NX_PACER_MAX_SPIN_MARGIN 4000000ull // 4ms
+
+#if defined(_WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+typedef struct frame_pacer
+{
+	u64 frameNanoseconds;
+	u64 deadline;
+	u64 lastFrameStamp;
+
+	// The oversleep estimate, which sets the spin margin.
+	i64 oversleepAverage;
+	i64 oversleepDeviation;
+	u64 spinMargin;
+
+	// What the last wait did, for frame timing displays.
+	u64 frameTime; // From the end of the previous wait to the end of this one.
+	u64 sleepTime;
+	u64 spinTime;
+	u64 missedDeadlines;
+
+#if defined(_WIN32)
+	HANDLE timer;
+#endif
+} frame_pacer;
+
+/**
+ * Creates a pacer for the given frame rate. The first deadline is one frame from now.
+ */
+inline frame_pacer
+CreateFramePacer(u32 framesPerSecond)
+{
+
+	frame_pacer _pacer = {};
+	_pacer.frameNanoseconds = 1000000000ull / framesPerSecond;
+	_pacer.lastFrameStamp = GetClockNanoseconds();
+	_pacer.deadline = _pacer.lastFrameStamp + _pacer.frameNanoseconds;
+	_pacer.oversleepDeviation = (i64)NX_PACER_INITIAL_SPIN_MARGIN / 4;
+	_pacer.spinMargin = NX_PACER_INITIAL_SPIN_MARGIN;
+
+#if defined(_WIN32)
+	_pacer.timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (_pacer.timer == NULL) timeBeginPeriod(1);
+#endif
+
+	return _pacer;
+
+}
+
+inline void
+DestroyFramePacer(frame_pacer* pacer)
+{
+#if defined(_WIN32)
+	if (pacer->timer != NULL) CloseHandle(pacer->timer);
+	else timeEndPeriod(1);
+	pacer->timer = NULL;
+#else
+	(void)pacer;
+#endif
+}
+
+inline void
+__pacer_sleep(frame_pacer* pacer, u64 nanoseconds)
+{
+#if defined(_WIN32)
+	if (pacer->timer != NULL)
+	{
+		LARGE_INTEGER DueTime;
+		DueTime.QuadPart = -(LONGLONG)(nanoseconds / 100); // Relative, in 100ns units.
+		if (SetWaitableTimer(pacer->timer, &DueTime, 0, NULL, NULL, FALSE))
+		{
+			WaitForSingleObject(pacer->timer, INFINITE);
+			return;
+		}
+	}
+#else
+	(void)pacer;
+#endif
+	SleepNanoseconds(nanoseconds);
+}
+
+/**
+ * Folds how far a sleep overslept into the estimate and recomputes the spin margin.
+ */
+inline void
+__pacer_learn(frame_pacer* pacer, i64 oversleep)
+{
+	if (oversleep < 0) oversleep = 0; // Waking early only costs spinning, it says nothing about waking late.
+
+	i64 _error = oversleep - pacer->oversleepAverage;
+	pacer->oversleepAverage += _error / 8;
+	pacer->oversleepDeviation += ((_error < 0 ? -_error : _error) - pacer->oversleepDeviation) / 4;
+
+	i64 _margin = pacer->oversleepAverage + 4 * pacer->oversleepDeviation;
+	if (_margin < (i64)NX_PACER_MIN_SPIN_MARGIN) _margin = (i64)NX_PACER_MIN_SPIN_MARGIN;
+	if (_margin > (i64)NX_PACER_MAX_SPIN_MARGIN) _margin = (i64)NX_PACER_MAX_SPIN_MARGIN;
+	pacer->spinMargin = (u64)_margin;
+}
+
+/**
+ * Waits for the current frame's deadline and schedules the next one. Call it once per frame, at
+ * the point the frame should be flipped.
+ */
+internal void
+WaitForNextFrame(frame_pacer* pacer)
+{
+
+	NX_PROFILE_SCOPE("WaitForNextFrame");
+	u64 _now = GetClockNanoseconds();
+	pacer->sleepTime = 0;
+	pacer->spinTime = 0;
+
+	if (_now >= pacer->deadline)
+	{
+		// Missed it. Move to the next deadline on the grid without waiting for it, the frame
+		// that follows gets the rest of its slot.
+		pacer->missedDeadlines++;
+		pacer->deadline += ((_now - pacer->deadline) / pacer->frameNanoseconds + 1) * pacer->frameNanoseconds;
+	}
+	else
+	{
+		while (pacer->deadline - _now > pacer->spinMargin)
+		{
+			u64 _request = pacer->deadline - _now - pacer->spinMargin;
+			__pacer_sleep(pacer, _request);
+
+			u64 _woke = GetClockNanoseconds();
+			__pacer_learn(pacer, (i64)(_woke - _now) - (i64)_request);
+			pacer->sleepTime += _woke - _now;
+			_now = _woke;
+			if (_now >= pacer->deadline) break;
+		}
+
+		u64 _spinStart = _now;
+		while (_now < pacer->deadline)
+		{
+			SpinPause();
+			_now = GetClockNanoseconds();
+		}
+		pacer->spinTime = _now - _spinStart;
+		pacer->deadline += pacer->frameNanoseconds;
+	}
+
+	pacer->frameTime = _now - pacer->lastFrameStamp;
+	pacer->lastFrameStamp = _now;
+
+}
+
+#endif
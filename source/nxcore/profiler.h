@@ -0,0 +1,404 @@
+#ifndef NINETAILSX_PROFILER_H
+#define NINETAILSX_PROFILER_H
+#include <atomic>
+#include <new>
+#include <nxcore/helpers.h>
+#include <nxcore/clock.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * The profiler.
+ *
+ * Instrumentation which stays in shipping builds. Code marks what it wants timed with a scope, and
+ * the time spent in it is recorded when the scope closes:
+ *
+ * 		NX_PROFILE_SCOPE("DrawRect");
+ * 		NX_PROFILE_COUNTER("RenderCommands", commands->commandCount);
+ *
+ * Every thread records into a ring of its own, so recording never takes a lock or shares a cache
+ * line with another thread, it is a pair of timestamp reads and one event written to the ring. The
+ * rings keep the latest NX_PROFILER_RING_EVENTS events of each thread and overwrite the oldest, so
+ * the profiler can run for the whole session and ExportProfilerTrace hands back the last stretch of
+ * it as Chrome trace_event JSON, which chrome://tracing and Perfetto open directly.
+ *
+ * Timestamps are read with rdtsc where there is one, and converted to real time when the trace is
+ * exported, from how far the counter and the clock each moved since the profiler was created.
+ *
+ * NOTE:
+ * 			The profiler lives in the platform. The platform creates it, makes it current with
+ * 			SetProfiler, and hands it to the engine through res_handler_interface, which makes it
+ * 			current on its side as well. The engine and the platform are separate modules with their
+ * 			own copy of everything in here, but a thread records into the same ring from both, since
+ * 			rings are looked up by the thread's OS id.
+ *
+ * 			Building with NX_PROFILER set to 0 (the NX_PROFILER CMake option) compiles every scope
+ * 			and counter out, and exports an empty trace.
+ */
+#ifndef NX_PROFILER
+#define NX_PROFILER 1
+#endif
+
+#ifndef NX_PROFILER_RING_EVENTS
+#define NX_PROFILER_RING_EVENTS 32768 // A power of two.
+#endif
+
+#define NX_PROFILER_THREAD_NAME_LENGTH 32
+
+enum profiler_event_type
+{
+	PROFILER_EVENT_SCOPE,
+	PROFILER_EVENT_COUNTER,
+};
+
+typedef struct profiler_event
+{
+	const char* name; // Must outlive the profiler, in practice a string literal.
+	u64 start; // In ticks.
+	u64 value; // The scope's length in ticks, or the counter's value.
+	u32 type;
+} profiler_event;
+
+typedef struct alignas(64) profiler_ring
+{
+	std::atomic<u64> threadId; // Zero until a thread has claimed the ring.
+	std::atomic<u64> head; // Events ever written, the next one goes at head % NX_PROFILER_RING_EVENTS.
+	char threadName[NX_PROFILER_THREAD_NAME_LENGTH];
+	profiler_event events[NX_PROFILER_RING_EVENTS];
+} profiler_ring;
+
+typedef struct profiler
+{
+	u64 baseTicks;
+	u64 baseNanoseconds;
+
+	u32 maxRings;
+	std::atomic<u32> ringCount;
+	profiler_ring* rings;
+} profiler;
+
+/**
+ * The current profiler, and the ring this thread records into. These are per module, see above.
+ */
+global profiler* __profiler;
+global thread_local profiler_ring* __profiler_ring;
+global thread_local b32 __profiler_ring_unavailable;
+
+inline u64
+ReadProfilerTicks()
+{
+#if defined(NINETAILSX_ARCH_X86)
+	return __rdtsc();
+#else
+	return GetClockNanoseconds();
+#endif
+}
+
+inline u64
+__profiler_thread_id()
+{
+#if defined(_WIN32)
+	return (u64)GetCurrentThreadId();
+#else
+	return (u64)syscall(SYS_gettid);
+#endif
+}
+
+/**
+ * The memory a profiler with room for the given number of threads needs.
+ */
+inline u64
+GetProfilerMemorySize(u32 maxThreads)
+{
+	return sizeof(profiler_ring) * (u64)(maxThreads + 1); // One more, to align the rings.
+}
+
+/**
+ * Creates a profiler in the given memory, which must be committed and stay so for the life of the
+ * profiler. Every thread which records anything takes a ring, once they run out the threads which
+ * came late go unrecorded.
+ */
+internal profiler*
+CreateProfiler(void* memory, u64 size)
+{
+
+	profiler* _profiler = new (memory) profiler();
+	_profiler->baseTicks = ReadProfilerTicks();
+	_profiler->baseNanoseconds = GetClockNanoseconds();
+
+	u64 _ringStart = ((u64)(_profiler + 1) + alignof(profiler_ring) - 1) & ~((u64)alignof(profiler_ring) - 1);
+	u64 _ringSpace = ((u64)memory + size > _ringStart ? (u64)memory + size - _ringStart : 0);
+	_profiler->rings = (profiler_ring*)_ringStart;
+	_profiler->maxRings = (u32)(_ringSpace / sizeof(profiler_ring));
+	for (u32 _ringIndex = 0; _ringIndex < _profiler->maxRings; ++_ringIndex)
+	{
+		_profiler->rings[_ringIndex].threadId.store(0, std::memory_order_relaxed);
+		_profiler->rings[_ringIndex].head.store(0, std::memory_order_relaxed);
+		_profiler->rings[_ringIndex].threadName[0] = 0;
+	}
+	_profiler->ringCount.store(0, std::memory_order_release);
+
+	return _profiler;
+
+}
+
+/**
+ * Makes a profiler current for this module. Call it before any thread records anything.
+ */
+inline void
+SetProfiler(profiler* Profiler)
+{
+	__profiler = Profiler;
+}
+
+/**
+ * Finds the ring this thread already has, which it may have claimed from the other module, or
+ * claims a new one.
+ */
+internal profiler_ring*
+__profiler_claim_ring()
+{
+
+	profiler* _profiler = __profiler;
+	if (_profiler == NULL || __profiler_ring_unavailable) return NULL;
+
+	u64 _threadId = __profiler_thread_id();
+	u32 _ringCount = _profiler->ringCount.load(std::memory_order_acquire);
+	if (_ringCount > _profiler->maxRings) _ringCount = _profiler->maxRings;
+	for (u32 _ringIndex = 0; _ringIndex < _ringCount; ++_ringIndex)
+	{
+		if (_profiler->rings[_ringIndex].threadId.load(std::memory_order_acquire) == _threadId)
+		{
+			__profiler_ring = &_profiler->rings[_ringIndex];
+			return __profiler_ring;
+		}
+	}
+
+	u32 _ringIndex = _profiler->ringCount.fetch_add(1, std::memory_order_acq_rel);
+	if (_ringIndex >= _profiler->maxRings)
+	{
+		__profiler_ring_unavailable = true;
+		return NULL;
+	}
+
+	__profiler_ring = &_profiler->rings[_ringIndex];
+	__profiler_ring->threadId.store(_threadId, std::memory_order_release);
+	return __profiler_ring;
+
+}
+
+/**
+ * Writes an event to this thread's ring. Only this thread ever writes to it, so the event only
+ * has to be filled in before the head moves past it.
+ */
+inline void
+RecordProfilerEvent(u32 type, const char* name, u64 start, u64 value)
+{
+	profiler_ring* _ring = __profiler_ring;
+	if (_ring == NULL && (_ring = __profiler_claim_ring()) == NULL) return;
+
+	u64 _head = _ring->head.load(std::memory_order_relaxed);
+	profiler_event* _event = &_ring->events[_head & (NX_PROFILER_RING_EVENTS - 1)];
+	_event->name = name;
+	_event->start = start;
+	_event->value = value;
+	_event->type = type;
+	_ring->head.store(_head + 1, std::memory_order_release);
+}
+
+/**
+ * Names the calling thread in the trace.
+ */
+inline void
+SetProfilerThreadName(const char* name)
+{
+	profiler_ring* _ring = __profiler_ring;
+	if (_ring == NULL && (_ring = __profiler_claim_ring()) == NULL) return;
+
+	u32 _length = 0;
+	for (; name[_length] && _length < NX_PROFILER_THREAD_NAME_LENGTH - 1; ++_length)
+		_ring->threadName[_length] = name[_length];
+	_ring->threadName[_length] = 0;
+}
+
+typedef struct profile_scope
+{
+	const char* name;
+	u64 start;
+
+	profile_scope(const char* scopeName) : name(scopeName), start(ReadProfilerTicks()) {}
+	~profile_scope() { RecordProfilerEvent(PROFILER_EVENT_SCOPE, name, start, ReadProfilerTicks() - start); }
+} profile_scope;
+
+#define __NX_PROFILE_JOIN2(a, b) a##b
+#define __NX_PROFILE_JOIN(a, b) __NX_PROFILE_JOIN2(a, b)
+
+#if NX_PROFILER
+#define NX_PROFILE_SCOPE(name) profile_scope __NX_PROFILE_JOIN(__profile_scope_, __LINE__)(name)
+#define NX_PROFILE_COUNTER(name, value) RecordProfilerEvent(PROFILER_EVENT_COUNTER, name, ReadProfilerTicks(), (u64)(value))
+#define NX_PROFILE_THREAD(name) SetProfilerThreadName(name)
+#else
+#define NX_PROFILE_SCOPE(name)
+#define NX_PROFILE_COUNTER(name, value)
+#define NX_PROFILE_THREAD(name)
+#endif
+
+/**
+ * Trace export.
+ *
+ * The JSON is written a buffer at a time through the sink, which returns false to stop the export.
+ */
+typedef b32 fnptr_profiler_sink(void* UserData, void* Data, u64 Size);
+
+typedef struct __profiler_writer
+{
+	fnptr_profiler_sink* sink;
+	void* userData;
+	b32 failed;
+	u32 count;
+	char buffer[4096];
+} __profiler_writer;
+
+inline void
+__profiler_flush(__profiler_writer* writer)
+{
+	if (!writer->failed && writer->count && !writer->sink(writer->userData, writer->buffer, writer->count))
+		writer->failed = true;
+	writer->count = 0;
+}
+
+inline void
+__profiler_put(__profiler_writer* writer, char c)
+{
+	if (writer->count == sizeof(writer->buffer)) __profiler_flush(writer);
+	writer->buffer[writer->count++] = c;
+}
+
+inline void
+__profiler_put_string(__profiler_writer* writer, const char* string)
+{
+	while (*string) __profiler_put(writer, *string++);
+}
+
+// Names are quoted and escaped for JSON.
+inline void
+__profiler_put_name(__profiler_writer* writer, const char* name)
+{
+	__profiler_put(writer, '"');
+	for (; *name; ++name)
+	{
+		if (*name == '"' || *name == '\\') __profiler_put(writer, '\\');
+		if ((u8)*name >= 0x20) __profiler_put(writer, *name);
+	}
+	__profiler_put(writer, '"');
+}
+
+inline void
+__profiler_put_u64(__profiler_writer* writer, u64 value)
+{
+	char _digits[20];
+	u32 _count = 0;
+	do { _digits[_count++] = (char)('0' + value % 10); value /= 10; } while (value);
+	while (_count) __profiler_put(writer, _digits[--_count]);
+}
+
+// Trace timestamps are in microseconds, we keep them to the nanosecond.
+inline void
+__profiler_put_microseconds(__profiler_writer* writer, u64 nanoseconds)
+{
+	__profiler_put_u64(writer, nanoseconds / 1000);
+	__profiler_put(writer, '.');
+	u32 _fraction = (u32)(nanoseconds % 1000);
+	__profiler_put(writer, (char)('0' + _fraction / 100));
+	__profiler_put(writer, (char)('0' + (_fraction / 10) % 10));
+	__profiler_put(writer, (char)('0' + _fraction % 10));
+}
+
+/**
+ * Writes out everything still in the rings as a Chrome trace. Returns false if the sink failed.
+ *
+ * NOTE:
+ * 			Threads can keep recording while the export runs, the export only takes what was in
+ * 			their ring when it got to it. A thread which writes a whole ring's worth of events in
+ * 			that time can overwrite some of what is being exported, so for a clean trace export
+ * 			between frames.
+ */
+internal b32
+ExportProfilerTrace(profiler* Profiler, fnptr_profiler_sink* Sink, void* UserData)
+{
+
+	__profiler_writer _writer;
+	__profiler_writer* writer = &_writer;
+	writer->sink = Sink;
+	writer->userData = UserData;
+	writer->failed = false;
+	writer->count = 0;
+
+	__profiler_put_string(writer, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	// How many nanoseconds a tick is, from how far both have moved since the profiler started.
+	u64 _ticks = ReadProfilerTicks() - Profiler->baseTicks;
+	u64 _nanoseconds = GetClockNanoseconds() - Profiler->baseNanoseconds;
+	r64 _nanosecondsPerTick = (_ticks ? (r64)_nanoseconds / (r64)_ticks : 1.0);
+
+	b32 _first = true;
+	u32 _ringCount = Profiler->ringCount.load(std::memory_order_acquire);
+	if (_ringCount > Profiler->maxRings) _ringCount = Profiler->maxRings;
+	for (u32 _ringIndex = 0; _ringIndex < _ringCount; ++_ringIndex)
+	{
+		profiler_ring* _ring = &Profiler->rings[_ringIndex];
+		u64 _threadId = _ring->threadId.load(std::memory_order_acquire);
+		if (_threadId == 0) continue;
+
+		if (_ring->threadName[0])
+		{
+			if (!_first) __profiler_put(writer, ',');
+			_first = false;
+			__profiler_put_string(writer, "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":");
+			__profiler_put_u64(writer, _threadId);
+			__profiler_put_string(writer, ",\"args\":{\"name\":");
+			__profiler_put_name(writer, _ring->threadName);
+			__profiler_put_string(writer, "}}");
+		}
+
+		u64 _head = _ring->head.load(std::memory_order_acquire);
+		u64 _tail = (_head > NX_PROFILER_RING_EVENTS ? _head - NX_PROFILER_RING_EVENTS : 0);
+		for (u64 _eventIndex = _tail; _eventIndex < _head; ++_eventIndex)
+		{
+			profiler_event _event = _ring->events[_eventIndex & (NX_PROFILER_RING_EVENTS - 1)];
+			if (_event.name == NULL || _event.start < Profiler->baseTicks) continue;
+			u64 _start = (u64)((r64)(_event.start - Profiler->baseTicks) * _nanosecondsPerTick);
+
+			if (!_first) __profiler_put(writer, ',');
+			_first = false;
+			__profiler_put_string(writer, "\n{\"name\":");
+			__profiler_put_name(writer, _event.name);
+			__profiler_put_string(writer, (_event.type == PROFILER_EVENT_SCOPE ? ",\"ph\":\"X\",\"ts\":" : ",\"ph\":\"C\",\"ts\":"));
+			__profiler_put_microseconds(writer, _start);
+			if (_event.type == PROFILER_EVENT_SCOPE)
+			{
+				__profiler_put_string(writer, ",\"dur\":");
+				__profiler_put_microseconds(writer, (u64)((r64)_event.value * _nanosecondsPerTick));
+			}
+			__profiler_put_string(writer, ",\"pid\":1,\"tid\":");
+			__profiler_put_u64(writer, _threadId);
+			if (_event.type == PROFILER_EVENT_COUNTER)
+			{
+				__profiler_put_string(writer, ",\"args\":{\"value\":");
+				__profiler_put_u64(writer, _event.value);
+				__profiler_put(writer, '}');
+			}
+			__profiler_put(writer, '}');
+		}
+	}
+
+	__profiler_put_string(writer, "\n]}\n");
+	__profiler_flush(writer);
+	return !writer->failed;
+
+}
+
+#endif
@@ -3,8 +3,30 @@
 #include <nxcore/helpers.h>
 #include <nxcore/math.h>
 #include <nxcore/renderer/software.h>
+#include <nxcore/renderer/triangles.h>
 #include <nxcore/renderer/colors.h>
 #include <nxcore/renderer/dibitmap.h>
+#include <nxcore/renderer/tiled.h>
+#include <nxcore/renderer/commands.h>
+#include <nxcore/renderer/present.h>
+#include <nxcore/renderer/import.h>
+#include <nxcore/renderer/qoi.h>
+#include <nxcore/renderer/png.h>
+
+/**
+ * Selects every kernel the renderer uses up front. They would otherwise be selected on first
+ * use, which has to happen before the worker threads start drawing.
+ */
+internal void
+SelectRendererKernels()
+{
+	SelectMemoryKernels();
+	SelectSpanKernels();
+	SelectBlendKernels();
+	SelectTriangleKernels();
+	SelectPresentKernels();
+	SelectImportKernels();
+}
 
 typedef struct
 {
@@ -22,4 +44,15 @@ CreateTexture(dibitmap source)
 
 }
 
+/**
+ * Draws a batch of triangles textured with tex, see triangle_vertex. Rotated, scaled and deformed
+ * sprites are a pair of triangles each.
+ */
+internal u64
+DrawTexturedTriangles(dibitmap* bitmap, texture_t* tex, triangle_vertex* vertices, u32 triangleCount,
+	blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	return DrawTriangles(bitmap, vertices, triangleCount, &tex->source, 0, mode, colorKey);
+}
+
 #endif
\ No newline at end of file
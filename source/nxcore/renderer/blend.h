@@ -0,0 +1,349 @@
+#ifndef NINETAILSX_BLEND_H
+#define NINETAILSX_BLEND_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/simd.h>
+
+/**
+ * The ways a source pixel can be combined with the pixel already in the destination. Pixels
+ * are 0xAARRGGBB, the same layout CreateBitmapLayer describes with its bitmasks.
+ *
+ * BLEND_OPAQUE				The source replaces the destination.
+ * BLEND_COLORKEY			As opaque, except source pixels whose RGB matches the key are skipped.
+ * BLEND_ALPHA				Straight (non-premultiplied) alpha, src*a + dest*(1-a).
+ * BLEND_PREMULTIPLIED		The source is already multiplied by its alpha, src + dest*(1-a).
+ * BLEND_ADDITIVE			dest + src*a on the color channels, the destination alpha is kept.
+ */
+enum blend_mode
+{
+	BLEND_OPAQUE = 0,
+	BLEND_COLORKEY,
+	BLEND_ALPHA,
+	BLEND_PREMULTIPLIED,
+	BLEND_ADDITIVE,
+};
+
+/**
+ * BlendSpan
+ * 			Blends a run of source pixels onto a run of destination pixels. There is a kernel per
+ * 			instruction set level, selected on first use like the span fill kernels.
+ *
+ * NOTE:
+ * 			All of the channel math is done in 8-bit fixed point with an exact divide by 255,
+ * 			(x + 128 + ((x + 128) >> 8)) >> 8, which fits in 16 bits for every product we form.
+ * 			The vector kernels use the same formula in 16-bit lanes, so every level produces
+ * 			identical output.
+ */
+typedef void fnptr_blend_span(u32* Dest, u32* Source, u64 PixelCount, blend_mode Mode, u32 ColorKey);
+
+inline u32
+__blend_div255(u32 Value)
+{
+	Value += 128;
+	return (Value + (Value >> 8)) >> 8;
+}
+
+inline u32
+__blend_pixel(u32 Dest, u32 Source, blend_mode Mode, u32 ColorKey)
+{
+	u32 Alpha = Source >> 24;
+	u32 InvAlpha = 255 - Alpha;
+	u32 _pixel = 0;
+
+	switch (Mode)
+	{
+		case BLEND_COLORKEY: return (((Source ^ ColorKey) & 0x00FFFFFF) == 0 ? Dest : Source);
+
+		case BLEND_ALPHA:
+		{
+			// The source alpha channel is treated as 255, which gives a + destAlpha*(1-a).
+			Source |= 0xFF000000;
+			for (u32 Shift = 0; Shift < 32; Shift += 8)
+			{
+				u32 s = (Source >> Shift) & 0xFF, d = (Dest >> Shift) & 0xFF;
+				_pixel |= __blend_div255(s*Alpha + d*InvAlpha) << Shift;
+			}
+		} break;
+
+		case BLEND_PREMULTIPLIED:
+		{
+			for (u32 Shift = 0; Shift < 32; Shift += 8)
+			{
+				u32 s = (Source >> Shift) & 0xFF, d = (Dest >> Shift) & 0xFF;
+				u32 c = s + __blend_div255(d*InvAlpha);
+				_pixel |= (c > 255 ? 255 : c) << Shift;
+			}
+		} break;
+
+		case BLEND_ADDITIVE:
+		{
+			for (u32 Shift = 0; Shift < 24; Shift += 8)
+			{
+				u32 s = (Source >> Shift) & 0xFF, d = (Dest >> Shift) & 0xFF;
+				u32 c = d + __blend_div255(s*Alpha);
+				_pixel |= (c > 255 ? 255 : c) << Shift;
+			}
+			_pixel |= Dest & 0xFF000000;
+		} break;
+
+		default: return Source;
+	}
+
+	return _pixel;
+}
+
+internal void
+__blend_span_scalar(u32* Dest, u32* Source, u64 PixelCount, blend_mode Mode, u32 ColorKey)
+{
+	for (u64 pIndex = 0; pIndex < PixelCount; ++pIndex)
+		Dest[pIndex] = __blend_pixel(Dest[pIndex], Source[pIndex], Mode, ColorKey);
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+/**
+ * SSE2, four pixels per step. Pixels are widened to 16-bit lanes two at a time, and the alpha
+ * of each pixel is broadcast across its four lanes with shufflelo/shufflehi.
+ */
+NX_TARGET_SSE2 inline __m128i
+__blend_div255_sse2(__m128i Value)
+{
+	Value = _mm_add_epi16(Value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(Value, _mm_srli_epi16(Value, 8)), 8);
+}
+
+NX_TARGET_SSE2 inline __m128i
+__blend_broadcast_alpha_sse2(__m128i Pixels16)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(Pixels16, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+}
+
+NX_TARGET_SSE2 internal void
+__blend_span_sse2(u32* Dest, u32* Source, u64 PixelCount, blend_mode Mode, u32 ColorKey)
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Max = _mm_set1_epi16(255);
+	u64 pIndex = 0;
+
+	switch (Mode)
+	{
+		case BLEND_COLORKEY:
+		{
+			__m128i Key = _mm_set1_epi32((i32)(ColorKey & 0x00FFFFFF));
+			__m128i RGBMask = _mm_set1_epi32(0x00FFFFFF);
+			for (; pIndex + 4 <= PixelCount; pIndex += 4)
+			{
+				__m128i S = _mm_loadu_si128((__m128i*)(Source + pIndex));
+				__m128i D = _mm_loadu_si128((__m128i*)(Dest + pIndex));
+				__m128i Keyed = _mm_cmpeq_epi32(_mm_and_si128(S, RGBMask), Key);
+				_mm_storeu_si128((__m128i*)(Dest + pIndex), _mm_or_si128(_mm_and_si128(Keyed, D), _mm_andnot_si128(Keyed, S)));
+			}
+		} break;
+
+		case BLEND_ALPHA:
+		{
+			__m128i AlphaChannel = _mm_set1_epi32((i32)0xFF000000);
+			for (; pIndex + 4 <= PixelCount; pIndex += 4)
+			{
+				__m128i S = _mm_loadu_si128((__m128i*)(Source + pIndex));
+				__m128i D = _mm_loadu_si128((__m128i*)(Dest + pIndex));
+				__m128i A_lo = __blend_broadcast_alpha_sse2(_mm_unpacklo_epi8(S, Zero));
+				__m128i A_hi = __blend_broadcast_alpha_sse2(_mm_unpackhi_epi8(S, Zero));
+				S = _mm_or_si128(S, AlphaChannel);
+
+				__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(S, Zero), A_lo),
+					_mm_mullo_epi16(_mm_unpacklo_epi8(D, Zero), _mm_sub_epi16(Max, A_lo)));
+				__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(S, Zero), A_hi),
+					_mm_mullo_epi16(_mm_unpackhi_epi8(D, Zero), _mm_sub_epi16(Max, A_hi)));
+				_mm_storeu_si128((__m128i*)(Dest + pIndex),
+					_mm_packus_epi16(__blend_div255_sse2(lo), __blend_div255_sse2(hi)));
+			}
+		} break;
+
+		case BLEND_PREMULTIPLIED:
+		{
+			for (; pIndex + 4 <= PixelCount; pIndex += 4)
+			{
+				__m128i S = _mm_loadu_si128((__m128i*)(Source + pIndex));
+				__m128i D = _mm_loadu_si128((__m128i*)(Dest + pIndex));
+				__m128i InvA_lo = _mm_sub_epi16(Max, __blend_broadcast_alpha_sse2(_mm_unpacklo_epi8(S, Zero)));
+				__m128i InvA_hi = _mm_sub_epi16(Max, __blend_broadcast_alpha_sse2(_mm_unpackhi_epi8(S, Zero)));
+
+				__m128i lo = __blend_div255_sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(D, Zero), InvA_lo));
+				__m128i hi = __blend_div255_sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(D, Zero), InvA_hi));
+				_mm_storeu_si128((__m128i*)(Dest + pIndex), _mm_adds_epu8(S, _mm_packus_epi16(lo, hi)));
+			}
+		} break;
+
+		case BLEND_ADDITIVE:
+		{
+			// Zeroes the alpha lane of the multiplier so the destination alpha is left alone.
+			__m128i ColorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+			for (; pIndex + 4 <= PixelCount; pIndex += 4)
+			{
+				__m128i S = _mm_loadu_si128((__m128i*)(Source + pIndex));
+				__m128i D = _mm_loadu_si128((__m128i*)(Dest + pIndex));
+				__m128i S_lo = _mm_unpacklo_epi8(S, Zero);
+				__m128i S_hi = _mm_unpackhi_epi8(S, Zero);
+				__m128i A_lo = _mm_and_si128(__blend_broadcast_alpha_sse2(S_lo), ColorLanes);
+				__m128i A_hi = _mm_and_si128(__blend_broadcast_alpha_sse2(S_hi), ColorLanes);
+
+				__m128i lo = __blend_div255_sse2(_mm_mullo_epi16(S_lo, A_lo));
+				__m128i hi = __blend_div255_sse2(_mm_mullo_epi16(S_hi, A_hi));
+				_mm_storeu_si128((__m128i*)(Dest + pIndex), _mm_adds_epu8(D, _mm_packus_epi16(lo, hi)));
+			}
+		} break;
+
+		default:
+		{
+			nx_memcopy(Dest, Source, PixelCount*sizeof(u32));
+			return;
+		}
+	}
+
+	__blend_span_scalar(Dest + pIndex, Source + pIndex, PixelCount - pIndex, Mode, ColorKey);
+}
+
+/**
+ * AVX2, eight pixels per step. The unpack and pack instructions both work within 128-bit lanes,
+ * so the pixel order survives the round trip without any cross-lane shuffles.
+ */
+NX_TARGET_AVX2 inline __m256i
+__blend_div255_avx2(__m256i Value)
+{
+	Value = _mm256_add_epi16(Value, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(Value, _mm256_srli_epi16(Value, 8)), 8);
+}
+
+NX_TARGET_AVX2 inline __m256i
+__blend_broadcast_alpha_avx2(__m256i Pixels16)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Pixels16, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+}
+
+NX_TARGET_AVX2 internal void
+__blend_span_avx2(u32* Dest, u32* Source, u64 PixelCount, blend_mode Mode, u32 ColorKey)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i Max = _mm256_set1_epi16(255);
+	u64 pIndex = 0;
+
+	switch (Mode)
+	{
+		case BLEND_COLORKEY:
+		{
+			__m256i Key = _mm256_set1_epi32((i32)(ColorKey & 0x00FFFFFF));
+			__m256i RGBMask = _mm256_set1_epi32(0x00FFFFFF);
+			for (; pIndex + 8 <= PixelCount; pIndex += 8)
+			{
+				__m256i S = _mm256_loadu_si256((__m256i*)(Source + pIndex));
+				__m256i D = _mm256_loadu_si256((__m256i*)(Dest + pIndex));
+				__m256i Keyed = _mm256_cmpeq_epi32(_mm256_and_si256(S, RGBMask), Key);
+				_mm256_storeu_si256((__m256i*)(Dest + pIndex), _mm256_blendv_epi8(S, D, Keyed));
+			}
+		} break;
+
+		case BLEND_ALPHA:
+		{
+			__m256i AlphaChannel = _mm256_set1_epi32((i32)0xFF000000);
+			for (; pIndex + 8 <= PixelCount; pIndex += 8)
+			{
+				__m256i S = _mm256_loadu_si256((__m256i*)(Source + pIndex));
+				__m256i D = _mm256_loadu_si256((__m256i*)(Dest + pIndex));
+				__m256i A_lo = __blend_broadcast_alpha_avx2(_mm256_unpacklo_epi8(S, Zero));
+				__m256i A_hi = __blend_broadcast_alpha_avx2(_mm256_unpackhi_epi8(S, Zero));
+				S = _mm256_or_si256(S, AlphaChannel);
+
+				__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(S, Zero), A_lo),
+					_mm256_mullo_epi16(_mm256_unpacklo_epi8(D, Zero), _mm256_sub_epi16(Max, A_lo)));
+				__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(S, Zero), A_hi),
+					_mm256_mullo_epi16(_mm256_unpackhi_epi8(D, Zero), _mm256_sub_epi16(Max, A_hi)));
+				_mm256_storeu_si256((__m256i*)(Dest + pIndex),
+					_mm256_packus_epi16(__blend_div255_avx2(lo), __blend_div255_avx2(hi)));
+			}
+		} break;
+
+		case BLEND_PREMULTIPLIED:
+		{
+			for (; pIndex + 8 <= PixelCount; pIndex += 8)
+			{
+				__m256i S = _mm256_loadu_si256((__m256i*)(Source + pIndex));
+				__m256i D = _mm256_loadu_si256((__m256i*)(Dest + pIndex));
+				__m256i InvA_lo = _mm256_sub_epi16(Max, __blend_broadcast_alpha_avx2(_mm256_unpacklo_epi8(S, Zero)));
+				__m256i InvA_hi = _mm256_sub_epi16(Max, __blend_broadcast_alpha_avx2(_mm256_unpackhi_epi8(S, Zero)));
+
+				__m256i lo = __blend_div255_avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(D, Zero), InvA_lo));
+				__m256i hi = __blend_div255_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(D, Zero), InvA_hi));
+				_mm256_storeu_si256((__m256i*)(Dest + pIndex), _mm256_adds_epu8(S, _mm256_packus_epi16(lo, hi)));
+			}
+		} break;
+
+		case BLEND_ADDITIVE:
+		{
+			__m256i ColorLanes = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+			for (; pIndex + 8 <= PixelCount; pIndex += 8)
+			{
+				__m256i S = _mm256_loadu_si256((__m256i*)(Source + pIndex));
+				__m256i D = _mm256_loadu_si256((__m256i*)(Dest + pIndex));
+				__m256i S_lo = _mm256_unpacklo_epi8(S, Zero);
+				__m256i S_hi = _mm256_unpackhi_epi8(S, Zero);
+				__m256i A_lo = _mm256_and_si256(__blend_broadcast_alpha_avx2(S_lo), ColorLanes);
+				__m256i A_hi = _mm256_and_si256(__blend_broadcast_alpha_avx2(S_hi), ColorLanes);
+
+				__m256i lo = __blend_div255_avx2(_mm256_mullo_epi16(S_lo, A_lo));
+				__m256i hi = __blend_div255_avx2(_mm256_mullo_epi16(S_hi, A_hi));
+				_mm256_storeu_si256((__m256i*)(Dest + pIndex), _mm256_adds_epu8(D, _mm256_packus_epi16(lo, hi)));
+			}
+		} break;
+
+		default:
+		{
+			nx_memcopy(Dest, Source, PixelCount*sizeof(u32));
+			return;
+		}
+	}
+
+	__blend_span_scalar(Dest + pIndex, Source + pIndex, PixelCount - pIndex, Mode, ColorKey);
+}
+#endif
+
+global fnptr_blend_span* __blend_span_kernel;
+
+/**
+ * Selects the blend kernels for the instruction set level reported by GetSIMDLevel(). There is
+ * no AVX-512 kernel, those machines use the AVX2 one. This happens automatically on first use,
+ * it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectBlendKernels()
+{
+	__blend_span_kernel = &__blend_span_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512:
+		case SIMD_LEVEL_AVX2: __blend_span_kernel = &__blend_span_avx2; break;
+		case SIMD_LEVEL_SSE2: __blend_span_kernel = &__blend_span_sse2; break;
+		default: break;
+	}
+#endif
+}
+
+/**
+ * Blends PixelCount pixels from Source onto Dest. The ColorKey is only used by BLEND_COLORKEY.
+ * Opaque spans don't need any per-pixel work, so they go straight to nx_memcopy.
+ */
+inline void
+BlendSpan(u32* Dest, u32* Source, u64 PixelCount, blend_mode Mode, u32 ColorKey = 0)
+{
+	if (Mode == BLEND_OPAQUE)
+	{
+		nx_memcopy(Dest, Source, PixelCount*sizeof(u32));
+		return;
+	}
+
+	if (__blend_span_kernel == NULL) SelectBlendKernels();
+	__blend_span_kernel(Dest, Source, PixelCount, Mode, ColorKey);
+}
+
+#endif
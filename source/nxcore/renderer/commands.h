@@ -0,0 +1,332 @@
+#ifndef NINETAILSX_COMMANDS_H
+#define NINETAILSX_COMMANDS_H
+#include <nxcore/helpers.h>
+#include <nxcore/math.h>
+#include <nxcore/memory.h>
+#include <nxcore/renderer/tiled.h>
+
+/**
+ * The render command stream.
+ *
+ * Instead of drawing straight away, the engine pushes commands through the frame and executes
+ * them all at once at the end. On execution the commands are sorted by layer, then by source
+ * bitmap, then by position, culled, merged where possible and handed to the tiled renderer.
+ *
+ * NOTE:
+ * 			Within a layer, the order of commands is not preserved beyond the sort key. Draws whose
+ * 			order matters, a sprite over a background for example, have to go on different layers.
+ * 			The sort is stable, so commands with identical keys still execute in the order they
+ * 			were pushed.
+ */
+#define RENDER_COMMANDS_MAX_TEXTURES 256
+
+enum render_command_type
+{
+	RENDER_COMMAND_CLEAR,
+	RENDER_COMMAND_RECT,
+	RENDER_COMMAND_BITMAP,
+	RENDER_COMMAND_LINES,
+	RENDER_COMMAND_TRIANGLES,
+};
+
+typedef struct render_command
+{
+	u64 sortKey;
+	render_command_type type;
+	u32 layer;
+	v2i position;
+	v2i dims;
+	u32 color;
+	dibitmap source;
+	blend_mode mode;
+	u32 colorKey;
+	line_segment* lines;
+	u32 lineCount;
+	b32 smooth;
+	triangle_vertex* vertices;
+	u32 triangleCount;
+} render_command;
+
+typedef struct render_commands
+{
+	memarena_t* arena; // The frame arena, which the command array and the sort are pushed on.
+	render_command* commands;
+	u32 commandCount;
+	u32 commandCapacity;
+	u32 droppedCount; // Pushed once the capacity was used up, and never drawn.
+
+	// Source bitmaps seen this frame. Their index is what commands sort on.
+	void* textures[RENDER_COMMANDS_MAX_TEXTURES];
+	u32 textureCount;
+} render_commands;
+
+/**
+ * Starts a new frame of commands, with room for capacity commands pushed on frameArena. The
+ * commands live until the frame arena is reset, which must not happen before they are executed.
+ */
+inline void
+BeginRenderCommands(render_commands* commands, memarena_t* frameArena, u32 capacity)
+{
+	commands->arena = frameArena;
+	commands->commands = PushArray(frameArena, render_command, capacity);
+	commands->commandCount = 0;
+	commands->commandCapacity = capacity;
+	commands->droppedCount = 0;
+	commands->textureCount = 0;
+}
+
+/**
+ * The sort key, from the most to least significant bits: layer (16), texture (16), y (16), x (16).
+ * Positions are biased so that negative coordinates still sort before positive ones.
+ */
+inline u64
+__render_commands_sort_key(u32 layer, u32 texture, v2i position)
+{
+	i32 x = position.x + 32768, y = position.y + 32768;
+	x = (x < 0 ? 0 : (x > 0xFFFF ? 0xFFFF : x));
+	y = (y < 0 ? 0 : (y > 0xFFFF ? 0xFFFF : y));
+	return ((u64)(layer & 0xFFFF) << 48) | ((u64)(texture & 0xFFFF) << 32) | ((u64)y << 16) | (u64)x;
+}
+
+// Texture zero means no texture, bitmaps are numbered from one in the order they are first seen.
+internal u32
+__render_commands_texture_id(render_commands* commands, void* buffer)
+{
+	for (u32 textureIndex = 0; textureIndex < commands->textureCount; ++textureIndex)
+		if (commands->textures[textureIndex] == buffer) return textureIndex + 1;
+
+	if (commands->textureCount == RENDER_COMMANDS_MAX_TEXTURES) return RENDER_COMMANDS_MAX_TEXTURES;
+	commands->textures[commands->textureCount++] = buffer;
+	return commands->textureCount;
+}
+
+/**
+ * Returns NULL once the frame's capacity is used up, the command is then dropped and counted in
+ * droppedCount.
+ */
+internal render_command*
+__render_commands_push(render_commands* commands, render_command_type type, u32 layer)
+{
+	if (commands->commandCount == commands->commandCapacity)
+	{
+		commands->droppedCount++;
+		return NULL;
+	}
+
+	render_command* _command = &commands->commands[commands->commandCount];
+	*_command = {};
+	_command->type = type;
+	_command->layer = layer;
+	commands->commandCount++;
+	return _command;
+}
+
+/**
+ * Fills the whole target with a color. Everything on a lower layer is culled, as is anything on
+ * this layer which was pushed before the clear.
+ */
+internal void
+PushRenderClear(render_commands* commands, u32 layer, u32 color)
+{
+	render_command* _command = __render_commands_push(commands, RENDER_COMMAND_CLEAR, layer);
+	if (_command == NULL) return;
+	_command->color = color;
+	_command->sortKey = __render_commands_sort_key(layer, 0, {-32768, -32768});
+}
+
+internal void
+PushRenderRect(render_commands* commands, u32 layer, v2i rectPos, v2i rectDims, u32 color)
+{
+	render_command* _command = __render_commands_push(commands, RENDER_COMMAND_RECT, layer);
+	if (_command == NULL) return;
+	_command->position = rectPos;
+	_command->dims = rectDims;
+	_command->color = color;
+	_command->sortKey = __render_commands_sort_key(layer, 0, rectPos);
+}
+
+/**
+ * The source pixels are read when the commands are executed, so they must stay valid until then.
+ */
+internal void
+PushRenderBitmap(render_commands* commands, u32 layer, dibitmap* source, v2i position,
+	blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	render_command* _command = __render_commands_push(commands, RENDER_COMMAND_BITMAP, layer);
+	if (_command == NULL) return;
+	_command->position = position;
+	_command->dims = source->dims;
+	_command->source = *source;
+	_command->mode = mode;
+	_command->colorKey = colorKey;
+	_command->sortKey = __render_commands_sort_key(layer,
+		__render_commands_texture_id(commands, source->buffer), position);
+}
+
+/**
+ * A batch of lines is one command, however many lines are in it, so debug overlays and graphs can
+ * draw thousands of them a frame. The lines are read when the commands are executed, so they must
+ * stay valid until then, pushing them on the frame arena is the easy way.
+ */
+internal void
+PushRenderLines(render_commands* commands, u32 layer, line_segment* lines, u32 lineCount, b32 smooth = false)
+{
+	if (lineCount == 0) return;
+	render_command* _command = __render_commands_push(commands, RENDER_COMMAND_LINES, layer);
+	if (_command == NULL) return;
+	rect2i _bounds = GetLineBounds(lines, lineCount, smooth, NULL);
+	_command->position = _bounds.min;
+	_command->dims = GetRectDims(_bounds);
+	_command->lines = lines;
+	_command->lineCount = lineCount;
+	_command->smooth = smooth;
+	_command->sortKey = __render_commands_sort_key(layer, 0, _bounds.min);
+}
+
+/**
+ * A batch of triangles is one command, textured or filled with color when the texture is NULL.
+ * Like lines, the vertices are read when the commands are executed, and so is the texture.
+ */
+internal void
+PushRenderTriangles(render_commands* commands, u32 layer, triangle_vertex* vertices, u32 triangleCount,
+	dibitmap* texture, u32 color = 0, blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	if (triangleCount == 0) return;
+	render_command* _command = __render_commands_push(commands, RENDER_COMMAND_TRIANGLES, layer);
+	if (_command == NULL) return;
+	rect2i _bounds = GetTriangleBounds(vertices, triangleCount, NULL);
+	_command->position = _bounds.min;
+	_command->dims = GetRectDims(_bounds);
+	_command->vertices = vertices;
+	_command->triangleCount = triangleCount;
+	if (texture) _command->source = *texture;
+	_command->color = color;
+	_command->mode = mode;
+	_command->colorKey = colorKey;
+	_command->sortKey = __render_commands_sort_key(layer,
+		(texture ? __render_commands_texture_id(commands, texture->buffer) : 0), _bounds.min);
+}
+
+/**
+ * True when command was pushed on the clear's layer before the clear. Commands live in push order
+ * in the command array, so their address is their push index.
+ */
+inline b32
+__render_commands_cleared(render_command* clear, render_command* command)
+{
+	return (clear != NULL && command->layer == clear->layer && command < clear);
+}
+
+/**
+ * Stable bottom-up merge sort of the command pointers by sort key.
+ */
+internal render_command**
+__render_commands_sort(render_command** entries, render_command** scratch, u32 count)
+{
+	for (u32 width = 1; width < count; width *= 2)
+	{
+		for (u32 left = 0; left < count; left += 2*width)
+		{
+			u32 middle = (left + width < count ? left + width : count);
+			u32 right = (left + 2*width < count ? left + 2*width : count);
+			u32 a = left, b = middle, out = left;
+			while (a < middle && b < right)
+				scratch[out++] = (entries[b]->sortKey < entries[a]->sortKey ? entries[b++] : entries[a++]);
+			while (a < middle) scratch[out++] = entries[a++];
+			while (b < right) scratch[out++] = entries[b++];
+		}
+		render_command** swap = entries;
+		entries = scratch;
+		scratch = swap;
+	}
+	return entries;
+}
+
+/**
+ * Sorts, culls and merges the commands, then draws them as one frame of the tiled renderer. The
+ * regions which changed are left in the renderer's dirty rects.
+ *
+ * Culling drops commands which miss the target, everything which sorts before the last clear
+ * and the commands on the clear's layer which were pushed before it. Rects of the same color and
+ * layer which sit side by side in the same row are merged.
+ */
+internal void
+ExecuteRenderCommands(render_commands* commands, tiled_renderer* renderer)
+{
+
+	NX_PROFILE_SCOPE("ExecuteRenderCommands");
+	NX_PROFILE_COUNTER("RenderCommands", commands->commandCount);
+
+	u32 count = commands->commandCount;
+	temporary_memory sortMemory = BeginTemporaryMemory(commands->arena);
+	render_command** entries = PushArray(commands->arena, render_command*, count);
+	render_command** scratch = PushArray(commands->arena, render_command*, count);
+	for (u32 commandIndex = 0; commandIndex < count; ++commandIndex)
+		entries[commandIndex] = &commands->commands[commandIndex];
+	entries = __render_commands_sort(entries, scratch, count);
+
+	u32 firstCommand = 0;
+	for (u32 entryIndex = 0; entryIndex < count; ++entryIndex)
+		if (entries[entryIndex]->type == RENDER_COMMAND_CLEAR) firstCommand = entryIndex;
+	render_command* clear = (count > 0 && entries[firstCommand]->type == RENDER_COMMAND_CLEAR ?
+		entries[firstCommand] : NULL);
+
+	BeginTiledFrame(renderer);
+	for (u32 entryIndex = firstCommand; entryIndex < count; ++entryIndex)
+	{
+		render_command* command = entries[entryIndex];
+		if (__render_commands_cleared(clear, command)) continue;
+		switch (command->type)
+		{
+			case RENDER_COMMAND_CLEAR:
+			{
+				TiledDrawRect(renderer, {0,0}, renderer->target->dims, command->color);
+			} break;
+
+			case RENDER_COMMAND_RECT:
+			{
+				if (CullTiledDraw(renderer, command->position, command->dims)) break;
+
+				v2i rectDims = command->dims;
+				while (entryIndex+1 < count)
+				{
+					render_command* next = entries[entryIndex+1];
+					if (__render_commands_cleared(clear, next)) { ++entryIndex; continue; }
+					if (next->type != RENDER_COMMAND_RECT || next->layer != command->layer ||
+						next->color != command->color || next->position.y != command->position.y ||
+						next->dims.height != rectDims.height || next->dims.width <= 0 || next->position.x != command->position.x + rectDims.width)
+						break;
+					rectDims.width += next->dims.width;
+					++entryIndex;
+				}
+
+				TiledDrawRect(renderer, command->position, rectDims, command->color);
+			} break;
+
+			case RENDER_COMMAND_BITMAP:
+			{
+				if (CullTiledDraw(renderer, command->position, command->dims)) break;
+				TiledDrawBitmap(renderer, &command->source, command->position, command->mode, command->colorKey);
+			} break;
+
+			case RENDER_COMMAND_LINES:
+			{
+				if (CullTiledDraw(renderer, command->position, command->dims)) break;
+				TiledDrawLines(renderer, command->lines, command->lineCount, command->smooth);
+			} break;
+
+			case RENDER_COMMAND_TRIANGLES:
+			{
+				if (CullTiledDraw(renderer, command->position, command->dims)) break;
+				TiledDrawTriangles(renderer, command->vertices, command->triangleCount,
+					(command->source.buffer ? &command->source : NULL), command->color, command->mode, command->colorKey);
+			} break;
+		}
+	}
+
+	EndTiledFrame(renderer);
+	EndTemporaryMemory(sortMemory);
+
+}
+
+#endif
@@ -75,11 +75,16 @@ typedef struct dibitmap
 	bitmap_header* header;
 	void* buffer;
 	v2i dims; // Quick access to the dimensions of a bitmap.
+	i32 pitch; // Pixels from the start of one row to the next, at least dims.width.
 } dibitmap;
 
 /**
  * Returns a dibitmap struct containing the details of bitmap. The resource parameter
  * is the raw data pulled from the file.
+ *
+ * NOTE:
+ * 			This uses the file's pixels as they are, which is only right for a bottom-up 32 bit
+ * 			0xAARRGGBB file. Use ImportBitmap (import.h) for anything else.
  */
 inline dibitmap
 GetBitmapFromResource(void* resource)
@@ -88,6 +93,7 @@ GetBitmapFromResource(void* resource)
 	_bitmap.header = (bitmap_header*)resource;
 	_bitmap.buffer = (u8*)resource + _bitmap.header->fileHeader.dataOffset;
 	_bitmap.dims = {(i32)_bitmap.header->infoHeader.width, (i32)_bitmap.header->infoHeader.height};
+	_bitmap.pitch = _bitmap.dims.width;
 	return _bitmap;
 }
 
@@ -0,0 +1,303 @@
+#ifndef NINETAILSX_IMPORT_H
+#define NINETAILSX_IMPORT_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/simd.h>
+#include <nxcore/math.h>
+#include <nxcore/renderer/dibitmap.h>
+#include <nxcore/renderer/blend.h>
+
+/**
+ * Bitmap import.
+ *
+ * Converts a BMP file, once at load time, into the one pixel format the renderer draws from:
+ *
+ * 		- 32 bits per pixel, 0xAARRGGBB, whatever channel masks the file used.
+ * 		- Premultiplied alpha, so translucent bitmaps are drawn with BLEND_PREMULTIPLIED.
+ * 		- Rows in the same order as our layers (the first row is the bottom one), whichever way
+ * 		  up the file was stored.
+ * 		- Every row starting on a BITMAP_ROW_ALIGNMENT boundary, the pitch rounded up to match.
+ *
+ * Uncompressed 24 and 32 bit files are supported, with or without bitfield masks and with either
+ * orientation. Files which already hold 0xAARRGGBB pixels (the common case, and what CreateBitmapLayer
+ * writes) are premultiplied straight from the file with the vector kernels.
+ *
+ * NOTE:
+ * 			32 bit files without an alpha mask are treated as opaque, since their fourth byte is
+ * 			undefined by the format.
+ */
+#define BITMAP_ROW_ALIGNMENT 16
+#define BITMAP_MAX_DIMENSION (1 << 24)
+
+#define BITMAP_COMPRESSION_RGB 0
+#define BITMAP_COMPRESSION_BITFIELDS 3
+#define BITMAP_COMPRESSION_ALPHABITFIELDS 6
+
+/**
+ * Returned by the streaming decoders (qoi.h, png.h), which produce the same format.
+ */
+enum image_decode_status
+{
+	IMAGE_DECODE_MORE, // Every byte given was consumed, call again with the ones that follow.
+	IMAGE_DECODE_DONE,
+	IMAGE_DECODE_ERROR,
+};
+
+typedef struct bitmap_format
+{
+	v2i dims;
+	b32 topDown;
+	u32 bpp;
+	u32 stride; // Bytes per row in the file, rows are padded to four bytes.
+	u8* pixels;
+	u32 redMask, greenMask, blueMask, alphaMask;
+} bitmap_format;
+
+/**
+ * PremultiplySpan
+ * 			Multiplies the color channels of a run of 0xAARRGGBB pixels by their alpha, with the
+ * 			exact divide by 255 of blend.h, so every level produces identical output.
+ */
+typedef void fnptr_premultiply_span(u32* Dest, u32* Source, u64 PixelCount);
+
+inline u32
+__premultiply_pixel(u32 Pixel)
+{
+	u32 Alpha = Pixel >> 24;
+	u32 _pixel = Pixel & 0xFF000000;
+	for (u32 Shift = 0; Shift < 24; Shift += 8)
+		_pixel |= __blend_div255(((Pixel >> Shift) & 0xFF) * Alpha) << Shift;
+	return _pixel;
+}
+
+internal void
+__premultiply_span_scalar(u32* Dest, u32* Source, u64 PixelCount)
+{
+	for (u64 pIndex = 0; pIndex < PixelCount; ++pIndex)
+		Dest[pIndex] = __premultiply_pixel(Source[pIndex]);
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+/**
+ * The alpha lane is multiplied by 255 and comes back out unchanged, so it needs no masking.
+ */
+NX_TARGET_SSE2 internal void
+__premultiply_span_sse2(u32* Dest, u32* Source, u64 PixelCount)
+{
+	__m128i Zero = _mm_setzero_si128();
+	u64 pIndex = 0;
+	for (; pIndex + 4 <= PixelCount; pIndex += 4)
+	{
+		__m128i S = _mm_loadu_si128((__m128i*)(Source + pIndex));
+		__m128i S_lo = _mm_unpacklo_epi8(S, Zero);
+		__m128i S_hi = _mm_unpackhi_epi8(S, Zero);
+		__m128i A_lo = _mm_or_si128(__blend_broadcast_alpha_sse2(S_lo), _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+		__m128i A_hi = _mm_or_si128(__blend_broadcast_alpha_sse2(S_hi), _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+
+		__m128i lo = __blend_div255_sse2(_mm_mullo_epi16(S_lo, A_lo));
+		__m128i hi = __blend_div255_sse2(_mm_mullo_epi16(S_hi, A_hi));
+		_mm_storeu_si128((__m128i*)(Dest + pIndex), _mm_packus_epi16(lo, hi));
+	}
+	__premultiply_span_scalar(Dest + pIndex, Source + pIndex, PixelCount - pIndex);
+}
+
+NX_TARGET_AVX2 internal void
+__premultiply_span_avx2(u32* Dest, u32* Source, u64 PixelCount)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i AlphaLanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+	u64 pIndex = 0;
+	for (; pIndex + 8 <= PixelCount; pIndex += 8)
+	{
+		__m256i S = _mm256_loadu_si256((__m256i*)(Source + pIndex));
+		__m256i S_lo = _mm256_unpacklo_epi8(S, Zero);
+		__m256i S_hi = _mm256_unpackhi_epi8(S, Zero);
+		__m256i A_lo = _mm256_or_si256(__blend_broadcast_alpha_avx2(S_lo), AlphaLanes);
+		__m256i A_hi = _mm256_or_si256(__blend_broadcast_alpha_avx2(S_hi), AlphaLanes);
+
+		__m256i lo = __blend_div255_avx2(_mm256_mullo_epi16(S_lo, A_lo));
+		__m256i hi = __blend_div255_avx2(_mm256_mullo_epi16(S_hi, A_hi));
+		_mm256_storeu_si256((__m256i*)(Dest + pIndex), _mm256_packus_epi16(lo, hi));
+	}
+	__premultiply_span_scalar(Dest + pIndex, Source + pIndex, PixelCount - pIndex);
+}
+#endif
+
+global fnptr_premultiply_span* __premultiply_span_kernel;
+
+/**
+ * Selects the import kernels for the instruction set level reported by GetSIMDLevel(). There is
+ * no AVX-512 kernel, those machines use the AVX2 one. This happens automatically on first use,
+ * it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectImportKernels()
+{
+	__premultiply_span_kernel = &__premultiply_span_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512:
+		case SIMD_LEVEL_AVX2: __premultiply_span_kernel = &__premultiply_span_avx2; break;
+		case SIMD_LEVEL_SSE2: __premultiply_span_kernel = &__premultiply_span_sse2; break;
+		default: break;
+	}
+#endif
+}
+
+/**
+ * Source may be Dest, the kernels only ever read a pixel before writing it.
+ */
+inline void
+PremultiplySpan(u32* Dest, u32* Source, u64 PixelCount)
+{
+	if (__premultiply_span_kernel == NULL) SelectImportKernels();
+	__premultiply_span_kernel(Dest, Source, PixelCount);
+}
+
+/**
+ * Scales a channel pulled out with a bitmask to eight bits.
+ */
+inline u32
+__import_channel(u32 Pixel, u32 Mask)
+{
+	if (Mask == 0) return 0;
+
+	u32 Shift = 0;
+	while (((Mask >> Shift) & 1) == 0) ++Shift;
+	u32 Bits = 0;
+	while (Shift + Bits < 32 && ((Mask >> (Shift + Bits)) & 1)) ++Bits;
+
+	u32 _value = (Pixel & Mask) >> Shift;
+	if (Bits >= 8) return _value >> (Bits - 8);
+	return (_value * 255 + ((1u << Bits) - 1) / 2) / ((1u << Bits) - 1);
+}
+
+/**
+ * Reads the format of a BMP file. Returns false for anything ImportBitmap can't convert, or a
+ * file which is too short for the pixels it claims to have.
+ */
+internal b32
+ReadBitmapFormat(void* resource, u64 size, bitmap_format* format)
+{
+
+	*format = {};
+	if (resource == NULL || size < sizeof(bitmap_file_header) + 40) return false;
+
+	bitmap_header* header = (bitmap_header*)resource;
+	if (header->fileHeader.signature != 0x4D42) return false; // "BM"
+
+	bitmap_info_header_v5* info = &header->infoHeader;
+	i32 width = (i32)info->width;
+	i32 height = (i32)info->height;
+	if (width <= 0 || width > BITMAP_MAX_DIMENSION || height == 0 || height > BITMAP_MAX_DIMENSION ||
+		height < -BITMAP_MAX_DIMENSION || (info->bpp != 24 && info->bpp != 32))
+		return false;
+
+	format->bpp = info->bpp;
+	format->topDown = (height < 0);
+	format->dims = { width, (format->topDown ? -height : height) };
+	format->stride = (u32)((((u64)width * info->bpp + 31) / 32) * 4);
+
+	// The masks follow the first 40 bytes of the info header, whichever version it is.
+	format->redMask = 0x00FF0000;
+	format->greenMask = 0x0000FF00;
+	format->blueMask = 0x000000FF;
+	format->alphaMask = 0;
+	if (info->compression == BITMAP_COMPRESSION_BITFIELDS || info->compression == BITMAP_COMPRESSION_ALPHABITFIELDS)
+	{
+		if (info->bpp != 32 || size < sizeof(bitmap_file_header) + 56) return false;
+		format->redMask = info->bitmask_red;
+		format->greenMask = info->bitmask_green;
+		format->blueMask = info->bitmask_blue;
+		if (info->compression == BITMAP_COMPRESSION_ALPHABITFIELDS || info->size >= 56) format->alphaMask = info->bitmask_alpha;
+	}
+	else if (info->compression != BITMAP_COMPRESSION_RGB) return false;
+
+	if ((u64)header->fileHeader.dataOffset + (u64)format->stride * (u64)format->dims.height > size) return false;
+	format->pixels = (u8*)resource + header->fileHeader.dataOffset;
+	return true;
+
+}
+
+/**
+ * Returns the pitch, in pixels, of a bitmap of the given width once imported.
+ */
+inline i32
+GetImportedBitmapPitch(i32 width)
+{
+	i32 pixelsPerAlignment = BITMAP_ROW_ALIGNMENT / sizeof(u32);
+	return (width + pixelsPerAlignment - 1) & ~(pixelsPerAlignment - 1);
+}
+
+inline u64
+GetImportedBitmapSize(bitmap_format* format)
+{
+	return (u64)GetImportedBitmapPitch(format->dims.width) * (u64)format->dims.height * sizeof(u32);
+}
+
+/**
+ * Converts a BMP file into a new bitmap pushed on arena, see the top of this file for the format.
+ * The result doesn't reference the file, which can be released afterwards. The row padding is
+ * zeroed. Returns false, and pushes nothing, if the file can't be imported or the bitmap doesn't
+ * fit on arena.
+ */
+internal b32
+ImportBitmap(memarena_t* arena, void* resource, u64 size, dibitmap* bitmap)
+{
+
+	bitmap_format format;
+	if (!ReadBitmapFormat(resource, size, &format)) return false;
+	u64 bitmapSize = GetImportedBitmapSize(&format);
+	if (bitmapSize + BITMAP_ROW_ALIGNMENT > arena->length - arena->commit) return false;
+
+	*bitmap = {};
+	bitmap->dims = format.dims;
+	bitmap->pitch = GetImportedBitmapPitch(format.dims.width);
+	bitmap->buffer = PushSizeAligned(arena, bitmapSize, BITMAP_ROW_ALIGNMENT);
+
+	b32 nativeLayout = (format.bpp == 32 && format.redMask == 0x00FF0000 && format.greenMask == 0x0000FF00 &&
+		format.blueMask == 0x000000FF && (format.alphaMask == 0xFF000000 || format.alphaMask == 0));
+
+	for (i32 row = 0; row < format.dims.height; ++row)
+	{
+		u8* source = format.pixels + (u64)format.stride * (u64)(format.topDown ? format.dims.height - 1 - row : row);
+		u32* dest = (u32*)bitmap->buffer + (u64)bitmap->pitch * (u64)row;
+
+		if (nativeLayout && format.alphaMask)
+		{
+			PremultiplySpan(dest, (u32*)source, (u64)format.dims.width);
+		}
+		else if (nativeLayout)
+		{
+			// Opaque, so premultiplying would change nothing.
+			for (i32 column = 0; column < format.dims.width; ++column)
+				dest[column] = ((u32*)source)[column] | 0xFF000000;
+		}
+		else if (format.bpp == 24)
+		{
+			for (i32 column = 0; column < format.dims.width; ++column, source += 3)
+				dest[column] = 0xFF000000 | ((u32)source[2] << 16) | ((u32)source[1] << 8) | (u32)source[0];
+		}
+		else
+		{
+			for (i32 column = 0; column < format.dims.width; ++column)
+			{
+				u32 pixel = ((u32*)source)[column];
+				u32 alpha = (format.alphaMask ? __import_channel(pixel, format.alphaMask) : 0xFF);
+				dest[column] = (alpha << 24) | (__import_channel(pixel, format.redMask) << 16) |
+					(__import_channel(pixel, format.greenMask) << 8) | __import_channel(pixel, format.blueMask);
+			}
+			if (format.alphaMask) PremultiplySpan(dest, dest, (u64)format.dims.width);
+		}
+
+		for (i32 column = format.dims.width; column < bitmap->pitch; ++column)
+			dest[column] = 0;
+	}
+
+	return true;
+
+}
+
+#endif
@@ -0,0 +1,590 @@
+#ifndef NINETAILSX_PNG_H
+#define NINETAILSX_PNG_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/inflate.h>
+#include <nxcore/renderer/dibitmap.h>
+#include <nxcore/renderer/import.h>
+
+/**
+ * PNG decoding.
+ *
+ * Decodes a PNG file straight into a bitmap pushed on an arena, in the same format ImportBitmap
+ * produces (see import.h). The file is taken a piece at a time, like QOIDecode:
+ *
+ * 		png_decoder decoder;
+ * 		BeginPNGDecode(&decoder, arena);
+ * 		while ((status = PNGDecode(&decoder, data, size)) == IMAGE_DECODE_MORE) ... next piece ...
+ *
+ * The chunks are parsed as they arrive and the image data is fed through Inflate (inflate.h) as
+ * it comes, without gathering the IDAT chunks together. Each scanline is unfiltered as soon as it
+ * has been decompressed and converted into its row of the bitmap, so apart from the bitmap the
+ * decoder only needs the inflate window and two scanlines, which are pushed as temporary memory
+ * above the bitmap and released when the decode finishes.
+ *
+ * Every color type and bit depth is supported, along with palettes and tRNS transparency. 16 bit
+ * samples are cut down to their high byte, low bit depths are scaled up to eight bits.
+ *
+ * NOTE:
+ * 			Interlaced (Adam7) images aren't supported, since none of the pixels of an interlaced
+ * 			row are final until the last pass. Re-save them without interlacing.
+ *
+ * NOTE:
+ * 			Chunk CRCs aren't checked. Ancillary chunks other than tRNS are skipped, gamma and color
+ * 			profiles are ignored and the samples used as they are.
+ */
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_CHUNK_HEADER_SIZE 8
+#define PNG_CHUNK_CRC_SIZE 4
+#define PNG_MAX_DIMENSION (1 << 24)
+
+#define PNG_CHUNK(a, b, c, d) (((u32)(a) << 24) | ((u32)(b) << 16) | ((u32)(c) << 8) | (u32)(d))
+#define PNG_CHUNK_IHDR PNG_CHUNK('I', 'H', 'D', 'R')
+#define PNG_CHUNK_PLTE PNG_CHUNK('P', 'L', 'T', 'E')
+#define PNG_CHUNK_TRNS PNG_CHUNK('t', 'R', 'N', 'S')
+#define PNG_CHUNK_IDAT PNG_CHUNK('I', 'D', 'A', 'T')
+#define PNG_CHUNK_IEND PNG_CHUNK('I', 'E', 'N', 'D')
+
+enum png_color_type
+{
+	PNG_COLOR_GRAY = 0,
+	PNG_COLOR_RGB = 2,
+	PNG_COLOR_PALETTE = 3,
+	PNG_COLOR_GRAY_ALPHA = 4,
+	PNG_COLOR_RGBA = 6,
+};
+
+enum png_filter
+{
+	PNG_FILTER_NONE,
+	PNG_FILTER_SUB,
+	PNG_FILTER_UP,
+	PNG_FILTER_AVERAGE,
+	PNG_FILTER_PAETH,
+};
+
+enum png_state
+{
+	PNG_STATE_SIGNATURE,
+	PNG_STATE_CHUNK_HEADER,
+	PNG_STATE_CHUNK_DATA,
+	PNG_STATE_CHUNK_CRC,
+	PNG_STATE_DONE,
+	PNG_STATE_ERROR,
+};
+
+typedef struct png_decoder
+{
+	memarena_t* arena;
+	temporary_memory image;
+	temporary_memory scratch;
+	u32 state;
+
+	u8 buffer[768]; // The signature, chunk headers and the small chunks, gathered whole.
+	u32 bufferCount;
+	u32 chunkType;
+	u32 chunkRemaining;
+	b32 headerRead;
+	b32 dataStarted;
+
+	u32 colorType;
+	u32 bitDepth;
+	u32 bytesPerPixel; // The distance the filters look back, at least one.
+	u32 rowBytes; // Without the filter byte.
+
+	u8 paletteColors[256*3];
+	u8 paletteAlpha[256];
+	u32 paletteCount;
+	u32 palette[256]; // Premultiplied, built once the image data starts.
+	b32 colorKeyed;
+	u32 colorKey[3];
+
+	u8* scanline; // The filter byte, then rowBytes of samples.
+	u8* previous; // The last scanline, unfiltered.
+	u32 scanlineFill;
+	i32 row;
+
+	inflate_stream inflate;
+	dibitmap bitmap;
+} png_decoder;
+
+global const u8 __png_signature[PNG_SIGNATURE_SIZE] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+inline u32
+__png_read_u32(u8* data)
+{
+	return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | (u32)data[3];
+}
+
+/**
+ * Reads sample index of a scanline at the given bit depth.
+ */
+inline u32
+__png_sample(u8* samples, u32 index, u32 bitDepth)
+{
+	if (bitDepth == 8) return samples[index];
+	if (bitDepth == 16) return ((u32)samples[index*2] << 8) | (u32)samples[index*2 + 1];
+	u32 bit = index * bitDepth;
+	return (samples[bit >> 3] >> (8 - bitDepth - (bit & 7))) & ((1u << bitDepth) - 1);
+}
+
+/**
+ * Scales a sample at the given bit depth to eight bits.
+ */
+inline u32
+__png_scale(u32 sample, u32 bitDepth)
+{
+	if (bitDepth == 8) return sample;
+	if (bitDepth == 16) return sample >> 8;
+	return sample * 255 / ((1u << bitDepth) - 1);
+}
+
+inline u8
+__png_paeth(i32 a, i32 b, i32 c)
+{
+	i32 p = a + b - c;
+	i32 pa = (p > a ? p - a : a - p);
+	i32 pb = (p > b ? p - b : b - p);
+	i32 pc = (p > c ? p - c : c - p);
+	if (pa <= pb && pa <= pc) return (u8)a;
+	return (u8)(pb <= pc ? b : c);
+}
+
+inline image_decode_status
+__png_fail(png_decoder* decoder)
+{
+	if (decoder->state != PNG_STATE_DONE && decoder->state != PNG_STATE_ERROR)
+	{
+		if (decoder->bitmap.buffer) EndTemporaryMemory(decoder->scratch);
+		EndTemporaryMemory(decoder->image);
+	}
+	decoder->state = PNG_STATE_ERROR;
+	return IMAGE_DECODE_ERROR;
+}
+
+/**
+ * Unfilters the scanline that was just decompressed and converts it into its row of the bitmap.
+ */
+internal b32
+__png_finish_scanline(png_decoder* decoder)
+{
+
+	u8* samples = decoder->scanline + 1;
+	u8* above = decoder->previous + 1;
+	u32 bpp = decoder->bytesPerPixel;
+	u32 count = decoder->rowBytes;
+
+	switch (decoder->scanline[0])
+	{
+		case PNG_FILTER_NONE: break;
+
+		case PNG_FILTER_SUB:
+		{
+			for (u32 bIndex = bpp; bIndex < count; ++bIndex)
+				samples[bIndex] += samples[bIndex - bpp];
+		} break;
+
+		case PNG_FILTER_UP:
+		{
+			for (u32 bIndex = 0; bIndex < count; ++bIndex)
+				samples[bIndex] += above[bIndex];
+		} break;
+
+		case PNG_FILTER_AVERAGE:
+		{
+			for (u32 bIndex = 0; bIndex < bpp; ++bIndex)
+				samples[bIndex] += above[bIndex] >> 1;
+			for (u32 bIndex = bpp; bIndex < count; ++bIndex)
+				samples[bIndex] += (u8)(((u32)samples[bIndex - bpp] + (u32)above[bIndex]) >> 1);
+		} break;
+
+		case PNG_FILTER_PAETH:
+		{
+			for (u32 bIndex = 0; bIndex < bpp; ++bIndex)
+				samples[bIndex] += above[bIndex];
+			for (u32 bIndex = bpp; bIndex < count; ++bIndex)
+				samples[bIndex] += __png_paeth(samples[bIndex - bpp], above[bIndex], above[bIndex - bpp]);
+		} break;
+
+		default: return false;
+	}
+
+	dibitmap* bitmap = &decoder->bitmap;
+	u32* dest = (u32*)bitmap->buffer + (u64)bitmap->pitch * (u64)(bitmap->dims.height - 1 - decoder->row);
+	u32 width = (u32)bitmap->dims.width;
+	u32 depth = decoder->bitDepth;
+	b32 straightAlpha = false;
+
+	if (decoder->colorType == PNG_COLOR_RGBA && depth == 8)
+	{
+		for (u32 column = 0; column < width; ++column, samples += 4)
+			dest[column] = ((u32)samples[3] << 24) | ((u32)samples[0] << 16) | ((u32)samples[1] << 8) | (u32)samples[2];
+		straightAlpha = true;
+	}
+	else if (decoder->colorType == PNG_COLOR_RGB && depth == 8 && !decoder->colorKeyed)
+	{
+		for (u32 column = 0; column < width; ++column, samples += 3)
+			dest[column] = 0xFF000000 | ((u32)samples[0] << 16) | ((u32)samples[1] << 8) | (u32)samples[2];
+	}
+	else if (decoder->colorType == PNG_COLOR_PALETTE)
+	{
+		for (u32 column = 0; column < width; ++column)
+			dest[column] = decoder->palette[__png_sample(samples, column, depth)];
+	}
+	else if (decoder->colorType == PNG_COLOR_GRAY)
+	{
+		for (u32 column = 0; column < width; ++column)
+		{
+			u32 sample = __png_sample(samples, column, depth);
+			if (decoder->colorKeyed && sample == decoder->colorKey[0]) dest[column] = 0;
+			else dest[column] = 0xFF000000 | (__png_scale(sample, depth) * 0x010101);
+		}
+	}
+	else if (decoder->colorType == PNG_COLOR_GRAY_ALPHA)
+	{
+		for (u32 column = 0; column < width; ++column)
+		{
+			u32 value = __png_scale(__png_sample(samples, column*2, depth), depth);
+			dest[column] = (__png_scale(__png_sample(samples, column*2 + 1, depth), depth) << 24) | (value * 0x010101);
+		}
+		straightAlpha = true;
+	}
+	else
+	{
+		// 16 bit RGB(A), or color keyed 8 bit RGB.
+		u32 channels = (decoder->colorType == PNG_COLOR_RGBA ? 4 : 3);
+		for (u32 column = 0; column < width; ++column)
+		{
+			u32 r = __png_sample(samples, column*channels, depth);
+			u32 g = __png_sample(samples, column*channels + 1, depth);
+			u32 b = __png_sample(samples, column*channels + 2, depth);
+			u32 a = (channels == 4 ? __png_scale(__png_sample(samples, column*channels + 3, depth), depth) : 0xFF);
+			if (decoder->colorKeyed && r == decoder->colorKey[0] && g == decoder->colorKey[1] && b == decoder->colorKey[2]) a = 0;
+			dest[column] = (a << 24) | (__png_scale(r, depth) << 16) | (__png_scale(g, depth) << 8) | __png_scale(b, depth);
+		}
+		straightAlpha = true;
+	}
+
+	if (straightAlpha) PremultiplySpan(dest, dest, (u64)width);
+	for (u32 column = width; column < (u32)bitmap->pitch; ++column)
+		dest[column] = 0;
+
+	u8* _previous = decoder->previous;
+	decoder->previous = decoder->scanline;
+	decoder->scanline = _previous;
+	decoder->row++;
+	return true;
+
+}
+
+/**
+ * The inflate sink, which gathers the decompressed bytes into scanlines. Anything after the last
+ * scanline is ignored.
+ */
+internal b32
+__png_inflate_sink(void* UserData, u8* Data, u64 Size)
+{
+	png_decoder* decoder = (png_decoder*)UserData;
+	u32 scanlineSize = decoder->rowBytes + 1;
+
+	while (Size && decoder->row < decoder->bitmap.dims.height)
+	{
+		u64 run = scanlineSize - decoder->scanlineFill;
+		if (run > Size) run = Size;
+		for (u64 bIndex = 0; bIndex < run; ++bIndex)
+			decoder->scanline[decoder->scanlineFill + bIndex] = Data[bIndex];
+
+		decoder->scanlineFill += (u32)run;
+		Data += run;
+		Size -= run;
+		if (decoder->scanlineFill == scanlineSize)
+		{
+			if (!__png_finish_scanline(decoder)) return false;
+			decoder->scanlineFill = 0;
+		}
+	}
+	return true;
+}
+
+/**
+ * Reads IHDR and pushes the bitmap and the scratch memory for the image it describes.
+ */
+internal b32
+__png_read_header(png_decoder* decoder)
+{
+
+	u8* header = decoder->buffer;
+	u32 width = __png_read_u32(header);
+	u32 height = __png_read_u32(header + 4);
+	u32 depth = header[8];
+	u32 colorType = header[9];
+	if (width == 0 || height == 0 || width > PNG_MAX_DIMENSION || height > PNG_MAX_DIMENSION) return false;
+	if (header[10] != 0 || header[11] != 0 || header[12] != 0) return false; // Unknown methods, or interlaced.
+
+	u32 channels = 0;
+	b32 validDepth = false;
+	switch (colorType)
+	{
+		case PNG_COLOR_GRAY: channels = 1; validDepth = (depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16); break;
+		case PNG_COLOR_RGB: channels = 3; validDepth = (depth == 8 || depth == 16); break;
+		case PNG_COLOR_PALETTE: channels = 1; validDepth = (depth == 1 || depth == 2 || depth == 4 || depth == 8); break;
+		case PNG_COLOR_GRAY_ALPHA: channels = 2; validDepth = (depth == 8 || depth == 16); break;
+		case PNG_COLOR_RGBA: channels = 4; validDepth = (depth == 8 || depth == 16); break;
+		default: return false;
+	}
+	if (!validDepth) return false;
+
+	decoder->colorType = colorType;
+	decoder->bitDepth = depth;
+	u32 bitsPerPixel = channels * depth;
+	decoder->bytesPerPixel = (bitsPerPixel >= 8 ? bitsPerPixel / 8 : 1);
+	decoder->rowBytes = (u32)(((u64)width * bitsPerPixel + 7) / 8);
+
+	dibitmap* bitmap = &decoder->bitmap;
+	bitmap->dims = { (i32)width, (i32)height };
+	bitmap->pitch = GetImportedBitmapPitch(bitmap->dims.width);
+	u64 bitmapSize = (u64)bitmap->pitch * (u64)height * sizeof(u32);
+	u64 scratchSize = INFLATE_WINDOW_SIZE + 2 * ((u64)decoder->rowBytes + 1);
+	memarena_t* arena = decoder->arena;
+	if (bitmapSize + scratchSize + BITMAP_ROW_ALIGNMENT > arena->length - arena->commit) return false;
+
+	bitmap->buffer = PushSizeAligned(arena, bitmapSize, BITMAP_ROW_ALIGNMENT);
+	decoder->scratch = BeginTemporaryMemory(arena);
+	u8* window = (u8*)PushSize(arena, INFLATE_WINDOW_SIZE);
+	decoder->scanline = (u8*)PushSize(arena, decoder->rowBytes + 1);
+	decoder->previous = (u8*)PushSize(arena, decoder->rowBytes + 1);
+	for (u32 bIndex = 0; bIndex <= decoder->rowBytes; ++bIndex) decoder->previous[bIndex] = 0; // Above the first row.
+
+	BeginInflate(&decoder->inflate, window, true, &__png_inflate_sink, decoder);
+	return true;
+
+}
+
+/**
+ * Called at the first IDAT, once every chunk the pixels depend on has been read.
+ */
+internal b32
+__png_begin_data(png_decoder* decoder)
+{
+	if (decoder->colorType == PNG_COLOR_PALETTE)
+	{
+		if (decoder->paletteCount == 0) return false;
+		for (u32 pIndex = 0; pIndex < decoder->paletteCount; ++pIndex)
+		{
+			u8* color = decoder->paletteColors + pIndex*3;
+			u32 pixel = ((u32)decoder->paletteAlpha[pIndex] << 24) | ((u32)color[0] << 16) | ((u32)color[1] << 8) | (u32)color[2];
+			decoder->palette[pIndex] = __premultiply_pixel(pixel);
+		}
+	}
+	decoder->dataStarted = true;
+	return true;
+}
+
+/**
+ * Handles a chunk which was gathered whole.
+ */
+internal b32
+__png_read_chunk(png_decoder* decoder)
+{
+
+	u8* data = decoder->buffer;
+	switch (decoder->chunkType)
+	{
+		case PNG_CHUNK_IHDR:
+		{
+			if (!__png_read_header(decoder)) return false;
+			decoder->headerRead = true;
+		} break;
+
+		case PNG_CHUNK_PLTE:
+		{
+			decoder->paletteCount = decoder->bufferCount / 3;
+			for (u32 bIndex = 0; bIndex < decoder->bufferCount; ++bIndex) decoder->paletteColors[bIndex] = data[bIndex];
+		} break;
+
+		case PNG_CHUNK_TRNS:
+		{
+			if (decoder->colorType == PNG_COLOR_PALETTE)
+			{
+				for (u32 bIndex = 0; bIndex < decoder->bufferCount; ++bIndex) decoder->paletteAlpha[bIndex] = data[bIndex];
+			}
+			else if (decoder->colorType == PNG_COLOR_GRAY && decoder->bufferCount >= 2)
+			{
+				decoder->colorKeyed = true;
+				decoder->colorKey[0] = ((u32)data[0] << 8) | (u32)data[1];
+			}
+			else if (decoder->colorType == PNG_COLOR_RGB && decoder->bufferCount >= 6)
+			{
+				decoder->colorKeyed = true;
+				for (u32 channel = 0; channel < 3; ++channel)
+					decoder->colorKey[channel] = ((u32)data[channel*2] << 8) | (u32)data[channel*2 + 1];
+			}
+		} break;
+	}
+	return true;
+
+}
+
+/**
+ * Starts decoding a PNG file into a bitmap pushed on arena. Nothing else should be pushed on the
+ * arena until the decode is done, or abandoned with AbortPNGDecode.
+ */
+inline void
+BeginPNGDecode(png_decoder* decoder, memarena_t* arena)
+{
+	decoder->arena = arena;
+	decoder->image = BeginTemporaryMemory(arena);
+	decoder->state = PNG_STATE_SIGNATURE;
+	decoder->bufferCount = 0;
+	decoder->chunkType = 0;
+	decoder->chunkRemaining = 0;
+	decoder->headerRead = false;
+	decoder->dataStarted = false;
+	decoder->paletteCount = 0;
+	decoder->colorKeyed = false;
+	decoder->scanlineFill = 0;
+	decoder->row = 0;
+	decoder->bitmap = {};
+	for (u32 pIndex = 0; pIndex < 256; ++pIndex)
+	{
+		decoder->paletteAlpha[pIndex] = 0xFF;
+		decoder->palette[pIndex] = 0;
+	}
+}
+
+/**
+ * Decodes the next size bytes of the file. Returns IMAGE_DECODE_MORE until the last scanline has
+ * been decoded, after which the bitmap is complete and the rest of the file is ignored. An error
+ * releases everything the decoder pushed.
+ */
+internal image_decode_status
+PNGDecode(png_decoder* decoder, void* Data, u64 Size)
+{
+
+	u8* data = (u8*)Data;
+	u64 position = 0;
+
+	while (decoder->state != PNG_STATE_DONE && decoder->state != PNG_STATE_ERROR)
+	{
+		switch (decoder->state)
+		{
+
+			case PNG_STATE_SIGNATURE:
+			{
+				while (decoder->bufferCount < PNG_SIGNATURE_SIZE && position < Size)
+					decoder->buffer[decoder->bufferCount++] = data[position++];
+				if (decoder->bufferCount < PNG_SIGNATURE_SIZE) return IMAGE_DECODE_MORE;
+
+				for (u32 bIndex = 0; bIndex < PNG_SIGNATURE_SIZE; ++bIndex)
+					if (decoder->buffer[bIndex] != __png_signature[bIndex]) return __png_fail(decoder);
+				decoder->bufferCount = 0;
+				decoder->state = PNG_STATE_CHUNK_HEADER;
+			} break;
+
+			case PNG_STATE_CHUNK_HEADER:
+			{
+				while (decoder->bufferCount < PNG_CHUNK_HEADER_SIZE && position < Size)
+					decoder->buffer[decoder->bufferCount++] = data[position++];
+				if (decoder->bufferCount < PNG_CHUNK_HEADER_SIZE) return IMAGE_DECODE_MORE;
+
+				u32 length = __png_read_u32(decoder->buffer);
+				u32 type = __png_read_u32(decoder->buffer + 4);
+				decoder->chunkType = type;
+				decoder->chunkRemaining = length;
+				decoder->bufferCount = 0;
+				if (length > 0x7FFFFFFF) return __png_fail(decoder);
+
+				// IHDR comes first, the chunks that are gathered whole must fit the buffer and any
+				// critical chunk (upper case first letter) we don't know can't be skipped.
+				if (decoder->headerRead == (type == PNG_CHUNK_IHDR)) return __png_fail(decoder);
+				if (type == PNG_CHUNK_IHDR && length != 13) return __png_fail(decoder);
+				if (type == PNG_CHUNK_PLTE && (length > 768 || length % 3 || decoder->dataStarted)) return __png_fail(decoder);
+				if (type == PNG_CHUNK_TRNS && length > 256) return __png_fail(decoder);
+				if (type == PNG_CHUNK_IEND) return __png_fail(decoder); // The image data ended early.
+				if (type == PNG_CHUNK_IDAT && !decoder->dataStarted && !__png_begin_data(decoder)) return __png_fail(decoder);
+				if (!(type & 0x20000000) && type != PNG_CHUNK_IHDR && type != PNG_CHUNK_PLTE && type != PNG_CHUNK_IDAT)
+					return __png_fail(decoder);
+
+				decoder->state = PNG_STATE_CHUNK_DATA;
+			} break;
+
+			case PNG_STATE_CHUNK_DATA:
+			{
+				u64 run = decoder->chunkRemaining;
+				if (run > Size - position) run = Size - position;
+				u32 type = decoder->chunkType;
+
+				if (type == PNG_CHUNK_IDAT)
+				{
+					if (Inflate(&decoder->inflate, data + position, run) == INFLATE_ERROR) return __png_fail(decoder);
+					if (decoder->row == decoder->bitmap.dims.height)
+					{
+						EndTemporaryMemory(decoder->scratch);
+						KeepTemporaryMemory(decoder->image);
+						decoder->state = PNG_STATE_DONE;
+						break;
+					}
+				}
+				else if (type == PNG_CHUNK_IHDR || type == PNG_CHUNK_PLTE || type == PNG_CHUNK_TRNS)
+				{
+					for (u64 bIndex = 0; bIndex < run; ++bIndex)
+						decoder->buffer[decoder->bufferCount++] = data[position + bIndex];
+				}
+
+				position += run;
+				decoder->chunkRemaining -= (u32)run;
+				if (decoder->chunkRemaining) return IMAGE_DECODE_MORE;
+
+				if (!__png_read_chunk(decoder)) return __png_fail(decoder);
+				decoder->bufferCount = 0;
+				decoder->state = PNG_STATE_CHUNK_CRC;
+			} break;
+
+			case PNG_STATE_CHUNK_CRC:
+			{
+				while (decoder->bufferCount < PNG_CHUNK_CRC_SIZE && position < Size)
+				{
+					decoder->bufferCount++;
+					position++;
+				}
+				if (decoder->bufferCount < PNG_CHUNK_CRC_SIZE) return IMAGE_DECODE_MORE;
+				decoder->bufferCount = 0;
+				decoder->state = PNG_STATE_CHUNK_HEADER;
+			} break;
+
+		}
+	}
+
+	return (decoder->state == PNG_STATE_DONE ? IMAGE_DECODE_DONE : IMAGE_DECODE_ERROR);
+
+}
+
+/**
+ * Abandons an unfinished decode, releasing the bitmap. Does nothing once the decode is done.
+ */
+inline void
+AbortPNGDecode(png_decoder* decoder)
+{
+	if (decoder->state != PNG_STATE_DONE) __png_fail(decoder);
+}
+
+/**
+ * Decodes a whole PNG file held in memory, see ImportBitmap. Returns false, and pushes nothing, if
+ * the file is invalid, cut short or interlaced.
+ */
+internal b32
+DecodePNG(memarena_t* arena, void* resource, u64 size, dibitmap* bitmap)
+{
+	png_decoder decoder;
+	BeginPNGDecode(&decoder, arena);
+	if (PNGDecode(&decoder, resource, size) != IMAGE_DECODE_DONE)
+	{
+		AbortPNGDecode(&decoder);
+		return false;
+	}
+
+	*bitmap = decoder.bitmap;
+	return true;
+}
+
+#endif
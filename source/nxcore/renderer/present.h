@@ -0,0 +1,400 @@
+#ifndef NINETAILSX_PRESENT_H
+#define NINETAILSX_PRESENT_H
+#include <nxcore/helpers.h>
+#include <nxcore/math.h>
+#include <nxcore/memory.h>
+#include <nxcore/simd.h>
+#include <nxcore/renderer/software.h>
+
+/**
+ * The output bitmap is swept over every frame, by us and then by the platform, so it is put on its
+ * own large pages to keep it from thrashing the TLB.
+ */
+#ifndef NX_PRESENT_LARGE_PAGES
+#define NX_PRESENT_LARGE_PAGES 1
+#endif
+
+/**
+ * The present stage.
+ *
+ * The engine rasterizes at its native (logical) resolution. The present stage scales that layer
+ * up into the bitmap the platform presents, centered in the window with black bars around it.
+ *
+ * PRESENT_FILTER_NEAREST		Scales by the largest integer factor which fits the window, every
+ * 								source pixel becomes a solid block. An output smaller than the
+ * 								source falls back to the bilinear fit, which scales down.
+ * PRESENT_FILTER_BILINEAR		Scales by the largest factor which fits the window while keeping the
+ * 								aspect ratio, filtering between the four nearest source pixels.
+ *
+ * Only the regions of the source which changed are scaled, and they come back out as regions of
+ * the output for the platform to present.
+ */
+enum present_filter
+{
+	PRESENT_FILTER_NEAREST,
+	PRESENT_FILTER_BILINEAR,
+};
+
+typedef struct present_stage
+{
+	dibitmap* source;
+	dibitmap output;
+	present_filter filter;
+
+	rect2i viewport; // Where the scaled source lands in the output.
+	i32 scale; // The integer factor, only used by PRESENT_FILTER_NEAREST. Zero when the source doesn't fit.
+	b32 forcePresent; // Scale and present everything, the bars included.
+
+	rect2i* dirtyRects; // In output coordinates.
+	u32 dirtyRectCount;
+	u32 dirtyRectCapacity;
+
+	// What the last PresentLayer wrote to the output.
+	u64 pixelsWritten;
+	u64 memcopyBytes;
+} present_stage;
+
+/**
+ * ScaleRowNearest
+ * 			Writes every source pixel Scale times over. There is a kernel per instruction set level,
+ * 			selected on first use.
+ */
+typedef void fnptr_scale_row_nearest(u32* Dest, u32* Source, u32 SourceCount, u32 Scale);
+
+internal void
+__scale_row_nearest_scalar(u32* Dest, u32* Source, u32 SourceCount, u32 Scale)
+{
+	for (u32 sIndex = 0; sIndex < SourceCount; ++sIndex)
+		for (u32 repeat = 0; repeat < Scale; ++repeat)
+			*Dest++ = Source[sIndex];
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+/**
+ * SSE2 has no variable shuffle, so only the factors we expect to see all the time (2x and 4x)
+ * get a vector path.
+ */
+NX_TARGET_SSE2 internal void
+__scale_row_nearest_sse2(u32* Dest, u32* Source, u32 SourceCount, u32 Scale)
+{
+	u32 sIndex = 0;
+	if (Scale == 2)
+	{
+		for (; sIndex + 4 <= SourceCount; sIndex += 4, Dest += 8)
+		{
+			__m128i S = _mm_loadu_si128((__m128i*)(Source + sIndex));
+			_mm_storeu_si128((__m128i*)Dest + 0, _mm_unpacklo_epi32(S, S));
+			_mm_storeu_si128((__m128i*)Dest + 1, _mm_unpackhi_epi32(S, S));
+		}
+	}
+	else if (Scale == 4)
+	{
+		for (; sIndex + 4 <= SourceCount; sIndex += 4, Dest += 16)
+		{
+			__m128i S = _mm_loadu_si128((__m128i*)(Source + sIndex));
+			_mm_storeu_si128((__m128i*)Dest + 0, _mm_shuffle_epi32(S, _MM_SHUFFLE(0,0,0,0)));
+			_mm_storeu_si128((__m128i*)Dest + 1, _mm_shuffle_epi32(S, _MM_SHUFFLE(1,1,1,1)));
+			_mm_storeu_si128((__m128i*)Dest + 2, _mm_shuffle_epi32(S, _MM_SHUFFLE(2,2,2,2)));
+			_mm_storeu_si128((__m128i*)Dest + 3, _mm_shuffle_epi32(S, _MM_SHUFFLE(3,3,3,3)));
+		}
+	}
+	__scale_row_nearest_scalar(Dest, Source + sIndex, SourceCount - sIndex, Scale);
+}
+
+/**
+ * AVX2 handles any factor with a permute. Eight output pixels never need more than eight source
+ * pixels, and which ones only depends on where the eight start within a source pixel, so there is
+ * one permute per phase.
+ */
+NX_TARGET_AVX2 internal void
+__scale_row_nearest_avx2(u32* Dest, u32* Source, u32 SourceCount, u32 Scale)
+{
+	if (Scale > 64)
+	{
+		__scale_row_nearest_scalar(Dest, Source, SourceCount, Scale);
+		return;
+	}
+
+	__m256i Permutes[64];
+	for (u32 phase = 0; phase < Scale; ++phase)
+	{
+		Permutes[phase] = _mm256_setr_epi32((phase+0)/Scale, (phase+1)/Scale, (phase+2)/Scale, (phase+3)/Scale,
+			(phase+4)/Scale, (phase+5)/Scale, (phase+6)/Scale, (phase+7)/Scale);
+	}
+
+	// The load reads eight source pixels, so stop once fewer than eight are left.
+	u64 DestCount = (u64)SourceCount * Scale;
+	u64 dIndex = 0;
+	for (; dIndex + 8 <= DestCount && (dIndex / Scale) + 8 <= SourceCount; dIndex += 8)
+	{
+		__m256i S = _mm256_loadu_si256((__m256i*)(Source + dIndex / Scale));
+		_mm256_storeu_si256((__m256i*)(Dest + dIndex), _mm256_permutevar8x32_epi32(S, Permutes[dIndex % Scale]));
+	}
+	for (; dIndex < DestCount; ++dIndex)
+		Dest[dIndex] = Source[dIndex / Scale];
+}
+#endif
+
+global fnptr_scale_row_nearest* __scale_row_nearest_kernel;
+
+/**
+ * Selects the scaling kernels for the instruction set level reported by GetSIMDLevel(). There
+ * is no AVX-512 kernel, those machines use the AVX2 one. This happens automatically on first
+ * use, it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectPresentKernels()
+{
+	__scale_row_nearest_kernel = &__scale_row_nearest_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512:
+		case SIMD_LEVEL_AVX2: __scale_row_nearest_kernel = &__scale_row_nearest_avx2; break;
+		case SIMD_LEVEL_SSE2: __scale_row_nearest_kernel = &__scale_row_nearest_sse2; break;
+		default: break;
+	}
+#endif
+}
+
+inline void
+ScaleRowNearest(u32* Dest, u32* Source, u32 SourceCount, u32 Scale)
+{
+	if (__scale_row_nearest_kernel == NULL) SelectPresentKernels();
+	__scale_row_nearest_kernel(Dest, Source, SourceCount, Scale);
+}
+
+/**
+ * True when the source is scaled up in whole blocks, rather than filtered.
+ */
+inline b32
+__present_is_nearest(present_stage* stage)
+{
+	return (stage->filter == PRESENT_FILTER_NEAREST && stage->scale > 0);
+}
+
+/**
+ * Works out the viewport of the scaled source within the output.
+ */
+internal void
+__present_fit_viewport(present_stage* stage)
+{
+	v2i sourceDims = stage->source->dims;
+	v2i outputDims = stage->output.dims;
+	v2i viewportDims = {};
+
+	stage->scale = 0;
+	if (stage->filter == PRESENT_FILTER_NEAREST)
+	{
+		i32 scaleX = outputDims.width / sourceDims.width;
+		i32 scaleY = outputDims.height / sourceDims.height;
+		stage->scale = (scaleX < scaleY ? scaleX : scaleY);
+		viewportDims = sourceDims * stage->scale;
+	}
+
+	if (!__present_is_nearest(stage))
+	{
+		// Fit the width, unless that makes us too tall.
+		viewportDims = { outputDims.width, (i32)(((i64)outputDims.width * sourceDims.height) / sourceDims.width) };
+		if (viewportDims.height > outputDims.height)
+			viewportDims = { (i32)(((i64)outputDims.height * sourceDims.width) / sourceDims.height), outputDims.height };
+	}
+
+	v2i offset = { (outputDims.width - viewportDims.width) / 2, (outputDims.height - viewportDims.height) / 2 };
+	stage->viewport = CreateRect(offset, viewportDims);
+}
+
+/**
+ * Creates a present stage which scales source into a new output bitmap of outputDims, allocated
+ * from arena. The source is presented in at most maxRegions dirty regions a frame, anything more
+ * and the whole viewport is presented instead.
+ */
+internal present_stage
+CreatePresentStage(memarena_t* arena, dibitmap* source, v2i outputDims, present_filter filter, u32 maxRegions)
+{
+
+	present_stage _stage = {};
+	_stage.source = source;
+	_stage.filter = filter;
+
+	u32 outputSize = (u32)GetBitmapSize(sizeof(u32), outputDims);
+#if NX_PRESENT_LARGE_PAGES
+	void* outputBuffer = PushLargePageSize(arena, outputSize);
+#else
+	void* outputBuffer = PushSize(arena, outputSize);
+#endif
+	_stage.output = CreateBitmapLayer(outputBuffer, outputSize, outputDims);
+
+	_stage.dirtyRectCapacity = maxRegions + 1;
+	_stage.dirtyRects = PushArray(arena, rect2i, _stage.dirtyRectCapacity);
+	_stage.forcePresent = true;
+	__present_fit_viewport(&_stage);
+
+	return _stage;
+
+}
+
+/**
+ * Changes the filter, which refits the viewport and presents everything next time.
+ */
+inline void
+SetPresentFilter(present_stage* stage, present_filter filter)
+{
+	stage->filter = filter;
+	stage->forcePresent = true;
+	__present_fit_viewport(stage);
+}
+
+/**
+ * Scales and presents everything next time, whatever regions are passed in.
+ */
+inline void
+MarkPresentDirty(present_stage* stage)
+{
+	stage->forcePresent = true;
+}
+
+internal void
+__present_nearest(present_stage* stage, rect2i region)
+{
+	u32 scale = (u32)stage->scale;
+	v2i regionDims = GetRectDims(region);
+	i32 outputPitch = stage->output.pitch;
+	i32 sourcePitch = stage->source->pitch;
+
+	for (i32 sourceRow = region.min.y; sourceRow < region.max.y; ++sourceRow)
+	{
+		u32* sourcePixels = (u32*)stage->source->buffer + sourceRow*sourcePitch + region.min.x;
+		u32* firstRow = (u32*)stage->output.buffer + (stage->viewport.min.y + sourceRow*(i32)scale)*outputPitch +
+			stage->viewport.min.x + region.min.x*(i32)scale;
+
+		// Scale the row once, then copy it down the rest of the block.
+		ScaleRowNearest(firstRow, sourcePixels, (u32)regionDims.width, scale);
+		for (u32 repeat = 1; repeat < scale; ++repeat)
+			nx_memcopy(firstRow + repeat*outputPitch, firstRow, (u64)regionDims.width*scale*sizeof(u32));
+	}
+}
+
+/**
+ * Bilinear filtering in 16.16 fixed point, sampling at output pixel centers. Each channel is
+ * interpolated horizontally on two source rows and then vertically between them.
+ */
+internal void
+__present_bilinear(present_stage* stage, rect2i outputRegion)
+{
+	v2i sourceDims = stage->source->dims;
+	v2i viewportDims = GetRectDims(stage->viewport);
+	u32* sourcePixels = (u32*)stage->source->buffer;
+
+	for (i32 outY = outputRegion.min.y; outY < outputRegion.max.y; ++outY)
+	{
+		i64 sampleY = (((i64)(outY - stage->viewport.min.y) << 16) + (1 << 15)) * sourceDims.height / viewportDims.height - (1 << 15);
+		if (sampleY < 0) sampleY = 0;
+		i32 y0 = (i32)(sampleY >> 16);
+		i32 y1 = (y0 + 1 < sourceDims.height ? y0 + 1 : y0);
+		u32 fy = (u32)(sampleY & 0xFFFF) >> 8;
+
+		u32* row0 = sourcePixels + y0*stage->source->pitch;
+		u32* row1 = sourcePixels + y1*stage->source->pitch;
+		u32* dest = (u32*)stage->output.buffer + outY*stage->output.pitch + outputRegion.min.x;
+
+		for (i32 outX = outputRegion.min.x; outX < outputRegion.max.x; ++outX)
+		{
+			i64 sampleX = (((i64)(outX - stage->viewport.min.x) << 16) + (1 << 15)) * sourceDims.width / viewportDims.width - (1 << 15);
+			if (sampleX < 0) sampleX = 0;
+			i32 x0 = (i32)(sampleX >> 16);
+			i32 x1 = (x0 + 1 < sourceDims.width ? x0 + 1 : x0);
+			u32 fx = (u32)(sampleX & 0xFFFF) >> 8;
+
+			u32 a = row0[x0], b = row0[x1], c = row1[x0], d = row1[x1];
+			u32 _pixel = 0;
+			for (u32 shift = 0; shift < 32; shift += 8)
+			{
+				u32 top = ((a >> shift) & 0xFF) * (256 - fx) + ((b >> shift) & 0xFF) * fx;
+				u32 bottom = ((c >> shift) & 0xFF) * (256 - fx) + ((d >> shift) & 0xFF) * fx;
+				_pixel |= (((top * (256 - fy) + bottom * fy) >> 16) & 0xFF) << shift;
+			}
+			*dest++ = _pixel;
+		}
+	}
+}
+
+/**
+ * Maps a region of the source to the region of the output it scales into. Bilinear output pixels
+ * also read the neighbouring source pixels, so the region grows by one source pixel first.
+ */
+internal rect2i
+__present_map_region(present_stage* stage, rect2i region)
+{
+	if (__present_is_nearest(stage))
+	{
+		rect2i _mapped;
+		_mapped.min = { stage->viewport.min.x + region.min.x*stage->scale, stage->viewport.min.y + region.min.y*stage->scale };
+		_mapped.max = { stage->viewport.min.x + region.max.x*stage->scale, stage->viewport.min.y + region.max.y*stage->scale };
+		return _mapped;
+	}
+
+	v2i sourceDims = stage->source->dims;
+	v2i viewportDims = GetRectDims(stage->viewport);
+	rect2i grown = { { region.min.x - 1, region.min.y - 1 }, { region.max.x + 1, region.max.y + 1 } };
+
+	rect2i _mapped;
+	_mapped.min.x = stage->viewport.min.x + (i32)(((i64)grown.min.x * viewportDims.width) / sourceDims.width);
+	_mapped.min.y = stage->viewport.min.y + (i32)(((i64)grown.min.y * viewportDims.height) / sourceDims.height);
+	_mapped.max.x = stage->viewport.min.x + (i32)(((i64)grown.max.x * viewportDims.width + sourceDims.width-1) / sourceDims.width);
+	_mapped.max.y = stage->viewport.min.y + (i32)(((i64)grown.max.y * viewportDims.height + sourceDims.height-1) / sourceDims.height);
+	return IntersectRect(_mapped, stage->viewport);
+}
+
+/**
+ * Scales the given regions of the source into the output and fills in the stage's dirty rects
+ * with where they ended up. When the stage is forced (the first frame, or the filter changed),
+ * the bars are cleared and everything is scaled and presented.
+ */
+internal void
+PresentLayer(present_stage* stage, rect2i* regions, u32 regionCount)
+{
+
+	NX_PROFILE_SCOPE("PresentLayer");
+	rect2i sourceRect = GetBitmapRect(stage->source);
+	stage->dirtyRectCount = 0;
+	stage->pixelsWritten = 0;
+	u64 memcopyStart = GetMemcopyByteCount();
+
+	// Too many regions to track one by one, scale the whole source and present it as one.
+	b32 presentAll = (stage->forcePresent || regionCount + 1 > stage->dirtyRectCapacity);
+	if (presentAll)
+	{
+		if (stage->forcePresent)
+		{
+			FillSpan((u32*)stage->output.buffer, (u64)stage->output.dims.width * (u64)stage->output.dims.height, 0xFF000000);
+			stage->pixelsWritten += (u64)stage->output.dims.width * (u64)stage->output.dims.height;
+			stage->dirtyRects[stage->dirtyRectCount++] = GetBitmapRect(&stage->output);
+		}
+		else stage->dirtyRects[stage->dirtyRectCount++] = stage->viewport;
+
+		regions = &sourceRect;
+		regionCount = 1;
+		stage->forcePresent = false;
+	}
+
+	for (u32 regionIndex = 0; regionIndex < regionCount; ++regionIndex)
+	{
+		rect2i region = IntersectRect(regions[regionIndex], sourceRect);
+		if (IsRectEmpty(region)) continue;
+
+		rect2i mapped = __present_map_region(stage, region);
+		if (__present_is_nearest(stage)) __present_nearest(stage, region);
+		else __present_bilinear(stage, mapped);
+
+		v2i mappedDims = GetRectDims(mapped);
+		stage->pixelsWritten += (u64)mappedDims.width * (u64)mappedDims.height;
+		if (!presentAll) stage->dirtyRects[stage->dirtyRectCount++] = mapped;
+	}
+
+	stage->memcopyBytes = GetMemcopyByteCount() - memcopyStart;
+
+}
+
+#endif
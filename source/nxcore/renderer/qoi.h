@@ -0,0 +1,320 @@
+#ifndef NINETAILSX_QOI_H
+#define NINETAILSX_QOI_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/renderer/dibitmap.h>
+#include <nxcore/renderer/import.h>
+
+/**
+ * QOI decoding.
+ *
+ * Decodes a QOI ("Quite OK Image") file straight into a bitmap pushed on an arena, in the same
+ * format ImportBitmap produces (see import.h): premultiplied 0xAARRGGBB, rows bottom-up and padded
+ * to BITMAP_ROW_ALIGNMENT. Each op is a byte or a handful, so decoding is a single pass that runs
+ * about as fast as the pixels can be written.
+ *
+ * The decoder takes the file a piece at a time:
+ *
+ * 		qoi_decoder decoder;
+ * 		BeginQOIDecode(&decoder, arena);
+ * 		while ((status = QOIDecode(&decoder, data, size)) == IMAGE_DECODE_MORE) ... next piece ...
+ *
+ * Pieces can end anywhere, an op split between two of them is carried over in the decoder. The
+ * bitmap is pushed as soon as the header has arrived and is in decoder.bitmap once it's done.
+ *
+ * NOTE:
+ * 			QOI stores straight alpha, so rows with any translucent pixel are premultiplied as they
+ * 			are finished. The colorspace byte is ignored, the pixels are used as they are.
+ */
+#define QOI_HEADER_SIZE 14
+#define QOI_MAGIC 0x716F6966 // "qoif"
+#define QOI_MAX_PIXELS 400000000
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xC0
+#define QOI_OP_RGB 0xFE
+#define QOI_OP_RGBA 0xFF
+
+enum qoi_state
+{
+	QOI_STATE_HEADER,
+	QOI_STATE_PIXELS,
+	QOI_STATE_DONE,
+	QOI_STATE_ERROR,
+};
+
+typedef struct qoi_decoder
+{
+	memarena_t* arena;
+	temporary_memory image;
+	u32 state;
+
+	u8 buffer[QOI_HEADER_SIZE]; // The header, or an op split across two pieces.
+	u32 bufferCount;
+
+	u32 index[64]; // Recently seen pixels, straight 0xAARRGGBB.
+	u32 pixel;
+	b32 translucent; // Set by the first pixel which isn't opaque.
+	i32 x;
+	i32 y;
+	u32* row;
+
+	dibitmap bitmap;
+} qoi_decoder;
+
+inline u32
+__qoi_hash(u32 pixel)
+{
+	u32 r = (pixel >> 16) & 0xFF;
+	u32 g = (pixel >> 8) & 0xFF;
+	u32 b = pixel & 0xFF;
+	u32 a = pixel >> 24;
+	return (r*3 + g*5 + b*7 + a*11) & 63;
+}
+
+inline u32
+__qoi_op_size(u8 op)
+{
+	if (op == QOI_OP_RGB) return 4;
+	if (op == QOI_OP_RGBA) return 5;
+	return ((op & 0xC0) == QOI_OP_LUMA ? 2 : 1);
+}
+
+inline u32
+__qoi_read_u32(u8* data)
+{
+	return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | (u32)data[3];
+}
+
+inline image_decode_status
+__qoi_fail(qoi_decoder* decoder)
+{
+	if (decoder->state == QOI_STATE_HEADER || decoder->state == QOI_STATE_PIXELS)
+		EndTemporaryMemory(decoder->image);
+	decoder->state = QOI_STATE_ERROR;
+	return IMAGE_DECODE_ERROR;
+}
+
+/**
+ * Premultiplies and pads the row that was just filled and moves on to the next one.
+ */
+internal void
+__qoi_finish_row(qoi_decoder* decoder)
+{
+	dibitmap* bitmap = &decoder->bitmap;
+	if (decoder->translucent) PremultiplySpan(decoder->row, decoder->row, (u64)bitmap->dims.width);
+	for (i32 column = bitmap->dims.width; column < bitmap->pitch; ++column)
+		decoder->row[column] = 0;
+
+	decoder->x = 0;
+	if (++decoder->y == bitmap->dims.height)
+	{
+		KeepTemporaryMemory(decoder->image);
+		decoder->state = QOI_STATE_DONE;
+		return;
+	}
+	decoder->row = (u32*)bitmap->buffer + (u64)bitmap->pitch * (u64)(bitmap->dims.height - 1 - decoder->y);
+}
+
+/**
+ * Decodes whole ops from data until it runs out, or the image is finished. Returns the bytes
+ * consumed, anything left over is the start of an op which didn't fit.
+ */
+internal u64
+__qoi_decode_ops(qoi_decoder* decoder, u8* data, u64 size)
+{
+
+	u32* index = decoder->index;
+	u32 pixel = decoder->pixel;
+	u32* row = decoder->row;
+	i32 x = decoder->x;
+	i32 width = decoder->bitmap.dims.width;
+	u64 position = 0;
+
+	while (position < size)
+	{
+		u8* op = data + position;
+		u32 opSize = __qoi_op_size(*op);
+		if (position + opSize > size) break;
+		position += opSize;
+
+		i32 run = 1;
+		if (*op == QOI_OP_RGB)
+		{
+			pixel = (pixel & 0xFF000000) | ((u32)op[1] << 16) | ((u32)op[2] << 8) | (u32)op[3];
+		}
+		else if (*op == QOI_OP_RGBA)
+		{
+			pixel = ((u32)op[4] << 24) | ((u32)op[1] << 16) | ((u32)op[2] << 8) | (u32)op[3];
+			if (op[4] != 0xFF) decoder->translucent = true;
+		}
+		else
+		{
+			switch (*op & 0xC0)
+			{
+				case QOI_OP_INDEX:
+				{
+					pixel = index[*op];
+				} break;
+
+				case QOI_OP_DIFF:
+				{
+					u32 r = ((pixel >> 16) + ((*op >> 4) & 3) - 2) & 0xFF;
+					u32 g = ((pixel >> 8) + ((*op >> 2) & 3) - 2) & 0xFF;
+					u32 b = (pixel + (*op & 3) - 2) & 0xFF;
+					pixel = (pixel & 0xFF000000) | (r << 16) | (g << 8) | b;
+				} break;
+
+				case QOI_OP_LUMA:
+				{
+					u32 dg = (u32)(*op & 63) - 32;
+					u32 r = ((pixel >> 16) + dg + (op[1] >> 4) - 8) & 0xFF;
+					u32 g = ((pixel >> 8) + dg) & 0xFF;
+					u32 b = (pixel + dg + (op[1] & 15) - 8) & 0xFF;
+					pixel = (pixel & 0xFF000000) | (r << 16) | (g << 8) | b;
+				} break;
+
+				default:
+				{
+					run = (*op & 63) + 1;
+				} break;
+			}
+		}
+		index[__qoi_hash(pixel)] = pixel;
+
+		// A run can carry on into the next row, or past the end of the image, which is ignored.
+		while (run)
+		{
+			i32 span = (run < width - x ? run : width - x);
+			for (i32 column = x; column < x + span; ++column) row[column] = pixel;
+			x += span;
+			run -= span;
+			if (x < width) break;
+
+			decoder->row = row;
+			__qoi_finish_row(decoder);
+			if (decoder->state != QOI_STATE_PIXELS)
+			{
+				decoder->pixel = pixel;
+				return position;
+			}
+			row = decoder->row;
+			x = 0;
+		}
+	}
+
+	decoder->row = row;
+	decoder->x = x;
+	decoder->pixel = pixel;
+	return position;
+
+}
+
+/**
+ * Starts decoding a QOI file into a bitmap pushed on arena. Nothing else should be pushed on the
+ * arena until the decode is done, or abandoned with AbortQOIDecode.
+ */
+inline void
+BeginQOIDecode(qoi_decoder* decoder, memarena_t* arena)
+{
+	*decoder = {};
+	decoder->arena = arena;
+	decoder->image = BeginTemporaryMemory(arena);
+	decoder->state = QOI_STATE_HEADER;
+	decoder->pixel = 0xFF000000;
+}
+
+/**
+ * Decodes the next size bytes of the file. Returns IMAGE_DECODE_MORE until the last pixel has been
+ * decoded, after which the bitmap is complete and anything else in the file is ignored. An error
+ * releases everything the decoder pushed.
+ */
+internal image_decode_status
+QOIDecode(qoi_decoder* decoder, void* Data, u64 Size)
+{
+
+	u8* data = (u8*)Data;
+	u64 position = 0;
+
+	if (decoder->state == QOI_STATE_HEADER)
+	{
+		while (decoder->bufferCount < QOI_HEADER_SIZE && position < Size)
+			decoder->buffer[decoder->bufferCount++] = data[position++];
+		if (decoder->bufferCount < QOI_HEADER_SIZE) return IMAGE_DECODE_MORE;
+
+		u8* header = decoder->buffer;
+		u32 width = __qoi_read_u32(header + 4);
+		u32 height = __qoi_read_u32(header + 8);
+		if (__qoi_read_u32(header) != QOI_MAGIC || width == 0 || height == 0 ||
+			(u64)width * (u64)height > QOI_MAX_PIXELS || (header[12] != 3 && header[12] != 4) || header[13] > 1)
+			return __qoi_fail(decoder);
+
+		dibitmap* bitmap = &decoder->bitmap;
+		bitmap->dims = { (i32)width, (i32)height };
+		bitmap->pitch = GetImportedBitmapPitch(bitmap->dims.width);
+		u64 bitmapSize = (u64)bitmap->pitch * (u64)height * sizeof(u32);
+		if (bitmapSize + BITMAP_ROW_ALIGNMENT > decoder->arena->length - decoder->arena->commit)
+			return __qoi_fail(decoder);
+
+		bitmap->buffer = PushSizeAligned(decoder->arena, bitmapSize, BITMAP_ROW_ALIGNMENT);
+		decoder->row = (u32*)bitmap->buffer + (u64)bitmap->pitch * (u64)(height - 1);
+		decoder->bufferCount = 0;
+		decoder->state = QOI_STATE_PIXELS;
+	}
+
+	if (decoder->state == QOI_STATE_PIXELS && decoder->bufferCount)
+	{
+		// Finish the op the last piece ended partway through.
+		u32 opSize = __qoi_op_size(decoder->buffer[0]);
+		while (decoder->bufferCount < opSize && position < Size)
+			decoder->buffer[decoder->bufferCount++] = data[position++];
+		if (decoder->bufferCount < opSize) return IMAGE_DECODE_MORE;
+
+		__qoi_decode_ops(decoder, decoder->buffer, opSize);
+		decoder->bufferCount = 0;
+	}
+
+	if (decoder->state == QOI_STATE_PIXELS)
+	{
+		position += __qoi_decode_ops(decoder, data + position, Size - position);
+		while (decoder->state == QOI_STATE_PIXELS && position < Size)
+			decoder->buffer[decoder->bufferCount++] = data[position++];
+	}
+
+	if (decoder->state == QOI_STATE_DONE) return IMAGE_DECODE_DONE;
+	if (decoder->state == QOI_STATE_ERROR) return IMAGE_DECODE_ERROR;
+	return IMAGE_DECODE_MORE;
+
+}
+
+/**
+ * Abandons an unfinished decode, releasing the bitmap. Does nothing once the decode is done.
+ */
+inline void
+AbortQOIDecode(qoi_decoder* decoder)
+{
+	if (decoder->state != QOI_STATE_DONE) __qoi_fail(decoder);
+}
+
+/**
+ * Decodes a whole QOI file held in memory, see ImportBitmap. Returns false, and pushes nothing, if
+ * the file is invalid or cut short.
+ */
+internal b32
+DecodeQOI(memarena_t* arena, void* resource, u64 size, dibitmap* bitmap)
+{
+	qoi_decoder decoder;
+	BeginQOIDecode(&decoder, arena);
+	if (QOIDecode(&decoder, resource, size) != IMAGE_DECODE_DONE)
+	{
+		AbortQOIDecode(&decoder);
+		return false;
+	}
+
+	*bitmap = decoder.bitmap;
+	return true;
+}
+
+#endif
@@ -1,153 +1,498 @@
 #ifndef NINETAILSX_SOFTWARE_H
 #define NINETAILSX_SOFTWARE_H
 #include <nxcore/helpers.h>
+#include <nxcore/math.h>
 #include <nxcore/renderer/dibitmap.h>
+#include <nxcore/renderer/spans.h>
+#include <nxcore/renderer/blend.h>
+#include <cfloat>
 /**
- * TODO:
- * 			I'd like to learn how to draw an arbitrary line based on two coordinates.
- * 			This is a good place to start as it is fast and somewhat simple to do:
- * 	
- * Bresenham's Line Algorithm
- * 			https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm
+ * Lines.
+ *
+ * Points are in pixels, with whole numbers at the middle of a pixel, so {3,4} is the middle of
+ * pixel (3,4). Colors are premultiplied, like everywhere else.
+ *
+ * Hard lines are integer Bresenham on the endpoints rounded to the nearest pixel, one pixel per
+ * step along the major axis, and write the color as it is. Smooth lines are Xiaolin Wu's, which
+ * splits each step between the two pixels either side of the line by how close it passes, and
+ * blends the color over them scaled by that coverage.
+ *
+ * Lines are clipped with Cohen-Sutherland to find the steps which can land inside the clip rect,
+ * and only those are walked. Every step is placed from the unclipped line, so a line which is
+ * drawn in pieces, one tile at a time, hits exactly the pixels it would if drawn whole.
+ *
+ * NOTE:
+ * 			Lines reaching further than NX_LINE_GUARD_BAND pixels from the origin are first cut
+ * 			down to it, the same way in every tile, so their endpoints always fit in an integer.
+ * 			Lines with an infinite or NaN endpoint aren't drawn.
  */
-internal void
-__DrawLine() { /** IMPLEMENT LATER */ return; };
+#define NX_LINE_GUARD_BAND 8192.0f
+
+typedef struct line_segment
+{
+	v2 from;
+	v2 to;
+	u32 color;
+} line_segment;
+
+#define LINE_OUTCODE_LEFT	1
+#define LINE_OUTCODE_RIGHT	2
+#define LINE_OUTCODE_BOTTOM	4
+#define LINE_OUTCODE_TOP	8
+
+inline u32
+__line_outcode(v2 point, v2 clipMin, v2 clipMax)
+{
+	u32 _code = 0;
+	if (point.x < clipMin.x) _code |= LINE_OUTCODE_LEFT;
+	else if (point.x > clipMax.x) _code |= LINE_OUTCODE_RIGHT;
+	if (point.y < clipMin.y) _code |= LINE_OUTCODE_BOTTOM;
+	else if (point.y > clipMax.y) _code |= LINE_OUTCODE_TOP;
+	return _code;
+}
 
 /**
- * Determines if one bitmap exists within the boundary of another bitmap with the origin
- * placed at the left-lower corner.
+ * Cohen-Sutherland. Clips the segment to the box in place, returns false if none of it is inside.
  */
-inline b32
-IsWithinBitmapBounds(i32 parentWidth, i32 parentHeight, i32 x, i32 y, i32 subWidth, i32 subHeight)
+internal b32
+__line_clip(v2* from, v2* to, v2 clipMin, v2 clipMax)
 {
-	b32 _within_bounds = true;
 
-	if (x+subWidth < 0) _within_bounds = false;
-	if (x >= parentWidth) _within_bounds = false;
-	if (y+subHeight < 0) _within_bounds = false;
-	if (y >= parentHeight) _within_bounds = false;
+	u32 _fromCode = __line_outcode(*from, clipMin, clipMax);
+	u32 _toCode = __line_outcode(*to, clipMin, clipMax);
+	for (;;)
+	{
+		if ((_fromCode | _toCode) == 0) return true;
+		if ((_fromCode & _toCode) != 0) return false;
+
+		// Move whichever end is outside onto the edge it is outside of.
+		u32 _code = (_fromCode ? _fromCode : _toCode);
+		v2 _point;
+		if (_code & LINE_OUTCODE_TOP)
+		{
+			_point.x = from->x + (to->x - from->x) * (clipMax.y - from->y) / (to->y - from->y);
+			_point.y = clipMax.y;
+		}
+		else if (_code & LINE_OUTCODE_BOTTOM)
+		{
+			_point.x = from->x + (to->x - from->x) * (clipMin.y - from->y) / (to->y - from->y);
+			_point.y = clipMin.y;
+		}
+		else if (_code & LINE_OUTCODE_RIGHT)
+		{
+			_point.y = from->y + (to->y - from->y) * (clipMax.x - from->x) / (to->x - from->x);
+			_point.x = clipMax.x;
+		}
+		else
+		{
+			_point.y = from->y + (to->y - from->y) * (clipMin.x - from->x) / (to->x - from->x);
+			_point.x = clipMin.x;
+		}
+
+		if (_code == _fromCode)
+		{
+			*from = _point;
+			_fromCode = __line_outcode(*from, clipMin, clipMax);
+		}
+		else
+		{
+			*to = _point;
+			_toCode = __line_outcode(*to, clipMin, clipMax);
+		}
+	}
 
-	return _within_bounds;
 }
 
+/**
+ * Cuts a line down to the guard band, returns false if none of it is inside or it isn't finite.
+ * This is Liang-Barsky in doubles rather than __line_clip, since the floats it is given can be
+ * large enough for the products in there to overflow.
+ */
+internal b32
+__line_guard(v2* from, v2* to)
+{
 
+	if (fabsf(from->x) <= NX_LINE_GUARD_BAND && fabsf(from->y) <= NX_LINE_GUARD_BAND &&
+		fabsf(to->x) <= NX_LINE_GUARD_BAND && fabsf(to->y) <= NX_LINE_GUARD_BAND) return true;
+	if (!(fabsf(from->x) <= FLT_MAX && fabsf(from->y) <= FLT_MAX &&
+		fabsf(to->x) <= FLT_MAX && fabsf(to->y) <= FLT_MAX)) return false;
+
+	r64 _fromX = from->x, _fromY = from->y;
+	r64 _deltaX = (r64)to->x - _fromX, _deltaY = (r64)to->y - _fromY;
+	r64 _band = NX_LINE_GUARD_BAND;
+	r64 _p[4] = { -_deltaX, _deltaX, -_deltaY, _deltaY };
+	r64 _q[4] = { _fromX + _band, _band - _fromX, _fromY + _band, _band - _fromY };
+	r64 _enter = 0.0, _exit = 1.0;
+	for (u32 _edge = 0; _edge < 4; ++_edge)
+	{
+		if (_p[_edge] == 0.0)
+		{
+			if (_q[_edge] < 0.0) return false;
+			continue;
+		}
+		r64 _t = _q[_edge] / _p[_edge];
+		if (_p[_edge] < 0.0) { if (_t > _enter) _enter = _t; }
+		else if (_t < _exit) _exit = _t;
+	}
+	if (_enter > _exit) return false;
+
+	*to = { (r32)(_fromX + _exit*_deltaX), (r32)(_fromY + _exit*_deltaY) };
+	*from = { (r32)(_fromX + _enter*_deltaX), (r32)(_fromY + _enter*_deltaY) };
+	return true;
+
+}
 
 /**
- * Draws a rectangle of a given size and color to a bitmap.
- * 
- * This improved version:
- * Utilizes the simpler code of the other draw functions and no longer uses the
- * renderer struct as a dependancy (because these draw functions operate on bitmaps,
- * we don't really care *what* bitmap it is we are drawing to, only that it is a
- * properly formatted bitmap).
+ * The clip box for a line in point coordinates, a pixel wider than the clip rect on every side
+ * so that rounding can't cut off a step which still lands inside. Steps are checked against the
+ * clip rect itself as they are drawn.
  */
-internal void
-DrawRect(dibitmap* bitmap, v2i rectPos, v2i rectDims, u32 color)
+inline void
+__line_clip_box(rect2i clipRect, v2* clipMin, v2* clipMax)
 {
+	*clipMin = { (r32)clipRect.min.x - 1.5f, (r32)clipRect.min.y - 1.5f };
+	*clipMax = { (r32)clipRect.max.x + 0.5f, (r32)clipRect.max.y + 0.5f };
+}
 
-	// Check within bounds for drawing, exit if it isn't.
-	if (!IsWithinBitmapBounds(bitmap->dims.width, bitmap->dims.height,
-		rectPos.x, rectPos.y, rectDims.width, rectDims.height)) return;
+inline b32
+__line_in_rect(rect2i clipRect, i64 x, i64 y)
+{
+	return (x >= clipRect.min.x && x < clipRect.max.x && y >= clipRect.min.y && y < clipRect.max.y);
+}
+
+// Returns the number of pixels written.
+internal u64
+__line_draw_hard(dibitmap* bitmap, line_segment* line, rect2i clipRect)
+{
+
+	v2 _from = line->from, _to = line->to;
+	if (!__line_guard(&_from, &_to)) return 0;
+
+	v2i _start = { (i32)floorf(_from.x + 0.5f), (i32)floorf(_from.y + 0.5f) };
+	v2i _end = { (i32)floorf(_to.x + 0.5f), (i32)floorf(_to.y + 0.5f) };
+	u32* _pixels = (u32*)bitmap->buffer;
 
-	// Boundary adjustments on the x-boundary.
-	if (rectPos.x < 0)
+	v2 _clipMin, _clipMax;
+	__line_clip_box(clipRect, &_clipMin, &_clipMax);
+	v2 _clipFrom = { (r32)_start.x, (r32)_start.y };
+	v2 _clipTo = { (r32)_end.x, (r32)_end.y };
+	if (!__line_clip(&_clipFrom, &_clipTo, _clipMin, _clipMax)) return 0;
+
+	i64 _deltaX = (i64)_end.x - _start.x, _deltaY = (i64)_end.y - _start.y;
+	i64 _adx = (_deltaX < 0 ? -_deltaX : _deltaX), _ady = (_deltaY < 0 ? -_deltaY : _deltaY);
+	if (_adx == 0 && _ady == 0)
 	{
-		rectDims.width -= absolute_i32(rectPos.x);
-		rectPos.x = 0;
+		if (!__line_in_rect(clipRect, _start.x, _start.y)) return 0;
+		_pixels[_start.y*bitmap->pitch + _start.x] = line->color;
+		return 1;
 	}
-	else if (rectPos.x+rectDims.width > bitmap->dims.width)
+
+	// Step along the major axis, the minor one advances whenever the error term rolls over.
+	b32 _xMajor = (_adx >= _ady);
+	i64 _major = (_xMajor ? _adx : _ady), _minor = (_xMajor ? _ady : _adx);
+	v2i _majorStep = (_xMajor ? v2i{ (_deltaX > 0 ? 1 : -1), 0 } : v2i{ 0, (_deltaY > 0 ? 1 : -1) });
+	v2i _minorStep = (_xMajor ? v2i{ 0, (_deltaY > 0 ? 1 : (_deltaY < 0 ? -1 : 0)) } :
+		v2i{ (_deltaX > 0 ? 1 : (_deltaX < 0 ? -1 : 0)), 0 });
+
+	// The steps the clipped piece covers, with one to spare either side.
+	r32 _fromStep = (_xMajor ? fabsf(_clipFrom.x - (r32)_start.x) : fabsf(_clipFrom.y - (r32)_start.y));
+	r32 _toStep = (_xMajor ? fabsf(_clipTo.x - (r32)_start.x) : fabsf(_clipTo.y - (r32)_start.y));
+	i64 _firstStep = (i64)floorf(_fromStep < _toStep ? _fromStep : _toStep) - 1;
+	i64 _lastStep = (i64)ceilf(_fromStep < _toStep ? _toStep : _fromStep) + 1;
+	if (_firstStep < 0) _firstStep = 0;
+	if (_lastStep > _major) _lastStep = _major;
+
+	// Where Bresenham would be at the first step, minor = round(step * minor / major).
+	i64 _twoMajor = 2*_major, _twoMinor = 2*_minor;
+	i64 _error = 2*_firstStep*_minor + _major;
+	i64 _minorOffset = _error / _twoMajor;
+	_error %= _twoMajor;
+
+	u64 _written = 0;
+	for (i64 _step = _firstStep; _step <= _lastStep; ++_step)
 	{
-		rectDims.width -= ((rectPos.x+rectDims.width) - bitmap->dims.width);
+		i64 _x = _start.x + _majorStep.x*_step + _minorStep.x*_minorOffset;
+		i64 _y = _start.y + _majorStep.y*_step + _minorStep.y*_minorOffset;
+		if (__line_in_rect(clipRect, _x, _y))
+		{
+			_pixels[_y*bitmap->pitch + _x] = line->color;
+			_written++;
+		}
+
+		_error += _twoMinor;
+		if (_error >= _twoMajor)
+		{
+			_error -= _twoMajor;
+			_minorOffset++;
+		}
 	}
+	return _written;
+
+}
+
+// Blends the color over a pixel, scaled by its coverage of it.
+inline u64
+__line_plot_smooth(dibitmap* bitmap, rect2i clipRect, i32 x, i32 y, u32 color, r32 coverage)
+{
+	u32 _coverage = (u32)(coverage * 255.0f + 0.5f);
+	if (_coverage == 0 || !__line_in_rect(clipRect, x, y)) return 0;
 
-	// Boundary adjustments on the y-boundary.
-	if (rectPos.y < 0)
+	u32 _scaled = 0;
+	for (u32 _shift = 0; _shift < 32; _shift += 8)
+		_scaled |= __blend_div255(((color >> _shift) & 0xFF) * _coverage) << _shift;
+
+	u32* _pixel = (u32*)bitmap->buffer + y*bitmap->pitch + x;
+	*_pixel = __blend_pixel(*_pixel, _scaled, BLEND_PREMULTIPLIED, 0);
+	return 1;
+}
+
+// Returns the number of pixels blended.
+internal u64
+__line_draw_smooth(dibitmap* bitmap, line_segment* line, rect2i clipRect)
+{
+
+	// Work along x, with y as the minor axis, swapping the two for steep lines.
+	v2 _from = line->from, _to = line->to;
+	if (!__line_guard(&_from, &_to)) return 0;
+	b32 _steep = fabsf(_to.y - _from.y) > fabsf(_to.x - _from.x);
+	if (_steep)
 	{
-		rectDims.height -= absolute_i32(rectPos.y);
-		rectPos.y = 0;
+		_from = { _from.y, _from.x };
+		_to = { _to.y, _to.x };
 	}
-	else if (rectPos.y+rectDims.height > bitmap->dims.height)
+	if (_from.x > _to.x)
 	{
-		rectDims.height -= ((rectPos.y+rectDims.height) - bitmap->dims.height);
+		v2 _swap = _from;
+		_from = _to;
+		_to = _swap;
 	}
 
-	// Drawing to the bitmap.
-	u32* offsetStart = (u32*)bitmap->buffer + (bitmap->dims.width*rectPos.y) + rectPos.x;
-	for (i32 Row = 0; Row < rectDims.height; ++Row)
+	v2 _clipMin, _clipMax;
+	__line_clip_box(clipRect, &_clipMin, &_clipMax);
+	if (_steep)
 	{
-		u32* Pitch = offsetStart + (Row*bitmap->dims.width);
-		for (i32 Col = 0; Col < rectDims.width; ++Col)
+		_clipMin = { _clipMin.y, _clipMin.x };
+		_clipMax = { _clipMax.y, _clipMax.x };
+	}
+	v2 _clipFrom = _from, _clipTo = _to;
+	if (!__line_clip(&_clipFrom, &_clipTo, _clipMin, _clipMax)) return 0;
+
+	r32 _dx = _to.x - _from.x;
+	r32 _gradient = (_dx == 0.0f ? 0.0f : (_to.y - _from.y) / _dx);
+	i32 _startX = (i32)floorf(_from.x + 0.5f);
+	i32 _endX = (i32)floorf(_to.x + 0.5f);
+	i32 _firstX = (i32)floorf(_clipFrom.x) - 1;
+	i32 _lastX = (i32)ceilf(_clipTo.x) + 1;
+	if (_firstX < _startX) _firstX = _startX;
+	if (_lastX > _endX) _lastX = _endX;
+
+	u64 _written = 0;
+	for (i32 _x = _firstX; _x <= _lastX; ++_x)
+	{
+		// The end columns are only partly covered by the line, by how far past them it reaches.
+		r32 _coverage = 1.0f;
+		if (_startX == _endX) _coverage = _dx;
+		else if (_x == _startX) _coverage = 1.0f - ((_from.x + 0.5f) - floorf(_from.x + 0.5f));
+		else if (_x == _endX) _coverage = (_to.x + 0.5f) - floorf(_to.x + 0.5f);
+
+		r32 _y = _from.y + _gradient * ((r32)_x - _from.x);
+		r32 _yFloor = floorf(_y);
+		r32 _fraction = _y - _yFloor;
+		i32 _pixelY = (i32)_yFloor;
+		if (_steep)
+		{
+			_written += __line_plot_smooth(bitmap, clipRect, _pixelY, _x, line->color, (1.0f - _fraction) * _coverage);
+			_written += __line_plot_smooth(bitmap, clipRect, _pixelY + 1, _x, line->color, _fraction * _coverage);
+		}
+		else
 		{
-			u32* Pixel = Pitch + Col;
-			*Pixel = color;
+			_written += __line_plot_smooth(bitmap, clipRect, _x, _pixelY, line->color, (1.0f - _fraction) * _coverage);
+			_written += __line_plot_smooth(bitmap, clipRect, _x, _pixelY + 1, line->color, _fraction * _coverage);
 		}
 	}
+	return _written;
 
 }
 
 /**
- * Draws a bitmap to the screen at a given position. The bitmapWidth and bitmapHeight *must*
- * be the exact size of the bitmap as it is required for proper pitch calculations.
+ * Draws a batch of lines, clipped to clipRect, which must lie within the bitmap. Smooth lines are
+ * anti-aliased. Returns the number of pixels written.
  */
-internal void
-DrawBitmap(dibitmap* dest, dibitmap* source, v2i position)
+internal u64
+DrawLinesClipped(dibitmap* bitmap, line_segment* lines, u32 lineCount, b32 smooth, rect2i clipRect)
 {
 
-	// Check within bounds, exit if it isn't.
-	if (!IsWithinBitmapBounds(dest->dims.width, dest->dims.height,
-		position.x, position.y, source->dims.width, source->dims.height)) return;
-
-
-	// We need to preserve parameter values.
-	u32* sourceBitmap = (u32*)source->buffer;
-	i32 sourceWidth = source->dims.width;
-	i32 sourceHeight = source->dims.height;
-	
-	// If we are slightly out of bounds, we need to clip the source and offset the source bitmap.
-	if (position.x < 0)
+	NX_PROFILE_SCOPE("DrawLines");
+	u64 _written = 0;
+	if (smooth)
 	{
-		i32 offsetX = absolute_i32(position.x);
-		sourceWidth -= offsetX;
-		sourceBitmap += offsetX; // Offsetting forward
-		position.x = 0; // Placing back in bounds
+		for (u32 _lineIndex = 0; _lineIndex < lineCount; ++_lineIndex)
+			_written += __line_draw_smooth(bitmap, &lines[_lineIndex], clipRect);
 	}
-
-	// We do not need to offset the source bitmap, but we do need to shrink the width to fit
-	// against the right edge.
-	else if (position.x+sourceWidth >= dest->dims.width)
+	else
 	{
-		sourceWidth -= ((position.x+sourceWidth) - dest->dims.width);
+		for (u32 _lineIndex = 0; _lineIndex < lineCount; ++_lineIndex)
+			_written += __line_draw_hard(bitmap, &lines[_lineIndex], clipRect);
 	}
+	return _written;
 
-	// Applying what we did to the x-coordinates with they y-coordinates above, except now we need
-	// to jump down rows.
-	if (position.y < 0)
+}
+
+/**
+ * Determines if one bitmap exists within the boundary of another bitmap with the origin
+ * placed at the left-lower corner.
+ */
+inline b32
+IsWithinBitmapBounds(i32 parentWidth, i32 parentHeight, i32 x, i32 y, i32 subWidth, i32 subHeight)
+{
+	b32 _within_bounds = true;
+
+	if (x+subWidth < 0) _within_bounds = false;
+	if (x >= parentWidth) _within_bounds = false;
+	if (y+subHeight < 0) _within_bounds = false;
+	if (y >= parentHeight) _within_bounds = false;
+
+	return _within_bounds;
+}
+
+
+
+/**
+ * Returns the rectangle covering the whole of a bitmap, which is what the draw functions clip
+ * against unless they are given something smaller.
+ */
+inline rect2i
+GetBitmapRect(dibitmap* bitmap)
+{
+	return CreateRect({0,0}, bitmap->dims);
+}
+
+/**
+ * Draws a rectangle of a given size and color to a bitmap, clipped to clipRect. The clip rect
+ * must lie within the bitmap.
+ */
+internal void
+DrawRectClipped(dibitmap* bitmap, v2i rectPos, v2i rectDims, u32 color, rect2i clipRect)
+{
+
+	NX_PROFILE_SCOPE("DrawRect");
+
+	// Clip the rect, exit if there is nothing left to draw.
+	rect2i drawRect = IntersectRect(CreateRect(rectPos, rectDims), clipRect);
+	if (IsRectEmpty(drawRect)) return;
+	rectPos = drawRect.min;
+	rectDims = GetRectDims(drawRect);
+
+	/**
+	 * Drawing to the bitmap. A rect which spans the full width of the layer is one contiguous
+	 * run of pixels, so it is filled as a single span instead of row by row. When the rect covers
+	 * most of a layer larger than the streaming threshold, we stream it past the cache.
+	 */
+	u64 RectArea = (u64)rectDims.width * (u64)rectDims.height;
+	u64 LayerArea = (u64)bitmap->dims.width * (u64)bitmap->dims.height;
+	b32 Stream = (RectArea*sizeof(u32) >= NX_MEMCOPY_STREAMING_THRESHOLD) && (RectArea*4 >= LayerArea*3);
+
+	u32* offsetStart = (u32*)bitmap->buffer + (bitmap->pitch*rectPos.y) + rectPos.x;
+	if (rectDims.width == bitmap->pitch)
 	{
-		i32 offsetY = absolute_i32(position.y);
-		sourceHeight -= offsetY;
-		sourceBitmap += (source->dims.width * offsetY); // Offsetting down y-rows
-		position.y = 0; // Placing back in bounds
+		FillSpan(offsetStart, RectArea, color, Stream);
+		return;
 	}
 
-	// Shrink to fit at y.
-	else if (position.y+sourceHeight >= dest->dims.height)
+	for (i32 Row = 0; Row < rectDims.height; ++Row)
 	{
-		sourceHeight -= ((position.y+sourceHeight) - dest->dims.height);
+		u32* Pitch = offsetStart + (Row*bitmap->pitch);
+		FillSpan(Pitch, (u64)rectDims.width, color, Stream);
 	}
 
-	// Now we can copy to the buffer.
-	u32* destBitmap = (u32*)dest->buffer + ((dest->dims.width*position.y) + position.x);
-	for (i32 row = 0; row < sourceHeight; ++row)
+}
+
+/**
+ * Draws a rectangle of a given size and color to a bitmap.
+ * 
+ * This improved version:
+ * Utilizes the simpler code of the other draw functions and no longer uses the
+ * renderer struct as a dependancy (because these draw functions operate on bitmaps,
+ * we don't really care *what* bitmap it is we are drawing to, only that it is a
+ * properly formatted bitmap).
+ */
+internal void
+DrawRect(dibitmap* bitmap, v2i rectPos, v2i rectDims, u32 color)
+{
+	DrawRectClipped(bitmap, rectPos, rectDims, color, GetBitmapRect(bitmap));
+}
+
+/**
+ * Draws a bitmap at a given position, clipped to clipRect. The clip rect must lie within the
+ * destination bitmap.
+ *
+ * The blend mode determines how the source is combined with what is already drawn, see
+ * blend_mode. The color key is only used with BLEND_COLORKEY.
+ */
+internal void
+DrawBitmapClipped(dibitmap* dest, dibitmap* source, v2i position, blend_mode mode, u32 colorKey,
+	rect2i clipRect)
+{
+
+	NX_PROFILE_SCOPE("DrawBitmap");
+
+	// Clip the destination area, exit if there is nothing left to draw.
+	rect2i drawRect = IntersectRect(CreateRect(position, source->dims), clipRect);
+	if (IsRectEmpty(drawRect)) return;
+	v2i drawDims = GetRectDims(drawRect);
+
+	// Whatever was clipped off the top-left corner is skipped in the source.
+	u32* sourceBitmap = (u32*)source->buffer + (source->pitch * (drawRect.min.y - position.y)) +
+		(drawRect.min.x - position.x);
+
+	// Now we can blend into the buffer, a row at a time.
+	u32* destBitmap = (u32*)dest->buffer + ((dest->pitch*drawRect.min.y) + drawRect.min.x);
+	for (i32 row = 0; row < drawDims.height; ++row)
 	{
-		u32* destPitch = destBitmap + (row*dest->dims.width);
-		u32* sourcePitch = sourceBitmap + (row*source->dims.width);
-		for (i32 col = 0; col < sourceWidth; ++col)
-		{
-			*destPitch++ = *sourcePitch++;
-		}
+		u32* destPitch = destBitmap + (row*dest->pitch);
+		u32* sourcePitch = sourceBitmap + (row*source->pitch);
+		BlendSpan(destPitch, sourcePitch, (u64)drawDims.width, mode, colorKey);
 	}
 
 }
+
+/**
+ * Draws a bitmap to the screen at a given position. The bitmapWidth and bitmapHeight *must*
+ * be the exact size of the bitmap as it is required for proper pitch calculations.
+ *
+ * The blend mode determines how the source is combined with what is already drawn, see
+ * blend_mode. The color key is only used with BLEND_COLORKEY.
+ */
+internal void
+DrawBitmap(dibitmap* dest, dibitmap* source, v2i position, blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	DrawBitmapClipped(dest, source, position, mode, colorKey, GetBitmapRect(dest));
+}
+
+/**
+ * Draws a batch of lines, see line_segment. Drawing many lines at once costs one call, rather than
+ * one per line.
+ */
+internal u64
+DrawLines(dibitmap* bitmap, line_segment* lines, u32 lineCount, b32 smooth = false)
+{
+	return DrawLinesClipped(bitmap, lines, lineCount, smooth, GetBitmapRect(bitmap));
+}
+
+internal void
+DrawLine(dibitmap* bitmap, v2 from, v2 to, u32 color)
+{
+	line_segment _line = { from, to, color };
+	DrawLinesClipped(bitmap, &_line, 1, false, GetBitmapRect(bitmap));
+}
+
+internal void
+DrawLineSmooth(dibitmap* bitmap, v2 from, v2 to, u32 color)
+{
+	line_segment _line = { from, to, color };
+	DrawLinesClipped(bitmap, &_line, 1, true, GetBitmapRect(bitmap));
+}
+
 #if 0
 /**
  * Draws a texture to the screen.
@@ -284,14 +629,21 @@ DrawTexture(dibitmap* bitmap, texture* tex, i32 x, i32 y)
 }
 #endif
 
+/**
+ * The pixel buffer of a bitmap layer is aligned to this many bytes so that the span kernels
+ * can use aligned (and streaming) stores across the whole row.
+ */
+#define BITMAP_PIXEL_ALIGNMENT 64
+
 /**
  * Calculates the size of a bitmap based on the given dimensions and bytes per pixel. Typically,
- * bytes-per-pixel is sizeof(unsigned int) or sizeof(u32).
+ * bytes-per-pixel is sizeof(unsigned int) or sizeof(u32). This includes the slack needed to
+ * align the pixel buffer.
  */
 inline size_t
 GetBitmapSize(u32 bytesPerPixel, v2i dims)
 {
-	size_t _bitmap_size = (bytesPerPixel * dims.x * dims.y) + sizeof(bitmap_header);
+	size_t _bitmap_size = (bytesPerPixel * dims.x * dims.y) + sizeof(bitmap_header) + BITMAP_PIXEL_ALIGNMENT;
 	return _bitmap_size;
 }
 
@@ -305,8 +657,16 @@ internal dibitmap
 CreateBitmapLayer(void* buffer, u32 bufferSize, v2i dims)
 {
 
+	// The header sits directly in front of the pixels, so we push both forward until the pixels
+	// land on BITMAP_PIXEL_ALIGNMENT. GetBitmapSize() accounts for the slack.
+	uintptr_t pixelAddress = (uintptr_t)buffer + sizeof(bitmap_header);
+	u32 alignmentOffset = (u32)((BITMAP_PIXEL_ALIGNMENT - (pixelAddress & (BITMAP_PIXEL_ALIGNMENT-1))) & (BITMAP_PIXEL_ALIGNMENT-1));
+	buffer = (u8*)buffer + alignmentOffset;
+	bufferSize -= alignmentOffset;
+
 	dibitmap bitmap = {};
 	bitmap.dims = dims;
+	bitmap.pitch = dims.width;
 	bitmap.buffer = (u8*)buffer + sizeof(bitmap_header); // Where the actual pixel data is stored.
 	bitmap.header = (bitmap_header*)buffer; // Cast the head of the bitmap buffer to bitmap_header.
 
@@ -0,0 +1,175 @@
+#ifndef NINETAILSX_SPANS_H
+#define NINETAILSX_SPANS_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/simd.h>
+
+/**
+ * FillSpan
+ * 			Fills a run of 32-bit pixels with a single color. This is the inner loop of every
+ * 			rectangle fill, so like nx_memset it has a kernel per instruction set level which is
+ * 			selected on first use.
+ *
+ * NOTE:
+ * 			Pixels are written one at a time until the destination reaches the vector width, then
+ * 			the body is written with full-width stores. When Stream is set, the body uses
+ * 			non-temporal stores instead; only do this when the span is far larger than the cache
+ * 			and won't be read back right away. A destination which isn't 4-byte aligned can never
+ * 			become vector aligned, so it is filled with unaligned stores and never streamed.
+ */
+typedef void fnptr_fill_span(u32* Dest, u64 PixelCount, u32 Color, b32 Stream);
+
+internal void
+__fill_span_scalar(u32* Dest, u64 PixelCount, u32 Color, b32 Stream)
+{
+	for (u64 pIndex = 0; pIndex < PixelCount; ++pIndex)
+		Dest[pIndex] = Color;
+}
+
+// Fills pixels until Dest is aligned to Alignment bytes, returns false if it never can be.
+inline b32
+__fill_span_head(u32** Dest, u64* PixelCount, u32 Color, uintptr_t Alignment)
+{
+	if (((uintptr_t)*Dest & 3) != 0) return false;
+	while (((uintptr_t)*Dest & (Alignment-1)) != 0 && *PixelCount > 0)
+	{
+		*(*Dest)++ = Color;
+		--(*PixelCount);
+	}
+	return true;
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+NX_TARGET_SSE2 internal void
+__fill_span_sse2(u32* Dest, u64 PixelCount, u32 Color, b32 Stream)
+{
+	u32* _dest = Dest;
+	__m128i _color = _mm_set1_epi32((i32)Color);
+	b32 Aligned = __fill_span_head(&_dest, &PixelCount, Color, 16);
+
+	if (Stream && Aligned)
+	{
+		for (; PixelCount >= 16; PixelCount -= 16, _dest += 16)
+		{
+			_mm_stream_si128((__m128i*)_dest + 0, _color);
+			_mm_stream_si128((__m128i*)_dest + 1, _color);
+			_mm_stream_si128((__m128i*)_dest + 2, _color);
+			_mm_stream_si128((__m128i*)_dest + 3, _color);
+		}
+		_mm_sfence();
+	}
+
+	for (; PixelCount >= 16; PixelCount -= 16, _dest += 16)
+	{
+		_mm_storeu_si128((__m128i*)_dest + 0, _color);
+		_mm_storeu_si128((__m128i*)_dest + 1, _color);
+		_mm_storeu_si128((__m128i*)_dest + 2, _color);
+		_mm_storeu_si128((__m128i*)_dest + 3, _color);
+	}
+	for (; PixelCount >= 4; PixelCount -= 4, _dest += 4)
+		_mm_storeu_si128((__m128i*)_dest, _color);
+
+	__fill_span_scalar(_dest, PixelCount, Color, false);
+}
+
+NX_TARGET_AVX2 internal void
+__fill_span_avx2(u32* Dest, u64 PixelCount, u32 Color, b32 Stream)
+{
+	u32* _dest = Dest;
+	__m256i _color = _mm256_set1_epi32((i32)Color);
+	b32 Aligned = __fill_span_head(&_dest, &PixelCount, Color, 32);
+
+	if (Stream && Aligned)
+	{
+		for (; PixelCount >= 32; PixelCount -= 32, _dest += 32)
+		{
+			_mm256_stream_si256((__m256i*)_dest + 0, _color);
+			_mm256_stream_si256((__m256i*)_dest + 1, _color);
+			_mm256_stream_si256((__m256i*)_dest + 2, _color);
+			_mm256_stream_si256((__m256i*)_dest + 3, _color);
+		}
+		_mm_sfence();
+	}
+
+	for (; PixelCount >= 32; PixelCount -= 32, _dest += 32)
+	{
+		_mm256_storeu_si256((__m256i*)_dest + 0, _color);
+		_mm256_storeu_si256((__m256i*)_dest + 1, _color);
+		_mm256_storeu_si256((__m256i*)_dest + 2, _color);
+		_mm256_storeu_si256((__m256i*)_dest + 3, _color);
+	}
+	for (; PixelCount >= 8; PixelCount -= 8, _dest += 8)
+		_mm256_storeu_si256((__m256i*)_dest, _color);
+
+	// The last 0-7 pixels go out in one masked store.
+	if (PixelCount > 0)
+	{
+		__m256i TailMask = _mm256_cmpgt_epi32(_mm256_set1_epi32((i32)PixelCount),
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		_mm256_maskstore_epi32((int*)_dest, TailMask, _color);
+	}
+}
+
+NX_TARGET_AVX512 internal void
+__fill_span_avx512(u32* Dest, u64 PixelCount, u32 Color, b32 Stream)
+{
+	u32* _dest = Dest;
+	__m512i _color = _mm512_set1_epi32((i32)Color);
+	b32 Aligned = __fill_span_head(&_dest, &PixelCount, Color, 64);
+
+	if (Stream && Aligned)
+	{
+		for (; PixelCount >= 32; PixelCount -= 32, _dest += 32)
+		{
+			_mm512_stream_si512((__m512i*)_dest + 0, _color);
+			_mm512_stream_si512((__m512i*)_dest + 1, _color);
+		}
+		_mm_sfence();
+	}
+
+	for (; PixelCount >= 32; PixelCount -= 32, _dest += 32)
+	{
+		_mm512_storeu_si512((__m512i*)_dest + 0, _color);
+		_mm512_storeu_si512((__m512i*)_dest + 1, _color);
+	}
+	for (; PixelCount >= 16; PixelCount -= 16, _dest += 16)
+		_mm512_storeu_si512((__m512i*)_dest, _color);
+
+	if (PixelCount > 0)
+		_mm512_mask_storeu_epi32(_dest, (__mmask16)((1u << PixelCount) - 1), _color);
+}
+#endif
+
+global fnptr_fill_span* __fill_span_kernel;
+
+/**
+ * Selects the span kernels for the instruction set level reported by GetSIMDLevel(). This
+ * happens automatically on first use, it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectSpanKernels()
+{
+	__fill_span_kernel = &__fill_span_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512: __fill_span_kernel = &__fill_span_avx512; break;
+		case SIMD_LEVEL_AVX2: __fill_span_kernel = &__fill_span_avx2; break;
+		case SIMD_LEVEL_SSE2: __fill_span_kernel = &__fill_span_sse2; break;
+		default: break;
+	}
+#endif
+}
+
+/**
+ * Fills PixelCount pixels starting at Dest with Color.
+ */
+inline void
+FillSpan(u32* Dest, u64 PixelCount, u32 Color, b32 Stream = false)
+{
+	if (__fill_span_kernel == NULL) SelectSpanKernels();
+	__fill_span_kernel(Dest, PixelCount, Color, Stream);
+}
+
+#endif
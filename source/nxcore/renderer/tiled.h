@@ -0,0 +1,652 @@
+#ifndef NINETAILSX_TILED_H
+#define NINETAILSX_TILED_H
+#include <nxcore/helpers.h>
+#include <nxcore/math.h>
+#include <nxcore/memory.h>
+#include <nxcore/jobs.h>
+#include <nxcore/renderer/software.h>
+#include <nxcore/renderer/triangles.h>
+
+/**
+ * The tiled renderer.
+ *
+ * Draw calls are recorded rather than drawn. On flush, the target bitmap is split into
+ * RENDER_TILE_SIZE tiles, every recorded item is binned into the tiles it touches, and the
+ * tiles are handed to the job system. Each tile replays its bin in submission order clipped to
+ * the tile, so no two threads ever write the same pixel and every pixel sees the same draws in
+ * the same order as it would drawing directly. The output is identical to the serial path.
+ *
+ * NOTE:
+ * 			A 64x64 tile of 32-bit pixels is 16KB, which sits comfortably in L1/L2 for all of the
+ * 			draws that touch it.
+ *
+ * NOTE:			Dirty tiles
+ * 			Between BeginTiledFrame and EndTiledFrame, every tile hashes the items drawn into it.
+ * 			A tile whose first item covers it opaquely doesn't depend on what was there before, so
+ * 			if its hash matches the last frame, its pixels would come out the same and it isn't
+ * 			rasterized again. Tiles which changed are merged into a list of dirty rects for the
+ * 			platform to present. Source bitmaps are hashed by address, so a bitmap whose pixels
+ * 			change in place needs MarkTiledRendererDirty().
+ *
+ * NOTE:			Stats
+ * 			The renderer counts what each frame cost in frameStats. Workers count what they rasterize
+ * 			on a cache line of their own, indexed by worker, and EndTiledFrame adds them up. Pixels
+ * 			are only counted where they were written, so skipped tiles cost nothing, while submitted
+ * 			is everything the frame's items covered after clipping, skipped or not. Line and
+ * 			triangle batches only count the pixels they write, their bounds are partly empty.
+ */
+#define RENDER_TILE_SIZE 64
+
+enum render_item_type
+{
+	RENDER_ITEM_RECT,
+	RENDER_ITEM_BITMAP,
+	RENDER_ITEM_LINES,
+	RENDER_ITEM_TRIANGLES,
+};
+
+typedef struct render_item
+{
+	render_item_type type;
+	rect2i bounds; // The area of the target the item covers, already clipped to the target.
+	v2i position;
+	v2i dims;
+	u32 color;
+	dibitmap source;
+	blend_mode mode;
+	u32 colorKey;
+
+	// A batch of lines, which every tile in the bounds draws clipped to itself.
+	line_segment* lines;
+	u32 lineCount;
+	b32 smooth;
+
+	// A batch of triangles, textured with source when it has a buffer, otherwise filled with color.
+	triangle_vertex* vertices;
+	u32 triangleCount;
+
+	u64 contentHash; // Batches are hashed by what they draw, once, rather than by address in every tile.
+} render_item;
+
+typedef struct alignas(64) tiled_stats
+{
+	u64 rectPixels; // Written by rects and clears.
+	u64 bitmapPixels; // Written by bitmaps.
+	u64 linePixels; // Written by lines.
+	u64 trianglePixels; // Written by triangles.
+	u64 submittedPixels;
+	u64 clippedPixels; // Covered by items, but outside the target.
+	u64 memcopyBytes;
+	u32 blits; // Bitmap draws, one per tile a bitmap was drawn into.
+	u32 rasterizedTiles;
+} tiled_stats;
+
+typedef struct render_tile_job
+{
+	struct tiled_renderer* renderer;
+	u32 tileIndex;
+} render_tile_job;
+
+typedef struct tiled_renderer
+{
+	dibitmap* target;
+	job_system* jobs;
+	v2i tileCount;
+
+	render_item* items;
+	u32 itemCount;
+	u32 itemCapacity;
+
+	// The bins, binIndices[binOffsets[tile]...binOffsets[tile+1]) are the items in a tile.
+	u32* binOffsets;
+	u32* binIndices;
+	u32 binIndexCount; // Total tile coverage of the recorded items.
+	u32 binIndexCapacity;
+
+	render_tile_job* tileJobs;
+
+	// Per tile hashes of this frame and the last, zero when the tile can't be skipped.
+	u64* tileSignatures;
+	u64* previousSignatures;
+	b32* tileSelfContained; // The first item this frame covers the whole tile opaquely.
+	b32 frameSplit; // The frame was flushed before EndTiledFrame, so it can't skip tiles.
+	b32 forceRedraw;
+
+	// The regions which changed in the last frame, in bitmap coordinates.
+	rect2i* dirtyRects;
+	u32 dirtyRectCount;
+
+	// What the last frame cost, and the counts being gathered for this one.
+	tiled_stats frameStats;
+	tiled_stats* workerStats;
+} tiled_renderer;
+
+/**
+ * Creates a tiled renderer which draws into target. The item capacity is the number of draws
+ * which can be recorded before the renderer has to flush on its own.
+ */
+internal tiled_renderer
+CreateTiledRenderer(memarena_t* arena, dibitmap* target, job_system* jobs, u32 itemCapacity)
+{
+
+	tiled_renderer _renderer = {};
+	_renderer.target = target;
+	_renderer.jobs = jobs;
+	_renderer.tileCount = { (target->dims.width + RENDER_TILE_SIZE-1) / RENDER_TILE_SIZE,
+		(target->dims.height + RENDER_TILE_SIZE-1) / RENDER_TILE_SIZE };
+
+	// The u32 arrays leave the arena on any four bytes, the 64-bit ones are aligned for themselves.
+	u32 tileTotal = (u32)(_renderer.tileCount.x * _renderer.tileCount.y);
+	_renderer.itemCapacity = itemCapacity;
+	_renderer.items = PushArrayAligned(arena, render_item, itemCapacity, alignof(render_item));
+	_renderer.binOffsets = PushArray(arena, u32, tileTotal+1);
+	_renderer.binIndexCapacity = itemCapacity * 4 + tileTotal * 4;
+	_renderer.binIndices = PushArray(arena, u32, _renderer.binIndexCapacity);
+	_renderer.tileJobs = PushArrayAligned(arena, render_tile_job, tileTotal, alignof(render_tile_job));
+	_renderer.tileSignatures = PushArrayAligned(arena, u64, tileTotal, alignof(u64));
+	_renderer.previousSignatures = PushArrayAligned(arena, u64, tileTotal, alignof(u64));
+	_renderer.tileSelfContained = PushArray(arena, b32, tileTotal);
+	_renderer.dirtyRects = PushArray(arena, rect2i, tileTotal);
+	_renderer.workerStats = PushArrayAligned(arena, tiled_stats, jobs->WorkerCount, 64);
+	_renderer.forceRedraw = true;
+
+	return _renderer;
+
+}
+
+// The range of tiles a rect touches, as a rect of tile coordinates.
+inline rect2i
+__tiled_get_tile_span(rect2i bounds)
+{
+	rect2i _span;
+	_span.min = { bounds.min.x / RENDER_TILE_SIZE, bounds.min.y / RENDER_TILE_SIZE };
+	_span.max = { (bounds.max.x + RENDER_TILE_SIZE-1) / RENDER_TILE_SIZE,
+		(bounds.max.y + RENDER_TILE_SIZE-1) / RENDER_TILE_SIZE };
+	return _span;
+}
+
+inline rect2i
+__tiled_get_tile_rect(tiled_renderer* renderer, u32 tileIndex)
+{
+	v2i tile = { (i32)tileIndex % renderer->tileCount.x, (i32)tileIndex / renderer->tileCount.x };
+	return IntersectRect(CreateRect(tile * RENDER_TILE_SIZE, { RENDER_TILE_SIZE, RENDER_TILE_SIZE }),
+		GetBitmapRect(renderer->target));
+}
+
+inline u64
+__tiled_hash(u64 hash, u64 value)
+{
+	hash ^= value;
+	hash *= 0x100000001B3ull;
+	return hash ^ (hash >> 29);
+}
+
+// Hashes the bits of a point, read through a union so it stays in registers.
+inline u64
+__tiled_hash_point(u64 hash, v2 point)
+{
+	union { r32 floats[2]; u32 bits[2]; } _point = { { point.x, point.y } };
+	return __tiled_hash(hash, ((u64)_point.bits[0] << 32) | _point.bits[1]);
+}
+
+// Folds an item into the signature of a tile.
+internal u64
+__tiled_hash_item(u64 hash, render_item* item)
+{
+	hash = __tiled_hash(hash, ((u64)item->type << 32) | item->mode);
+	hash = __tiled_hash(hash, ((u64)(u32)item->position.x << 32) | (u32)item->position.y);
+	hash = __tiled_hash(hash, ((u64)(u32)item->dims.width << 32) | (u32)item->dims.height);
+	hash = __tiled_hash(hash, ((u64)item->color << 32) | item->colorKey);
+	hash = __tiled_hash(hash, (u64)(uintptr_t)item->source.buffer);
+	hash = __tiled_hash(hash, item->contentHash);
+	return (hash | 1); // Zero is reserved for tiles which can't be skipped.
+}
+
+// Whether an item overwrites every pixel of a tile without reading any of them.
+inline b32
+__tiled_item_covers(render_item* item, rect2i tileRect)
+{
+	if (item->type == RENDER_ITEM_LINES || item->type == RENDER_ITEM_TRIANGLES) return false;
+	if (item->type == RENDER_ITEM_BITMAP && item->mode != BLEND_OPAQUE) return false;
+	return (item->bounds.min.x <= tileRect.min.x && item->bounds.min.y <= tileRect.min.y &&
+		item->bounds.max.x >= tileRect.max.x && item->bounds.max.y >= tileRect.max.y);
+}
+
+internal void
+__tiled_rasterize_tile(void* data, u32 workerIndex)
+{
+
+	NX_PROFILE_SCOPE("RasterizeTile");
+	render_tile_job* tileJob = (render_tile_job*)data;
+	tiled_renderer* renderer = tileJob->renderer;
+	tiled_stats* stats = &renderer->workerStats[workerIndex];
+	u64 memcopyStart = GetMemcopyByteCount();
+
+	rect2i tileRect = __tiled_get_tile_rect(renderer, tileJob->tileIndex);
+
+	for (u32 binIndex = renderer->binOffsets[tileJob->tileIndex];
+		binIndex < renderer->binOffsets[tileJob->tileIndex+1]; ++binIndex)
+	{
+		render_item* item = &renderer->items[renderer->binIndices[binIndex]];
+		v2i drawDims = GetRectDims(IntersectRect(item->bounds, tileRect));
+		u64 drawArea = (u64)drawDims.width * (u64)drawDims.height;
+		switch (item->type)
+		{
+			case RENDER_ITEM_RECT:
+			{
+				DrawRectClipped(renderer->target, item->position, item->dims, item->color, tileRect);
+				stats->rectPixels += drawArea;
+			} break;
+
+			case RENDER_ITEM_BITMAP:
+			{
+				DrawBitmapClipped(renderer->target, &item->source, item->position, item->mode,
+					item->colorKey, tileRect);
+				stats->bitmapPixels += drawArea;
+				stats->blits++;
+			} break;
+
+			case RENDER_ITEM_LINES:
+			{
+				stats->linePixels += DrawLinesClipped(renderer->target, item->lines, item->lineCount,
+					item->smooth, tileRect);
+			} break;
+
+			case RENDER_ITEM_TRIANGLES:
+			{
+				stats->trianglePixels += DrawTrianglesClipped(renderer->target, item->vertices, item->triangleCount,
+					(item->source.buffer ? &item->source : NULL), item->color, item->mode, item->colorKey, tileRect);
+			} break;
+		}
+	}
+
+	stats->memcopyBytes += GetMemcopyByteCount() - memcopyStart;
+	stats->rasterizedTiles++;
+
+}
+
+/**
+ * Bins the recorded items, updates the tile signatures and rasterizes every tile which has
+ * something in it across the job system. At the end of a frame, tiles which are unchanged from
+ * the last frame are skipped.
+ */
+internal void
+__tiled_flush(tiled_renderer* renderer, b32 frameEnd)
+{
+
+	if (renderer->itemCount == 0) return;
+
+	// Count the items per tile, then turn the counts into offsets.
+	u32 tileTotal = (u32)(renderer->tileCount.x * renderer->tileCount.y);
+	nx_memset(renderer->binOffsets, sizeof(u32)*(tileTotal+1));
+	for (u32 itemIndex = 0; itemIndex < renderer->itemCount; ++itemIndex)
+	{
+		rect2i span = __tiled_get_tile_span(renderer->items[itemIndex].bounds);
+		for (i32 tileY = span.min.y; tileY < span.max.y; ++tileY)
+			for (i32 tileX = span.min.x; tileX < span.max.x; ++tileX)
+				renderer->binOffsets[tileY*renderer->tileCount.x + tileX + 1]++;
+	}
+	for (u32 tileIndex = 0; tileIndex < tileTotal; ++tileIndex)
+		renderer->binOffsets[tileIndex+1] += renderer->binOffsets[tileIndex];
+
+	// Fill the bins. Items are walked in submission order, so each bin stays in that order.
+	for (u32 itemIndex = 0; itemIndex < renderer->itemCount; ++itemIndex)
+	{
+		rect2i span = __tiled_get_tile_span(renderer->items[itemIndex].bounds);
+		for (i32 tileY = span.min.y; tileY < span.max.y; ++tileY)
+			for (i32 tileX = span.min.x; tileX < span.max.x; ++tileX)
+				renderer->binIndices[renderer->binOffsets[tileY*renderer->tileCount.x + tileX]++] = itemIndex;
+	}
+
+	// Filling moved every offset to the end of its bin, which is the start of the next one.
+	for (u32 tileIndex = tileTotal; tileIndex > 0; --tileIndex)
+		renderer->binOffsets[tileIndex] = renderer->binOffsets[tileIndex-1];
+	renderer->binOffsets[0] = 0;
+
+	for (u32 tileIndex = 0; tileIndex < tileTotal; ++tileIndex)
+	{
+		u32 binStart = renderer->binOffsets[tileIndex];
+		u32 binEnd = renderer->binOffsets[tileIndex+1];
+		if (binStart == binEnd) continue;
+
+		u64 signature = renderer->tileSignatures[tileIndex];
+		if (signature == 0)
+		{
+			render_item* firstItem = &renderer->items[renderer->binIndices[binStart]];
+			renderer->tileSelfContained[tileIndex] = __tiled_item_covers(firstItem,
+				__tiled_get_tile_rect(renderer, tileIndex));
+			signature = 0xCBF29CE484222325ull;
+		}
+		for (u32 binIndex = binStart; binIndex < binEnd; ++binIndex)
+			signature = __tiled_hash_item(signature, &renderer->items[renderer->binIndices[binIndex]]);
+		renderer->tileSignatures[tileIndex] = signature;
+
+		if (frameEnd && !renderer->frameSplit && !renderer->forceRedraw &&
+			renderer->tileSelfContained[tileIndex] && signature == renderer->previousSignatures[tileIndex])
+			continue;
+
+		renderer->tileJobs[tileIndex] = { renderer, tileIndex };
+		SubmitJob(renderer->jobs, &__tiled_rasterize_tile, &renderer->tileJobs[tileIndex]);
+	}
+	WaitForJobs(renderer->jobs);
+
+	renderer->itemCount = 0;
+	renderer->binIndexCount = 0;
+
+}
+
+/**
+ * Rasterizes everything recorded so far. This happens on its own when the renderer runs out
+ * of room, and means the rest of the frame can no longer skip unchanged tiles.
+ */
+internal void
+FlushTiledRenderer(tiled_renderer* renderer)
+{
+	if (renderer->itemCount > 0) renderer->frameSplit = true;
+	__tiled_flush(renderer, false);
+}
+
+/**
+ * Forces every tile to be rasterized and presented next frame. Use this when the contents of a
+ * source bitmap change in place, or the target was written to outside of the renderer.
+ */
+inline void
+MarkTiledRendererDirty(tiled_renderer* renderer)
+{
+	renderer->forceRedraw = true;
+}
+
+/**
+ * A tile is dirty when something was drawn into it which differs from the last frame. Tiles
+ * which nothing was drawn into keep their pixels, so they are never dirty unless forced.
+ */
+inline b32
+__tiled_is_tile_dirty(tiled_renderer* renderer, u32 tileIndex)
+{
+	u64 signature = renderer->tileSignatures[tileIndex];
+	return (renderer->forceRedraw || (signature != 0 && signature != renderer->previousSignatures[tileIndex]));
+}
+
+/**
+ * Starts recording a frame.
+ */
+internal void
+BeginTiledFrame(tiled_renderer* renderer)
+{
+	u32 tileTotal = (u32)(renderer->tileCount.x * renderer->tileCount.y);
+	nx_memset(renderer->tileSignatures, sizeof(u64)*tileTotal);
+	nx_memset(renderer->workerStats, sizeof(tiled_stats)*renderer->jobs->WorkerCount);
+	renderer->frameSplit = false;
+}
+
+/**
+ * Rasterizes the rest of the frame and works out which regions of the target changed. Dirty
+ * tiles are merged into runs along each row of tiles, and runs are merged with identical runs
+ * in the row below.
+ */
+internal void
+EndTiledFrame(tiled_renderer* renderer)
+{
+
+	__tiled_flush(renderer, true);
+
+	u32 tileTotal = (u32)(renderer->tileCount.x * renderer->tileCount.y);
+	renderer->dirtyRectCount = 0;
+	for (i32 tileY = 0; tileY < renderer->tileCount.y; ++tileY)
+	{
+		u32 rowEnd = renderer->dirtyRectCount; // Rects from the rows below, the only ones we merge with.
+		for (i32 tileX = 0; tileX < renderer->tileCount.x;)
+		{
+			if (!__tiled_is_tile_dirty(renderer, tileY*renderer->tileCount.x + tileX)) { ++tileX; continue; }
+
+			i32 runStart = tileX;
+			while (tileX < renderer->tileCount.x && __tiled_is_tile_dirty(renderer, tileY*renderer->tileCount.x + tileX))
+				++tileX;
+
+			rect2i run = IntersectRect(CreateRect({ runStart*RENDER_TILE_SIZE, tileY*RENDER_TILE_SIZE },
+				{ (tileX - runStart)*RENDER_TILE_SIZE, RENDER_TILE_SIZE }), GetBitmapRect(renderer->target));
+
+			b32 merged = false;
+			for (u32 rectIndex = 0; rectIndex < rowEnd && !merged; ++rectIndex)
+			{
+				rect2i* below = &renderer->dirtyRects[rectIndex];
+				if (below->min.x == run.min.x && below->max.x == run.max.x && below->max.y == run.min.y)
+				{
+					below->max.y = run.max.y;
+					merged = true;
+				}
+			}
+			if (!merged) renderer->dirtyRects[renderer->dirtyRectCount++] = run;
+		}
+	}
+
+	// Only self-contained tiles can be skipped next frame, so only they keep a signature.
+	for (u32 tileIndex = 0; tileIndex < tileTotal; ++tileIndex)
+	{
+		renderer->previousSignatures[tileIndex] = (renderer->tileSelfContained[tileIndex] ?
+			renderer->tileSignatures[tileIndex] : 0);
+	}
+	renderer->forceRedraw = false;
+
+	// The workers are idle until the next flush, so their counts can be gathered.
+	tiled_stats* frameStats = &renderer->frameStats;
+	tiled_stats* gathered = &renderer->workerStats[0];
+	for (u32 workerIndex = 1; workerIndex < renderer->jobs->WorkerCount; ++workerIndex)
+	{
+		tiled_stats* stats = &renderer->workerStats[workerIndex];
+		gathered->rectPixels += stats->rectPixels;
+		gathered->bitmapPixels += stats->bitmapPixels;
+		gathered->linePixels += stats->linePixels;
+		gathered->trianglePixels += stats->trianglePixels;
+		gathered->memcopyBytes += stats->memcopyBytes;
+		gathered->blits += stats->blits;
+		gathered->rasterizedTiles += stats->rasterizedTiles;
+	}
+	*frameStats = *gathered;
+
+}
+
+/**
+ * Records an item. Items which miss the target entirely are dropped here, and if the item
+ * doesn't fit, everything recorded so far is flushed first.
+ */
+internal void
+__tiled_push_item(tiled_renderer* renderer, render_item* item)
+{
+
+	v2i requestedDims = GetRectDims(item->bounds);
+	item->bounds = IntersectRect(item->bounds, GetBitmapRect(renderer->target));
+	v2i boundsDims = (IsRectEmpty(item->bounds) ? v2i{0,0} : GetRectDims(item->bounds));
+
+	// The counts for the items themselves are kept on worker zero's line, which is the caller's.
+	tiled_stats* stats = &renderer->workerStats[0];
+	u64 requestedArea = (requestedDims.width > 0 && requestedDims.height > 0 ?
+		(u64)requestedDims.width * (u64)requestedDims.height : 0);
+	u64 boundsArea = (u64)boundsDims.width * (u64)boundsDims.height;
+	if (item->type != RENDER_ITEM_LINES && item->type != RENDER_ITEM_TRIANGLES)
+	{
+		stats->submittedPixels += boundsArea;
+		stats->clippedPixels += requestedArea - boundsArea;
+	}
+	if (boundsArea == 0) return;
+
+	v2i spanDims = GetRectDims(__tiled_get_tile_span(item->bounds));
+	u32 coverage = (u32)(spanDims.x * spanDims.y);
+	if (renderer->itemCount == renderer->itemCapacity ||
+		renderer->binIndexCount + coverage > renderer->binIndexCapacity)
+	{
+		FlushTiledRenderer(renderer);
+	}
+
+	renderer->items[renderer->itemCount++] = *item;
+	renderer->binIndexCount += coverage;
+
+}
+
+/**
+ * Whether a draw would miss the target entirely, so it can be dropped before it is recorded. It
+ * still counts towards the clipped pixels.
+ */
+inline b32
+CullTiledDraw(tiled_renderer* renderer, v2i position, v2i dims)
+{
+	if (!IsRectEmpty(IntersectRect(CreateRect(position, dims), GetBitmapRect(renderer->target)))) return false;
+	if (dims.width > 0 && dims.height > 0)
+		renderer->workerStats[0].clippedPixels += (u64)dims.width * (u64)dims.height;
+	return true;
+}
+
+/**
+ * Records a DrawRect.
+ */
+internal void
+TiledDrawRect(tiled_renderer* renderer, v2i rectPos, v2i rectDims, u32 color)
+{
+	render_item item = {};
+	item.type = RENDER_ITEM_RECT;
+	item.bounds = CreateRect(rectPos, rectDims);
+	item.position = rectPos;
+	item.dims = rectDims;
+	item.color = color;
+	__tiled_push_item(renderer, &item);
+}
+
+/**
+ * Records a DrawBitmap. The source pixels are read at flush, so they must stay valid until then.
+ */
+internal void
+TiledDrawBitmap(tiled_renderer* renderer, dibitmap* source, v2i position, blend_mode mode = BLEND_OPAQUE,
+	u32 colorKey = 0)
+{
+	render_item item = {};
+	item.type = RENDER_ITEM_BITMAP;
+	item.bounds = CreateRect(position, source->dims);
+	item.position = position;
+	item.dims = source->dims;
+	item.source = *source;
+	item.mode = mode;
+	item.colorKey = colorKey;
+	__tiled_push_item(renderer, &item);
+}
+
+/**
+ * The area a batch of lines can touch, and a hash of what it draws.
+ */
+internal rect2i
+GetLineBounds(line_segment* lines, u32 lineCount, b32 smooth, u64* contentHash)
+{
+
+	v2 _min = lines[0].from, _max = lines[0].from;
+	u64 _hash = 0xCBF29CE484222325ull;
+	for (u32 _lineIndex = 0; _lineIndex < lineCount; ++_lineIndex)
+	{
+		line_segment* _line = &lines[_lineIndex];
+		if (_line->from.x < _min.x) _min.x = _line->from.x;
+		if (_line->from.y < _min.y) _min.y = _line->from.y;
+		if (_line->from.x > _max.x) _max.x = _line->from.x;
+		if (_line->from.y > _max.y) _max.y = _line->from.y;
+		if (_line->to.x < _min.x) _min.x = _line->to.x;
+		if (_line->to.y < _min.y) _min.y = _line->to.y;
+		if (_line->to.x > _max.x) _max.x = _line->to.x;
+		if (_line->to.y > _max.y) _max.y = _line->to.y;
+
+		_hash = __tiled_hash_point(_hash, _line->from);
+		_hash = __tiled_hash_point(_hash, _line->to);
+		_hash = __tiled_hash(_hash, _line->color);
+	}
+	if (contentHash) *contentHash = _hash;
+
+	// Nothing past the guard band is drawn, which also keeps the bounds in range, NaNs included.
+	_min.x = (!(_min.x >= -NX_LINE_GUARD_BAND) ? -NX_LINE_GUARD_BAND : _min.x);
+	_min.y = (!(_min.y >= -NX_LINE_GUARD_BAND) ? -NX_LINE_GUARD_BAND : _min.y);
+	_max.x = (!(_max.x <= NX_LINE_GUARD_BAND) ? NX_LINE_GUARD_BAND : _max.x);
+	_max.y = (!(_max.y <= NX_LINE_GUARD_BAND) ? NX_LINE_GUARD_BAND : _max.y);
+
+	// Smooth lines spill into the pixel either side of them.
+	r32 _margin = (smooth ? 2.0f : 1.0f);
+	rect2i _bounds;
+	_bounds.min = { (i32)floorf(_min.x - _margin), (i32)floorf(_min.y - _margin) };
+	_bounds.max = { (i32)ceilf(_max.x + _margin) + 1, (i32)ceilf(_max.y + _margin) + 1 };
+	return _bounds;
+
+}
+
+/**
+ * Records a DrawLines. The lines are read at flush, so they must stay valid until then.
+ */
+internal void
+TiledDrawLines(tiled_renderer* renderer, line_segment* lines, u32 lineCount, b32 smooth = false)
+{
+	if (lineCount == 0) return;
+
+	render_item item = {};
+	item.type = RENDER_ITEM_LINES;
+	item.bounds = GetLineBounds(lines, lineCount, smooth, &item.contentHash);
+	item.position = item.bounds.min;
+	item.dims = GetRectDims(item.bounds);
+	item.lines = lines;
+	item.lineCount = lineCount;
+	item.smooth = smooth;
+	item.mode = (smooth ? BLEND_PREMULTIPLIED : BLEND_OPAQUE);
+	__tiled_push_item(renderer, &item);
+}
+
+/**
+ * The area a batch of triangles can touch, and a hash of what it draws.
+ */
+internal rect2i
+GetTriangleBounds(triangle_vertex* vertices, u32 triangleCount, u64* contentHash)
+{
+
+	v2 _min = vertices[0].position, _max = vertices[0].position;
+	u64 _hash = 0xCBF29CE484222325ull;
+	for (u32 _vertexIndex = 0; _vertexIndex < triangleCount*3; ++_vertexIndex)
+	{
+		triangle_vertex* _vertex = &vertices[_vertexIndex];
+		if (_vertex->position.x < _min.x) _min.x = _vertex->position.x;
+		if (_vertex->position.y < _min.y) _min.y = _vertex->position.y;
+		if (_vertex->position.x > _max.x) _max.x = _vertex->position.x;
+		if (_vertex->position.y > _max.y) _max.y = _vertex->position.y;
+
+		_hash = __tiled_hash_point(_hash, _vertex->position);
+		_hash = __tiled_hash_point(_hash, _vertex->uv);
+	}
+	if (contentHash) *contentHash = _hash;
+
+	// Nothing past the guard band is drawn, which also keeps the bounds in range.
+	_min.x = (_min.x < -NX_TRIANGLE_GUARD_BAND ? -NX_TRIANGLE_GUARD_BAND : _min.x);
+	_min.y = (_min.y < -NX_TRIANGLE_GUARD_BAND ? -NX_TRIANGLE_GUARD_BAND : _min.y);
+	_max.x = (_max.x > NX_TRIANGLE_GUARD_BAND ? NX_TRIANGLE_GUARD_BAND : _max.x);
+	_max.y = (_max.y > NX_TRIANGLE_GUARD_BAND ? NX_TRIANGLE_GUARD_BAND : _max.y);
+	rect2i _bounds;
+	_bounds.min = { (i32)floorf(_min.x), (i32)floorf(_min.y) };
+	_bounds.max = { (i32)ceilf(_max.x), (i32)ceilf(_max.y) };
+	return _bounds;
+
+}
+
+/**
+ * Records a DrawTriangles. The vertices and texture are read at flush, so they must stay valid
+ * until then. Pass a NULL texture for a flat color.
+ */
+internal void
+TiledDrawTriangles(tiled_renderer* renderer, triangle_vertex* vertices, u32 triangleCount, dibitmap* texture,
+	u32 color = 0, blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	if (triangleCount == 0) return;
+
+	render_item item = {};
+	item.type = RENDER_ITEM_TRIANGLES;
+	item.bounds = GetTriangleBounds(vertices, triangleCount, &item.contentHash);
+	item.position = item.bounds.min;
+	item.dims = GetRectDims(item.bounds);
+	item.vertices = vertices;
+	item.triangleCount = triangleCount;
+	if (texture) item.source = *texture;
+	item.color = color;
+	item.mode = mode;
+	item.colorKey = colorKey;
+	__tiled_push_item(renderer, &item);
+}
+
+#endif
@@ -0,0 +1,546 @@
+#ifndef NINETAILSX_TRIANGLES_H
+#define NINETAILSX_TRIANGLES_H
+#include <nxcore/helpers.h>
+#include <nxcore/math.h>
+#include <nxcore/simd.h>
+#include <nxcore/renderer/software.h>
+
+/**
+ * Triangles.
+ *
+ * Vertices are in pixels with whole numbers on the corners of pixels, the same way rects are, so
+ * two triangles spanning {x,y} to {x+w,y+h} cover exactly the pixels DrawRect would. A pixel is
+ * drawn when its middle is inside the triangle. Positions are snapped to 1/16th of a pixel and the
+ * inside test is the three half-space edge functions in integers, so it is exact.
+ *
+ * Pixel middles which fall exactly on an edge go by the top-left rule: they belong to the
+ * triangle only if the edge is a top edge (horizontal, with the triangle on the side of the later
+ * rows) or a left edge. Triangles which share an edge then never both draw a pixel on it, nor
+ * leave a gap between them, which is what makes a quad blended over a background come out right.
+ *
+ * The bounds of a triangle are walked in 8x8 blocks on a grid aligned to the bitmap. Each block
+ * evaluates the edges at its corners first, a block outside of any edge is skipped, and edges a
+ * block is entirely inside of are dropped for it, so the inner loop only tests the edges which
+ * actually cross the block. The rows of a block are the SIMD kernels' work, eight pixels at a
+ * time. A block inside of every edge needs no tests at all, runs of them along a row of blocks are
+ * drawn as one span per pixel row, with a single FillSpan or BlendSpan.
+ *
+ * Textured triangles interpolate their UVs linearly, there is no perspective in 2D. UVs run from 0
+ * to 1 across the texture, with {0,0} at its first pixel, the corner DrawBitmap puts at position.
+ * Sampling is nearest texel, and UVs outside of 0 to 1 are clamped to the edge of the texture.
+ *
+ * NOTE:
+ * 			Every pixel is placed from the triangle itself, never stepped to from the edge of the
+ * 			clip rect, so a triangle drawn tile by tile comes out exactly as it would if drawn whole.
+ * 			The kernels all evaluate the UVs with the same float operations in the same order, so
+ * 			every instruction set level produces identical output as well.
+ *
+ * NOTE:
+ * 			Triangles reaching further than NX_TRIANGLE_GUARD_BAND pixels from the origin are not
+ * 			drawn. Beyond that, the edge functions no longer fit the 32-bit lanes of the kernels.
+ */
+#define NX_TRIANGLE_SUBPIXEL_BITS 4
+#define NX_TRIANGLE_SUBPIXELS (1 << NX_TRIANGLE_SUBPIXEL_BITS)
+#define NX_TRIANGLE_GUARD_BAND 8192.0f
+#define NX_TRIANGLE_BLOCK_SIZE 8
+#define NX_TRIANGLE_SPAN_SIZE 256 // The longest run of inside blocks drawn at once, in pixels.
+
+typedef struct triangle_vertex
+{
+	v2 position;
+	v2 uv;
+} triangle_vertex;
+
+/**
+ * A triangle ready to be rasterized. Edge values are in 1/256ths of a pixel squared with the fill
+ * rule folded in, so a pixel is inside when all three are zero or more.
+ */
+typedef struct triangle_setup
+{
+	i64 edgeOrigin[3]; // At the middle of pixel {0,0}.
+	i32 edgeStepX[3]; // Per pixel.
+	i32 edgeStepY[3];
+
+	// Texel coordinates are planes around the first vertex.
+	r32 originX;
+	r32 originY;
+	r32 uOrigin;
+	r32 uStepX;
+	r32 uStepY;
+	r32 vOrigin;
+	r32 vStepX;
+	r32 vStepY;
+	r32 maxU;
+	r32 maxV;
+
+	u32* texels; // NULL for a flat color.
+	i32 texturePitch;
+} triangle_setup;
+
+/**
+ * ShadeTriangleRow
+ * 			Tests eight pixels of a block row, from X, against the edges which cross the block and
+ * 			returns which of them are inside as the low eight bits. Edges[e] is the value at X and
+ * 			EdgeSteps[e] the step per pixel, an edge which doesn't cross the block is passed as zero
+ * 			for both. Textured triangles also sample the texel of every pixel into Colors.
+ */
+typedef u32 fnptr_shade_triangle_row(triangle_setup* Setup, i32* Edges, i32* EdgeSteps, i32 X, i32 Y, u32* Colors);
+
+/**
+ * SampleTriangleRow
+ * 			Samples the texels of eight pixels of a row, from X, into Colors, the same as the shade
+ * 			kernel of the level does. Used for blocks which are inside of every edge.
+ */
+typedef void fnptr_sample_triangle_row(triangle_setup* Setup, i32 X, i32 Y, u32* Colors);
+
+inline u32
+__triangle_sample(triangle_setup* Setup, r32 PixelX, r32 PixelY)
+{
+	r32 _dx = PixelX - Setup->originX;
+	r32 _dy = PixelY - Setup->originY;
+	r32 _u = (_dx*Setup->uStepX + _dy*Setup->uStepY) + Setup->uOrigin;
+	r32 _v = (_dx*Setup->vStepX + _dy*Setup->vStepY) + Setup->vOrigin;
+
+	// In the same order as minps/maxps, so that the kernels agree even on NaNs.
+	_u = (_u < Setup->maxU ? _u : Setup->maxU);
+	_u = (_u > 0.0f ? _u : 0.0f);
+	_v = (_v < Setup->maxV ? _v : Setup->maxV);
+	_v = (_v > 0.0f ? _v : 0.0f);
+	return Setup->texels[(i32)_v * Setup->texturePitch + (i32)_u];
+}
+
+internal void
+__triangle_sample_row_scalar(triangle_setup* Setup, i32 X, i32 Y, u32* Colors)
+{
+	for (i32 Lane = 0; Lane < NX_TRIANGLE_BLOCK_SIZE; ++Lane)
+		Colors[Lane] = __triangle_sample(Setup, (r32)(X + Lane) + 0.5f, (r32)Y + 0.5f);
+}
+
+internal u32
+__triangle_shade_row_scalar(triangle_setup* Setup, i32* Edges, i32* EdgeSteps, i32 X, i32 Y, u32* Colors)
+{
+	u32 _coverage = 0;
+	for (i32 Lane = 0; Lane < NX_TRIANGLE_BLOCK_SIZE; ++Lane)
+	{
+		i32 _outside = ((Edges[0] + Lane*EdgeSteps[0]) | (Edges[1] + Lane*EdgeSteps[1]) |
+			(Edges[2] + Lane*EdgeSteps[2]));
+		if (_outside < 0) continue;
+
+		_coverage |= 1u << Lane;
+		if (Setup->texels) Colors[Lane] = __triangle_sample(Setup, (r32)(X + Lane) + 0.5f, (r32)Y + 0.5f);
+	}
+	return _coverage;
+}
+
+#if defined(NINETAILSX_ARCH_X86)
+/**
+ * SSE2, the row in two halves of four. SSE2 has no 32-bit multiply or gather, so the lane steps
+ * are built on the scalar side and the texels are fetched one at a time.
+ */
+NX_TARGET_SSE2 internal void
+__triangle_sample_row_sse2(triangle_setup* Setup, i32 X, i32 Y, u32* Colors)
+{
+	__m128 Half = _mm_set1_ps(0.5f);
+	__m128 PixelY = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((r32)Y), Half), _mm_set1_ps(Setup->originY));
+	__m128 UY = _mm_mul_ps(PixelY, _mm_set1_ps(Setup->uStepY));
+	__m128 VY = _mm_mul_ps(PixelY, _mm_set1_ps(Setup->vStepY));
+	alignas(16) i32 TexelU[NX_TRIANGLE_BLOCK_SIZE];
+	alignas(16) i32 TexelV[NX_TRIANGLE_BLOCK_SIZE];
+	for (i32 Lane = 0; Lane < NX_TRIANGLE_BLOCK_SIZE; Lane += 4)
+	{
+		__m128i Columns = _mm_add_epi32(_mm_set1_epi32(X + Lane), _mm_setr_epi32(0, 1, 2, 3));
+		__m128 PixelX = _mm_sub_ps(_mm_add_ps(_mm_cvtepi32_ps(Columns), Half), _mm_set1_ps(Setup->originX));
+		__m128 U = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PixelX, _mm_set1_ps(Setup->uStepX)), UY), _mm_set1_ps(Setup->uOrigin));
+		__m128 V = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PixelX, _mm_set1_ps(Setup->vStepX)), VY), _mm_set1_ps(Setup->vOrigin));
+		U = _mm_max_ps(_mm_min_ps(U, _mm_set1_ps(Setup->maxU)), _mm_setzero_ps());
+		V = _mm_max_ps(_mm_min_ps(V, _mm_set1_ps(Setup->maxV)), _mm_setzero_ps());
+		_mm_store_si128((__m128i*)(TexelU + Lane), _mm_cvttps_epi32(U));
+		_mm_store_si128((__m128i*)(TexelV + Lane), _mm_cvttps_epi32(V));
+	}
+	for (i32 Lane = 0; Lane < NX_TRIANGLE_BLOCK_SIZE; ++Lane)
+		Colors[Lane] = Setup->texels[TexelV[Lane] * Setup->texturePitch + TexelU[Lane]];
+}
+
+NX_TARGET_SSE2 internal u32
+__triangle_shade_row_sse2(triangle_setup* Setup, i32* Edges, i32* EdgeSteps, i32 X, i32 Y, u32* Colors)
+{
+	__m128i Outside[2];
+	for (i32 Quad = 0; Quad < 2; ++Quad)
+	{
+		Outside[Quad] = _mm_setzero_si128();
+		for (u32 EdgeIndex = 0; EdgeIndex < 3; ++EdgeIndex)
+		{
+			i32 Start = Edges[EdgeIndex] + Quad*4*EdgeSteps[EdgeIndex];
+			i32 Step = EdgeSteps[EdgeIndex];
+			Outside[Quad] = _mm_or_si128(Outside[Quad], _mm_setr_epi32(Start, Start + Step, Start + 2*Step, Start + 3*Step));
+		}
+	}
+	u32 _coverage = ~(u32)(_mm_movemask_ps(_mm_castsi128_ps(Outside[0])) |
+		(_mm_movemask_ps(_mm_castsi128_ps(Outside[1])) << 4)) & 0xFF;
+	if (_coverage == 0 || Setup->texels == NULL) return _coverage;
+
+	__triangle_sample_row_sse2(Setup, X, Y, Colors);
+	return _coverage;
+}
+
+/**
+ * AVX2, the whole row in one register, with the texels gathered. There is no AVX-512 kernel, a
+ * row is only eight pixels.
+ */
+NX_TARGET_AVX2 internal void
+__triangle_sample_row_avx2(triangle_setup* Setup, i32 X, i32 Y, u32* Colors)
+{
+	__m256i Lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256 Half = _mm256_set1_ps(0.5f);
+	__m256 PixelX = _mm256_sub_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(X), Lanes)), Half),
+		_mm256_set1_ps(Setup->originX));
+	__m256 PixelY = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((r32)Y), Half), _mm256_set1_ps(Setup->originY));
+	__m256 U = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(PixelX, _mm256_set1_ps(Setup->uStepX)),
+		_mm256_mul_ps(PixelY, _mm256_set1_ps(Setup->uStepY))), _mm256_set1_ps(Setup->uOrigin));
+	__m256 V = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(PixelX, _mm256_set1_ps(Setup->vStepX)),
+		_mm256_mul_ps(PixelY, _mm256_set1_ps(Setup->vStepY))), _mm256_set1_ps(Setup->vOrigin));
+	U = _mm256_max_ps(_mm256_min_ps(U, _mm256_set1_ps(Setup->maxU)), _mm256_setzero_ps());
+	V = _mm256_max_ps(_mm256_min_ps(V, _mm256_set1_ps(Setup->maxV)), _mm256_setzero_ps());
+
+	__m256i Index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(V), _mm256_set1_epi32(Setup->texturePitch)),
+		_mm256_cvttps_epi32(U));
+	_mm256_storeu_si256((__m256i*)Colors, _mm256_i32gather_epi32((const int*)Setup->texels, Index, 4));
+}
+
+NX_TARGET_AVX2 internal u32
+__triangle_shade_row_avx2(triangle_setup* Setup, i32* Edges, i32* EdgeSteps, i32 X, i32 Y, u32* Colors)
+{
+	__m256i Lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i Outside = _mm256_setzero_si256();
+	for (u32 EdgeIndex = 0; EdgeIndex < 3; ++EdgeIndex)
+	{
+		__m256i Edge = _mm256_add_epi32(_mm256_set1_epi32(Edges[EdgeIndex]),
+			_mm256_mullo_epi32(Lanes, _mm256_set1_epi32(EdgeSteps[EdgeIndex])));
+		Outside = _mm256_or_si256(Outside, Edge);
+	}
+	u32 _coverage = ~(u32)_mm256_movemask_ps(_mm256_castsi256_ps(Outside)) & 0xFF;
+	if (_coverage == 0 || Setup->texels == NULL) return _coverage;
+
+	__triangle_sample_row_avx2(Setup, X, Y, Colors);
+	return _coverage;
+}
+#endif
+
+global fnptr_shade_triangle_row* __triangle_row_kernel;
+global fnptr_sample_triangle_row* __triangle_sample_kernel;
+
+/**
+ * Selects the triangle kernels for the instruction set level reported by GetSIMDLevel(). This
+ * happens automatically on first use, it only needs to be called again after SetSIMDLevelCap().
+ */
+internal void
+SelectTriangleKernels()
+{
+	__triangle_row_kernel = &__triangle_shade_row_scalar;
+	__triangle_sample_kernel = &__triangle_sample_row_scalar;
+
+#if defined(NINETAILSX_ARCH_X86)
+	switch (GetSIMDLevel())
+	{
+		case SIMD_LEVEL_AVX512:
+		case SIMD_LEVEL_AVX2:
+		{
+			__triangle_row_kernel = &__triangle_shade_row_avx2;
+			__triangle_sample_kernel = &__triangle_sample_row_avx2;
+		} break;
+		case SIMD_LEVEL_SSE2:
+		{
+			__triangle_row_kernel = &__triangle_shade_row_sse2;
+			__triangle_sample_kernel = &__triangle_sample_row_sse2;
+		} break;
+		default: break;
+	}
+#endif
+}
+
+/**
+ * Snaps the triangle, orders it so that its inside is on the positive side of every edge and
+ * works out the pixels it can touch within clipRect. Returns false if there is nothing to draw.
+ */
+internal b32
+__triangle_setup(triangle_setup* setup, triangle_vertex* vertices, dibitmap* texture, rect2i clipRect,
+	rect2i* bounds)
+{
+
+	triangle_vertex* _vertices[3] = { &vertices[0], &vertices[1], &vertices[2] };
+	i64 _x[3], _y[3];
+	for (u32 _index = 0; _index < 3; ++_index)
+	{
+		v2 _position = _vertices[_index]->position;
+		if (!(fabsf(_position.x) <= NX_TRIANGLE_GUARD_BAND && fabsf(_position.y) <= NX_TRIANGLE_GUARD_BAND)) return false;
+		_x[_index] = (i64)floorf(_position.x * NX_TRIANGLE_SUBPIXELS + 0.5f);
+		_y[_index] = (i64)floorf(_position.y * NX_TRIANGLE_SUBPIXELS + 0.5f);
+	}
+
+	i64 _area = (_x[1] - _x[0])*(_y[2] - _y[0]) - (_y[1] - _y[0])*(_x[2] - _x[0]);
+	if (_area == 0) return false;
+	if (_area < 0)
+	{
+		triangle_vertex* _swapVertex = _vertices[1]; _vertices[1] = _vertices[2]; _vertices[2] = _swapVertex;
+		i64 _swap = _x[1]; _x[1] = _x[2]; _x[2] = _swap;
+		_swap = _y[1]; _y[1] = _y[2]; _y[2] = _swap;
+		_area = -_area;
+	}
+
+	// The pixels whose middles are within the snapped extents.
+	i64 _minX = _x[0], _minY = _y[0], _maxX = _x[0], _maxY = _y[0];
+	for (u32 _index = 1; _index < 3; ++_index)
+	{
+		if (_x[_index] < _minX) _minX = _x[_index];
+		if (_y[_index] < _minY) _minY = _y[_index];
+		if (_x[_index] > _maxX) _maxX = _x[_index];
+		if (_y[_index] > _maxY) _maxY = _y[_index];
+	}
+	i64 _middle = NX_TRIANGLE_SUBPIXELS / 2;
+	rect2i _pixels;
+	_pixels.min = { (i32)((_minX - _middle + NX_TRIANGLE_SUBPIXELS-1) >> NX_TRIANGLE_SUBPIXEL_BITS),
+		(i32)((_minY - _middle + NX_TRIANGLE_SUBPIXELS-1) >> NX_TRIANGLE_SUBPIXEL_BITS) };
+	_pixels.max = { (i32)((_maxX - _middle) >> NX_TRIANGLE_SUBPIXEL_BITS) + 1,
+		(i32)((_maxY - _middle) >> NX_TRIANGLE_SUBPIXEL_BITS) + 1 };
+	*bounds = IntersectRect(_pixels, clipRect);
+	if (IsRectEmpty(*bounds)) return false;
+
+	// E(p) = dx*(p.y - a.y) - dy*(p.x - a.x) for the edge from a to b.
+	for (u32 _edge = 0; _edge < 3; ++_edge)
+	{
+		u32 _next = (_edge + 1) % 3;
+		i64 _dx = _x[_next] - _x[_edge];
+		i64 _dy = _y[_next] - _y[_edge];
+		b32 _topLeft = (_dy < 0 || (_dy == 0 && _dx > 0));
+		setup->edgeOrigin[_edge] = _dx*(_middle - _y[_edge]) - _dy*(_middle - _x[_edge]) + (_topLeft ? 0 : -1);
+		setup->edgeStepX[_edge] = (i32)(-_dy * NX_TRIANGLE_SUBPIXELS);
+		setup->edgeStepY[_edge] = (i32)(_dx * NX_TRIANGLE_SUBPIXELS);
+	}
+
+	setup->texels = NULL;
+	if (texture == NULL) return true;
+
+	// The UV planes, from the snapped positions so that they follow what is drawn.
+	r32 _scale = 1.0f / NX_TRIANGLE_SUBPIXELS;
+	r32 _x1 = (r32)(_x[1] - _x[0]) * _scale, _y1 = (r32)(_y[1] - _y[0]) * _scale;
+	r32 _x2 = (r32)(_x[2] - _x[0]) * _scale, _y2 = (r32)(_y[2] - _y[0]) * _scale;
+	r32 _determinant = (r32)_area * _scale * _scale;
+	r32 _width = (r32)texture->dims.width, _height = (r32)texture->dims.height;
+	v2 _uv0 = _vertices[0]->uv, _uv1 = _vertices[1]->uv, _uv2 = _vertices[2]->uv;
+
+	setup->originX = (r32)_x[0] * _scale;
+	setup->originY = (r32)_y[0] * _scale;
+	setup->uOrigin = _uv0.x * _width;
+	setup->uStepX = ((_uv1.x - _uv0.x)*_y2 - (_uv2.x - _uv0.x)*_y1) / _determinant * _width;
+	setup->uStepY = ((_uv2.x - _uv0.x)*_x1 - (_uv1.x - _uv0.x)*_x2) / _determinant * _width;
+	setup->vOrigin = _uv0.y * _height;
+	setup->vStepX = ((_uv1.y - _uv0.y)*_y2 - (_uv2.y - _uv0.y)*_y1) / _determinant * _height;
+	setup->vStepY = ((_uv2.y - _uv0.y)*_x1 - (_uv1.y - _uv0.y)*_x2) / _determinant * _height;
+	setup->maxU = _width - 1.0f;
+	setup->maxV = _height - 1.0f;
+	setup->texels = (u32*)texture->buffer;
+	setup->texturePitch = texture->pitch;
+	return true;
+
+}
+
+/**
+ * Draws the pixels from runStart to runEnd on every row from rowStart to rowEnd, all of which are
+ * inside the triangle. The run starts within the block at runBlockX and is at most
+ * NX_TRIANGLE_SPAN_SIZE pixels from there, span holds the color for flat triangles which blend.
+ * Returns the number of pixels written.
+ */
+internal u64
+__triangle_draw_run(dibitmap* bitmap, triangle_setup* setup, i32 runBlockX, i32 runStart, i32 runEnd,
+	i32 rowStart, i32 rowEnd, u32 color, blend_mode mode, u32 colorKey, u32* span)
+{
+
+	if (runEnd <= runStart) return 0;
+
+	u32* _pixels = (u32*)bitmap->buffer;
+	i32 _runLength = runEnd - runStart;
+	for (i32 _row = rowStart; _row < rowEnd; ++_row)
+	{
+		u32* _dest = _pixels + (bitmap->pitch*_row) + runStart;
+		if (setup->texels)
+		{
+			for (i32 _blockX = runBlockX; _blockX < runEnd; _blockX += NX_TRIANGLE_BLOCK_SIZE)
+				__triangle_sample_kernel(setup, _blockX, _row, span + (_blockX - runBlockX));
+			BlendSpan(_dest, span + (runStart - runBlockX), (u64)_runLength, mode, colorKey);
+		}
+		else if (mode == BLEND_OPAQUE) FillSpan(_dest, (u64)_runLength, color);
+		else BlendSpan(_dest, span, (u64)_runLength, mode, colorKey);
+	}
+
+	return (u64)_runLength * (u64)(rowEnd - rowStart);
+
+}
+
+// Returns the number of pixels written.
+internal u64
+__triangle_draw(dibitmap* bitmap, triangle_vertex* vertices, dibitmap* texture, u32 color, blend_mode mode,
+	u32 colorKey, rect2i clipRect)
+{
+
+	triangle_setup _setup;
+	rect2i _bounds;
+	if (!__triangle_setup(&_setup, vertices, texture, clipRect, &_bounds)) return 0;
+
+	u32 _colors[NX_TRIANGLE_BLOCK_SIZE];
+	for (u32 _lane = 0; _lane < NX_TRIANGLE_BLOCK_SIZE; ++_lane) _colors[_lane] = color;
+	b32 _fill = (_setup.texels == NULL && mode == BLEND_OPAQUE);
+
+	// Runs of inside blocks blend from here, flat ones never need more of it than the bounds are wide.
+	alignas(32) u32 _span[NX_TRIANGLE_SPAN_SIZE];
+	if (_setup.texels == NULL && !_fill)
+	{
+		i32 _boundsWidth = _bounds.max.x - _bounds.min.x;
+		FillSpan(_span, (u64)(_boundsWidth < NX_TRIANGLE_SPAN_SIZE ? _boundsWidth : NX_TRIANGLE_SPAN_SIZE), color);
+	}
+
+	// How far below and above its value at a block's first corner an edge reaches within the block.
+	i32 _last = NX_TRIANGLE_BLOCK_SIZE - 1;
+	i64 _lowOffset[3], _highOffset[3];
+	for (u32 _edge = 0; _edge < 3; ++_edge)
+	{
+		i64 _spanX = (i64)_setup.edgeStepX[_edge]*_last, _spanY = (i64)_setup.edgeStepY[_edge]*_last;
+		_lowOffset[_edge] = (_spanX < 0 ? _spanX : 0) + (_spanY < 0 ? _spanY : 0);
+		_highOffset[_edge] = (_spanX > 0 ? _spanX : 0) + (_spanY > 0 ? _spanY : 0);
+	}
+
+	u32* _pixels = (u32*)bitmap->buffer;
+	u64 _written = 0;
+	for (i32 _blockY = _bounds.min.y & ~_last; _blockY < _bounds.max.y; _blockY += NX_TRIANGLE_BLOCK_SIZE)
+	{
+		i32 _rowStart = (_blockY > _bounds.min.y ? _blockY : _bounds.min.y);
+		i32 _rowEnd = (_blockY + NX_TRIANGLE_BLOCK_SIZE < _bounds.max.y ? _blockY + NX_TRIANGLE_BLOCK_SIZE : _bounds.max.y);
+
+		// The run of blocks inside every edge waiting to be drawn, empty when start and end meet.
+		i32 _runBlockX = 0, _runStart = 0, _runEnd = 0;
+		b32 _entered = false;
+		for (i32 _blockX = _bounds.min.x & ~_last; _blockX < _bounds.max.x; _blockX += NX_TRIANGLE_BLOCK_SIZE)
+		{
+			/**
+			 * Classify the block against each edge by its extremes, which are at its corners. The
+			 * blocks a triangle touches along a row are all next to each other, so once one is
+			 * rejected past them, the rest of the row is too.
+			 */
+			i32 _edges[3], _edgeSteps[3], _rowSteps[3];
+			b32 _rejected = false;
+			u32 _crossing = 0;
+			for (u32 _edge = 0; _edge < 3 && !_rejected; ++_edge)
+			{
+				i64 _corner = _setup.edgeOrigin[_edge] + (i64)_setup.edgeStepX[_edge]*_blockX +
+					(i64)_setup.edgeStepY[_edge]*_blockY;
+				if (_corner + _highOffset[_edge] < 0) _rejected = true;
+				else if (_corner + _lowOffset[_edge] >= 0) _edges[_edge] = _edgeSteps[_edge] = _rowSteps[_edge] = 0;
+				else
+				{
+					_edges[_edge] = (i32)_corner;
+					_edgeSteps[_edge] = _setup.edgeStepX[_edge];
+					_rowSteps[_edge] = _setup.edgeStepY[_edge];
+					++_crossing;
+				}
+			}
+			if (_rejected && _entered) break;
+			if (_rejected) continue;
+			_entered = true;
+
+			i32 _left = (_blockX > _bounds.min.x ? _blockX : _bounds.min.x);
+			i32 _right = (_blockX + NX_TRIANGLE_BLOCK_SIZE < _bounds.max.x ? _blockX + NX_TRIANGLE_BLOCK_SIZE : _bounds.max.x);
+
+			// Inside of every edge, so every pixel is drawn. Joins the run if it carries straight on.
+			if (_crossing == 0)
+			{
+				if (_runEnd == _runStart || _runEnd != _left ||
+					_blockX + NX_TRIANGLE_BLOCK_SIZE - _runBlockX > NX_TRIANGLE_SPAN_SIZE)
+				{
+					_written += __triangle_draw_run(bitmap, &_setup, _runBlockX, _runStart, _runEnd, _rowStart, _rowEnd,
+						color, mode, colorKey, _span);
+					_runBlockX = _blockX;
+					_runStart = _left;
+				}
+				_runEnd = _right;
+				continue;
+			}
+
+			i32 _columnStart = _left - _blockX;
+			i32 _columnEnd = _right - _blockX;
+			u32 _columns = ((1u << _columnEnd) - 1) & ~((1u << _columnStart) - 1);
+
+			for (i32 _row = _rowStart; _row < _rowEnd; ++_row)
+			{
+				i32 _rowEdges[3];
+				for (u32 _edge = 0; _edge < 3; ++_edge)
+					_rowEdges[_edge] = _edges[_edge] + _rowSteps[_edge]*(_row - _blockY);
+
+				u32 _coverage = __triangle_row_kernel(&_setup, _rowEdges, _edgeSteps, _blockX, _row, _colors) & _columns;
+				if (_coverage == 0) continue;
+
+				u32* _dest = _pixels + (bitmap->pitch*_row) + _blockX;
+				if (_coverage == 0xFF)
+				{
+					if (_fill) FillSpan(_dest, NX_TRIANGLE_BLOCK_SIZE, color);
+					else BlendSpan(_dest, _colors, NX_TRIANGLE_BLOCK_SIZE, mode, colorKey);
+					_written += NX_TRIANGLE_BLOCK_SIZE;
+					continue;
+				}
+
+				for (i32 _lane = _columnStart; _lane < _columnEnd; ++_lane)
+				{
+					if (!(_coverage & (1u << _lane))) continue;
+					_dest[_lane] = __blend_pixel(_dest[_lane], _colors[_lane], mode, colorKey);
+					++_written;
+				}
+			}
+		}
+
+		_written += __triangle_draw_run(bitmap, &_setup, _runBlockX, _runStart, _runEnd, _rowStart, _rowEnd,
+			color, mode, colorKey, _span);
+	}
+
+	return _written;
+
+}
+
+/**
+ * Draws a batch of triangles, three vertices each, clipped to clipRect, which must lie within the
+ * bitmap. With a texture, every pixel is the texel its UV lands on, otherwise it is color. Either
+ * way it is combined with what is already drawn by the blend mode, see blend_mode. Returns the
+ * number of pixels written.
+ */
+internal u64
+DrawTrianglesClipped(dibitmap* bitmap, triangle_vertex* vertices, u32 triangleCount, dibitmap* texture,
+	u32 color, blend_mode mode, u32 colorKey, rect2i clipRect)
+{
+
+	NX_PROFILE_SCOPE("DrawTriangles");
+	if (__triangle_row_kernel == NULL) SelectTriangleKernels();
+	if (texture && (texture->buffer == NULL || texture->dims.width <= 0 || texture->dims.height <= 0)) return 0;
+
+	u64 _written = 0;
+	for (u32 _triangleIndex = 0; _triangleIndex < triangleCount; ++_triangleIndex)
+		_written += __triangle_draw(bitmap, &vertices[_triangleIndex*3], texture, color, mode, colorKey, clipRect);
+	return _written;
+
+}
+
+/**
+ * Draws a batch of triangles, three vertices each. Pass a NULL texture for a flat color.
+ */
+internal u64
+DrawTriangles(dibitmap* bitmap, triangle_vertex* vertices, u32 triangleCount, dibitmap* texture,
+	u32 color = 0, blend_mode mode = BLEND_OPAQUE, u32 colorKey = 0)
+{
+	return DrawTrianglesClipped(bitmap, vertices, triangleCount, texture, color, mode, colorKey,
+		GetBitmapRect(bitmap));
+}
+
+internal void
+DrawTriangle(dibitmap* bitmap, v2 a, v2 b, v2 c, u32 color, blend_mode mode = BLEND_OPAQUE)
+{
+	triangle_vertex _vertices[3] = { { a, {} }, { b, {} }, { c, {} } };
+	DrawTrianglesClipped(bitmap, _vertices, 1, NULL, color, mode, 0, GetBitmapRect(bitmap));
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef NINETAILSX_REPLAY_H
+#define NINETAILSX_REPLAY_H
+#include <nxcore/helpers.h>
+#include <nxcore/primitives.h>
+#include <nxcore/memory.h>
+#include <nxcore/input.h>
+
+/**
+ * Input recordings (.nxrec).
+ *
+ * The input every EngineUpdate saw, step by step, along with a snapshot of the simulation from
+ * when the recording started. The simulation only changes in EngineUpdate and only depends on its
+ * state and its input, so restoring the snapshot and feeding the steps back in plays the same
+ * session out again exactly, which makes recordings repeatable workloads for benchmarking. The
+ * file is laid out as:
+ *
+ * 		nxrec_header
+ * 		snapshot						snapshotSize bytes, from EngineSaveState.
+ * 		nxrec_run[runCount]
+ *
+ * Each step's input is packed into 16 bits, a down and a released bit for every button, and runs
+ * of steps with the same input are stored once with a repeat count. Nobody changes their input 60
+ * times a second, so an hour of play is a few tens of kilobytes.
+ *
+ * NOTE:
+ * 			Replays are only exact with the engine build they were recorded with, since the
+ * 			snapshot is the engine's own layout and floating point results can change between builds.
+ */
+#define NXREC_MAGIC 0x4352584E // "NXRC"
+#define NXREC_VERSION 1
+#define NXREC_MAX_REPEAT 0xFFFF
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct nxrec_header
+{
+	u32 magic;
+	u32 version;
+	u32 stepsPerSecond;
+	u32 snapshotSize;
+	u64 stepCount;
+	u64 runCount;
+} nxrec_header;
+
+typedef struct nxrec_run
+{
+	u16 buttons;
+	u16 repeat; // Steps in the run, at least one.
+} nxrec_run;
+
+#pragma pack(pop)
+
+#define NXREC_BUTTON_COUNT (sizeof(input) / sizeof(button))
+static_assert(NXREC_BUTTON_COUNT <= 8, "A step's input no longer fits into 16 bits.");
+
+inline u16
+PackInput(input* frameInput)
+{
+	button* _buttons = (button*)frameInput;
+	u16 _packed = 0;
+	for (u32 _index = 0; _index < NXREC_BUTTON_COUNT; ++_index)
+	{
+		if (_buttons[_index].down) _packed |= (u16)(1 << _index);
+		if (_buttons[_index].released) _packed |= (u16)(1 << (_index + 8));
+	}
+	return _packed;
+}
+
+inline void
+UnpackInput(u16 packed, input* frameInput)
+{
+	button* _buttons = (button*)frameInput;
+	for (u32 _index = 0; _index < NXREC_BUTTON_COUNT; ++_index)
+	{
+		_buttons[_index].down = (packed >> _index) & 1;
+		_buttons[_index].released = (packed >> (_index + 8)) & 1;
+	}
+}
+
+/**
+ * Recording.
+ *
+ * The file is built in memory as the steps come in, on an arena over reserved memory, so it only
+ * commits what the recording grows into. Once the arena is full the recording stops, and what was
+ * recorded up to then is still a complete file.
+ */
+typedef struct input_recorder
+{
+	memarena_t arena;
+	nxrec_header* header;
+	nxrec_run* lastRun;
+	b32 full;
+} input_recorder;
+
+/**
+ * Starts a recording in the given reserved memory and returns where the snapshot goes, which the
+ * caller fills in with the simulation's state before the first step is recorded. Returns NULL if the
+ * memory can't even fit the snapshot.
+ */
+internal void*
+BeginInputRecording(input_recorder* recorder, void* memory, u64 size, u32 stepsPerSecond, u32 snapshotSize)
+{
+
+	*recorder = {};
+	if (size < sizeof(nxrec_header) + snapshotSize) return NULL;
+
+	recorder->arena = CreateVirtualMemoryArena(memory, size);
+	recorder->header = PushStruct(&recorder->arena, nxrec_header);
+	recorder->header->magic = NXREC_MAGIC;
+	recorder->header->version = NXREC_VERSION;
+	recorder->header->stepsPerSecond = stepsPerSecond;
+	recorder->header->snapshotSize = snapshotSize;
+	recorder->header->stepCount = 0;
+	recorder->header->runCount = 0;
+	return PushSize(&recorder->arena, snapshotSize);
+
+}
+
+/**
+ * Records the input for the next step.
+ */
+internal void
+RecordInput(input_recorder* recorder, input* frameInput)
+{
+
+	if (recorder->header == NULL || recorder->full) return;
+
+	u16 _buttons = PackInput(frameInput);
+	if (recorder->lastRun && recorder->lastRun->buttons == _buttons && recorder->lastRun->repeat < NXREC_MAX_REPEAT)
+	{
+		recorder->lastRun->repeat++;
+	}
+	else
+	{
+		if (recorder->arena.commit + sizeof(nxrec_run) > recorder->arena.length)
+		{
+			recorder->full = true;
+			return;
+		}
+
+		recorder->lastRun = PushStruct(&recorder->arena, nxrec_run);
+		recorder->lastRun->buttons = _buttons;
+		recorder->lastRun->repeat = 1;
+		recorder->header->runCount++;
+	}
+	recorder->header->stepCount++;
+
+}
+
+/**
+ * The recording so far, as the contents of a .nxrec file. Returns the size.
+ */
+inline u64
+GetInputRecording(input_recorder* recorder, void** data)
+{
+	*data = recorder->arena.base;
+	return (u64)recorder->arena.commit;
+}
+
+/**
+ * Replaying.
+ */
+typedef struct input_replay
+{
+	nxrec_header* header;
+	void* snapshot;
+	nxrec_run* runs;
+
+	u64 runIndex;
+	u32 repeatIndex;
+	u64 stepIndex;
+} input_replay;
+
+/**
+ * Opens a recording which is already in memory. Returns false if it isn't one we can read.
+ */
+internal b32
+OpenInputReplay(input_replay* replay, void* data, u64 size)
+{
+
+	*replay = {};
+	if (data == NULL || size < sizeof(nxrec_header)) return false;
+
+	nxrec_header* header = (nxrec_header*)data;
+	if (header->magic != NXREC_MAGIC || header->version != NXREC_VERSION || header->stepsPerSecond == 0) return false;
+	if ((u64)header->snapshotSize > size - sizeof(nxrec_header)) return false;
+	if (header->runCount > (size - sizeof(nxrec_header) - header->snapshotSize) / sizeof(nxrec_run)) return false;
+
+	replay->header = header;
+	replay->snapshot = (u8*)data + sizeof(nxrec_header);
+	replay->runs = (nxrec_run*)((u8*)replay->snapshot + header->snapshotSize);
+
+	u64 _steps = 0;
+	for (u64 _runIndex = 0; _runIndex < header->runCount; ++_runIndex)
+	{
+		if (replay->runs[_runIndex].repeat == 0) return false;
+		_steps += replay->runs[_runIndex].repeat;
+	}
+	if (_steps != header->stepCount) return false;
+
+	return true;
+
+}
+
+/**
+ * Reads the input for the next step. Returns false once every step has been replayed.
+ */
+internal b32
+ReadReplayInput(input_replay* replay, input* frameInput)
+{
+
+	if (replay->runIndex >= replay->header->runCount) return false;
+
+	nxrec_run* _run = &replay->runs[replay->runIndex];
+	UnpackInput(_run->buttons, frameInput);
+	if (++replay->repeatIndex == _run->repeat)
+	{
+		replay->repeatIndex = 0;
+		replay->runIndex++;
+	}
+	replay->stepIndex++;
+	return true;
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef NINETAILSX_SIMD_H
+#define NINETAILSX_SIMD_H
+#include <nxcore/helpers.h>
+
+/**
+ * Instruction set detection and the glue we need to compile SIMD kernels for instruction sets
+ * beyond the compiler's baseline. Kernels are compiled per instruction set and selected once at
+ * runtime, so a single engine binary runs on everything from SSE2 to AVX-512.
+ *
+ * NOTE:
+ * 			MSVC lets us use any intrinsic without special flags. GCC and Clang require the function
+ * 			containing the intrinsic to be tagged with the target it is compiled for, which is what
+ * 			the NX_TARGET_* macros are for. A tagged function must only be called once we know the
+ * 			CPU supports it.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NINETAILSX_ARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(NINETAILSX_ARCH_X86) && !defined(_MSC_VER)
+#define NX_TARGET_SSE2 __attribute__((target("sse2")))
+#define NX_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define NX_TARGET_AVX2 __attribute__((target("avx2")))
+#define NX_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define NX_TARGET_SSE2
+#define NX_TARGET_SSE41
+#define NX_TARGET_AVX2
+#define NX_TARGET_AVX512
+#endif
+
+/**
+ * The instruction set levels we compile kernels for. Each level implies the ones below it.
+ */
+enum simd_level
+{
+	SIMD_LEVEL_SCALAR = 0,
+	SIMD_LEVEL_SSE2,
+	SIMD_LEVEL_AVX2,
+	SIMD_LEVEL_AVX512,
+};
+
+typedef struct cpu_features
+{
+	b32 sse2;
+	b32 sse41;
+	b32 avx2;
+	b32 avx512f;
+	b32 avx512bw;
+} cpu_features;
+
+#if defined(NINETAILSX_ARCH_X86)
+inline void
+__nx_cpuid(u32 Leaf, u32 Subleaf, u32* Registers)
+{
+#if defined(_MSC_VER)
+	__cpuidex((int*)Registers, (int)Leaf, (int)Subleaf);
+#else
+	__cpuid_count(Leaf, Subleaf, Registers[0], Registers[1], Registers[2], Registers[3]);
+#endif
+}
+
+// Reads XCR0, the register the OS uses to tell us which vector states it saves on a context switch.
+inline u64
+__nx_xgetbv()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	u32 eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((u64)edx << 32) | eax;
+#endif
+}
+#endif
+
+/**
+ * Queries the CPU through cpuid. It isn't enough that the CPU supports AVX, the OS has to have
+ * enabled the wider register state as well (XCR0), otherwise the first AVX instruction faults.
+ */
+internal cpu_features
+QueryCPUFeatures()
+{
+
+	cpu_features _features = {};
+
+#if defined(NINETAILSX_ARCH_X86)
+	u32 Registers[4] = {};
+	__nx_cpuid(0, 0, Registers);
+	u32 MaxLeaf = Registers[0];
+
+	__nx_cpuid(1, 0, Registers);
+	_features.sse2 = (Registers[3] >> 26) & 1;
+	_features.sse41 = (Registers[2] >> 19) & 1;
+	b32 OSXSave = (Registers[2] >> 27) & 1;
+	b32 AVX = (Registers[2] >> 28) & 1;
+
+	u64 XCR0 = OSXSave ? __nx_xgetbv() : 0;
+	b32 OSSavesYMM = (XCR0 & 0x06) == 0x06;
+	b32 OSSavesZMM = (XCR0 & 0xE6) == 0xE6;
+
+	if (MaxLeaf >= 7)
+	{
+		__nx_cpuid(7, 0, Registers);
+		_features.avx2 = AVX && OSSavesYMM && ((Registers[1] >> 5) & 1);
+		_features.avx512f = OSSavesZMM && ((Registers[1] >> 16) & 1);
+		_features.avx512bw = OSSavesZMM && ((Registers[1] >> 30) & 1);
+	}
+#endif
+
+	return _features;
+
+}
+
+/**
+ * The detected features are cached the first time they are asked for. The level cap lets the
+ * benchmarks (or a user on a misbehaving machine) force a lower instruction set.
+ */
+global cpu_features __nx_cpu_features;
+global b32 __nx_cpu_features_queried;
+global simd_level __nx_simd_level_cap = SIMD_LEVEL_AVX512;
+
+inline cpu_features*
+GetCPUFeatures()
+{
+	if (!__nx_cpu_features_queried)
+	{
+		__nx_cpu_features = QueryCPUFeatures();
+		__nx_cpu_features_queried = true;
+	}
+	return &__nx_cpu_features;
+}
+
+/**
+ * Returns the highest instruction set level we can run kernels at.
+ */
+inline simd_level
+GetSIMDLevel()
+{
+	cpu_features* Features = GetCPUFeatures();
+	simd_level _level = SIMD_LEVEL_SCALAR;
+	if (Features->sse2) _level = SIMD_LEVEL_SSE2;
+	if (Features->sse2 && Features->avx2) _level = SIMD_LEVEL_AVX2;
+	if (Features->avx2 && Features->avx512f && Features->avx512bw) _level = SIMD_LEVEL_AVX512;
+	return (_level > __nx_simd_level_cap ? __nx_simd_level_cap : _level);
+}
+
+/**
+ * Caps the instruction set level. Kernels which have already been selected need to be
+ * re-selected for this to take effect.
+ */
+inline void
+SetSIMDLevelCap(simd_level Level)
+{
+	__nx_simd_level_cap = Level;
+}
+
+inline const char*
+GetSIMDLevelName(simd_level Level)
+{
+	switch (Level)
+	{
+		case SIMD_LEVEL_SSE2: return "sse2";
+		case SIMD_LEVEL_AVX2: return "avx2";
+		case SIMD_LEVEL_AVX512: return "avx512";
+		default: return "scalar";
+	}
+}
+
+#endif
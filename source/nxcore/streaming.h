@@ -0,0 +1,211 @@
+#ifndef NINETAILSX_STREAMING_H
+#define NINETAILSX_STREAMING_H
+#include <nxcore/helpers.h>
+#include <nxcore/memory.h>
+#include <nxcore/core.h>
+#include <nxcore/string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * The resource stream.
+ *
+ * Serves the asynchronous resource requests in core.h for the platforms. A small pool of I/O
+ * threads takes requests off a FIFO, reads each file with the platform's FetchResourceFile, runs
+ * the request's process callback and moves it onto the completion queue, which the engine drains
+ * once a frame through PollResources.
+ *
+ * NOTE:
+ * 			Requests are only ever submitted and polled from the engine's thread. The I/O threads
+ * 			never touch the engine's arenas, the buffers are pushed when the request is submitted
+ * 			and the process only ever pushes on the request's own output arena.
+ */
+#define RESOURCE_STREAM_CAPACITY 256
+#define RESOURCE_STREAM_MAX_THREADS 8
+#define RESOURCE_STREAM_PATH_LENGTH 260
+
+typedef struct resource_request
+{
+	resource_ticket Ticket;
+	char Path[RESOURCE_STREAM_PATH_LENGTH];
+	void* Buffer;
+	u64 Size;
+	memarena_t Output; // Over OutputSize bytes pushed after the buffer, empty without any.
+	fnptr_resource_process* Process;
+	void* UserData;
+	b32 Succeeded;
+} resource_request;
+
+typedef struct resource_stream
+{
+	fnptr_platform_fetch_res_file* FetchResourceFile;
+	fnptr_platform_fetch_res_size* FetchResourceSize;
+
+	// Slots are handed out from the free list, then queued by index as pending and then completed.
+	resource_request Requests[RESOURCE_STREAM_CAPACITY];
+	u32 FreeSlots[RESOURCE_STREAM_CAPACITY];
+	u32 FreeCount;
+	u32 Pending[RESOURCE_STREAM_CAPACITY];
+	u32 PendingHead, PendingTail;
+	u32 Completed[RESOURCE_STREAM_CAPACITY];
+	u32 CompletedHead, CompletedTail;
+	resource_ticket NextTicket;
+
+	u32 ThreadCount;
+	std::thread Threads[RESOURCE_STREAM_MAX_THREADS];
+	b32 Running;
+
+	std::mutex Lock;
+	std::condition_variable WakeThreads;
+} resource_stream;
+
+internal void
+__resource_stream_thread(resource_stream* Stream)
+{
+	NX_PROFILE_THREAD("Resource I/O");
+
+	std::unique_lock<std::mutex> Guard(Stream->Lock);
+	for (;;)
+	{
+		Stream->WakeThreads.wait(Guard, [Stream]{ return Stream->PendingHead != Stream->PendingTail || !Stream->Running; });
+		if (!Stream->Running) return;
+
+		u32 Slot = Stream->Pending[Stream->PendingHead++ % RESOURCE_STREAM_CAPACITY];
+		resource_request* Request = &Stream->Requests[Slot];
+		Guard.unlock();
+
+		Request->Succeeded = (Stream->FetchResourceFile(Request->Path, Request->Buffer, (u32)Request->Size) != 0);
+		if (Request->Succeeded && Request->Process)
+		{
+			NX_PROFILE_SCOPE("ProcessResource");
+			Request->Succeeded = Request->Process(Request->Buffer, Request->Size,
+				(Request->Output.length ? &Request->Output : NULL), Request->UserData);
+		}
+
+		Guard.lock();
+		Stream->Completed[Stream->CompletedTail++ % RESOURCE_STREAM_CAPACITY] = Slot;
+	}
+}
+
+/**
+ * Starts the I/O threads, which read files through the given platform functions.
+ */
+internal void
+StartResourceStream(resource_stream* Stream, u32 ThreadCount,
+	fnptr_platform_fetch_res_file* FetchResourceFile, fnptr_platform_fetch_res_size* FetchResourceSize)
+{
+	if (ThreadCount == 0) ThreadCount = 1;
+	if (ThreadCount > RESOURCE_STREAM_MAX_THREADS) ThreadCount = RESOURCE_STREAM_MAX_THREADS;
+
+	Stream->FetchResourceFile = FetchResourceFile;
+	Stream->FetchResourceSize = FetchResourceSize;
+	Stream->FreeCount = RESOURCE_STREAM_CAPACITY;
+	for (u32 Slot = 0; Slot < RESOURCE_STREAM_CAPACITY; ++Slot)
+		Stream->FreeSlots[Slot] = RESOURCE_STREAM_CAPACITY - 1 - Slot;
+	Stream->PendingHead = Stream->PendingTail = 0;
+	Stream->CompletedHead = Stream->CompletedTail = 0;
+	Stream->NextTicket = 1;
+	Stream->Running = true;
+
+	Stream->ThreadCount = ThreadCount;
+	for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ++ThreadIndex)
+		Stream->Threads[ThreadIndex] = std::thread(&__resource_stream_thread, Stream);
+}
+
+/**
+ * Sizes the file, pushes its buffer and OutputSize bytes of output on Arena and queues the read.
+ * Returns zero if the file doesn't exist, is too long a path, doesn't fit on Arena along with the
+ * output, or every slot is in use.
+ */
+internal resource_ticket
+SubmitResourceRequest(resource_stream* Stream, char* RelativePath, memarena_t* Arena, u64 OutputSize,
+	fnptr_resource_process* Process, void* UserData)
+{
+
+	u32 PathSize = StringSize(RelativePath);
+	if (PathSize > RESOURCE_STREAM_PATH_LENGTH) return 0;
+
+	u32 Size = Stream->FetchResourceSize(RelativePath);
+	if (Size == 0) return 0;
+	if ((u64)Size + 64 + OutputSize + 64 > Arena->length - Arena->commit) return 0;
+
+	u32 Slot;
+	{
+		std::lock_guard<std::mutex> Guard(Stream->Lock);
+		if (Stream->FreeCount == 0) return 0;
+		Slot = Stream->FreeSlots[--Stream->FreeCount];
+	}
+
+	// The slot is ours until it is queued, so it can be filled in without the lock.
+	resource_request* Request = &Stream->Requests[Slot];
+	Request->Ticket = Stream->NextTicket++;
+	if (Stream->NextTicket == 0) Stream->NextTicket = 1;
+	nx_memcopy(Request->Path, RelativePath, PathSize);
+	Request->Buffer = PushSizeAligned(Arena, Size, 64);
+	Request->Size = Size;
+	Request->Output = {};
+	if (OutputSize) Request->Output = CreateMemoryArena(PushSizeAligned(Arena, OutputSize, 64), OutputSize);
+	Request->Process = Process;
+	Request->UserData = UserData;
+	Request->Succeeded = false;
+
+	{
+		std::lock_guard<std::mutex> Guard(Stream->Lock);
+		Stream->Pending[Stream->PendingTail++ % RESOURCE_STREAM_CAPACITY] = Slot;
+	}
+	Stream->WakeThreads.notify_one();
+
+	return Request->Ticket;
+
+}
+
+/**
+ * Copies out up to MaxCount finished requests and frees their slots. Returns how many there were.
+ */
+internal u32
+PollResourceCompletions(resource_stream* Stream, resource_completion* Completions, u32 MaxCount)
+{
+
+	std::lock_guard<std::mutex> Guard(Stream->Lock);
+
+	u32 _count = 0;
+	while (_count < MaxCount && Stream->CompletedHead != Stream->CompletedTail)
+	{
+		u32 Slot = Stream->Completed[Stream->CompletedHead++ % RESOURCE_STREAM_CAPACITY];
+		resource_request* Request = &Stream->Requests[Slot];
+
+		resource_completion* Completion = &Completions[_count++];
+		Completion->ticket = Request->Ticket;
+		Completion->success = Request->Succeeded;
+		Completion->data = Request->Buffer;
+		Completion->size = Request->Size;
+		Completion->output = (Request->Output.length ? Request->Output.base : NULL);
+		Completion->outputSize = Request->Output.commit;
+		Completion->userData = Request->UserData;
+
+		Stream->FreeSlots[Stream->FreeCount++] = Slot;
+	}
+
+	return _count;
+
+}
+
+/**
+ * Stops and joins the I/O threads. Requests which haven't started are dropped.
+ */
+internal void
+StopResourceStream(resource_stream* Stream)
+{
+	{
+		std::lock_guard<std::mutex> Guard(Stream->Lock);
+		Stream->Running = false;
+	}
+	Stream->WakeThreads.notify_all();
+
+	for (u32 ThreadIndex = 0; ThreadIndex < Stream->ThreadCount; ++ThreadIndex)
+		Stream->Threads[ThreadIndex].join();
+	Stream->ThreadCount = 0;
+}
+
+#endif
@@ -9,7 +9,7 @@
  * will return 0.
  */
 internal u32
-StringLength_s(char* string, u32 buff_size)
+StringLength_s(const char* string, u32 buff_size)
 {
 
 	u32 _size = 0;
@@ -36,7 +36,7 @@ StringLength_s(char* string, u32 buff_size)
  * string.
  */
 internal u32
-StringLength(char* string)
+StringLength(const char* string)
 {
 
 	u32 _size = 0;
@@ -49,7 +49,7 @@ StringLength(char* string)
  * Returns, in bytes, the size of a given string. This assumes that the string is null-terminated.
  */
 internal u32
-StringSize(char* string)
+StringSize(const char* string)
 {
 	u32 _size = StringLength(string) + 1; // Accounts for the null-terminated portion.
 	return _size;
@@ -60,7 +60,7 @@ StringSize(char* string)
  * "safe" method.
  */
 internal void
-ConcatenateStrings_s(char* a, u32 a_length, char* b, u32 b_length, char* dest, u32 dest_length)
+ConcatenateStrings_s(char* a, u32 a_length, const char* b, u32 b_length, char* dest, u32 dest_length)
 {
 
 	u32 _a_size_proper = StringLength_s(a, a_length);
@@ -74,7 +74,7 @@ ConcatenateStrings_s(char* a, u32 a_length, char* b, u32 b_length, char* dest, u
 
 	// Copy everything over to the dest buffer.
 	nx_memcopy(dest, a, _a_size_proper);
-	nx_memcopy(dest+_a_size_proper, b, _b_size_proper);
+	nx_memcopy(dest+_a_size_proper, (char*)b, _b_size_proper);
 	
 	// Null terminate the string.
 	*(dest+_a_size_proper+_b_size_proper) = '\0';
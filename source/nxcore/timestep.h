@@ -0,0 +1,99 @@
+#ifndef NINETAILSX_TIMESTEP_H
+#define NINETAILSX_TIMESTEP_H
+#include <nxcore/helpers.h>
+#include <nxcore/clock.h>
+
+/**
+ * The fixed timestep.
+ *
+ * Decouples the simulation from the rate frames are drawn at. The platform feeds the real time
+ * that passed since the last frame into an accumulator, then runs EngineUpdate once for every whole
+ * step in it, which might be none at all on a fast host or several on a slow one. What is left over
+ * is how far the frame sits between the last two steps, and EngineRender gets it as an alpha to
+ * interpolate by:
+ *
+ * 		u32 steps = AdvanceFixedTimestep(&timestep);
+ * 		for (u32 step = 0; step < steps; ++step) EngineUpdate(...);
+ * 		EngineRender(..., GetTimestepAlpha(&timestep));
+ *
+ * So the simulation always advances by the same step, however long frames take. A host which can't
+ * keep up drops frames rather than slowing the game down, and one which renders faster than the
+ * step shows smoothly interpolated frames in between.
+ *
+ * NOTE:
+ * 			A frame which would need more than NX_TIMESTEP_MAX_STEPS updates to catch up (a long
+ * 			hitch, or a host where the update itself takes longer than a step) runs only that many,
+ * 			and the rest of the time is dropped. Without the cap each slow frame would owe more
+ * 			updates to the next, which then runs slower still.
+ */
+#ifndef NX_TIMESTEP_MAX_STEPS
+#define NX_TIMESTEP_MAX_STEPS 8
+#endif
+
+typedef struct fixed_timestep
+{
+	u64 stepNanoseconds;
+	u64 accumulator;
+	u64 lastStamp;
+
+	u64 stepCount; // Steps run since the timestep was created.
+	u64 droppedTime; // Time thrown away by NX_TIMESTEP_MAX_STEPS.
+} fixed_timestep;
+
+/**
+ * Creates a timestep which runs the simulation the given number of times a second, starting now.
+ */
+inline fixed_timestep
+CreateFixedTimestep(u32 stepsPerSecond)
+{
+	fixed_timestep _timestep = {};
+	_timestep.stepNanoseconds = 1000000000ull / stepsPerSecond;
+	_timestep.lastStamp = GetClockNanoseconds();
+	return _timestep;
+}
+
+/**
+ * Adds the time since the last call to the accumulator and takes out the steps which are due.
+ * Returns how many updates to run this frame. Call it once per frame.
+ */
+inline u32
+AdvanceFixedTimestep(fixed_timestep* timestep)
+{
+
+	u64 _now = GetClockNanoseconds();
+	timestep->accumulator += _now - timestep->lastStamp;
+	timestep->lastStamp = _now;
+
+	u64 _steps = timestep->accumulator / timestep->stepNanoseconds;
+	timestep->accumulator -= _steps * timestep->stepNanoseconds;
+	if (_steps > NX_TIMESTEP_MAX_STEPS)
+	{
+		timestep->droppedTime += (_steps - NX_TIMESTEP_MAX_STEPS) * timestep->stepNanoseconds;
+		_steps = NX_TIMESTEP_MAX_STEPS;
+	}
+
+	timestep->stepCount += _steps;
+	return (u32)_steps;
+
+}
+
+/**
+ * How far the current frame is between the last step and the next one, from 0 up to (but not
+ * including) 1.
+ */
+inline r32
+GetTimestepAlpha(fixed_timestep* timestep)
+{
+	return (r32)timestep->accumulator / (r32)timestep->stepNanoseconds;
+}
+
+/**
+ * The step in milliseconds, which is what action_interface::frameStep carries to the engine.
+ */
+inline r32
+GetTimestepMilliseconds(fixed_timestep* timestep)
+{
+	return (r32)timestep->stepNanoseconds / 1000000.0f;
+}
+
+#endif
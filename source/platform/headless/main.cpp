@@ -0,0 +1,266 @@
+/**
+ *
+ * The headless runner.
+ *
+ * Loads the engine library and runs it as fast as it will go, with no window, no presentation
+ * and no frame pacing, so the numbers it reports are the cost of the engine frame alone. This is
+ * what we track for regressions on CI boxes. Every frame is exactly one simulation step and one
+ * render, rather than however many steps the clock says are due, so runs stay comparable.
+ *
+ * Usage:
+ * 			NinetailsXHeadless [--frames N] [--warmup N] [--trace PATH] [--replay PATH] [--dirty]
+ *
+ * 			--frames N		The number of measured frames (default 1000, or the whole replay).
+ * 			--warmup N		Frames which run before measuring starts (default 60).
+ * 			--trace PATH	Writes the profiler's trace of the last measured frames to PATH, see
+ * 							nxcore/profiler.h.
+ * 			--replay PATH	Measures a recording made with the Linux host's --record (see
+ * 							nxcore/replay.h) instead of a simulation nobody touches. Warmup runs
+ * 							without input, then the simulation is put back to where the recording
+ * 							starts, so every run measures the same frames.
+ * 			--dirty			Lets the engine skip tiles which didn't change and present only the
+ * 							dirty regions, as the windowed hosts do. By default every frame is
+ * 							drawn and presented whole, otherwise a static scene measures nothing.
+ */
+
+#include <platform/linux/loader.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct headless_state
+{
+	res_handler_interface ResourceHandlerInterface;
+	engine_library EngineLibrary;
+	window_props WindowProperties;
+	void* appMemStore;
+	u64 appMemSize;
+	action_interface InputHandle;
+	input FrameInput;
+} headless_state;
+
+internal i32
+CompareFrameTimes(const void* lhs, const void* rhs)
+{
+	u64 a = *(const u64*)lhs;
+	u64 b = *(const u64*)rhs;
+	return (a > b) - (a < b);
+}
+
+/**
+ * Returns the nearest-rank percentile of a sorted sample set.
+ */
+internal u64
+GetPercentile(u64* SortedSamples, u64 SampleCount, r64 Percentile)
+{
+	u64 Rank = (u64)(Percentile * (r64)SampleCount + 0.5);
+	if (Rank > 0) Rank -= 1;
+	if (Rank >= SampleCount) Rank = SampleCount - 1;
+	return SortedSamples[Rank];
+}
+
+i32
+main(i32 argc, char** argv)
+{
+
+	u64 FrameCount = 1000;
+	u64 WarmupCount = 60;
+	char* TracePath = NULL;
+	char* ReplayPath = NULL;
+	b32 FrameCountGiven = false;
+	b32 SkipUnchanged = false;
+	for (i32 argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		if (strcmp(argv[argIndex], "--frames") == 0 && argIndex+1 < argc)
+		{
+			FrameCount = strtoull(argv[++argIndex], NULL, 10);
+			FrameCountGiven = true;
+		}
+		else if (strcmp(argv[argIndex], "--warmup") == 0 && argIndex+1 < argc)
+			WarmupCount = strtoull(argv[++argIndex], NULL, 10);
+		else if (strcmp(argv[argIndex], "--trace") == 0 && argIndex+1 < argc)
+			TracePath = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "--replay") == 0 && argIndex+1 < argc)
+			ReplayPath = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "--dirty") == 0)
+			SkipUnchanged = true;
+		else
+		{
+			fprintf(stderr, "Usage: %s [--frames N] [--warmup N] [--trace PATH] [--replay PATH] [--dirty]\n", argv[0]);
+			return 1;
+		}
+	}
+	headless_state _state = {};
+	headless_state* State = &_state;
+
+	if (!LinuxResolveBasePath()) return 1;
+
+	char modulePath[PATH_MAX];
+	LinuxGetAbsolutePath((char*)"libNinetailsXEngine.so", modulePath, PATH_MAX);
+	if (!InitializeNinetailsXEngine(modulePath, &State->EngineLibrary)) return 1;
+
+	State->ResourceHandlerInterface.FetchResourceFile = &FetchResourceFile;
+	State->ResourceHandlerInterface.FetchResourceSize = &FetchResourceSize;
+	State->ResourceHandlerInterface.MapResource = &MapResource;
+	State->ResourceHandlerInterface.UnmapResource = &UnmapResource;
+	State->ResourceHandlerInterface.RequestResource = &RequestResource;
+	State->ResourceHandlerInterface.PollResources = &PollResources;
+	State->ResourceHandlerInterface.Profiler = LinuxCreateProfiler();
+	NX_PROFILE_THREAD("Main");
+	LinuxStartResourceStream(2);
+
+	/**
+	 * The same memory store the windowed hosts hand to the engine. It is only reserved here, the
+	 * engine commits it as it goes.
+	 */
+#define VIRTUAL_ALLOCATION_SIZE Megabytes(512)
+	State->appMemSize = VIRTUAL_ALLOCATION_SIZE;
+	State->appMemStore = ReserveVirtualMemory(NULL, State->appMemSize);
+	if (State->appMemStore == NULL)
+	{
+		fprintf(stderr, "Unable to allocate the engine memory store.\n");
+		return 1;
+	}
+
+	engine_library& EngineLib = State->EngineLibrary;
+	State->WindowProperties.fullRedraw = !SkipUnchanged;
+	if (EngineLib.EngineInit(State->appMemStore, State->appMemSize, &State->WindowProperties,
+		&State->ResourceHandlerInterface) != 0)
+	{
+		fprintf(stderr, "The engine failed to initialize.\n");
+		return 1;
+	}
+
+	// Without a replay no input is ever pressed, the simulation still steps at the fixed target.
+	u32 StepsPerSecond = 60;
+	input_replay Replay = {};
+	mapped_resource ReplayFile = {};
+	if (ReplayPath)
+	{
+		if (!LinuxOpenInputReplay(&Replay, &ReplayFile, &EngineLib, ReplayPath)) return 1;
+		StepsPerSecond = Replay.header->stepsPerSecond;
+		if (!FrameCountGiven || FrameCount > Replay.header->stepCount) FrameCount = Replay.header->stepCount;
+	}
+	if (FrameCount == 0) FrameCount = 1;
+
+	State->FrameInput = {};
+	State->InputHandle.frame_input = &State->FrameInput;
+	State->InputHandle.frameStep = (r32)1000 / (r32)StepsPerSecond;
+
+	u64* FrameTimes = (u64*)mmap(NULL, FrameCount*sizeof(u64), PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (FrameTimes == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to allocate the frame time samples.\n");
+		return 1;
+	}
+
+	for (u64 FrameIndex = 0; FrameIndex < WarmupCount; ++FrameIndex)
+	{
+		EngineLib.EngineUpdate(&State->InputHandle);
+		EngineLib.EngineRender(&State->WindowProperties, 0.0f);
+	}
+
+	// The warmup moved the simulation on, the replay has to start where it was recorded from.
+	if (ReplayPath) EngineLib.EngineLoadState(Replay.snapshot, Replay.header->snapshotSize);
+
+	u64 PixelsWindow = 0;
+	u64 PixelsDirty = 0;
+	render_stats StatsTotal = {};
+	u64 RunStart = GetClockNanoseconds();
+	for (u64 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+	{
+		if (ReplayPath) ReadReplayInput(&Replay, &State->FrameInput);
+
+		u64 FrameStart = GetClockNanoseconds();
+		i32 EngineStatus = EngineLib.EngineUpdate(&State->InputHandle);
+		EngineStatus |= EngineLib.EngineRender(&State->WindowProperties, 0.0f);
+		FrameTimes[FrameIndex] = GetClockNanoseconds() - FrameStart;
+
+		PixelsWindow += (u64)State->WindowProperties.dimensions.width *
+			(u64)State->WindowProperties.dimensions.height;
+		for (u32 RegionIndex = 0; RegionIndex < State->WindowProperties.dirtyRegionCount; ++RegionIndex)
+		{
+			v2i RegionDims = GetRectDims(State->WindowProperties.dirtyRegions[RegionIndex]);
+			PixelsDirty += (u64)RegionDims.width * (u64)RegionDims.height;
+		}
+
+		render_stats* Stats = State->WindowProperties.renderStats;
+		StatsTotal.framebufferPixels = Stats->framebufferPixels;
+		StatsTotal.rectPixelsWritten += Stats->rectPixelsWritten;
+		StatsTotal.bitmapPixelsWritten += Stats->bitmapPixelsWritten;
+		StatsTotal.linePixelsWritten += Stats->linePixelsWritten;
+		StatsTotal.trianglePixelsWritten += Stats->trianglePixelsWritten;
+		StatsTotal.presentPixelsWritten += Stats->presentPixelsWritten;
+		StatsTotal.pixelsSubmitted += Stats->pixelsSubmitted;
+		StatsTotal.pixelsClipped += Stats->pixelsClipped;
+		StatsTotal.blits += Stats->blits;
+		StatsTotal.tilesRasterized += Stats->tilesRasterized;
+		StatsTotal.commandsDropped += Stats->commandsDropped;
+		StatsTotal.memcopyBytes += Stats->memcopyBytes;
+
+		if (EngineStatus != 0)
+		{
+			FrameCount = FrameIndex + 1;
+			break;
+		}
+	}
+	u64 RunTime = GetClockNanoseconds() - RunStart;
+
+	/**
+	 * Report. Times are per frame (one EngineUpdate and one EngineRender), fill is every pixel the
+	 * renderer actually wrote, drawing at the native resolution and scaling up into the bitmap the
+	 * engine hands back to the platform. Dirty is the share of that bitmap a windowed host would
+	 * have to present. The renderer's stats are averages per frame, overdraw against the native
+	 * resolution, see render_stats.
+	 */
+	qsort(FrameTimes, FrameCount, sizeof(u64), &CompareFrameTimes);
+
+	if (TracePath && State->ResourceHandlerInterface.Profiler)
+		LinuxWriteProfilerTrace(State->ResourceHandlerInterface.Profiler, TracePath);
+	EngineLib.EngineShutdown();
+	StopResourceStream(LinuxResourceStream);
+	if (ReplayPath) UnmapResource(&ReplayFile);
+
+	u64 FrameTimeSum = 0;
+	for (u64 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+		FrameTimeSum += FrameTimes[FrameIndex];
+
+	r64 NanosecondsToMilliseconds = 1.0 / 1000000.0;
+	u64 PixelsWritten = StatsTotal.rectPixelsWritten + StatsTotal.bitmapPixelsWritten + StatsTotal.linePixelsWritten +
+		StatsTotal.trianglePixelsWritten + StatsTotal.presentPixelsWritten;
+	r64 PixelsPerSecond = (r64)PixelsWritten / ((r64)FrameTimeSum / 1000000000.0);
+
+	printf("NinetailsX headless :: %llu frames at %dx%d (%llu warmup, %s)\n", (unsigned long long)FrameCount,
+		State->WindowProperties.dimensions.width, State->WindowProperties.dimensions.height,
+		(unsigned long long)WarmupCount, (SkipUnchanged ? "dirty regions" : "full redraw"));
+	if (ReplayPath) printf("  replay  %s\n", ReplayPath);
+	printf("  min     %9.4f ms\n", (r64)FrameTimes[0] * NanosecondsToMilliseconds);
+	printf("  median  %9.4f ms\n", (r64)GetPercentile(FrameTimes, FrameCount, 0.50) * NanosecondsToMilliseconds);
+	printf("  p99     %9.4f ms\n", (r64)GetPercentile(FrameTimes, FrameCount, 0.99) * NanosecondsToMilliseconds);
+	printf("  max     %9.4f ms\n", (r64)FrameTimes[FrameCount-1] * NanosecondsToMilliseconds);
+	printf("  mean    %9.4f ms\n", ((r64)FrameTimeSum / (r64)FrameCount) * NanosecondsToMilliseconds);
+	printf("  total   %9.4f ms\n", (r64)RunTime * NanosecondsToMilliseconds);
+	printf("  fill    %9.2f Mpixels/s\n", PixelsPerSecond / 1000000.0);
+	printf("  dirty   %9.2f %%\n", 100.0 * (r64)PixelsDirty / (r64)PixelsWindow);
+
+	r64 PerFrame = 1.0 / (r64)FrameCount;
+	r64 Framebuffer = (r64)StatsTotal.framebufferPixels;
+	printf("Renderer :: per frame at %llu native pixels\n", (unsigned long long)StatsTotal.framebufferPixels);
+	printf("  overdraw   %9.3f x (%.3f x submitted)\n",
+		(r64)(StatsTotal.rectPixelsWritten + StatsTotal.bitmapPixelsWritten + StatsTotal.linePixelsWritten +
+			StatsTotal.trianglePixelsWritten) * PerFrame / Framebuffer,
+		(r64)StatsTotal.pixelsSubmitted * PerFrame / Framebuffer);
+	printf("  rects      %9.0f pixels\n", (r64)StatsTotal.rectPixelsWritten * PerFrame);
+	printf("  bitmaps    %9.0f pixels, %.1f blits\n", (r64)StatsTotal.bitmapPixelsWritten * PerFrame,
+		(r64)StatsTotal.blits * PerFrame);
+	printf("  lines      %9.0f pixels\n", (r64)StatsTotal.linePixelsWritten * PerFrame);
+	printf("  triangles  %9.0f pixels\n", (r64)StatsTotal.trianglePixelsWritten * PerFrame);
+	printf("  present    %9.0f pixels\n", (r64)StatsTotal.presentPixelsWritten * PerFrame);
+	printf("  clipped    %9.0f pixels\n", (r64)StatsTotal.pixelsClipped * PerFrame);
+	printf("  tiles      %9.1f\n", (r64)StatsTotal.tilesRasterized * PerFrame);
+	printf("  dropped    %9.1f commands\n", (r64)StatsTotal.commandsDropped * PerFrame);
+	printf("  memcopy    %9.0f bytes\n", (r64)StatsTotal.memcopyBytes * PerFrame);
+
+	return 0;
+}
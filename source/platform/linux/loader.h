@@ -0,0 +1,356 @@
+/**
+ * Shared by the Linux hosts (the X11 platform and the headless runner). Loads the engine
+ * library and serves resource requests relative to the executable's directory.
+ */
+#ifndef NINETAILSX_LINUX_LOADER_H
+#define NINETAILSX_LINUX_LOADER_H
+#include <nxcore/core.h>
+#include <nxcore/string.h>
+#include <nxcore/streaming.h>
+#include <nxcore/clock.h>
+#include <nxcore/timestep.h>
+#include <nxcore/replay.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <stdio.h>
+
+typedef struct engine_library
+{
+	void* LibraryHandle;
+	fnptr_engine_init* EngineInit;
+	fnptr_engine_reinit* EngineReinit;
+	fnptr_engine_update* EngineUpdate;
+	fnptr_engine_render* EngineRender;
+	fnptr_engine_shutdown* EngineShutdown;
+	fnptr_engine_save_state* EngineSaveState;
+	fnptr_engine_load_state* EngineLoadState;
+} engine_library;
+
+/**
+ * The directory of the executable, with a trailing slash.
+ */
+global char LinuxBasePath[PATH_MAX];
+
+/**
+ * This will load the engine library code and assign it to the struct which carries the
+ * pointers to the necessary functions.
+ *
+ * dlopen / dlsym:
+ * 			https://man7.org/linux/man-pages/man3/dlopen.3.html
+ */
+internal i32
+InitializeNinetailsXEngine(char* dynamicLibraryFilePath, engine_library* EngineLibrary)
+{
+
+	EngineLibrary->LibraryHandle = dlopen(dynamicLibraryFilePath, RTLD_NOW|RTLD_LOCAL);
+	if (EngineLibrary->LibraryHandle == NULL)
+	{
+		fprintf(stderr, "Unable to load the engine library: %s\n", dlerror());
+		return 0;
+	}
+
+	EngineLibrary->EngineUpdate = (fnptr_engine_update*)dlsym(EngineLibrary->LibraryHandle, "EngineUpdate");
+	EngineLibrary->EngineRender = (fnptr_engine_render*)dlsym(EngineLibrary->LibraryHandle, "EngineRender");
+	EngineLibrary->EngineShutdown = (fnptr_engine_shutdown*)dlsym(EngineLibrary->LibraryHandle, "EngineShutdown");
+	EngineLibrary->EngineInit = (fnptr_engine_init*)dlsym(EngineLibrary->LibraryHandle, "EngineInit");
+	EngineLibrary->EngineReinit = (fnptr_engine_reinit*)dlsym(EngineLibrary->LibraryHandle, "EngineReinit");
+	EngineLibrary->EngineSaveState = (fnptr_engine_save_state*)dlsym(EngineLibrary->LibraryHandle, "EngineSaveState");
+	EngineLibrary->EngineLoadState = (fnptr_engine_load_state*)dlsym(EngineLibrary->LibraryHandle, "EngineLoadState");
+
+	if (EngineLibrary->EngineUpdate == NULL || EngineLibrary->EngineRender == NULL || EngineLibrary->EngineShutdown == NULL ||
+		EngineLibrary->EngineInit == NULL || EngineLibrary->EngineReinit == NULL ||
+		EngineLibrary->EngineSaveState == NULL || EngineLibrary->EngineLoadState == NULL)
+	{
+		fprintf(stderr, "The engine library is missing one or more entry points.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Builds an absolute path from a path relative to the executable's directory.
+ */
+internal void
+LinuxGetAbsolutePath(const char* RelativePath, char* Dest, u32 DestLength)
+{
+	ConcatenateStrings_s(LinuxBasePath, PATH_MAX, RelativePath,
+		StringSize(RelativePath), Dest, DestLength);
+}
+
+/**
+ * Resolves the directory of the executable into LinuxBasePath. The engine library and the
+ * assets are expected to sit next to the executable.
+ */
+internal b32
+LinuxResolveBasePath()
+{
+
+	char executablePath[PATH_MAX] = {};
+	ssize_t executablePathLength = readlink("/proc/self/exe", executablePath, PATH_MAX-1);
+	if (executablePathLength <= 0)
+	{
+		fprintf(stderr, "Unable to resolve the executable path.\n");
+		return false;
+	}
+
+	// Find location of last slash.
+	char* lastSlash = executablePath;
+	for (i32 offset = 0; executablePath[offset]; ++offset)
+	{
+		if (executablePath[offset] == '/')
+			lastSlash = &executablePath[offset+1];
+	}
+
+	// Copy everything up to last slash then null-terminate the string to get root dir.
+	u32 BasePathCount = (u32)(lastSlash - executablePath);
+	nx_memcopy(LinuxBasePath, executablePath, BasePathCount);
+	*(LinuxBasePath + BasePathCount) = '\0';
+
+	return true;
+
+}
+
+/**
+ * Fetches the size of a file from a relative path. This function looks at LinuxBasePath,
+ * therefore it must be resolved first in order for it to construct a valid path. A return value of 0 is considered a failure.
+ */
+internal u32
+FetchResourceSize(char* RelativePath)
+{
+
+	char _absolute_path[PATH_MAX];
+	LinuxGetAbsolutePath(RelativePath, _absolute_path, PATH_MAX);
+
+	struct stat _file_stat = {};
+	if (stat(_absolute_path, &_file_stat) != 0) return 0;
+
+#ifdef NINETAILSX_DEBUG
+	assert((u64)_file_stat.st_size < 0xFFFFFFFF);
+#endif
+
+	return (u32)_file_stat.st_size;
+
+}
+
+/**
+ * Fetches a file and stores the contents of the file into the buffer.
+ * This function looks at LinuxBasePath,
+ * therefore it must be resolved first in order for it to construct a valid path. Returns 0 if the
+ * file couldn't be found or read in full. This is also called from the I/O threads.
+ */
+internal u32
+FetchResourceFile(char* RelativePath, void* Buffer, u32 BufferSize)
+{
+
+	NX_PROFILE_SCOPE("FetchResource");
+	char _absolute_path[PATH_MAX];
+	LinuxGetAbsolutePath(RelativePath, _absolute_path, PATH_MAX);
+
+	i32 _resource_handle = open(_absolute_path, O_RDONLY);
+	if (_resource_handle < 0) return 0;
+
+	// pread() may return short, so keep going until we have everything or hit end of file.
+	u32 BytesRead = 0;
+	while (BytesRead < BufferSize)
+	{
+		ssize_t ReadCount = pread(_resource_handle, (u8*)Buffer + BytesRead, BufferSize - BytesRead, (off_t)BytesRead);
+		if (ReadCount < 0 && errno == EINTR) continue;
+		if (ReadCount <= 0) break;
+		BytesRead += (u32)ReadCount;
+	}
+
+	close(_resource_handle);
+
+	return (BytesRead == BufferSize);
+
+}
+
+/**
+ * Maps a whole file read-only into memory. The descriptor can be closed straight away, the
+ * mapping keeps the file alive until it is unmapped. Empty files can't be mapped and fail.
+ *
+ * mmap:
+ * 			https://man7.org/linux/man-pages/man2/mmap.2.html
+ */
+internal b32
+LinuxMapFile(char* Path, mapped_resource* Resource)
+{
+
+	*Resource = {};
+
+	i32 _resource_handle = open(Path, O_RDONLY);
+	if (_resource_handle < 0) return false;
+
+	struct stat _file_stat = {};
+	void* _data = MAP_FAILED;
+	if (fstat(_resource_handle, &_file_stat) == 0 && _file_stat.st_size > 0)
+		_data = mmap(NULL, (size_t)_file_stat.st_size, PROT_READ, MAP_PRIVATE, _resource_handle, 0);
+
+	close(_resource_handle);
+	if (_data == MAP_FAILED) return false;
+
+	Resource->data = _data;
+	Resource->size = (u64)_file_stat.st_size;
+	return true;
+
+}
+
+/**
+ * Maps a file relative to the executable's directory, see LinuxMapFile.
+ */
+internal b32
+MapResource(const char* RelativePath, mapped_resource* Resource)
+{
+
+	NX_PROFILE_SCOPE("MapResource");
+	char _absolute_path[PATH_MAX];
+	LinuxGetAbsolutePath(RelativePath, _absolute_path, PATH_MAX);
+	return LinuxMapFile(_absolute_path, Resource);
+
+}
+
+internal void
+UnmapResource(mapped_resource* Resource)
+{
+	if (Resource->data) munmap(Resource->data, (size_t)Resource->size);
+	*Resource = {};
+}
+
+/**
+ * The I/O threads behind RequestResource and PollResources. It is never destroyed, so an early
+ * exit can't trip over joinable threads, but hosts should still stop it on the way out.
+ */
+global resource_stream* LinuxResourceStream;
+
+internal void
+LinuxStartResourceStream(u32 ThreadCount)
+{
+	LinuxResourceStream = new resource_stream();
+	StartResourceStream(LinuxResourceStream, ThreadCount, &FetchResourceFile, &FetchResourceSize);
+}
+
+internal resource_ticket
+RequestResource(char* RelativePath, memarena_t* Arena, u64 OutputSize, fnptr_resource_process* Process, void* UserData)
+{
+	return SubmitResourceRequest(LinuxResourceStream, RelativePath, Arena, OutputSize, Process, UserData);
+}
+
+internal u32
+PollResources(resource_completion* Completions, u32 MaxCount)
+{
+	return PollResourceCompletions(LinuxResourceStream, Completions, MaxCount);
+}
+
+/**
+ * Creates the profiler the host and the engine record into, with a ring for every thread either of
+ * them is going to start. Only the rings which are written to are ever backed by memory.
+ */
+internal profiler*
+LinuxCreateProfiler()
+{
+	u32 MaxThreads = std::thread::hardware_concurrency() + 8;
+	u64 ProfilerSize = GetProfilerMemorySize(MaxThreads);
+	void* ProfilerMemory = ReserveVirtualMemory(NULL, ProfilerSize);
+	if (ProfilerMemory == NULL || !CommitVirtualMemory(ProfilerMemory, ProfilerSize)) return NULL;
+
+	profiler* Profiler = CreateProfiler(ProfilerMemory, ProfilerSize);
+	SetProfiler(Profiler);
+	return Profiler;
+}
+
+internal b32
+__linux_trace_sink(void* UserData, void* Data, u64 Size)
+{
+	return (fwrite(Data, 1, (size_t)Size, (FILE*)UserData) == (size_t)Size);
+}
+
+/**
+ * Writes the profiler's trace to the given path, open it in chrome://tracing or ui.perfetto.dev.
+ */
+internal b32
+LinuxWriteProfilerTrace(profiler* Profiler, char* Path)
+{
+	FILE* TraceFile = fopen(Path, "wb");
+	if (TraceFile == NULL)
+	{
+		fprintf(stderr, "Unable to open %s for the trace.\n", Path);
+		return false;
+	}
+
+	b32 Written = ExportProfilerTrace(Profiler, &__linux_trace_sink, TraceFile);
+	Written = (fclose(TraceFile) == 0) && Written;
+	if (!Written) fprintf(stderr, "Unable to write the trace to %s.\n", Path);
+	return Written;
+}
+
+/**
+ * Input recordings (see replay.h). The recording is built in reserved memory, which is only
+ * committed as it grows, and written out when the host closes.
+ */
+#define LINUX_RECORDING_RESERVE Megabytes(64)
+
+/**
+ * Starts recording from the simulation as it is now, at the given number of steps a second.
+ */
+internal b32
+LinuxBeginInputRecording(input_recorder* Recorder, engine_library* EngineLib, u32 StepsPerSecond)
+{
+	u64 SnapshotSize = EngineLib->EngineSaveState(NULL, 0);
+	void* RecordingMemory = ReserveVirtualMemory(NULL, LINUX_RECORDING_RESERVE);
+	void* Snapshot = (RecordingMemory != NULL) ?
+		BeginInputRecording(Recorder, RecordingMemory, LINUX_RECORDING_RESERVE, StepsPerSecond, (u32)SnapshotSize) : NULL;
+	if (Snapshot == NULL)
+	{
+		fprintf(stderr, "Unable to start the input recording.\n");
+		return false;
+	}
+
+	EngineLib->EngineSaveState(Snapshot, SnapshotSize);
+	return true;
+}
+
+internal b32
+LinuxWriteInputRecording(input_recorder* Recorder, char* Path)
+{
+	void* Recording;
+	u64 RecordingSize = GetInputRecording(Recorder, &Recording);
+	if (Recorder->full) fprintf(stderr, "The input recording ran out of room, only the first %llu steps were kept.\n",
+		(unsigned long long)Recorder->header->stepCount);
+
+	FILE* RecordingFile = fopen(Path, "wb");
+	b32 Written = (RecordingFile != NULL) && (fwrite(Recording, 1, (size_t)RecordingSize, RecordingFile) == (size_t)RecordingSize);
+	if (RecordingFile != NULL) Written = (fclose(RecordingFile) == 0) && Written;
+	if (!Written) fprintf(stderr, "Unable to write the input recording to %s.\n", Path);
+	return Written;
+}
+
+/**
+ * Maps a recording and puts the simulation back the way it was when the recording started. The
+ * file stays mapped for as long as the replay runs.
+ */
+internal b32
+LinuxOpenInputReplay(input_replay* Replay, mapped_resource* ReplayFile, engine_library* EngineLib, char* Path)
+{
+	if (!LinuxMapFile(Path, ReplayFile) || !OpenInputReplay(Replay, ReplayFile->data, ReplayFile->size))
+	{
+		fprintf(stderr, "%s isn't an input recording.\n", Path);
+		return false;
+	}
+
+	if (EngineLib->EngineLoadState(Replay->snapshot, Replay->header->snapshotSize) != 0)
+	{
+		fprintf(stderr, "%s was recorded with a different build of the engine.\n", Path);
+		return false;
+	}
+
+	return true;
+}
+
+#endif
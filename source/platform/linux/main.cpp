@@ -1,12 +1,503 @@
-#include <iostream>
-#include <stdio.h> // Since I absolutely *hate* std::cout
-#include <nxcore/primitives.h>
+/**
+ *
+ * The Linux platform layer.
+ *
+ * NOTE:			Presentation
+ * 			The engine's memory store is allocated as a System V shared memory segment and attached
+ * 			to the X server through MIT-SHM. Since the software bitmap is allocated from that store,
+ * 			XShmPutImage only has to tell the server where the bitmap lives in the segment; the pixels
+ * 			never travel through the X socket. When the extension isn't available (remote displays),
+ * 			we fall back to an anonymous mapping and a plain XPutImage.
+ *
+ * NOTE:			Headless testing
+ * 			Nothing here depends on a window manager or a GPU, so this runs against Xvfb:
+ * 			xvfb-run -s "-screen 0 1280x720x24" ./NinetailsX --frames 600
+ */
 
+#include "main.h"
+#include <nxcore/pacer.h>
+#include <nxcore/string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * XShmAttach reports failure asynchronously as an X error (typically BadAccess when the server
+ * is on another machine), so we trap errors while we attach and sync.
+ */
+global b32 LinuxSharedMemoryAttachFailed;
+
+internal i32
+LinuxSharedMemoryErrorHandler(Display* display, XErrorEvent* errorEvent)
+{
+	LinuxSharedMemoryAttachFailed = true;
+	return 0;
+}
+
+/**
+ * Allocates the memory store for the engine. When MIT-SHM is available, the store is a shared
+ * memory segment which the X server attaches to so that anything the engine allocates from it,
+ * the software bitmap in particular, can be presented without a copy.
+ *
+ * NOTE:
+ * 			The segment is marked for removal as soon as both sides are attached, so it will be
+ * 			released by the kernel when the process exits, even if it crashes.
+ */
+internal void*
+LinuxAllocateMemoryStore(x11_display* Display, u64 MemorySize)
+{
+
+#ifdef NINETAILSX_DEBUG
+	void* BaseAddress = (void*)Terabytes(2);
+#else
+	void* BaseAddress = NULL;
+#endif
+
+	if (Display->sharedMemoryPresent)
+	{
+		XShmSegmentInfo* SegmentInfo = &Display->segmentInfo;
+		SegmentInfo->shmid = shmget(IPC_PRIVATE, MemorySize, IPC_CREAT|0600);
+		SegmentInfo->shmaddr = (char*)-1;
+
+		if (SegmentInfo->shmid >= 0)
+		{
+			SegmentInfo->shmaddr = (char*)shmat(SegmentInfo->shmid, BaseAddress, 0);
+			if (SegmentInfo->shmaddr == (char*)-1 && BaseAddress != NULL)
+				SegmentInfo->shmaddr = (char*)shmat(SegmentInfo->shmid, NULL, 0);
+		}
+
+		if (SegmentInfo->shmaddr != (char*)-1)
+		{
+			SegmentInfo->readOnly = False;
+
+			LinuxSharedMemoryAttachFailed = false;
+			XErrorHandler PreviousHandler = XSetErrorHandler(&LinuxSharedMemoryErrorHandler);
+			Status AttachStatus = XShmAttach(Display->display, SegmentInfo);
+			XSync(Display->display, False);
+			XSetErrorHandler(PreviousHandler);
+
+			shmctl(SegmentInfo->shmid, IPC_RMID, NULL);
+
+			// The segment is only backed as it is touched, but lock it down so it behaves like
+			// any other reservation and the engine has to commit it first.
+			if (AttachStatus && !LinuxSharedMemoryAttachFailed)
+			{
+				mprotect(SegmentInfo->shmaddr, MemorySize, PROT_NONE);
+				return SegmentInfo->shmaddr;
+			}
+
+			shmdt(SegmentInfo->shmaddr);
+		}
+		else if (SegmentInfo->shmid >= 0)
+		{
+			shmctl(SegmentInfo->shmid, IPC_RMID, NULL);
+		}
+
+		fprintf(stderr, "MIT-SHM is unavailable, presenting through XPutImage instead.\n");
+		Display->sharedMemoryPresent = false;
+	}
+
+	return ReserveVirtualMemory(BaseAddress, MemorySize);
+
+}
+
+/**
+ * Creates the window and the graphics context we present into. The window is created at the
+ * size that the engine requested during initialization.
+ */
+internal b32
+LinuxCreateWindow(x11_display* Display, v2i WindowSize)
+{
+
+	i32 Screen = DefaultScreen(Display->display);
+	Display->visual = DefaultVisual(Display->display, Screen);
+	Display->depth = DefaultDepth(Display->display, Screen);
+
+	/**
+	 * The engine writes 32-bit 0xAARRGGBB pixels, which is the memory layout of a 24/32-bit
+	 * little-endian TrueColor visual. Anything else would require a conversion pass.
+	 */
+	if (Display->depth < 24 || Display->visual->red_mask != 0x00FF0000 ||
+		Display->visual->green_mask != 0x0000FF00 || Display->visual->blue_mask != 0x000000FF)
+	{
+		fprintf(stderr, "The default visual is not a 24-bit RGB TrueColor visual.\n");
+		return false;
+	}
+
+	XSetWindowAttributes WindowAttributes = {};
+	WindowAttributes.event_mask = KeyPressMask|KeyReleaseMask|StructureNotifyMask|ExposureMask;
+	WindowAttributes.background_pixel = BlackPixel(Display->display, Screen);
+
+	Display->window = XCreateWindow(Display->display, RootWindow(Display->display, Screen), 0, 0,
+		WindowSize.width, WindowSize.height, 0, Display->depth, InputOutput, Display->visual,
+		CWEventMask|CWBackPixel, &WindowAttributes);
+	XStoreName(Display->display, Display->window, "NinetailsX Engine");
+
+	// We want WM_DELETE_WINDOW as a message rather than having the connection killed on close.
+	Display->deleteWindowAtom = XInternAtom(Display->display, "WM_DELETE_WINDOW", False);
+	XSetWMProtocols(Display->display, Display->window, &Display->deleteWindowAtom, 1);
+
+	// Key auto-repeat would otherwise generate release events while a key is held.
+	XkbSetDetectableAutoRepeat(Display->display, True, NULL);
+
+	Display->graphicsContext = XCreateGC(Display->display, Display->window, 0, NULL);
+	XMapWindow(Display->display, Display->window);
+	XFlush(Display->display);
+
+	return true;
+
+}
+
+/**
+ * RenderSoftwareBitmap
+ * 			Presents the given regions of the engine's software bitmap to the window. The XImage
+ * 			only describes the bitmap, it never owns the pixels, so it is rebuilt whenever the engine
+ * 			hands us a different buffer or size, and the whole bitmap is presented when that happens.
+ *
+ * NOTE:
+ * 			The bitmap is bottom-up (the engine draws with the origin at the lower-left corner, the
+ * 			way StretchDIBits expects it), while X11 images are top-down. Rather than flipping into
+ * 			an intermediate copy, we issue one put per row. The requests are tiny since with MIT-SHM
+ * 			they only carry the offset into the segment.
+ *
+ * 			The server reads the segment asynchronously, so we have to sync before the engine is
+ * 			allowed to write into the bitmap again.
+ */
+internal void
+RenderSoftwareBitmap(app_state* ApplicationState, void* BitmapData, i32 BitmapWidth, i32 BitmapHeight,
+	rect2i* Regions, u32 RegionCount)
+{
+
+	NX_PROFILE_SCOPE("RenderSoftwareBitmap");
+	x11_display* Display = &ApplicationState->Display;
+
+	if (Display->presentImage == NULL || Display->presentImageData != BitmapData ||
+		Display->presentImageDims.width != BitmapWidth || Display->presentImageDims.height != BitmapHeight)
+	{
+		if (Display->presentImage != NULL)
+		{
+			Display->presentImage->data = NULL; // We don't own the pixels, don't let X free them.
+			XDestroyImage(Display->presentImage);
+		}
+
+		if (Display->sharedMemoryPresent)
+		{
+			Display->presentImage = XShmCreateImage(Display->display, Display->visual, Display->depth,
+				ZPixmap, (char*)BitmapData, &Display->segmentInfo, BitmapWidth, BitmapHeight);
+		}
+		else
+		{
+			Display->presentImage = XCreateImage(Display->display, Display->visual, Display->depth,
+				ZPixmap, 0, (char*)BitmapData, BitmapWidth, BitmapHeight, 32, BitmapWidth*sizeof(u32));
+		}
+
+		Display->presentImageData = BitmapData;
+		Display->presentImageDims = { BitmapWidth, BitmapHeight };
+		ApplicationState->PresentFullFrame = true;
+	}
+
+	rect2i FullFrame = CreateRect({0,0}, {BitmapWidth, BitmapHeight});
+	if (ApplicationState->PresentFullFrame)
+	{
+		Regions = &FullFrame;
+		RegionCount = 1;
+		ApplicationState->PresentFullFrame = false;
+	}
+	if (RegionCount == 0) return;
+
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		rect2i Region = IntersectRect(Regions[RegionIndex], FullFrame);
+		for (i32 Row = Region.min.y; Row < Region.max.y; ++Row)
+		{
+			i32 WindowRow = BitmapHeight - 1 - Row;
+			i32 RegionWidth = Region.max.x - Region.min.x;
+			if (Display->sharedMemoryPresent)
+			{
+				XShmPutImage(Display->display, Display->window, Display->graphicsContext, Display->presentImage,
+					Region.min.x, Row, Region.min.x, WindowRow, RegionWidth, 1, False);
+			}
+			else
+			{
+				XPutImage(Display->display, Display->window, Display->graphicsContext, Display->presentImage,
+					Region.min.x, Row, Region.min.x, WindowRow, RegionWidth, 1);
+			}
+		}
+	}
+
+	XSync(Display->display, False);
+
+}
+
+/**
+ * Fetches the state of keyboard using a key symbol and determines the state of input.
+ */
+internal void
+setInputButtonState(KeySym keySymbol, button* previousInputButton, button* currentInputButton)
+{
+	KeyCode keyCode = XKeysymToKeycode(ApplicationState->Display.display, keySymbol);
+	b32 keyState = ApplicationState->KeyStates[keyCode];
+	if (previousInputButton->down && keyState == 0)
+	{
+		currentInputButton->released = true;
+		currentInputButton->down = false;
+	}
+	else if (keyState != 0)
+	{
+		currentInputButton->down = true;
+		currentInputButton->released = false;
+	}
+}
+
+/**
+ * Pumps the X event queue, tracking the keyboard state and window closure.
+ */
+internal void
+LinuxProcessEvents(app_state* ApplicationState)
+{
+	x11_display* Display = &ApplicationState->Display;
+	while (XPending(Display->display))
+	{
+		XEvent Event;
+		XNextEvent(Display->display, &Event);
+		switch (Event.type)
+		{
+			case KeyPress:
+			case KeyRelease:
+			{
+				ApplicationState->KeyStates[Event.xkey.keycode & 0xFF] = (Event.type == KeyPress);
+			} break;
+
+			// The server dropped some of the window's contents, we have to present all of it again.
+			case Expose:
+			{
+				ApplicationState->PresentFullFrame = true;
+			} break;
+
+			case ClientMessage:
+			{
+				if ((Atom)Event.xclient.data.l[0] == Display->deleteWindowAtom)
+					ApplicationState->isRunnning = false;
+			} break;
+
+			case DestroyNotify:
+			{
+				ApplicationState->isRunnning = false;
+			} break;
+
+			default: break;
+		}
+	}
+}
+
+/**
+ * Defines the entry point for the Linux application.
+ *
+ * Arguments:
+ * 			--frames N		Exits after N frames, for unattended runs against Xvfb.
+ * 			--uncapped		Renders as fast as the host allows instead of pacing to 60 frames a
+ * 							second. The simulation still steps at its fixed rate.
+ * 			--trace PATH	Writes the profiler's trace of the last stretch of the run to PATH on
+ * 							exit, see nxcore/profiler.h.
+ * 			--record PATH	Records every step's input to PATH, written on exit, see nxcore/replay.h.
+ * 			--replay PATH	Plays back a recording in place of the keyboard, and exits once it runs out.
+ */
 i32
-main()
+main(i32 argc, char** argv)
 {
 
-	printf("Test message for linux compilation.\n");
+	app_state _appState = {};
+	ApplicationState = &_appState;
+
+	u64 FrameLimit = 0;
+	b32 Uncapped = false;
+	char* TracePath = NULL;
+	char* RecordPath = NULL;
+	char* ReplayPath = NULL;
+	for (i32 argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		if (strcmp(argv[argIndex], "--frames") == 0 && argIndex+1 < argc)
+			FrameLimit = strtoull(argv[++argIndex], NULL, 10);
+		else if (strcmp(argv[argIndex], "--uncapped") == 0)
+			Uncapped = true;
+		else if (strcmp(argv[argIndex], "--trace") == 0 && argIndex+1 < argc)
+			TracePath = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "--record") == 0 && argIndex+1 < argc)
+			RecordPath = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "--replay") == 0 && argIndex+1 < argc)
+			ReplayPath = argv[++argIndex];
+	}
+
+	if (!LinuxResolveBasePath()) return 1;
+
+	char modulePath[PATH_MAX];
+	LinuxGetAbsolutePath((char*)"libNinetailsXEngine.so", modulePath, PATH_MAX);
+	if (!InitializeNinetailsXEngine(modulePath, &ApplicationState->EngineLibrary)) return 1;
+
+	ApplicationState->ResourceHandlerInterface.FetchResourceFile = &FetchResourceFile;
+	ApplicationState->ResourceHandlerInterface.FetchResourceSize = &FetchResourceSize;
+	ApplicationState->ResourceHandlerInterface.MapResource = &MapResource;
+	ApplicationState->ResourceHandlerInterface.UnmapResource = &UnmapResource;
+	ApplicationState->ResourceHandlerInterface.RequestResource = &RequestResource;
+	ApplicationState->ResourceHandlerInterface.PollResources = &PollResources;
+	ApplicationState->ResourceHandlerInterface.Profiler = LinuxCreateProfiler();
+	NX_PROFILE_THREAD("Main");
+	LinuxStartResourceStream(2);
+
+	/**
+	 * Connect to the X server and determine whether we can share memory with it.
+	 */
+	x11_display* Display = &ApplicationState->Display;
+	Display->display = XOpenDisplay(NULL);
+	if (Display->display == NULL)
+	{
+		fprintf(stderr, "Unable to open the X display, is DISPLAY set?\n");
+		return 1;
+	}
+	Display->sharedMemoryPresent = XShmQueryExtension(Display->display);
+
+	/**
+	 * Allocate the memory store for the engine and initialize it.
+	 */
+#define VIRTUAL_ALLOCATION_SIZE Megabytes(512)
+	ApplicationState->appMemStore = LinuxAllocateMemoryStore(Display, VIRTUAL_ALLOCATION_SIZE);
+	ApplicationState->appMemSize = VIRTUAL_ALLOCATION_SIZE;
+	if (ApplicationState->appMemStore == NULL)
+	{
+		fprintf(stderr, "Unable to allocate the engine memory store.\n");
+		return 1;
+	}
+
+	input* currentInput = &ApplicationState->InputSwapBuffer[0];
+	input* previousInput = &ApplicationState->InputSwapBuffer[1];
+	*currentInput = {};
+	*previousInput = {};
+
+	engine_library& EngineLib = ApplicationState->EngineLibrary;
+	if (EngineLib.EngineInit(ApplicationState->appMemStore, ApplicationState->appMemSize,
+		&ApplicationState->WindowProperties, &ApplicationState->ResourceHandlerInterface) != 0)
+	{
+		fprintf(stderr, "The engine failed to initialize.\n");
+		return 1;
+	}
+
+	if (!LinuxCreateWindow(Display, ApplicationState->WindowProperties.dimensions)) return 1;
+	v2i CurrentWindowSize = ApplicationState->WindowProperties.dimensions;
+
+	/**
+	 * A replay starts from the simulation as it was recorded and steps at the rate it was recorded
+	 * at, a recording starts from the simulation as it is now.
+	 */
+	u32 StepsPerSecond = 60;
+	input_replay Replay = {};
+	mapped_resource ReplayFile = {};
+	input ReplayInput = {};
+	if (ReplayPath)
+	{
+		if (!LinuxOpenInputReplay(&Replay, &ReplayFile, &EngineLib, ReplayPath)) return 1;
+		StepsPerSecond = Replay.header->stepsPerSecond;
+	}
+
+	input_recorder Recorder = {};
+	if (RecordPath && !LinuxBeginInputRecording(&Recorder, &EngineLib, StepsPerSecond)) return 1;
+
+	/**
+	 * The runtime loop. The simulation runs at a fixed 60 steps a second off the accumulator in
+	 * nxcore/timestep.h, however many frames that takes, and frames are paced to 60 a second by the
+	 * frame pacer (nxcore/pacer.h) unless we were asked to run uncapped.
+	 */
+	frame_pacer Pacer = CreateFramePacer(60);
+	fixed_timestep Timestep = CreateFixedTimestep(StepsPerSecond);
+	ApplicationState->InputHandle.frameStep = GetTimestepMilliseconds(&Timestep);
+	u64 FrameCount = 0;
+
+	ApplicationState->isRunnning = true;
+	while (ApplicationState->isRunnning)
+	{
+
+		NX_PROFILE_SCOPE("Frame");
+		LinuxProcessEvents(ApplicationState);
+
+		ApplicationState->InputHandle.frame_input = currentInput;
+		*currentInput = {};
+
+		setInputButtonState(XK_z, &previousInput->aButton, &currentInput->aButton);
+		setInputButtonState(XK_x, &previousInput->bButton, &currentInput->bButton);
+		setInputButtonState(XK_Return, &previousInput->startButton, &currentInput->startButton);
+		setInputButtonState(XK_Shift_R, &previousInput->selectButton, &currentInput->selectButton);
+		setInputButtonState(XK_Right, &previousInput->rightButton, &currentInput->rightButton);
+		setInputButtonState(XK_Left, &previousInput->leftButton, &currentInput->leftButton);
+		setInputButtonState(XK_Up, &previousInput->upButton, &currentInput->upButton);
+		setInputButtonState(XK_Down, &previousInput->downButton, &currentInput->downButton);
+
+		/**
+		 * A release is only seen by the first update which runs after it. When no update runs this
+		 * frame, the input buffers aren't swapped, so the release is still there for the next frame.
+		 * A replay hands each step the input it was recorded with instead.
+		 */
+		u32 Steps = AdvanceFixedTimestep(&Timestep);
+		for (u32 Step = 0; Step < Steps && ApplicationState->isRunnning; ++Step)
+		{
+			if (ReplayPath)
+			{
+				if (!ReadReplayInput(&Replay, &ReplayInput))
+				{
+					ApplicationState->isRunnning = false;
+					break;
+				}
+				ApplicationState->InputHandle.frame_input = &ReplayInput;
+			}
+
+			RecordInput(&Recorder, ApplicationState->InputHandle.frame_input);
+			if (EngineLib.EngineUpdate(&ApplicationState->InputHandle) != 0) ApplicationState->isRunnning = false;
+			ClearInputEdges(currentInput);
+		}
+
+		i32 EngineStatus = EngineLib.EngineRender(&ApplicationState->WindowProperties, GetTimestepAlpha(&Timestep));
+		if (EngineStatus != 0) ApplicationState->isRunnning = false;
+
+		// The engine may request the window be resized the accomodate the size of the render area.
+		if (CurrentWindowSize != ApplicationState->WindowProperties.dimensions)
+		{
+			CurrentWindowSize = ApplicationState->WindowProperties.dimensions;
+			XResizeWindow(Display->display, Display->window, CurrentWindowSize.width, CurrentWindowSize.height);
+		}
+
+		if (Steps != 0)
+		{
+			input* placeholder = currentInput;
+			currentInput = previousInput;
+			previousInput = placeholder;
+		}
+
+		RenderSoftwareBitmap(ApplicationState, ApplicationState->WindowProperties.softwareBitmap,
+			ApplicationState->WindowProperties.dimensions.width, ApplicationState->WindowProperties.dimensions.height,
+			ApplicationState->WindowProperties.dirtyRegions, ApplicationState->WindowProperties.dirtyRegionCount);
+
+		if (FrameLimit != 0 && ++FrameCount >= FrameLimit) break;
+
+		if (!Uncapped) WaitForNextFrame(&Pacer);
+
+	}
+
+	DestroyFramePacer(&Pacer);
+	if (RecordPath) LinuxWriteInputRecording(&Recorder, RecordPath);
+	if (ReplayPath) UnmapResource(&ReplayFile);
+	if (TracePath && ApplicationState->ResourceHandlerInterface.Profiler)
+		LinuxWriteProfilerTrace(ApplicationState->ResourceHandlerInterface.Profiler, TracePath);
+	EngineLib.EngineShutdown();
+	StopResourceStream(LinuxResourceStream);
+
+	if (Display->sharedMemoryPresent)
+	{
+		XShmDetach(Display->display, &Display->segmentInfo);
+		XSync(Display->display, False);
+		shmdt(Display->segmentInfo.shmaddr);
+	}
+	XCloseDisplay(Display->display);
 
 	return 0;
 }
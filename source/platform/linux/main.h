@@ -0,0 +1,51 @@
+#ifndef NINETAILSX_LINUX_MAIN_H
+#define NINETAILSX_LINUX_MAIN_H
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include "loader.h"
+
+/**
+ * The X11 connection and the presentation state for the software bitmap. When the MIT-SHM
+ * extension is available, the engine's memory store lives inside a shared memory segment which
+ * the X server has attached, so the bitmap is presented straight out of engine memory.
+ */
+typedef struct x11_display
+{
+	Display* display;
+	Window window;
+	GC graphicsContext;
+	Visual* visual;
+	i32 depth;
+	Atom deleteWindowAtom;
+	b32 sharedMemoryPresent;
+	XShmSegmentInfo segmentInfo;
+	XImage* presentImage;
+	void* presentImageData;
+	v2i presentImageDims;
+} x11_display;
+
+typedef struct app_state
+{
+	res_handler_interface ResourceHandlerInterface;
+	engine_library EngineLibrary;
+	window_props WindowProperties;
+	void* appMemStore;
+	u64 appMemSize;
+	action_interface InputHandle;
+	input InputSwapBuffer[2];
+	b32 KeyStates[256];
+	x11_display Display;
+	b32 PresentFullFrame; // The window lost its contents, present everything rather than the dirty regions.
+	b32 isRunnning;
+} app_state;
+
+/**
+ * The application state functions as a global variable, so we are going to define a pointer
+ * reference to it here which will guarantee its existence at the start of main.
+ */
+app_state* ApplicationState;
+
+#endif
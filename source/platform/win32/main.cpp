@@ -8,18 +8,17 @@
  * 			the past that I know to work, but you never know unless I do proper debugging. For now,
  * 			it doesn't seem to cause any segment faults (since the bitmap buffer is used on the tail
  * 			end of the heap allocation, any over-runs would cause a seg-fault).
- * 
- * BUGFIX:			Frame timing
- * 			There is most certainly a bug with the frame timing and sleep protocol which will need to
- * 			be ironed out and refactored soon enough. While the application itself seems to work as
- * 			intended, residual framesync issues persist until timing falls back in line. Whether or
- * 			not that's the actual case or not is yet to be determined.
  */
 
 #include "main.h"
 #include "display.h"
 #include <nxcore/string.h>
+#include <nxcore/streaming.h>
+#include <nxcore/pacer.h>
+#include <nxcore/timestep.h>
+#include <nxcore/replay.h>
 #include <stdio.h>
+#include <wchar.h>
 
 /**
  * This will load the engine library code and assign it to the struct which carries the
@@ -58,14 +57,22 @@ InitializeNinetailsXEngine(char* dynamicLibraryFilePath, engine_library* EngineL
 	 * TODO:
 	 * 			Maybe we play nice and just yeet into a fail-fast state and exit. Maybe.
 	 */
-	EngineLibrary->EngineRuntime = (fnptr_engine_runtime*)GetProcAddress(EngineModule, "EngineRuntime");
+	EngineLibrary->EngineUpdate = (fnptr_engine_update*)GetProcAddress(EngineModule, "EngineUpdate");
+	EngineLibrary->EngineRender = (fnptr_engine_render*)GetProcAddress(EngineModule, "EngineRender");
+	EngineLibrary->EngineShutdown = (fnptr_engine_shutdown*)GetProcAddress(EngineModule, "EngineShutdown");
 	EngineLibrary->EngineInit = (fnptr_engine_init*)GetProcAddress(EngineModule, "EngineInit");
 	EngineLibrary->EngineReinit = (fnptr_engine_reinit*)GetProcAddress(EngineModule, "EngineReinit");
+	EngineLibrary->EngineSaveState = (fnptr_engine_save_state*)GetProcAddress(EngineModule, "EngineSaveState");
+	EngineLibrary->EngineLoadState = (fnptr_engine_load_state*)GetProcAddress(EngineModule, "EngineLoadState");
 
 #ifdef NINETAILSX_DEBUG
-	assert(EngineLibrary->EngineRuntime != NULL);
+	assert(EngineLibrary->EngineUpdate != NULL);
+	assert(EngineLibrary->EngineRender != NULL);
+	assert(EngineLibrary->EngineShutdown != NULL);
 	assert(EngineLibrary->EngineInit != NULL);
 	assert(EngineLibrary->EngineReinit != NULL);
+	assert(EngineLibrary->EngineSaveState != NULL);
+	assert(EngineLibrary->EngineLoadState != NULL);
 #endif
 
 	return 1;
@@ -73,18 +80,29 @@ InitializeNinetailsXEngine(char* dynamicLibraryFilePath, engine_library* EngineL
 
 /**
  * RenderSoftwareBitmap
- * 			Renders a given bitmap image to the screen. This is effectively a software-only rendering
- * 			method. Therefore, this shouldn't be used for anything that may be hardware intensive and
- * 			primarily used for basic 2D drawing.
+ * 			Renders the given regions of a bitmap image to the screen. This is effectively a software-only
+ * 			rendering method. Therefore, this shouldn't be used for anything that may be hardware intensive
+ * 			and primarily used for basic 2D drawing.
  * 
  * StretchDIBits
  * 				We will use this as our primary mode outputting to the window.
  * 				https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-stretchdibits
+ *
+ * NOTE:
+ * 			The regions are in bitmap coordinates with the origin at the lower-left corner. For a
+ * 			bottom-up DIB, StretchDIBits measures the source y from the bottom as well, but the
+ * 			destination y is from the top of the window.
+ *
+ * 			When the engine hands us a different bitmap or size, or a region fails to present, the
+ * 			whole bitmap is presented (again) rather than only the dirty regions.
  */
 internal void
-RenderSoftwareBitmap(app_state* ApplicationState, void* BitmapData, i32 BitmapWidth, i32 BitmapHeight)
+RenderSoftwareBitmap(app_state* ApplicationState, void* BitmapData, i32 BitmapWidth, i32 BitmapHeight,
+	rect2i* Regions, u32 RegionCount)
 {
 
+	NX_PROFILE_SCOPE("RenderSoftwareBitmap");
+
 	BITMAPINFO BitmapInfo = {0};
 	BitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
 	BitmapInfo.bmiHeader.biWidth = BitmapWidth;
@@ -94,8 +112,33 @@ RenderSoftwareBitmap(app_state* ApplicationState, void* BitmapData, i32 BitmapWi
 	BitmapInfo.bmiHeader.biCompression = BI_RGB;
 	BitmapInfo.bmiHeader.biSizeImage = BitmapWidth*BitmapHeight*sizeof(u32);
 
-	i32 Status = StretchDIBits(ApplicationState->WindowDeviceContext, 0, 0, BitmapWidth, BitmapHeight, 0, 0,
-		BitmapWidth, BitmapHeight, BitmapData, &BitmapInfo, DIB_RGB_COLORS, SRCCOPY);
+	if (ApplicationState->PresentedBitmap != BitmapData || ApplicationState->PresentedBitmapDims.width != BitmapWidth ||
+		ApplicationState->PresentedBitmapDims.height != BitmapHeight)
+	{
+		ApplicationState->PresentedBitmap = BitmapData;
+		ApplicationState->PresentedBitmapDims = { BitmapWidth, BitmapHeight };
+		ApplicationState->PresentFullFrame = true;
+	}
+
+	rect2i FullFrame = CreateRect({0,0}, {BitmapWidth, BitmapHeight});
+	if (ApplicationState->PresentFullFrame)
+	{
+		Regions = &FullFrame;
+		RegionCount = 1;
+		ApplicationState->PresentFullFrame = false;
+	}
+
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		rect2i Region = IntersectRect(Regions[RegionIndex], FullFrame);
+		v2i RegionDims = GetRectDims(Region);
+		i32 Status = StretchDIBits(ApplicationState->WindowDeviceContext, Region.min.x, BitmapHeight - Region.max.y,
+			RegionDims.width, RegionDims.height, Region.min.x, Region.min.y, RegionDims.width, RegionDims.height,
+			BitmapData, &BitmapInfo, DIB_RGB_COLORS, SRCCOPY);
+
+		// The region never made it to the window, the dirty regions won't cover it next frame.
+		if (Status == 0) ApplicationState->PresentFullFrame = true;
+	}
 
 }
 
@@ -160,6 +203,7 @@ WindowProcedure(HWND WindowHandle, u32 Message, WPARAM wParam, LPARAM lParam)
 			HDC PaintDeviceContext = BeginPaint(WindowHandle, &PaintRegion);
 
 			FillRect(PaintDeviceContext, &PaintRegion.rcPaint, GetSysColorBrush(COLOR_WINDOW));
+			ApplicationState->PresentFullFrame = true; // We just painted over the bitmap.
 
 			/**
 			 * TODO:
@@ -182,34 +226,6 @@ WindowProcedure(HWND WindowHandle, u32 Message, WPARAM wParam, LPARAM lParam)
 	return(DefWindowProcA(WindowHandle, Message, wParam, lParam));
 }
 
-/**
- * Retrieves the current performance counter from QueryPerformanceCounter and returns
- * it as a 64-bit unsigned integer.
- */
-inline u64
-GetCurrentPerformanceStamp()
-{
-
-	LARGE_INTEGER Timestamp;
-	QueryPerformanceCounter(&Timestamp);
-	return Timestamp.QuadPart;
-
-}
-
-/**
- * Retrives the current time in milliseconds using a previous QPC timestamp and
- * returns it as a float.
- */
-inline r32
-GetPerformanceTimeDifferenceMilliseconds(u64 frequency, u64 previous)
-{
-	u64 now = GetCurrentPerformanceStamp();
-	u64 difference = now - previous;
-	u64 differenceMilliseconds = difference * 1000; // Conversion to milliseconds.
-	r32 Time = (r32)differenceMilliseconds / (r32)frequency;
-	return Time;
-}
-
 /**
  * Fetches the state of keyboard using a key code and determines the state of input.
  */
@@ -246,8 +262,8 @@ FetchResourceSize(char* RelativePath)
 	ConcatenateStrings_s(ApplicationState->BasePath, MAX_PATH, RelativePath,
 		StringSize(RelativePath), _absolute_path, MAX_PATH);
 
-	HANDLE _resource_handle = CreateFileA(RelativePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-	assert(_resource_handle != INVALID_HANDLE_VALUE);
+	HANDLE _resource_handle = CreateFileA(_absolute_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (_resource_handle == INVALID_HANDLE_VALUE) return 0;
 
 	LARGE_INTEGER _file_size = {0};
 	BOOL FileSizeStatus = GetFileSizeEx(_resource_handle, &_file_size);
@@ -271,36 +287,180 @@ FetchResourceSize(char* RelativePath)
  * Fetches a file and stores the contents of the file into the buffer.
  * This function looks at app_state for BasePath, therefore it must be
  * properly set in order for it to construct a valid path. Additionally,
- * this function will work only for files under 4GB.
- * 
- * TODO:
- * 			We might want to report back to the engine that status of the
- * 			operation. For now, we will just assert if the file hasn't
- * 			been found or unable to be loaded.
+ * this function will work only for files under 4GB. Returns 0 if the file
+ * couldn't be found or read in full. This is also called from the I/O threads.
  */
 internal u32
 FetchResourceFile(char* RelativePath, void* Buffer, u32 BufferSize)
 {
 
+	NX_PROFILE_SCOPE("FetchResource");
 	char _absolute_path[MAX_PATH];
 
 	ConcatenateStrings_s(ApplicationState->BasePath, MAX_PATH, RelativePath,
 		StringSize(RelativePath), _absolute_path, MAX_PATH);
 
-	HANDLE _resource_handle = CreateFileA(RelativePath, GENERIC_READ, FILE_SHARE_READ,
+	HANDLE _resource_handle = CreateFileA(_absolute_path, GENERIC_READ, FILE_SHARE_READ,
 		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-	assert(_resource_handle != INVALID_HANDLE_VALUE);
+	if (_resource_handle == INVALID_HANDLE_VALUE) return 0;
 
 	DWORD BytesRead = 0;
 	BOOL ReadStatus = ReadFile(_resource_handle, Buffer, BufferSize, &BytesRead, 0);
+	CloseHandle(_resource_handle);
 
-	assert(ReadStatus);
-	assert(BytesRead == BufferSize);
+	return (ReadStatus && BytesRead == BufferSize);
+
+}
 
-	return 1; // We assume that the read succeeded.
+/**
+ * The I/O threads behind RequestResource and PollResources. It is never destroyed, so that an
+ * early exit can't trip over joinable threads.
+ */
+global resource_stream* Win32ResourceStream;
 
+internal resource_ticket
+RequestResource(char* RelativePath, memarena_t* Arena, u64 OutputSize, fnptr_resource_process* Process, void* UserData)
+{
+	return SubmitResourceRequest(Win32ResourceStream, RelativePath, Arena, OutputSize, Process, UserData);
 }
 
+internal u32
+PollResources(resource_completion* Completions, u32 MaxCount)
+{
+	return PollResourceCompletions(Win32ResourceStream, Completions, MaxCount);
+}
+
+/**
+ * Maps a whole file read-only into memory. The file and mapping handles can be closed as soon as
+ * the view exists, the view keeps them alive until it is unmapped. Empty files can't be mapped
+ * and fail.
+ *
+ * CreateFileMappingA / MapViewOfFile:
+ * 			https://docs.microsoft.com/en-us/windows/win32/api/winbase/nf-winbase-createfilemappinga
+ * 			https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-mapviewoffile
+ */
+internal b32
+MapResource(const char* RelativePath, mapped_resource* Resource)
+{
+
+	NX_PROFILE_SCOPE("MapResource");
+	*Resource = {};
+
+	char _absolute_path[MAX_PATH];
+
+	ConcatenateStrings_s(ApplicationState->BasePath, MAX_PATH, RelativePath,
+		StringSize(RelativePath), _absolute_path, MAX_PATH);
+
+	HANDLE _resource_handle = CreateFileA(_absolute_path, GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (_resource_handle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER _file_size = {0};
+	HANDLE _mapping_handle = NULL;
+	if (GetFileSizeEx(_resource_handle, &_file_size) && _file_size.QuadPart > 0)
+		_mapping_handle = CreateFileMappingA(_resource_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	void* _data = NULL;
+	if (_mapping_handle != NULL)
+	{
+		_data = MapViewOfFile(_mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(_mapping_handle);
+	}
+	CloseHandle(_resource_handle);
+	if (_data == NULL) return false;
+
+	Resource->data = _data;
+	Resource->size = (u64)_file_size.QuadPart;
+	return true;
+
+}
+
+internal void
+UnmapResource(mapped_resource* Resource)
+{
+	if (Resource->data) UnmapViewOfFile(Resource->data);
+	*Resource = {};
+}
+
+/**
+ * Creates the profiler the platform and the engine record into, with a ring for every thread
+ * either of them is going to start.
+ */
+internal profiler*
+Win32CreateProfiler()
+{
+	u32 MaxThreads = std::thread::hardware_concurrency() + 8;
+	u64 ProfilerSize = GetProfilerMemorySize(MaxThreads);
+	void* ProfilerMemory = ReserveVirtualMemory(NULL, ProfilerSize);
+	if (ProfilerMemory == NULL || !CommitVirtualMemory(ProfilerMemory, ProfilerSize)) return NULL;
+
+	profiler* Profiler = CreateProfiler(ProfilerMemory, ProfilerSize);
+	SetProfiler(Profiler);
+	return Profiler;
+}
+
+internal b32
+Win32TraceSink(void* UserData, void* Data, u64 Size)
+{
+	DWORD BytesWritten = 0;
+	return (WriteFile((HANDLE)UserData, Data, (DWORD)Size, &BytesWritten, NULL) && BytesWritten == (DWORD)Size);
+}
+
+/**
+ * Writes the profiler's trace to a file relative to BasePath, open it in chrome://tracing or
+ * ui.perfetto.dev.
+ */
+internal b32
+Win32WriteProfilerTrace(profiler* Profiler, char* RelativePath)
+{
+	char _absolute_path[MAX_PATH];
+	ConcatenateStrings_s(ApplicationState->BasePath, MAX_PATH, RelativePath,
+		StringSize(RelativePath), _absolute_path, MAX_PATH);
+
+	HANDLE _trace_handle = CreateFileA(_absolute_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (_trace_handle == INVALID_HANDLE_VALUE) return false;
+
+	b32 Written = ExportProfilerTrace(Profiler, &Win32TraceSink, _trace_handle);
+	CloseHandle(_trace_handle);
+	return Written;
+}
+
+/**
+ * Input recordings (see nxcore/replay.h). The recording is built in reserved memory, which is only
+ * committed as it grows, and written out to a file relative to BasePath when the application closes.
+ */
+#define WIN32_RECORDING_RESERVE Megabytes(64)
+
+internal b32
+Win32BeginInputRecording(input_recorder* Recorder, engine_library* EngineLib, u32 StepsPerSecond)
+{
+	u64 SnapshotSize = EngineLib->EngineSaveState(NULL, 0);
+	void* RecordingMemory = ReserveVirtualMemory(NULL, WIN32_RECORDING_RESERVE);
+	if (RecordingMemory == NULL) return false;
+
+	void* Snapshot = BeginInputRecording(Recorder, RecordingMemory, WIN32_RECORDING_RESERVE, StepsPerSecond, (u32)SnapshotSize);
+	if (Snapshot == NULL) return false;
+
+	EngineLib->EngineSaveState(Snapshot, SnapshotSize);
+	return true;
+}
+
+internal b32
+Win32WriteInputRecording(input_recorder* Recorder, char* RelativePath)
+{
+	char _absolute_path[MAX_PATH];
+	ConcatenateStrings_s(ApplicationState->BasePath, MAX_PATH, RelativePath,
+		StringSize(RelativePath), _absolute_path, MAX_PATH);
+
+	HANDLE _recording_handle = CreateFileA(_absolute_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (_recording_handle == INVALID_HANDLE_VALUE) return false;
+
+	void* Recording;
+	u64 RecordingSize = GetInputRecording(Recorder, &Recording);
+	b32 Written = Win32TraceSink(_recording_handle, Recording, RecordingSize);
+	CloseHandle(_recording_handle);
+	return Written;
+}
 
 /**
  * Defines the entry point for a win32 application.
@@ -402,36 +562,22 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 	assert(ActualWindowHeight == INIT_WINDOW_HEIGHT);
 #endif
 
-	/**
-	 * Setting up performance timing for the application runtime.
-	 * 
-	 * TODO:
-	 * 			We need to set up a way of maintaining some form of frame-timing and performance monitoring.
-	 * 			This will be accomplished using Windows' QPC.
-	 * 
-	 * QueryPerformanceCounter
-	 * 			https://docs.microsoft.com/en-us/windows/win32/sysinfo/acquiring-high-resolution-time-stamps
-	 */
-	LARGE_INTEGER PerformanceFrequency;
-	QueryPerformanceFrequency(&PerformanceFrequency);
-	ApplicationState->PerformanceFrequency = PerformanceFrequency.QuadPart;
-
 	/**
 	 * Allocate the heap necessary for application runtime. These are set up in the ApplicationStates'
 	 * memory_layout member such that we can feed this to the engine DLL.
 	 * 
 	 * NOTE:
-	 * 			We will need to *dynamically* consider what the user's system is capable of, but for
-	 * 			now we will delegate a fixed size at compile time during development.
+	 * 			The heap is only reserved (MEM_RESERVE) here. The engine commits the pages as its
+	 * 			arenas grow into them, so startup doesn't pay for the whole range up front.
 	 * 
 	 * VirtualAlloc:
 	 * 			https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc
 	 */
 #define VIRTUAL_ALLOCATION_SIZE Megabytes(512)
 #ifdef NINETAILSX_DEBUG
-	void* HeapMemory = VirtualAlloc((void*)Terabytes(2), VIRTUAL_ALLOCATION_SIZE, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+	void* HeapMemory = ReserveVirtualMemory((void*)Terabytes(2), VIRTUAL_ALLOCATION_SIZE);
 #else
-	void* HeapMemory = VirtualAlloc((void*)0x00, VIRTUAL_ALLOCATION_SIZE, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+	void* HeapMemory = ReserveVirtualMemory((void*)0x00, VIRTUAL_ALLOCATION_SIZE);
 #endif
 	ApplicationState->appMemStore = HeapMemory;
 	ApplicationState->appMemSize = VIRTUAL_ALLOCATION_SIZE;
@@ -479,6 +625,14 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 
 	ApplicationState->ResourceHandlerInterface.FetchResourceFile = &FetchResourceFile;
 	ApplicationState->ResourceHandlerInterface.FetchResourceSize = &FetchResourceSize;
+	ApplicationState->ResourceHandlerInterface.MapResource = &MapResource;
+	ApplicationState->ResourceHandlerInterface.UnmapResource = &UnmapResource;
+	ApplicationState->ResourceHandlerInterface.RequestResource = &RequestResource;
+	ApplicationState->ResourceHandlerInterface.PollResources = &PollResources;
+	ApplicationState->ResourceHandlerInterface.Profiler = Win32CreateProfiler();
+	NX_PROFILE_THREAD("Main");
+	Win32ResourceStream = new resource_stream();
+	StartResourceStream(Win32ResourceStream, 2, &FetchResourceFile, &FetchResourceSize);
 
 
 	/**
@@ -492,26 +646,15 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 	*previousInput = {0};
 
 	/**
-	 * We need to ensure that the Windows scheduler is fine-grained enough for us to hit our software
-	 * v-sync time consistently. To do this, we will use timeBeginPeriod(1). Then we need to establish
-	 * what our vsync frame target is. This is relatively easy to calculate.
-	 * 
-	 * NOTE:
-	 * 			The frameTarget will need to be adjusted should we begin to miss our frame targets.
-	 * 
-	 * NOTE:
-	 * 			Additionally, since the scheduler may not wake up on the exact moment we want, we an
-	 * 			"offset" of sorts such that we can "busy-spin" the remainder of the frame for the highest
-	 * 			accuracy "flip-time".
+	 * Establish our software v-sync frame target. The frame pacer (nxcore/pacer.h) sleeps most of
+	 * each frame on a high resolution timer and busy-spins only the last stretch before the flip,
+	 * learning how much to leave for the spin from how late its sleeps wake up.
+	 *
+	 * The simulation doesn't follow the frames. It steps at its own fixed rate off the accumulator in
+	 * nxcore/timestep.h, so a frame which runs long costs us a frame, not game time.
 	 */
-	MMRESULT timePeriodResult = timeBeginPeriod(1);
-	r32 frameTarget = (r32)1000 / 60; // 1000ms = 1s diveded by how many frames per second = how many ms/frame
-	r32 sleepOffset = 1.0;
-
-#ifdef NINETAILSX_DEBUG
-	// We want to make sure we get our requested time period in debug.
-	assert(timePeriodResult == TIMERR_NOERROR);
-#endif
+	frame_pacer Pacer = CreateFramePacer(60);
+	r32 frameTarget = (r32)Pacer.frameNanoseconds / 1000000.0f; // How many ms/frame.
 
 	/**
 	 * We need to perform engine initialization before we show the window. This will handle any window
@@ -519,8 +662,12 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 	 * the init finishes up, we can begin showing the window and initiated the engine runtime.
 	 */
 	engine_library& EngineLib = ApplicationState->EngineLibrary;
-	EngineLib.EngineInit(ApplicationState->appMemStore, ApplicationState->appMemSize,
-		&ApplicationState->WindowProperties, &ApplicationState->ResourceHandlerInterface);
+	if (EngineLib.EngineInit(ApplicationState->appMemStore, ApplicationState->appMemSize,
+		&ApplicationState->WindowProperties, &ApplicationState->ResourceHandlerInterface) != 0)
+	{
+		OutputDebugStringA("The engine failed to initialize.\n");
+		return 1;
+	}
 
 	if (GetWindowClientSize(WindowHandle) != ApplicationState->WindowProperties.dimensions)
 		SetWindowClientSize(WindowHandle, ApplicationState->WindowProperties.dimensions);
@@ -531,11 +678,40 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 	 * the necessary facilities to reach this point. We will show the window at this point.
 	 */
 	ShowWindow(WindowHandle, CommandShow);
+
+	/**
+	 * Launched with --replay, input.nxrec next to the executable is played back in place of the
+	 * keyboard, from the simulation as it was recorded and at the rate it was recorded at, and we
+	 * close once it runs out. Launched with --record, every step's input is recorded from the
+	 * simulation as it is now and written to input.nxrec when we close.
+	 */
+	u32 StepsPerSecond = 60;
+	b32 Replaying = false;
+	input_replay Replay = {};
+	mapped_resource ReplayFile = {};
+	input ReplayInput = {0};
+	if (Commandline && wcsstr(Commandline, L"--replay"))
+	{
+		Replaying = MapResource("input.nxrec", &ReplayFile) &&
+			OpenInputReplay(&Replay, ReplayFile.data, ReplayFile.size) &&
+			EngineLib.EngineLoadState(Replay.snapshot, Replay.header->snapshotSize) == 0;
+		if (Replaying) StepsPerSecond = Replay.header->stepsPerSecond;
+		else UnmapResource(&ReplayFile);
+	}
+
+	input_recorder Recorder = {};
+	b32 Recording = false;
+	if (Commandline && wcsstr(Commandline, L"--record"))
+		Recording = Win32BeginInputRecording(&Recorder, &EngineLib, StepsPerSecond);
+
+	fixed_timestep Timestep = CreateFixedTimestep(StepsPerSecond);
+	ApplicationState->InputHandle.frameStep = GetTimestepMilliseconds(&Timestep);
 	ApplicationState->isRunnning = true;
-	u64 InitialFrameStamp = GetCurrentPerformanceStamp();
 	while (ApplicationState->isRunnning)
 	{
 
+		NX_PROFILE_SCOPE("Frame");
+
 		/**
 		 * NOTE:
 		 * 			We are handling the window messages, but the state changes happen within
@@ -553,9 +729,8 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		}
 
 		/**
-		 * We have to process input for the engine, so we will do that here. This will also carry over
-		 * the frameStep/deltaTime over to the client, so we need to make sure that we're sending correct
-		 * data.
+		 * We have to process input for the engine, so we will do that here. The frameStep is the fixed
+		 * simulation step, which was set before the loop and never changes.
 		 * 
 		 * Additionally, we will capture the keyboard state as it were since the last message capture.
 		 * This is fine because we pump the message loop at the head of every frame.
@@ -563,7 +738,6 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		 * GetKeyState:
 		 * 			https://docs.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getkeystate
 		 */
-		ApplicationState->InputHandle.frameStep = frameTarget; // Consistent frame steps need target, not actual!
 		ApplicationState->InputHandle.frame_input = currentInput;
 		*currentInput = {0}; // Reset
 
@@ -577,22 +751,46 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		setInputButtonState(VK_DOWN, &previousInput->downButton, &currentInput->downButton);
 
 		/**
-		 * We are executing the engine runtime here.
+		 * We are executing the engine here. First every simulation step which is due, which might be
+		 * none, then the frame itself, drawn as far between the last two steps as the accumulator says.
 		 * 
 		 * NOTE:
-		 * 			The engine runtime contains a number of side-effects we will need to consider.
+		 * 			The engine contains a number of side-effects we will need to consider.
 		 * 			The first side effect is that the engine may request a new window size. We will handle
 		 * 			this accordingly.
 		 * 
-		 * 			The return value of EngineRuntime() determines if the application should close based
-		 * 			on the request of the engine client or user. We need to respect this decision by
-		 * 			exitting gracefully. For now, we are assuming that all non-zero values request a close.
+		 * 			The return values of EngineUpdate() and EngineRender() determine if the application
+		 * 			should close based on the request of the engine client or user. We need to respect this
+		 * 			decision by exitting gracefully. For now, we are assuming that all non-zero values
+		 * 			request a close.
+		 * 
+		 * 			A release is only seen by the first update which runs after it. When no update runs this
+		 * 			frame, the input buffers aren't swapped, so the release is still there for the next frame.
+		 * 			A replay hands each step the input it was recorded with instead.
 		 * 			
 		 * TODO:
 		 * 			Define an enumeration outlining various reasons for closing, such as standard exits,
 		 * 			error exits, re-init exits, etc.
 		 */
-		b32 EngineStatus = EngineLib.EngineRuntime(&ApplicationState->WindowProperties, &ApplicationState->InputHandle); 
+		u32 Steps = AdvanceFixedTimestep(&Timestep);
+		b32 EngineStatus = 0;
+		for (u32 Step = 0; Step < Steps && EngineStatus == 0; ++Step)
+		{
+			if (Replaying)
+			{
+				if (!ReadReplayInput(&Replay, &ReplayInput))
+				{
+					ApplicationState->isRunnning = false;
+					break;
+				}
+				ApplicationState->InputHandle.frame_input = &ReplayInput;
+			}
+
+			RecordInput(&Recorder, ApplicationState->InputHandle.frame_input);
+			EngineStatus = EngineLib.EngineUpdate(&ApplicationState->InputHandle);
+			ClearInputEdges(currentInput);
+		}
+		EngineStatus |= EngineLib.EngineRender(&ApplicationState->WindowProperties, GetTimestepAlpha(&Timestep));
 
 		// If the engine status returns non-zero status, it means we should close.
 		if (EngineStatus != NULL)
@@ -607,46 +805,17 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		/**
 		 * Now that the frame is completed, we can swap the input buffers for the next frame.
 		 */
-		input** placeholder = &currentInput;
-		currentInput = previousInput;
-		previousInput = *placeholder;
+		if (Steps != 0)
+		{
+			input* placeholder = currentInput;
+			currentInput = previousInput;
+			previousInput = placeholder;
+		}
 		
 		/**
-		 * We need to create some v-sync for fixed-physics timescale or something close to it.
-		 * 
-		 * NOTE:
-		 * 			There are some limitations to using sleep as a form of software v-sync. Since
-		 * 			the Windows scheduler does not guarantee that it will switch to our process on time,
-		 * 			we may go below or above our requested sleep time.
-		 * 
-		 * 			We *could* busy spin for the highest-accuracy swap interval, as it will generally
-		 * 			be granular enough for us to hit our vsync timing with great precision. The problem
-		 * 			is that it will busy-spin, burning up the CPU for no other reason but to keep accuracy.
-		 * 			Instead, we can under-estimate our sleep time, guaranteeing that we are short of flip,
-		 * 			busy spin the difference, and keep close to our frame target.
+		 * Software v-sync, so the flip lands on the frame target.
 		 */
-		r32 frameTime = GetPerformanceTimeDifferenceMilliseconds(ApplicationState->PerformanceFrequency,
-			InitialFrameStamp);
-		r32 initFrameTime = frameTime; // frameTime will change during the sleep loop, let's preserve it here.
-
-		r32 sleepTime = frameTarget - frameTime;
-		r32 initSleepTime = (r32)((u32)(sleepTime - sleepOffset));
-		if (sleepTime > 0.0f)
-		{
-			Sleep((u32)(sleepTime-sleepOffset)); // Sleep wants flat ms, so we just truncate the sleep time.
-			frameTime = GetPerformanceTimeDifferenceMilliseconds(ApplicationState->PerformanceFrequency, InitialFrameStamp);
-			sleepTime = frameTarget - frameTime;
-		}
-
-		r32 busySpinTime = sleepTime; // We want to preserve how long we spend busy-spinning.
-		if (busySpinTime > 0.0f)
-		{
-			while (frameTime < frameTarget)
-			{
-				frameTime = GetPerformanceTimeDifferenceMilliseconds(ApplicationState->PerformanceFrequency, InitialFrameStamp);
-				sleepTime = frameTarget - frameTime;
-			}
-		}
+		WaitForNextFrame(&Pacer);
 
 #ifdef NINETAILSX_DEBUG
 		/**
@@ -654,8 +823,10 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		 * do simple performance monitoring.
 		 */
 		char frameDebugString[256];
-		sprintf_s(frameDebugString, 256, "Frame Timing :: Target %.2fms | Actual %.2fms | Sleeptime %.2fs | Spintime %.2fms | Postsleep %.2fms \n",
-			frameTarget, initFrameTime, initSleepTime, busySpinTime, frameTime);
+		sprintf_s(frameDebugString, 256, "Frame Timing :: Target %.2fms | Actual %.2fms | Sleeptime %.2fms | Spintime %.3fms | Margin %.3fms | Missed %llu | Steps %u | Overdraw %.2fx \n",
+			frameTarget, (r64)Pacer.frameTime / 1000000.0, (r64)Pacer.sleepTime / 1000000.0, (r64)Pacer.spinTime / 1000000.0,
+			(r64)Pacer.spinMargin / 1000000.0, (unsigned long long)Pacer.missedDeadlines, Steps,
+			(r64)ApplicationState->WindowProperties.renderStats->overdraw);
 		OutputDebugStringA(frameDebugString);
 #endif
 
@@ -664,14 +835,23 @@ wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PWSTR Commandline, int Com
 		 * just drawing straight to the Window using Window's bitmap drawing method.
 		 */
 		RenderSoftwareBitmap(ApplicationState, ApplicationState->WindowProperties.softwareBitmap,
-			ApplicationState->WindowProperties.dimensions.width, ApplicationState->WindowProperties.dimensions.height);
-
-		/**
-		 * We will now reset everything for the next frame.
-		 */
-		InitialFrameStamp = GetCurrentPerformanceStamp(); // Sets the timing of the next frame.
+			ApplicationState->WindowProperties.dimensions.width, ApplicationState->WindowProperties.dimensions.height,
+			ApplicationState->WindowProperties.dirtyRegions, ApplicationState->WindowProperties.dirtyRegionCount);
 
 	}
 
+	DestroyFramePacer(&Pacer);
+	if (Recording) Win32WriteInputRecording(&Recorder, (char*)"input.nxrec");
+	if (Replaying) UnmapResource(&ReplayFile);
+
+	/**
+	 * Launched with --trace, we leave the last stretch of the run behind in trace.json next to the
+	 * executable, see nxcore/profiler.h.
+	 */
+	if (Commandline && wcsstr(Commandline, L"--trace") && ApplicationState->ResourceHandlerInterface.Profiler)
+		Win32WriteProfilerTrace(ApplicationState->ResourceHandlerInterface.Profiler, (char*)"trace.json");
+
+	EngineLib.EngineShutdown();
+	StopResourceStream(Win32ResourceStream);
 	return(0);
 }
\ No newline at end of file
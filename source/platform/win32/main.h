@@ -8,7 +8,11 @@ typedef struct engine_library
 {
 	fnptr_engine_init* EngineInit;
 	fnptr_engine_reinit* EngineReinit;
-	fnptr_engine_runtime* EngineRuntime;
+	fnptr_engine_update* EngineUpdate;
+	fnptr_engine_render* EngineRender;
+	fnptr_engine_shutdown* EngineShutdown;
+	fnptr_engine_save_state* EngineSaveState;
+	fnptr_engine_load_state* EngineLoadState;
 } engine_library;
 
 typedef struct app_state
@@ -21,8 +25,10 @@ typedef struct app_state
 	action_interface InputHandle;
 	input InputSwapBuffer[2];
 	char BasePath[MAX_PATH];
-	u64 PerformanceFrequency;
 	HDC WindowDeviceContext;
+	b32 PresentFullFrame; // The window lost its contents, present everything rather than the dirty regions.
+	void* PresentedBitmap; // The bitmap presented last, and its size. A different one is presented whole.
+	v2i PresentedBitmapDims;
 	b32 isRunnning;
 } app_state;
 
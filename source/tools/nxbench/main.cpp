@@ -0,0 +1,654 @@
+/**
+ * nx_bench
+ *
+ * Times the hot kernels one at a time, away from the engine: nx_memset, nx_memcopy, DrawRect,
+ * DrawBitmap, DrawLines, DrawTriangles, CreateDIBPixel and the string helpers the platforms build
+ * paths with. Every change to a kernel, its SIMD paths or how the renderer threads it should come
+ * with a before and after from here.
+ *
+ * Each case runs in batches long enough to time with the clock, and the median batch is reported
+ * as ns/op, along with GB/s for the bytes an op reads and writes and pixels per cycle for the
+ * pixels it draws. Cases run hot, on one working set that stays in cache, and cold, rotating
+ * through NX_BENCH_COLD_BYTES of working sets a page apart in a scattered order, so every op starts
+ * from main memory the way a frame's first touch of a layer does.
+ *
+ * Usage:
+ * 			nx_bench [--json] [--filter TEXT] [--simd LEVEL] [--min-time MS] [--reps N]
+ *
+ * 			--json			Prints the results as JSON, for CI to keep and diff between commits.
+ * 			--filter TEXT	Only runs the cases whose name contains TEXT.
+ * 			--simd LEVEL	Caps the kernels at scalar, sse2, avx2 or avx512.
+ * 			--min-time MS	The shortest a batch may run (default 2ms).
+ * 			--reps N		Batches per case, the median is reported (default 9).
+ *
+ * NOTE:
+ * 			Cycles are read with ReadProfilerTicks, which on x86 is the time stamp counter. It
+ * 			runs at a fixed rate rather than the core clock, so pixels per cycle moves with
+ * 			turbo and power states and is only comparable between runs on the same machine.
+ *
+ * 			The kernels are built the way the tree is configured, so their profiler scopes are
+ * 			part of what is measured. Configure with -DNX_PROFILER=OFF to time them bare, and
+ * 			with -DCMAKE_BUILD_TYPE=Release for numbers worth comparing at all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The standard library has to come first, nxcore's keyword macros (internal, global) would break it.
+#include <nxcore/renderer.h>
+#include <nxcore/string.h>
+#include <nxcore/profiler.h>
+#include <nxcore/clock.h>
+
+#ifndef NX_BENCH_COLD_BYTES
+#define NX_BENCH_COLD_BYTES Megabytes(128) // Well past the last level cache of anything we run on.
+#endif
+
+#define NX_BENCH_SLOT_ALIGNMENT Kilobytes(4)
+#define NX_BENCH_MAX_CASES 128
+#define NX_BENCH_MAX_REPS 64
+
+struct bench_case;
+typedef void fnptr_bench_run(bench_case* Case, u64 FirstIteration, u64 Iterations);
+
+typedef struct bench_case
+{
+	char name[64];
+	fnptr_bench_run* run;
+	b32 cold;
+
+	u64 size; // Bytes for the memory kernels, characters for the string helpers.
+	v2i layerDims;
+	v2i position;
+	v2i dims;
+	blend_mode mode;
+	u32 lineCount;
+	b32 smooth;
+	b32 textured;
+	triangle_vertex sprite[6];
+
+	u64 bytesPerOp; // Read and written.
+	u64 pixelsPerOp; // Drawn, after clipping.
+	u64 footprint; // The memory one op works on, which sets how many working sets fit the cold set.
+
+	// Where the op's working sets are, one for a hot case.
+	u8* slots;
+	u64 slotStride;
+	u64 slotMask;
+} bench_case;
+
+typedef struct bench_result
+{
+	r64 nanosecondsPerOp; // The median batch.
+	r64 minNanosecondsPerOp;
+	r64 ticksPerOp;
+	u64 iterations;
+} bench_result;
+
+global u8* BenchPool;
+global volatile u64 BenchSink; // Keeps the results of the pure functions from being optimized away.
+
+/**
+ * The working set for an iteration. Cold cases step through theirs with an odd multiplier, which
+ * visits every slot once per lap without the addresses ever running in a line for the prefetcher.
+ */
+inline u8*
+GetBenchSlot(bench_case* Case, u64 Iteration)
+{
+	return Case->slots + ((Iteration * 0x9E3779B1ull) & Case->slotMask) * Case->slotStride;
+}
+
+inline dibitmap
+GetBenchBitmap(void* Pixels, v2i Dims)
+{
+	dibitmap _bitmap = {};
+	_bitmap.buffer = Pixels;
+	_bitmap.dims = Dims;
+	_bitmap.pitch = Dims.width;
+	return _bitmap;
+}
+
+inline u64
+GetBenchLayerBytes(v2i Dims)
+{
+	return ((u64)Dims.width * (u64)Dims.height * sizeof(u32) + 63) & ~63ull;
+}
+
+/**
+ * The kernels.
+ */
+internal void
+BenchMemset(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+		nx_memset(GetBenchSlot(Case, Iteration), Case->size, (u8)Iteration);
+}
+
+internal void
+BenchMemcopy(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+	{
+		u8* Slot = GetBenchSlot(Case, Iteration);
+		nx_memcopy(Slot + Case->size, Slot, Case->size);
+	}
+}
+
+internal void
+BenchDrawRect(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+	{
+		dibitmap Layer = GetBenchBitmap(GetBenchSlot(Case, Iteration), Case->layerDims);
+		DrawRect(&Layer, Case->position, Case->dims, 0xFF000000 | (u32)Iteration);
+	}
+}
+
+internal void
+BenchDrawBitmap(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+	{
+		u8* Slot = GetBenchSlot(Case, Iteration);
+		dibitmap Layer = GetBenchBitmap(Slot, Case->layerDims);
+		dibitmap Source = GetBenchBitmap(Slot + GetBenchLayerBytes(Case->layerDims), Case->dims);
+		DrawBitmap(&Layer, &Source, Case->position, Case->mode, 0x00FF00FF);
+	}
+}
+
+internal void
+BenchDrawLines(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+	{
+		u8* Slot = GetBenchSlot(Case, Iteration);
+		dibitmap Layer = GetBenchBitmap(Slot, Case->layerDims);
+		DrawLines(&Layer, (line_segment*)(Slot + GetBenchLayerBytes(Case->layerDims)), Case->lineCount, Case->smooth);
+	}
+}
+
+internal void
+BenchDrawTriangles(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+	{
+		u8* Slot = GetBenchSlot(Case, Iteration);
+		dibitmap Layer = GetBenchBitmap(Slot, Case->layerDims);
+		dibitmap Texture = GetBenchBitmap(Slot + GetBenchLayerBytes(Case->layerDims), Case->dims);
+		DrawTriangles(&Layer, Case->sprite, 2, (Case->textured ? &Texture : NULL), 0xFF336699, Case->mode);
+	}
+}
+
+internal void
+BenchCreateDIBPixel(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	v4* Colors = (v4*)Case->slots;
+	u64 ColorMask = Case->size - 1;
+	u64 Sum = 0;
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+		Sum += CreateDIBPixel(Colors[Iteration & ColorMask]);
+	BenchSink += Sum;
+}
+
+internal void
+BenchStringLength(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	u64 Sum = 0;
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+		Sum += StringLength((char*)Case->slots);
+	BenchSink += Sum;
+}
+
+internal void
+BenchConcatenatePath(bench_case* Case, u64 FirstIteration, u64 Iterations)
+{
+	char* BasePath = (char*)Case->slots;
+	char* RelativePath = BasePath + 256;
+	char* Dest = BasePath + 512;
+	for (u64 Iteration = FirstIteration; Iteration < FirstIteration + Iterations; ++Iteration)
+		ConcatenateStrings_s(BasePath, 256, RelativePath, 256, Dest, 512);
+	BenchSink += (u8)Dest[0];
+}
+
+/**
+ * The cases.
+ */
+global bench_case BenchCases[NX_BENCH_MAX_CASES];
+global u32 BenchCaseCount;
+
+internal bench_case*
+AddBenchCase(fnptr_bench_run* Run, b32 Cold, u64 Footprint)
+{
+	assert(BenchCaseCount < NX_BENCH_MAX_CASES);
+	bench_case* Case = &BenchCases[BenchCaseCount++];
+	*Case = {};
+	Case->run = Run;
+	Case->cold = Cold;
+	Case->footprint = Footprint;
+	return Case;
+}
+
+inline const char*
+GetBenchCacheName(b32 Cold)
+{
+	return Cold ? "cold" : "hot";
+}
+
+inline const char*
+GetBenchBlendName(blend_mode Mode)
+{
+	switch (Mode)
+	{
+		case BLEND_COLORKEY: return "colorkey";
+		case BLEND_ALPHA: return "alpha";
+		case BLEND_PREMULTIPLIED: return "premultiplied";
+		case BLEND_ADDITIVE: return "additive";
+		default: return "opaque";
+	}
+}
+
+/**
+ * The pixels actually drawn once a rect at Position is clipped to the layer.
+ */
+inline u64
+GetBenchVisiblePixels(v2i LayerDims, v2i Position, v2i Dims)
+{
+	rect2i Visible = IntersectRect(CreateRect(Position, Dims), CreateRect({0,0}, LayerDims));
+	if (IsRectEmpty(Visible)) return 0;
+	v2i VisibleDims = GetRectDims(Visible);
+	return (u64)VisibleDims.width * (u64)VisibleDims.height;
+}
+
+internal void
+AddBenchRect(const char* Name, v2i LayerDims, v2i Position, v2i Dims)
+{
+	for (b32 Cold = 0; Cold < 2; ++Cold)
+	{
+		bench_case* Case = AddBenchCase(&BenchDrawRect, Cold, GetBenchLayerBytes(LayerDims));
+		Case->layerDims = LayerDims;
+		Case->position = Position;
+		Case->dims = Dims;
+		Case->pixelsPerOp = GetBenchVisiblePixels(LayerDims, Position, Dims);
+		Case->bytesPerOp = Case->pixelsPerOp * sizeof(u32);
+		snprintf(Case->name, sizeof(Case->name), "DrawRect/%dx%d/%s/%s", Dims.width, Dims.height, Name,
+			GetBenchCacheName(Cold));
+	}
+}
+
+internal void
+AddBenchBitmap(const char* Name, v2i Position, v2i Dims, blend_mode Mode)
+{
+	v2i LayerDims = { 640, 576 };
+	for (b32 Cold = 0; Cold < 2; ++Cold)
+	{
+		bench_case* Case = AddBenchCase(&BenchDrawBitmap, Cold, GetBenchLayerBytes(LayerDims) + GetBenchLayerBytes(Dims));
+		Case->layerDims = LayerDims;
+		Case->position = Position;
+		Case->dims = Dims;
+		Case->mode = Mode;
+		Case->pixelsPerOp = GetBenchVisiblePixels(LayerDims, Position, Dims);
+		Case->bytesPerOp = Case->pixelsPerOp * sizeof(u32) * (Mode == BLEND_OPAQUE ? 2 : 3);
+		snprintf(Case->name, sizeof(Case->name), "DrawBitmap/%dx%d/%s/%s/%s", Dims.width, Dims.height,
+			GetBenchBlendName(Mode), Name, GetBenchCacheName(Cold));
+	}
+}
+
+// A sprite turned by 30 degrees in the middle of the layer, two triangles.
+internal void
+AddBenchSprite(v2i Dims, b32 Textured, blend_mode Mode)
+{
+	v2i LayerDims = { 640, 576 };
+	for (b32 Cold = 0; Cold < 2; ++Cold)
+	{
+		bench_case* Case = AddBenchCase(&BenchDrawTriangles, Cold, GetBenchLayerBytes(LayerDims) + GetBenchLayerBytes(Dims));
+		Case->layerDims = LayerDims;
+		Case->dims = Dims;
+		Case->textured = Textured;
+		Case->mode = Mode;
+
+		v2 Corners[4] = { {0,0}, {1,0}, {1,1}, {0,1} };
+		v2 Points[4];
+		for (u32 CornerIndex = 0; CornerIndex < 4; ++CornerIndex)
+		{
+			r32 X = (Corners[CornerIndex].x - 0.5f) * (r32)Dims.width;
+			r32 Y = (Corners[CornerIndex].y - 0.5f) * (r32)Dims.height;
+			Points[CornerIndex] = { 320.0f + X*0.8660254f - Y*0.5f, 288.0f + X*0.5f + Y*0.8660254f };
+		}
+		u32 Order[6] = { 0, 1, 2, 0, 2, 3 };
+		for (u32 VertexIndex = 0; VertexIndex < 6; ++VertexIndex)
+			Case->sprite[VertexIndex] = { Points[Order[VertexIndex]], Corners[Order[VertexIndex]] };
+
+		snprintf(Case->name, sizeof(Case->name), "DrawTriangles/%dx%d/%s/%s/%s", Dims.width, Dims.height,
+			(Textured ? "textured" : "flat"), GetBenchBlendName(Mode), GetBenchCacheName(Cold));
+	}
+}
+
+internal void
+AddBenchCases()
+{
+
+	u64 MemorySizes[] = { 64, Kilobytes(4), Kilobytes(256), Megabytes(16) };
+	for (u32 SizeIndex = 0; SizeIndex < sizeof(MemorySizes) / sizeof(MemorySizes[0]); ++SizeIndex)
+	{
+		u64 Size = MemorySizes[SizeIndex];
+		for (b32 Cold = 0; Cold < 2; ++Cold)
+		{
+			bench_case* Case = AddBenchCase(&BenchMemset, Cold, Size);
+			Case->size = Size;
+			Case->bytesPerOp = Size;
+			snprintf(Case->name, sizeof(Case->name), "nx_memset/%llu/%s", (unsigned long long)Size, GetBenchCacheName(Cold));
+		}
+		for (b32 Cold = 0; Cold < 2; ++Cold)
+		{
+			bench_case* Case = AddBenchCase(&BenchMemcopy, Cold, Size*2);
+			Case->size = Size;
+			Case->bytesPerOp = Size*2;
+			snprintf(Case->name, sizeof(Case->name), "nx_memcopy/%llu/%s", (unsigned long long)Size, GetBenchCacheName(Cold));
+		}
+	}
+
+	// The native layer the engine draws into, and the presented one it is scaled up to.
+	v2i NativeDims = { 160, 144 };
+	v2i PresentDims = { 640, 576 };
+	AddBenchRect("inside", PresentDims, {32,32}, {16,16});
+	AddBenchRect("inside", PresentDims, {32,32}, {64,64});
+	AddBenchRect("inside", PresentDims, {32,32}, {256,256});
+	AddBenchRect("full", NativeDims, {0,0}, NativeDims);
+	AddBenchRect("full", PresentDims, {0,0}, PresentDims);
+	AddBenchRect("clipped", PresentDims, {-32,-32}, {64,64});
+	AddBenchRect("outside", PresentDims, {-100,-100}, {64,64});
+
+	AddBenchBitmap("inside", {32,32}, {16,16}, BLEND_OPAQUE);
+	AddBenchBitmap("inside", {32,32}, {16,16}, BLEND_PREMULTIPLIED);
+	AddBenchBitmap("inside", {32,32}, {64,64}, BLEND_OPAQUE);
+	AddBenchBitmap("inside", {32,32}, {64,64}, BLEND_COLORKEY);
+	AddBenchBitmap("inside", {32,32}, {64,64}, BLEND_ALPHA);
+	AddBenchBitmap("inside", {32,32}, {64,64}, BLEND_PREMULTIPLIED);
+	AddBenchBitmap("inside", {32,32}, {64,64}, BLEND_ADDITIVE);
+	AddBenchBitmap("clipped", {-32,-32}, {64,64}, BLEND_PREMULTIPLIED);
+
+	// Batches of lines scattered over the layer, a few partly off it, as debug overlays draw them.
+	for (b32 Smooth = 0; Smooth < 2; ++Smooth)
+	{
+		for (b32 Cold = 0; Cold < 2; ++Cold)
+		{
+			bench_case* Case = AddBenchCase(&BenchDrawLines, Cold, GetBenchLayerBytes(PresentDims) + 1024*sizeof(line_segment));
+			Case->layerDims = PresentDims;
+			Case->lineCount = 1024;
+			Case->smooth = Smooth;
+			snprintf(Case->name, sizeof(Case->name), "DrawLines/1024/%s/%s", Smooth ? "smooth" : "hard", GetBenchCacheName(Cold));
+		}
+	}
+
+	AddBenchSprite({256,256}, false, BLEND_OPAQUE);
+	AddBenchSprite({64,64}, true, BLEND_OPAQUE);
+	AddBenchSprite({256,256}, true, BLEND_OPAQUE);
+	AddBenchSprite({256,256}, true, BLEND_PREMULTIPLIED);
+
+	// These only ever work on a handful of bytes, so there is no cold case.
+	bench_case* Case = AddBenchCase(&BenchCreateDIBPixel, false, 4096*sizeof(v4));
+	Case->size = 4096;
+	Case->bytesPerOp = sizeof(v4);
+	Case->pixelsPerOp = 1;
+	snprintf(Case->name, sizeof(Case->name), "CreateDIBPixel/hot");
+
+	u64 StringLengths[] = { 16, 256 };
+	for (u32 LengthIndex = 0; LengthIndex < sizeof(StringLengths) / sizeof(StringLengths[0]); ++LengthIndex)
+	{
+		Case = AddBenchCase(&BenchStringLength, false, StringLengths[LengthIndex] + 1);
+		Case->size = StringLengths[LengthIndex];
+		Case->bytesPerOp = StringLengths[LengthIndex];
+		snprintf(Case->name, sizeof(Case->name), "StringLength/%llu/hot", (unsigned long long)Case->size);
+	}
+
+	Case = AddBenchCase(&BenchConcatenatePath, false, 1024);
+	snprintf(Case->name, sizeof(Case->name), "ConcatenateStrings_s/path/hot");
+
+}
+
+/**
+ * Lays out a case's working sets in the pool and fills them with what it reads. Bitmap sources get
+ * a spread of opaque, transparent and partially covered pixels, so no blend path gets to skip
+ * all of its work.
+ */
+internal void
+PrepareBenchCase(bench_case* Case)
+{
+
+	Case->slots = BenchPool;
+	Case->slotStride = (Case->footprint + NX_BENCH_SLOT_ALIGNMENT - 1) & ~((u64)NX_BENCH_SLOT_ALIGNMENT - 1);
+
+	u64 SlotCount = 1;
+	if (Case->cold)
+		while (SlotCount * 2 * Case->slotStride <= NX_BENCH_COLD_BYTES) SlotCount *= 2;
+	Case->slotMask = SlotCount - 1;
+
+	// Only the cases which read pixels need any, the rest write over whatever is there.
+	u32 Random = 0x2545F491;
+	b32 ReadsPixels = (Case->run == &BenchMemcopy || Case->run == &BenchDrawBitmap || Case->run == &BenchDrawTriangles);
+	for (u64 SlotIndex = 0; ReadsPixels && SlotIndex < SlotCount; ++SlotIndex)
+	{
+		u32* Pixels = (u32*)(Case->slots + SlotIndex * Case->slotStride);
+		for (u64 PixelIndex = 0; PixelIndex < Case->footprint / sizeof(u32); ++PixelIndex)
+		{
+			Random ^= Random << 13;
+			Random ^= Random >> 17;
+			Random ^= Random << 5;
+			u32 Alpha = ((Random & 7) < 5) ? 255 : (((Random & 7) < 7) ? 0 : (Random >> 24));
+			u32 Red = (((Random >> 8) & 0xFF) * Alpha) / 255;
+			u32 Green = (((Random >> 16) & 0xFF) * Alpha) / 255;
+			u32 Blue = ((Random & 0xFF) * Alpha) / 255;
+			Pixels[PixelIndex] = (Alpha << 24) | (Red << 16) | (Green << 8) | Blue;
+		}
+	}
+
+	if (Case->run == &BenchDrawLines)
+	{
+		// The same lines in every slot, and the pixels they draw are counted by drawing them once.
+		for (u64 SlotIndex = 0; SlotIndex <= Case->slotMask; ++SlotIndex)
+		{
+			line_segment* Lines = (line_segment*)(Case->slots + SlotIndex * Case->slotStride + GetBenchLayerBytes(Case->layerDims));
+			u32 LineRandom = 0x9E3779B9;
+			for (u32 LineIndex = 0; LineIndex < Case->lineCount; ++LineIndex)
+			{
+				r32 Coordinates[4];
+				for (u32 CoordinateIndex = 0; CoordinateIndex < 4; ++CoordinateIndex)
+				{
+					LineRandom ^= LineRandom << 13;
+					LineRandom ^= LineRandom >> 17;
+					LineRandom ^= LineRandom << 5;
+					r32 Extent = (r32)(CoordinateIndex & 1 ? Case->layerDims.height : Case->layerDims.width);
+					Coordinates[CoordinateIndex] = (r32)(LineRandom % 11000) / 10000.0f * Extent - Extent * 0.05f;
+				}
+				Lines[LineIndex] = { { Coordinates[0], Coordinates[1] }, { Coordinates[2], Coordinates[3] }, 0xFF000000 | LineRandom };
+			}
+		}
+
+		dibitmap Layer = GetBenchBitmap(Case->slots, Case->layerDims);
+		Case->pixelsPerOp = DrawLines(&Layer, (line_segment*)(Case->slots + GetBenchLayerBytes(Case->layerDims)),
+			Case->lineCount, Case->smooth);
+		Case->bytesPerOp = Case->pixelsPerOp * sizeof(u32) * (Case->smooth ? 2 : 1) + Case->lineCount * sizeof(line_segment);
+	}
+	else if (Case->run == &BenchDrawTriangles)
+	{
+		// Only the pixels inside the sprite are drawn, which are counted by drawing it once.
+		dibitmap Layer = GetBenchBitmap(Case->slots, Case->layerDims);
+		dibitmap Texture = GetBenchBitmap(Case->slots + GetBenchLayerBytes(Case->layerDims), Case->dims);
+		Case->pixelsPerOp = DrawTriangles(&Layer, Case->sprite, 2, (Case->textured ? &Texture : NULL), 0xFF336699, Case->mode);
+		Case->bytesPerOp = Case->pixelsPerOp * sizeof(u32) * ((Case->textured ? 1 : 0) + (Case->mode == BLEND_OPAQUE ? 1 : 2));
+	}
+	else if (Case->run == &BenchCreateDIBPixel)
+	{
+		v4* Colors = (v4*)Case->slots;
+		for (u64 ColorIndex = 0; ColorIndex < Case->size; ++ColorIndex)
+		{
+			r32 Shade = (r32)ColorIndex / (r32)Case->size;
+			Colors[ColorIndex] = { Shade, 1.0f - Shade, Shade * 0.5f, 1.0f };
+		}
+	}
+	else if (Case->run == &BenchStringLength)
+	{
+		char* String = (char*)Case->slots;
+		for (u64 CharIndex = 0; CharIndex < Case->size; ++CharIndex) String[CharIndex] = 'a' + (char)(CharIndex % 26);
+		String[Case->size] = '\0';
+	}
+	else if (Case->run == &BenchConcatenatePath)
+	{
+		char* BasePath = (char*)Case->slots;
+		const char BaseText[] = "/home/ninetails/projects/ninetailsx/build/bin/";
+		const char RelativeText[] = "./assets/sprites/characters/test.bmp";
+		memcpy(BasePath, BaseText, sizeof(BaseText));
+		memcpy(BasePath + 256, RelativeText, sizeof(RelativeText));
+		Case->bytesPerOp = (sizeof(BaseText) - 1 + sizeof(RelativeText) - 1) * 2;
+	}
+
+}
+
+internal i32
+CompareBatchTimes(const void* lhs, const void* rhs)
+{
+	r64 a = *(const r64*)lhs;
+	r64 b = *(const r64*)rhs;
+	return (a > b) - (a < b);
+}
+
+/**
+ * Doubles the iteration count until a batch takes at least MinBatchTime, which also warms the case
+ * up, then times the batches.
+ */
+internal bench_result
+RunBenchCase(bench_case* Case, u64 MinBatchTime, u32 Repetitions)
+{
+
+	u64 Iteration = 0;
+	u64 Iterations = 1;
+	for (;;)
+	{
+		u64 Start = GetClockNanoseconds();
+		Case->run(Case, Iteration, Iterations);
+		u64 Elapsed = GetClockNanoseconds() - Start;
+		Iteration += Iterations;
+		if (Elapsed >= MinBatchTime || Iterations >= (1ull << 40)) break;
+		Iterations *= 2;
+	}
+
+	r64 BatchTimes[NX_BENCH_MAX_REPS];
+	r64 BatchTicks[NX_BENCH_MAX_REPS];
+	for (u32 Repetition = 0; Repetition < Repetitions; ++Repetition)
+	{
+		u64 StartTicks = ReadProfilerTicks();
+		u64 Start = GetClockNanoseconds();
+		Case->run(Case, Iteration, Iterations);
+		u64 Elapsed = GetClockNanoseconds() - Start;
+		u64 ElapsedTicks = ReadProfilerTicks() - StartTicks;
+		Iteration += Iterations;
+
+		BatchTimes[Repetition] = (r64)Elapsed / (r64)Iterations;
+		BatchTicks[Repetition] = (r64)ElapsedTicks / (r64)Iterations;
+	}
+
+	qsort(BatchTimes, Repetitions, sizeof(r64), &CompareBatchTimes);
+	qsort(BatchTicks, Repetitions, sizeof(r64), &CompareBatchTimes);
+
+	bench_result _result = {};
+	_result.nanosecondsPerOp = BatchTimes[Repetitions / 2];
+	_result.minNanosecondsPerOp = BatchTimes[0];
+	_result.ticksPerOp = BatchTicks[Repetitions / 2];
+	_result.iterations = Iterations;
+	return _result;
+
+}
+
+i32
+main(i32 argc, char** argv)
+{
+
+	b32 JsonOutput = false;
+	char* Filter = NULL;
+	u64 MinBatchTime = 2000000;
+	u32 Repetitions = 9;
+	for (i32 argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		if (strcmp(argv[argIndex], "--json") == 0)
+			JsonOutput = true;
+		else if (strcmp(argv[argIndex], "--filter") == 0 && argIndex+1 < argc)
+			Filter = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "--min-time") == 0 && argIndex+1 < argc)
+			MinBatchTime = (u64)(atof(argv[++argIndex]) * 1000000.0);
+		else if (strcmp(argv[argIndex], "--reps") == 0 && argIndex+1 < argc)
+			Repetitions = (u32)strtoul(argv[++argIndex], NULL, 10);
+		else if (strcmp(argv[argIndex], "--simd") == 0 && argIndex+1 < argc)
+		{
+			char* Level = argv[++argIndex];
+			if (strcmp(Level, "scalar") == 0) SetSIMDLevelCap(SIMD_LEVEL_SCALAR);
+			else if (strcmp(Level, "sse2") == 0) SetSIMDLevelCap(SIMD_LEVEL_SSE2);
+			else if (strcmp(Level, "avx2") == 0) SetSIMDLevelCap(SIMD_LEVEL_AVX2);
+			else if (strcmp(Level, "avx512") == 0) SetSIMDLevelCap(SIMD_LEVEL_AVX512);
+			else
+			{
+				fprintf(stderr, "Unknown SIMD level %s.\n", Level);
+				return 1;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--json] [--filter TEXT] [--simd LEVEL] [--min-time MS] [--reps N]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (Repetitions == 0) Repetitions = 1;
+	if (Repetitions > NX_BENCH_MAX_REPS) Repetitions = NX_BENCH_MAX_REPS;
+
+	SelectRendererKernels();
+	AddBenchCases();
+
+	BenchPool = (u8*)ReserveVirtualMemory(NULL, NX_BENCH_COLD_BYTES);
+	if (BenchPool == NULL || !CommitVirtualMemory(BenchPool, NX_BENCH_COLD_BYTES))
+	{
+		fprintf(stderr, "Unable to allocate the working sets.\n");
+		return 1;
+	}
+	nx_memset(BenchPool, NX_BENCH_COLD_BYTES); // Fault every page in before anything is timed.
+
+	const char* SIMDLevel = GetSIMDLevelName(GetSIMDLevel());
+	if (JsonOutput)
+	{
+		printf("{\n  \"simd\": \"%s\",\n  \"profiler\": %s,\n  \"benchmarks\": [", SIMDLevel, NX_PROFILER ? "true" : "false");
+	}
+	else
+	{
+		printf("nx_bench :: %s kernels, median of %u batches\n", SIMDLevel, Repetitions);
+		printf("%-44s %12s %12s %10s %12s\n", "case", "ns/op", "min ns/op", "GB/s", "pixels/cycle");
+	}
+
+	b32 FirstResult = true;
+	for (u32 CaseIndex = 0; CaseIndex < BenchCaseCount; ++CaseIndex)
+	{
+		bench_case* Case = &BenchCases[CaseIndex];
+		if (Filter && strstr(Case->name, Filter) == NULL) continue;
+
+		PrepareBenchCase(Case);
+		bench_result Result = RunBenchCase(Case, MinBatchTime, Repetitions);
+		r64 BytesPerSecond = (r64)Case->bytesPerOp / Result.nanosecondsPerOp; // Bytes per ns is GB/s.
+		r64 PixelsPerCycle = (r64)Case->pixelsPerOp / Result.ticksPerOp;
+
+		if (JsonOutput)
+		{
+			printf("%s\n    {\"name\": \"%s\", \"ns_per_op\": %.4f, \"min_ns_per_op\": %.4f, \"gb_per_s\": %.4f, "
+				"\"pixels_per_cycle\": %.4f, \"iterations\": %llu}", FirstResult ? "" : ",", Case->name,
+				Result.nanosecondsPerOp, Result.minNanosecondsPerOp, BytesPerSecond, PixelsPerCycle,
+				(unsigned long long)Result.iterations);
+		}
+		else
+		{
+			printf("%-44s %12.2f %12.2f %10.2f %12.3f\n", Case->name, Result.nanosecondsPerOp,
+				Result.minNanosecondsPerOp, BytesPerSecond, PixelsPerCycle);
+		}
+		FirstResult = false;
+	}
+
+	if (JsonOutput) printf("\n  ]\n}\n");
+	return 0;
+
+}
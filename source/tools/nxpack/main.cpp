@@ -0,0 +1,213 @@
+/**
+ * nxpack
+ * 
+ * Packs everything under an assets directory into a single .nxpak archive (see nxcore/nxpak.h).
+ * Images (BMP, QOI and PNG) are converted to the engine's native pixel layout on the way in, every
+ * other file is stored as it is.
+ * 
+ * Usage:
+ * 			nxpack <assets directory> <output file>
+ * 
+ * NOTE:
+ * 			This runs at build time on the development machine, so unlike the engine it is free
+ * 			to use the standard library for files, directories and containers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+// The standard library has to come first, nxcore's keyword macros (internal, global) would break it.
+#include <nxcore/nxpak.h>
+#include <nxcore/renderer/import.h>
+#include <nxcore/renderer/qoi.h>
+#include <nxcore/renderer/png.h>
+
+typedef struct pack_asset
+{
+	std::string path;
+	u64 id;
+	u32 type;
+	u32 width;
+	u32 height;
+	u32 pitch;
+	std::vector<u8> data;
+} pack_asset;
+
+internal b32
+ReadWholeFile(const std::filesystem::path& path, std::vector<u8>* data)
+{
+
+	FILE* _file = fopen(path.string().c_str(), "rb");
+	if (_file == NULL) return false;
+
+	fseek(_file, 0, SEEK_END);
+	long _size = ftell(_file);
+	fseek(_file, 0, SEEK_SET);
+
+	data->resize(_size > 0 ? (size_t)_size : 0);
+	b32 _read = (data->empty() || fread(data->data(), 1, data->size(), _file) == data->size());
+	fclose(_file);
+	return _read;
+
+}
+
+/**
+ * Imports, or decodes, an image into the renderer's format with the same functions the engine uses.
+ * Returns false for anything they can't handle, which is then packed raw.
+ */
+typedef b32 fnptr_import_image(memarena_t* arena, void* resource, u64 size, dibitmap* bitmap);
+
+internal b32
+ConvertImage(pack_asset* asset, memarena_t* arena, fnptr_import_image* import)
+{
+
+	ResetMemoryArena(arena);
+	dibitmap bitmap;
+	if (!import(arena, asset->data.data(), asset->data.size(), &bitmap)) return false;
+
+	u64 size = (u64)bitmap.pitch * (u64)bitmap.dims.height * sizeof(u32);
+	asset->type = NXPAK_ASSET_BITMAP;
+	asset->width = (u32)bitmap.dims.width;
+	asset->height = (u32)bitmap.dims.height;
+	asset->pitch = (u32)bitmap.pitch;
+	asset->data.assign((u8*)bitmap.buffer, (u8*)bitmap.buffer + size);
+	return true;
+
+}
+
+i32
+main(i32 argc, char** argv)
+{
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <assets directory> <output file>\n", argv[0]);
+		return 1;
+	}
+
+	std::filesystem::path assetDirectory = argv[1];
+	std::error_code error;
+	if (!std::filesystem::is_directory(assetDirectory, error))
+	{
+		fprintf(stderr, "nxpack: %s is not a directory.\n", argv[1]);
+		return 1;
+	}
+
+	/**
+	 * Gather every file, sorted by path so the archive comes out the same on every machine.
+	 */
+	u64 imageMemorySize = Gigabytes(4);
+	void* imageMemory = ReserveVirtualMemory(NULL, imageMemorySize);
+	if (imageMemory == NULL)
+	{
+		fprintf(stderr, "nxpack: unable to reserve memory for decoding images.\n");
+		return 1;
+	}
+	memarena_t imageArena = CreateVirtualMemoryArena(imageMemory, imageMemorySize);
+
+	std::vector<pack_asset> assets;
+	for (const std::filesystem::directory_entry& file : std::filesystem::recursive_directory_iterator(assetDirectory))
+	{
+		if (!file.is_regular_file()) continue;
+
+		pack_asset asset = {};
+		asset.path = file.path().lexically_relative(assetDirectory).generic_string();
+		asset.id = NxpakAssetID(asset.path.c_str());
+		asset.type = NXPAK_ASSET_RAW;
+		if (!ReadWholeFile(file.path(), &asset.data))
+		{
+			fprintf(stderr, "nxpack: unable to read %s.\n", file.path().string().c_str());
+			return 1;
+		}
+
+		std::string extension = file.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".bmp" && !ConvertImage(&asset, &imageArena, &ImportBitmap))
+			fprintf(stderr, "nxpack: %s isn't an uncompressed 24 or 32 bit bitmap, packing it raw.\n", asset.path.c_str());
+		if (extension == ".qoi" && !ConvertImage(&asset, &imageArena, &DecodeQOI))
+			fprintf(stderr, "nxpack: %s isn't a valid QOI image, packing it raw.\n", asset.path.c_str());
+		if (extension == ".png" && !ConvertImage(&asset, &imageArena, &DecodePNG))
+			fprintf(stderr, "nxpack: %s isn't a PNG we can decode (interlaced?), packing it raw.\n", asset.path.c_str());
+
+		assets.push_back(std::move(asset));
+	}
+	std::sort(assets.begin(), assets.end(), [](const pack_asset& a, const pack_asset& b) { return a.path < b.path; });
+
+	/**
+	 * Build the table of contents, at most half full so probes stay short.
+	 */
+	u32 tableCapacity = 16;
+	while (tableCapacity < assets.size() * 2) tableCapacity *= 2;
+	std::vector<nxpak_entry> table(tableCapacity);
+
+	u64 offset = sizeof(nxpak_header) + (u64)tableCapacity * sizeof(nxpak_entry);
+	for (pack_asset& asset : assets)
+	{
+		offset = (offset + NXPAK_BLOB_ALIGNMENT - 1) & ~(u64)(NXPAK_BLOB_ALIGNMENT - 1);
+
+		u32 slot = (u32)asset.id & (tableCapacity - 1);
+		while (table[slot].id != 0)
+		{
+			if (table[slot].id == asset.id)
+			{
+				fprintf(stderr, "nxpack: %s collides with another asset's id.\n", asset.path.c_str());
+				return 1;
+			}
+			slot = (slot + 1) & (tableCapacity - 1);
+		}
+
+		table[slot].id = asset.id;
+		table[slot].offset = offset;
+		table[slot].size = asset.data.size();
+		table[slot].type = asset.type;
+		table[slot].width = asset.width;
+		table[slot].height = asset.height;
+		table[slot].pitch = asset.pitch;
+		offset += asset.data.size();
+	}
+
+	/**
+	 * Write it all out, padding each blob to its alignment.
+	 */
+	FILE* output = fopen(argv[2], "wb");
+	if (output == NULL)
+	{
+		fprintf(stderr, "nxpack: unable to open %s for writing.\n", argv[2]);
+		return 1;
+	}
+
+	nxpak_header header = {};
+	header.magic = NXPAK_MAGIC;
+	header.version = NXPAK_VERSION;
+	header.entryCount = (u32)assets.size();
+	header.tableCapacity = tableCapacity;
+	header.tableOffset = sizeof(nxpak_header);
+
+	b32 written = (fwrite(&header, sizeof(header), 1, output) == 1);
+	written = written && (fwrite(table.data(), sizeof(nxpak_entry), table.size(), output) == table.size());
+
+	u64 position = sizeof(nxpak_header) + (u64)tableCapacity * sizeof(nxpak_entry);
+	static const u8 padding[NXPAK_BLOB_ALIGNMENT] = {};
+	for (pack_asset& asset : assets)
+	{
+		u64 aligned = (position + NXPAK_BLOB_ALIGNMENT - 1) & ~(u64)(NXPAK_BLOB_ALIGNMENT - 1);
+		written = written && (fwrite(padding, 1, (size_t)(aligned - position), output) == aligned - position);
+		written = written && (asset.data.empty() || fwrite(asset.data.data(), 1, asset.data.size(), output) == asset.data.size());
+		position = aligned + asset.data.size();
+	}
+
+	written = (fclose(output) == 0) && written;
+	if (!written)
+	{
+		fprintf(stderr, "nxpack: unable to write %s.\n", argv[2]);
+		return 1;
+	}
+
+	printf("nxpack: packed %u assets into %s (%llu bytes)\n", header.entryCount, argv[2], (unsigned long long)position);
+	return 0;
+
+}